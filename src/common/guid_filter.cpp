@@ -17,3 +17,7 @@
 // {2aac6912-8c07-4952-98d3-115a89c80c99}
 DEFINE_GUID(CLSID_KinectWebCam,
 0x2aac6912, 0x8c07, 0x4952, 0x98, 0xd3, 0x11, 0x5a, 0x89, 0xc8, 0x0c, 0x99);
+
+// {30323449-0000-0010-8000-00aa00389b71} : FOURCC 'I420'
+DEFINE_GUID(MEDIASUBTYPE_KW_I420,
+0x30323449, 0x0000, 0x0010, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71);
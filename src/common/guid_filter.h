@@ -17,4 +17,7 @@
 
 EXTERN_C const GUID CLSID_KinectWebCam;
 
+// I420 media subtype (not declared by every version of uuids.h)
+EXTERN_C const GUID MEDIASUBTYPE_KW_I420;
+
 #endif // KW_GUID_FILTER_H
@@ -14,8 +14,24 @@
 
 SETTING_BOOLEAN(TrackingEnabled,	true)
 SETTING_INTEGER(TrackingJoint,		3)			// JointType_Head
+SETTING_BOOLEAN(TrackingZoom,		false)		// widen the view when the tracked person comes closer
+SETTING_BOOLEAN(TrackingFrameAll,	false)		// keep all tracked people in view (zooms out as far as needed)
+SETTING_INTEGER(TrackingFilter,		0)			// smoothing of the focus : 0 = one euro, 1 = spring, 2 = moving average
+SETTING_INTEGER(TrackingPrediction,	0)			// extrapolate the focus up to this many ms to make up for the tracking latency (0 = off)
+SETTING_STRING(TrackingRecord,		L"")		// write the measured focus points to this file, to replay with focus_eval
+SETTING_INTEGER(TrackingDeadZone,	10)			// the crop stays put while the focus moves this far from its center (% of the crop)
+SETTING_INTEGER(TrackingPanSpeed,	50)			// and pans at most this fast when it has to follow (% of the crop width per second)
 
 SETTING_BOOLEAN(GreenScreenEnabled, false)
+SETTING_BOOLEAN(GreenScreenLowRes,	false)		// build the mask at depth resolution (faster, softer edges)
+SETTING_BOOLEAN(GreenScreenSoftEdges, false)	// feathered, temporally smoothed edges (in the alpha channel of RGB32 output)
+SETTING_INTEGER(GreenScreenKeying,	0)			// 0 = tracked bodies, 1 = depth range, 2 = tracked bodies within the depth range
+SETTING_INTEGER(GreenScreenNear,	500)		// depth range in millimeters
+SETTING_INTEGER(GreenScreenFar,		2000)
+SETTING_STRING(GreenScreenBackground, L"")		// image file shown behind the people (empty = black)
+SETTING_INTEGER(GreenScreenBlur,	0)			// blur the background instead : 0 = off, 1 = low, 2 = medium, 3 = high
+
+SETTING_BOOLEAN(MirrorOutput,		false)		// show the image as a mirror, left and right swapped
 
 SETTING_BOOLEAN(KinectV1Enabled,	true)
 SETTING_BOOLEAN(KinectV2Enabled,	true)
@@ -0,0 +1,640 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	coordinate_mapper.cpp
+//
+// Purpose	: 	map between the depth and the color image without the sensor runtime
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "coordinate_mapper.h"
+#include "image_kernels.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <string>
+
+namespace keying {
+
+namespace {
+
+const char *CALIBRATION_HEADER	= "kinect_webcam_calibration";
+const int	CALIBRATION_VERSION = 1;
+
+// the grid of projection_samples : rays in each direction, the depths in meters
+const int	SAMPLE_GRID		= 16;
+const float SAMPLE_DEPTHS[] = {0.5f, 1.0f, 2.0f, 4.0f};
+
+// where the footprint of a depth pixel is measured (see CoordinateMapper::configure), in millimeters
+const uint16_t FOOTPRINT_DEPTH = 1500;
+
+// mappings_match
+const float MATCH_MEAN_ERROR	= 1.0f;
+const float MATCH_MAX_ERROR		= 4.0f;
+const int	MATCH_MISMATCHED	= 100;			// at most one in this many points
+
+inline bool inside_color(const ColorPoint &p_point, int p_width, int p_height)
+{
+	// false for infinity and NaN
+	return p_point.m_x >= 0.0f && p_point.m_x < p_width && p_point.m_y >= 0.0f && p_point.m_y < p_height;
+}
+
+inline void project(const float *p_projection, float p_x, float p_y, float p_z, ColorPoint &p_point)
+{
+	const float f_w = (p_projection[8] * p_x) + (p_projection[9] * p_y) + (p_projection[10] * p_z) + p_projection[11];
+
+	p_point.m_x = ((p_projection[0] * p_x) + (p_projection[1] * p_y) + (p_projection[2] * p_z) + p_projection[3]) / f_w;
+	p_point.m_y = ((p_projection[4] * p_x) + (p_projection[5] * p_y) + (p_projection[6] * p_z) + p_projection[7]) / f_w;
+}
+
+// a pair of points fit_color_projection can use : the sensor runtime found a position, the point is in front of the depth camera
+inline bool usable_sample(const float *p_camera_point, const ColorPoint &p_color_point)
+{
+	return std::isfinite(p_color_point.m_x) && std::isfinite(p_color_point.m_y) && p_camera_point[2] > 0.0f;
+}
+
+// solve p_a * x = p_b in place (gaussian elimination with partial pivoting), the solution ends up in p_b
+template <int N>
+bool solve(double (&p_a)[N][N], double (&p_b)[N])
+{
+	for (int f_col = 0; f_col < N; ++f_col)
+	{
+		int f_pivot = f_col;
+
+		for (int f_row = f_col + 1; f_row < N; ++f_row)
+		{
+			if (std::fabs(p_a[f_row][f_col]) > std::fabs(p_a[f_pivot][f_col]))
+				f_pivot = f_row;
+		}
+
+		if (std::fabs(p_a[f_pivot][f_col]) < 1e-12)
+			return false;
+
+		std::swap(p_a[f_col], p_a[f_pivot]);
+		std::swap(p_b[f_col], p_b[f_pivot]);
+
+		for (int f_row = f_col + 1; f_row < N; ++f_row)
+		{
+			const double f_factor = p_a[f_row][f_col] / p_a[f_col][f_col];
+
+			for (int f_c = f_col; f_c < N; ++f_c)
+				p_a[f_row][f_c] -= f_factor * p_a[f_col][f_c];
+
+			p_b[f_row] -= f_factor * p_b[f_col];
+		}
+	}
+
+	for (int f_row = N - 1; f_row >= 0; --f_row)
+	{
+		for (int f_c = f_row + 1; f_c < N; ++f_c)
+			p_b[f_row] -= p_a[f_row][f_c] * p_b[f_c];
+
+		p_b[f_row] /= p_a[f_row][f_row];
+	}
+
+	return true;
+}
+
+// the points color_to_depth writes
+inline void set_point(DepthPoint &p_point, int p_x, int p_y, uint16_t)
+{
+	p_point.m_x = static_cast<float> (p_x);
+	p_point.m_y = static_cast<float> (p_y);
+}
+
+inline void set_point(DepthPixelPoint &p_point, int p_x, int p_y, uint16_t p_depth)
+{
+	p_point = {p_x, p_y, p_depth, 0};
+}
+
+inline void clear_point(DepthPoint &p_point)
+{
+	p_point.m_x = -std::numeric_limits<float>::infinity();
+	p_point.m_y = -std::numeric_limits<float>::infinity();
+}
+
+inline void clear_point(DepthPixelPoint &p_point)
+{
+	p_point = {-1, -1, 0, 0};
+}
+
+// rounds down, for positions above -64 (a few footprints left of the color image at most)
+inline int floor_int(float p_pos)
+{
+	return static_cast<int> (p_pos + 64.0f) - 64;
+}
+
+// the first color pixel past a depth pixel : where its neighbour lands, unless that is not a plausible next position
+// (behind it, too far away, or no position at all at the edge of an object)
+inline int footprint_end(float p_pos, float p_next, int p_start, int p_footprint)
+{
+	if (p_next >= p_pos && p_next - p_pos <= static_cast<float> (2 * p_footprint))
+		return floor_int(p_next);
+
+	return p_start + p_footprint;
+}
+
+// the depth of the nearest depth pixel for each column of the color row being registered, reused from frame to frame
+// (each thread that registers rows has its own)
+thread_local std::vector<uint16_t> g_nearest;
+
+} // unnamed namespace
+
+//
+// calibration
+//
+
+std::vector<float> projection_samples(const CameraCalibration &p_calibration)
+{
+	std::vector<float> f_samples;
+
+	if (static_cast<int> (p_calibration.m_depth_rays.size()) != p_calibration.m_depth_width * p_calibration.m_depth_height)
+		return f_samples;
+
+	for (float f_z : SAMPLE_DEPTHS)
+	{
+		for (int f_gy = 0; f_gy < SAMPLE_GRID; ++f_gy)
+		{
+			for (int f_gx = 0; f_gx < SAMPLE_GRID; ++f_gx)
+			{
+				// from edge to edge of the depth frame
+				const int		  f_x	= (f_gx * (p_calibration.m_depth_width - 1)) / (SAMPLE_GRID - 1);
+				const int		  f_y	= (f_gy * (p_calibration.m_depth_height - 1)) / (SAMPLE_GRID - 1);
+				const ColorPoint &f_ray = p_calibration.m_depth_rays[(f_y * p_calibration.m_depth_width) + f_x];
+
+				f_samples.insert(f_samples.end(), {f_ray.m_x * f_z, f_ray.m_y * f_z, f_z});
+			}
+		}
+	}
+
+	return f_samples;
+}
+
+bool fit_color_projection(const float *p_camera_points, const ColorPoint *p_color_points, int p_count, float *p_projection)
+{
+	// center and scale the color points : keeps the normal equations well conditioned
+	double	f_cu	= 0.0;
+	double	f_cv	= 0.0;
+	int		f_valid = 0;
+
+	for (int f_i = 0; f_i < p_count; ++f_i)
+	{
+		if (usable_sample(p_camera_points + (f_i * 3), p_color_points[f_i]))
+		{
+			f_cu += p_color_points[f_i].m_x;
+			f_cv += p_color_points[f_i].m_y;
+			++f_valid;
+		}
+	}
+
+	if (f_valid < 6)
+		return false;
+
+	f_cu /= f_valid;
+	f_cv /= f_valid;
+
+	double f_scale = 0.0;
+
+	for (int f_i = 0; f_i < p_count; ++f_i)
+	{
+		if (usable_sample(p_camera_points + (f_i * 3), p_color_points[f_i]))
+			f_scale += std::fabs(p_color_points[f_i].m_x - f_cu) + std::fabs(p_color_points[f_i].m_y - f_cv);
+	}
+
+	f_scale = std::max(f_scale / (2.0 * f_valid), 1.0);
+
+	// u (p8 x + p9 y + z + p11) = p0 x + p1 y + p2 z + p3 (and the same for v) : the z coefficient of the third row is fixed to one,
+	// the cameras look the same way (the translation in the third row is close to zero, it can't be the one that is fixed)
+	double f_ata[11][11] = {};
+	double f_atb[11]	 = {};
+
+	auto f_add = [&](const double (&p_row)[11], double p_value) {
+		for (int f_r = 0; f_r < 11; ++f_r)
+		{
+			for (int f_c = 0; f_c < 11; ++f_c)
+				f_ata[f_r][f_c] += p_row[f_r] * p_row[f_c];
+
+			f_atb[f_r] += p_row[f_r] * p_value;
+		}
+	};
+
+	for (int f_i = 0; f_i < p_count; ++f_i)
+	{
+		if (!usable_sample(p_camera_points + (f_i * 3), p_color_points[f_i]))
+			continue;
+
+		const double f_x = p_camera_points[(f_i * 3)];
+		const double f_y = p_camera_points[(f_i * 3) + 1];
+		const double f_z = p_camera_points[(f_i * 3) + 2];
+		const double f_u = (p_color_points[f_i].m_x - f_cu) / f_scale;
+		const double f_v = (p_color_points[f_i].m_y - f_cv) / f_scale;
+
+		f_add({f_x, f_y, f_z, 1.0, 0.0, 0.0, 0.0, 0.0, -f_u * f_x, -f_u * f_y, -f_u}, f_u * f_z);
+		f_add({0.0, 0.0, 0.0, 0.0, f_x, f_y, f_z, 1.0, -f_v * f_x, -f_v * f_y, -f_v}, f_v * f_z);
+	}
+
+	if (!solve(f_ata, f_atb))
+		return false;
+
+	// back to pixels : u = scale * u' + center
+	const double f_third[4] = {f_atb[8], f_atb[9], 1.0, f_atb[10]};
+
+	for (int f_c = 0; f_c < 4; ++f_c)
+	{
+		p_projection[f_c]	  = static_cast<float> ((f_scale * f_atb[f_c]) + (f_cu * f_third[f_c]));
+		p_projection[4 + f_c] = static_cast<float> ((f_scale * f_atb[4 + f_c]) + (f_cv * f_third[f_c]));
+		p_projection[8 + f_c] = static_cast<float> (f_third[f_c]);
+	}
+
+	return true;
+}
+
+void fit_color_offsets(CameraCalibration &p_calibration, const ColorPoint *p_color_points, uint16_t p_depth)
+{
+	const float f_z = p_depth * 0.001f;
+
+	p_calibration.m_color_offsets.resize(p_calibration.m_depth_rays.size());
+
+	for (size_t f_i = 0; f_i < p_calibration.m_depth_rays.size(); ++f_i)
+	{
+		const ColorPoint &f_ray = p_calibration.m_depth_rays[f_i];
+		ColorPoint		  f_projected;
+
+		project(p_calibration.m_color_projection, f_ray.m_x * f_z, f_ray.m_y * f_z, f_z, f_projected);
+
+		const ColorPoint f_offset = {p_color_points[f_i].m_x - f_projected.m_x, p_color_points[f_i].m_y - f_projected.m_y};
+
+		// no correction where the sensor runtime has no position
+		p_calibration.m_color_offsets[f_i] = (std::isfinite(f_offset.m_x) && std::isfinite(f_offset.m_y)) ? f_offset : ColorPoint{0.0f, 0.0f};
+	}
+}
+
+MappingError compare_mappings(const ColorPoint *p_a, const ColorPoint *p_b, int p_count, int p_color_width, int p_color_height)
+{
+	MappingError f_error = {0, 0, 0.0f, 0.0f};
+	double		 f_sum	 = 0.0;
+
+	for (int f_i = 0; f_i < p_count; ++f_i)
+	{
+		const bool f_inside_a = inside_color(p_a[f_i], p_color_width, p_color_height);
+		const bool f_inside_b = inside_color(p_b[f_i], p_color_width, p_color_height);
+
+		if (f_inside_a != f_inside_b)
+		{
+			++f_error.m_mismatched;
+			continue;
+		}
+
+		if (!f_inside_a)
+			continue;
+
+		const float f_dist = std::hypot(p_a[f_i].m_x - p_b[f_i].m_x, p_a[f_i].m_y - p_b[f_i].m_y);
+
+		++f_error.m_compared;
+		f_sum		   += f_dist;
+		f_error.m_max	= std::max(f_error.m_max, f_dist);
+	}
+
+	f_error.m_mean = (f_error.m_compared > 0) ? static_cast<float> (f_sum / f_error.m_compared) : 0.0f;
+	return f_error;
+}
+
+bool mappings_match(const MappingError &p_error)
+{
+	return	p_error.m_compared > 0 &&
+			p_error.m_mean <= MATCH_MEAN_ERROR &&
+			p_error.m_max <= MATCH_MAX_ERROR &&
+			p_error.m_mismatched * MATCH_MISMATCHED <= p_error.m_compared;
+}
+
+bool write_calibration(std::ostream &p_stream, const CameraCalibration &p_calibration)
+{
+	const size_t f_size = static_cast<size_t> (p_calibration.m_depth_width) * p_calibration.m_depth_height;
+
+	if (p_calibration.m_depth_rays.size() != f_size || (!p_calibration.m_color_offsets.empty() && p_calibration.m_color_offsets.size() != f_size))
+		return false;
+
+	// enough digits for the floats to read back exactly
+	p_stream.precision(std::numeric_limits<float>::max_digits10);
+
+	p_stream << CALIBRATION_HEADER << " " << CALIBRATION_VERSION << "\n";
+	p_stream << "depth_size " << p_calibration.m_depth_width << " " << p_calibration.m_depth_height << "\n";
+	p_stream << "color_projection";
+
+	for (float f_value : p_calibration.m_color_projection)
+		p_stream << " " << f_value;
+
+	p_stream << "\ndepth_rays\n";
+
+	for (const auto &f_ray : p_calibration.m_depth_rays)
+		p_stream << f_ray.m_x << " " << f_ray.m_y << "\n";
+
+	p_stream << "color_offsets " << p_calibration.m_color_offsets.size() << "\n";
+
+	for (const auto &f_offset : p_calibration.m_color_offsets)
+		p_stream << f_offset.m_x << " " << f_offset.m_y << "\n";
+
+	return p_stream.good();
+}
+
+bool read_calibration(std::istream &p_stream, CameraCalibration &p_calibration)
+{
+	std::string f_token;
+	int			f_version = 0;
+
+	if (!(p_stream >> f_token >> f_version) || f_token != CALIBRATION_HEADER || f_version != CALIBRATION_VERSION)
+		return false;
+
+	CameraCalibration f_cal;
+
+	if (!(p_stream >> f_token >> f_cal.m_depth_width >> f_cal.m_depth_height) || f_token != "depth_size" ||
+		f_cal.m_depth_width <= 0 || f_cal.m_depth_height <= 0)
+	{
+		return false;
+	}
+
+	if (!(p_stream >> f_token) || f_token != "color_projection")
+		return false;
+
+	for (float &f_value : f_cal.m_color_projection)
+		p_stream >> f_value;
+
+	if (!(p_stream >> f_token) || f_token != "depth_rays")
+		return false;
+
+	f_cal.m_depth_rays.resize(static_cast<size_t> (f_cal.m_depth_width) * f_cal.m_depth_height);
+
+	for (auto &f_ray : f_cal.m_depth_rays)
+		p_stream >> f_ray.m_x >> f_ray.m_y;
+
+	size_t f_offsets = 0;
+
+	if (!(p_stream >> f_token >> f_offsets) || f_token != "color_offsets" || (f_offsets != 0 && f_offsets != f_cal.m_depth_rays.size()))
+		return false;
+
+	f_cal.m_color_offsets.resize(f_offsets);
+
+	for (auto &f_offset : f_cal.m_color_offsets)
+		p_stream >> f_offset.m_x >> f_offset.m_y;
+
+	if (p_stream.fail())
+		return false;
+
+	p_calibration = std::move(f_cal);
+	return true;
+}
+
+//
+// CoordinateMapper
+//
+
+CoordinateMapper::CoordinateMapper() :	m_depth_width(0),
+										m_depth_height(0),
+										m_color_width(0),
+										m_color_height(0),
+										m_footprint_x(1),
+										m_footprint_y(1),
+										m_offset{0.0f, 0.0f, 0.0f}
+{
+}
+
+bool CoordinateMapper::configure(const CameraCalibration &p_calibration, int p_color_width, int p_color_height)
+{
+	const size_t f_size = static_cast<size_t> (p_calibration.m_depth_width) * p_calibration.m_depth_height;
+
+	reset();
+
+	if (f_size == 0 || p_color_width <= 0 || p_color_height <= 0 || p_calibration.m_depth_rays.size() != f_size ||
+		(!p_calibration.m_color_offsets.empty() && p_calibration.m_color_offsets.size() != f_size))
+	{
+		return false;
+	}
+
+	// with the point (rx * z, ry * z, z) the projection is z * (P0 rx + P1 ry + P2) + P3 : only the part in parentheses depends on the pixel
+	const float *f_p = p_calibration.m_color_projection;
+
+	m_coef_u.resize(f_size);
+	m_coef_v.resize(f_size);
+	m_coef_w.resize(f_size);
+
+	for (size_t f_i = 0; f_i < f_size; ++f_i)
+	{
+		const ColorPoint &f_ray = p_calibration.m_depth_rays[f_i];
+
+		m_coef_u[f_i] = (f_p[0] * f_ray.m_x) + (f_p[1] * f_ray.m_y) + f_p[2];
+		m_coef_v[f_i] = (f_p[4] * f_ray.m_x) + (f_p[5] * f_ray.m_y) + f_p[6];
+		m_coef_w[f_i] = (f_p[8] * f_ray.m_x) + (f_p[9] * f_ray.m_y) + f_p[10];
+
+		// the offsets move the point in the color image : u / w + du = (u + du * w) / w (exact when P11 is zero, close enough otherwise)
+		if (!p_calibration.m_color_offsets.empty())
+		{
+			m_coef_u[f_i] += p_calibration.m_color_offsets[f_i].m_x * m_coef_w[f_i];
+			m_coef_v[f_i] += p_calibration.m_color_offsets[f_i].m_y * m_coef_w[f_i];
+		}
+	}
+
+	m_offset[0]		= f_p[3];
+	m_offset[1]		= f_p[7];
+	m_offset[2]		= f_p[11];
+	m_depth_width	= p_calibration.m_depth_width;
+	m_depth_height	= p_calibration.m_depth_height;
+	m_color_width	= p_color_width;
+	m_color_height	= p_color_height;
+
+	m_points.resize(f_size);
+	m_footprints.resize(f_size);
+	m_row_top.resize(m_depth_height);
+	m_row_bottom.resize(m_depth_height);
+
+	// the size of a depth pixel in the color image : in the center of the frame, at a typical distance
+	const auto &	f_kernel   = img::kernels::row_kernels().m_depth_to_color;
+	const int		f_center   = ((m_depth_height / 2) * m_depth_width) + (m_depth_width / 2);
+	const uint16_t	f_depth[2] = {FOOTPRINT_DEPTH, FOOTPRINT_DEPTH};
+	ColorPoint		f_pos[2];
+	ColorPoint		f_below;
+
+	auto f_map = [&](int p_idx, int p_count, ColorPoint *p_points) {
+		const img::kernels::DepthColorCoefficients f_coefficients = {	&m_coef_u[p_idx], &m_coef_v[p_idx], &m_coef_w[p_idx],
+																		{m_offset[0], m_offset[1], m_offset[2]}};
+		f_kernel(f_depth, f_coefficients, &p_points->m_x, p_count);
+	};
+
+	f_map(f_center, 2, f_pos);
+	f_map(f_center + m_depth_width, 1, &f_below);
+
+	const float f_size_x = std::fabs(f_pos[1].m_x - f_pos[0].m_x);
+	const float f_size_y = std::fabs(f_below.m_y - f_pos[0].m_y);
+
+	m_footprint_x = (std::isfinite(f_size_x)) ? std::max(1, std::min(16, static_cast<int> (std::ceil(f_size_x)))) : 1;
+	m_footprint_y = (std::isfinite(f_size_y)) ? std::max(1, std::min(16, static_cast<int> (std::ceil(f_size_y)))) : 1;
+
+	return true;
+}
+
+void CoordinateMapper::reset()
+{
+	m_depth_width  = 0;
+	m_depth_height = 0;
+	m_color_width  = 0;
+	m_color_height = 0;
+
+	m_coef_u.clear();
+	m_coef_v.clear();
+	m_coef_w.clear();
+	m_points.clear();
+	m_footprints.clear();
+	m_row_top.clear();
+	m_row_bottom.clear();
+}
+
+bool CoordinateMapper::valid() const
+{
+	return m_depth_width > 0 && m_color_width > 0;
+}
+
+bool CoordinateMapper::depth_to_color(const uint16_t *p_depth, ColorPoint *p_points) const
+{
+	if (!valid())
+		return false;
+
+	const auto &f_kernels = img::kernels::row_kernels();
+
+	parallel::for_each_stripe(m_depth_height, m_depth_width * static_cast<int> (sizeof(ColorPoint)), [&](int p_begin, int p_end) {
+		const int f_first = p_begin * m_depth_width;
+		const img::kernels::DepthColorCoefficients f_coefficients = {	m_coef_u.data() + f_first, m_coef_v.data() + f_first, m_coef_w.data() + f_first,
+																		{m_offset[0], m_offset[1], m_offset[2]}};
+
+		f_kernels.m_depth_to_color(p_depth + f_first, f_coefficients, &p_points[f_first].m_x, (p_end - p_begin) * m_depth_width);
+	});
+
+	return true;
+}
+
+DepthToColorFunc CoordinateMapper::depth_to_color_func() const
+{
+	return [this](const uint16_t *p_depth, ColorPoint *p_points) -> bool {
+		return depth_to_color(p_depth, p_points);
+	};
+}
+
+bool CoordinateMapper::color_to_depth(const uint16_t *p_depth, int p_x, int p_y, int p_width, int p_height, DepthPoint *p_points)
+{
+	return register_color(p_depth, p_x, p_y, p_width, p_height, p_points);
+}
+
+bool CoordinateMapper::color_to_depth(const uint16_t *p_depth, int p_x, int p_y, int p_width, int p_height, DepthPixelPoint *p_points)
+{
+	return register_color(p_depth, p_x, p_y, p_width, p_height, p_points);
+}
+
+template <typename Point>
+bool CoordinateMapper::register_color(const uint16_t *p_depth, int p_x, int p_y, int p_width, int p_height, Point *p_points)
+{
+	if (!valid() || p_x < 0 || p_y < 0 || p_width <= 0 || p_height <= 0 || p_x + p_width > m_color_width || p_y + p_height > m_color_height)
+		return false;
+
+	// every depth pixel to the color image once, and the rectangle of color pixels it covers
+	depth_to_color(p_depth, m_points.data());
+
+	parallel::for_each_stripe(m_depth_height, m_depth_width * static_cast<int> (sizeof(Footprint)), [&](int p_begin, int p_end) {
+		const float f_min_x = -static_cast<float> (2 * m_footprint_x);
+		const float f_min_y = -static_cast<float> (2 * m_footprint_y);
+
+		for (int f_dy = p_begin; f_dy < p_end; ++f_dy)
+		{
+			const int f_row	   = f_dy * m_depth_width;
+			int		  f_top	   = m_color_height;
+			int		  f_bottom = 0;
+
+			for (int f_dx = 0; f_dx < m_depth_width; ++f_dx)
+			{
+				const ColorPoint &f_pos		  = m_points[f_row + f_dx];
+				Footprint &		  f_footprint = m_footprints[f_row + f_dx];
+
+				// also skips the pixels without a position (-infinity)
+				if (!(f_pos.m_x > f_min_x && f_pos.m_x < m_color_width && f_pos.m_y > f_min_y && f_pos.m_y < m_color_height))
+				{
+					f_footprint = {0, 0, 0, 0};
+					continue;
+				}
+
+				const int f_u0 = floor_int(f_pos.m_x);
+				const int f_v0 = floor_int(f_pos.m_y);
+				const int f_u1 = (f_dx + 1 < m_depth_width) ? footprint_end(f_pos.m_x, m_points[f_row + f_dx + 1].m_x, f_u0, m_footprint_x)
+															: f_u0 + m_footprint_x;
+				const int f_v1 = (f_dy + 1 < m_depth_height) ? footprint_end(f_pos.m_y, m_points[f_row + m_depth_width + f_dx].m_y, f_v0, m_footprint_y)
+															 : f_v0 + m_footprint_y;
+
+				f_footprint = {	static_cast<int16_t> (std::max(f_u0, 0)), static_cast<int16_t> (std::max(f_v0, 0)),
+								static_cast<int16_t> (std::min(f_u1, m_color_width)), static_cast<int16_t> (std::min(f_v1, m_color_height))};
+
+				if (f_footprint.m_x0 < f_footprint.m_x1 && f_footprint.m_y0 < f_footprint.m_y1)
+				{
+					f_top	 = std::min(f_top, static_cast<int> (f_footprint.m_y0));
+					f_bottom = std::max(f_bottom, static_cast<int> (f_footprint.m_y1));
+				}
+			}
+
+			m_row_top[f_dy]	   = f_top;
+			m_row_bottom[f_dy] = f_bottom;
+		}
+	});
+
+	// row by row : every thread fills a stripe of the region, the depth of the nearest pixel only has to be kept for the current row
+	// (it stays in the cache, and every point is written out once)
+	parallel::for_each_stripe(p_height, p_width * static_cast<int> (sizeof(Point)), [&](int p_begin, int p_end) {
+		const int			   f_right	 = p_x + p_width;
+		std::vector<uint16_t> &f_nearest = g_nearest;
+
+		f_nearest.resize(m_color_width);
+
+		for (int f_y = p_y + p_begin; f_y < p_y + p_end; ++f_y)
+		{
+			Point *f_points = p_points + (static_cast<size_t> (f_y) * m_color_width);
+
+			std::for_each(f_points + p_x, f_points + f_right, [](Point &p_point) { clear_point(p_point); });
+			std::fill(f_nearest.begin() + p_x, f_nearest.begin() + f_right, std::numeric_limits<uint16_t>::max());
+
+			for (int f_dy = 0; f_dy < m_depth_height; ++f_dy)
+			{
+				if (f_y < m_row_top[f_dy] || f_y >= m_row_bottom[f_dy])
+					continue;
+
+				const int f_row = f_dy * m_depth_width;
+
+				for (int f_dx = 0; f_dx < m_depth_width; ++f_dx)
+				{
+					const Footprint &f_footprint = m_footprints[f_row + f_dx];
+
+					if (f_y < f_footprint.m_y0 || f_y >= f_footprint.m_y1)
+						continue;
+
+					const int	   f_x_end = std::min(static_cast<int> (f_footprint.m_x1), f_right);
+					const uint16_t f_depth = p_depth[f_row + f_dx];
+
+					for (int f_x = std::max(static_cast<int> (f_footprint.m_x0), p_x); f_x < f_x_end; ++f_x)
+					{
+						if (f_depth < f_nearest[f_x])
+						{
+							f_nearest[f_x] = f_depth;
+							set_point(f_points[f_x], f_dx, f_dy, f_depth);
+						}
+					}
+				}
+			}
+		}
+	});
+
+	return true;
+}
+
+} // namespace keying
@@ -0,0 +1,142 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	coordinate_mapper.h
+//
+// Purpose	: 	map between the depth and the color image without the sensor runtime
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef KW_COORDINATE_MAPPER_H
+#define KW_COORDINATE_MAPPER_H
+
+#include "keying.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+namespace keying {
+
+// a position in the depth image (same layout as the DepthSpacePoint of the Kinect v2 SDK)
+struct DepthPoint
+{
+	float	m_x;
+	float	m_y;
+};
+
+// a depth pixel (same layout as the NUI_DEPTH_IMAGE_POINT of the Kinect v1 SDK)
+struct DepthPixelPoint
+{
+	int32_t	m_x;
+	int32_t	m_y;
+	int32_t	m_depth;			// millimeters
+	int32_t	m_reserved;
+};
+
+// the calibration of the depth and the color camera
+//	- captured once from the sensor runtime (see fit_color_projection) or read from a file (see read_calibration)
+struct CameraCalibration
+{
+	int						m_depth_width;
+	int						m_depth_height;
+	std::vector<ColorPoint>	m_depth_rays;			// for each depth pixel : x / z and y / z of its ray in depth camera space
+													// (e.g. from ICoordinateMapper::GetDepthFrameToCameraSpaceTable)
+	float					m_color_projection[12];	// depth camera space (meters) to color pixels : K [R | t], 3x4 row major
+	std::vector<ColorPoint>	m_color_offsets;		// optional : for each depth pixel, what the projection misses in color pixels
+													// (the lens distortion of the color camera), empty = none
+};
+
+// points in depth camera space (x, y, z in meters) to fit the projection to : a grid over the depth rays at several depths
+std::vector<float> projection_samples(const CameraCalibration &p_calibration);
+
+// fit the projection onto the color image to pairs of points in depth camera space and in the color image
+//	- a linear least squares fit (DLT), the points have to span a volume (see projection_samples)
+bool fit_color_projection(const float *p_camera_points, const ColorPoint *p_color_points, int p_count, float *p_projection);
+
+// what the projection misses for each depth pixel of a frame the sensor runtime mapped (a flat frame of p_depth millimeters)
+void fit_color_offsets(CameraCalibration &p_calibration, const ColorPoint *p_color_points, uint16_t p_depth);
+
+// how far two mappings of the same depth frame are apart, in color pixels
+struct MappingError
+{
+	int		m_compared;			// points both mappings put inside the color image
+	int		m_mismatched;		// points only one of them puts inside the color image
+	float	m_mean;
+	float	m_max;
+};
+
+MappingError compare_mappings(const ColorPoint *p_a, const ColorPoint *p_b, int p_count, int p_color_width, int p_color_height);
+
+// the software mapping can replace the sensor runtime : within a pixel on average, a few pixels at most and the same coverage
+bool mappings_match(const MappingError &p_error);
+
+// calibration files : plain text, so a calibration can be recorded with the sensor and used (or inspected) anywhere else
+bool write_calibration(std::ostream &p_stream, const CameraCalibration &p_calibration);
+bool read_calibration(std::istream &p_stream, CameraCalibration &p_calibration);
+
+// maps between the depth and the color image with a CameraCalibration instead of per-frame calls into the sensor runtime
+//	- configure precomputes three coefficients for every depth pixel : a frame takes a multiply-add and a division per pixel
+//	- color to depth is the inverse by forward mapping (registration) : every depth pixel covers the color pixels up to
+//	  where its right and lower neighbours land, the nearest depth pixel wins where they overlap
+//	- works on the threads of the shared pool, does not depend on the sensor runtime or Windows
+class CoordinateMapper
+{
+	public :
+		CoordinateMapper();
+
+		bool configure(const CameraCalibration &p_calibration, int p_color_width, int p_color_height);
+		void reset();
+
+		bool valid() const;
+
+		// every pixel of a depth frame (in millimeters) to the color image, see DepthToColorFunc
+		bool depth_to_color(const uint16_t *p_depth, ColorPoint *p_points) const;
+
+		// a DepthToColorFunc for LowResBodyMask (the mapper has to outlive it)
+		DepthToColorFunc depth_to_color_func() const;
+
+		// the depth pixel behind every color pixel of a region (like ICoordinateMapper::MapColorFrameToDepthSpace)
+		//	- p_points has a point for each pixel of the color frame, only the region is written
+		//	- color pixels without a depth pixel get -infinity (float) or -1 (int)
+		bool color_to_depth(const uint16_t *p_depth, int p_x, int p_y, int p_width, int p_height, DepthPoint *p_points);
+		bool color_to_depth(const uint16_t *p_depth, int p_x, int p_y, int p_width, int p_height, DepthPixelPoint *p_points);
+
+	private :
+		// the color pixels [x0, x1) x [y0, y1) a depth pixel covers
+		struct Footprint
+		{
+			int16_t	m_x0;
+			int16_t	m_y0;
+			int16_t	m_x1;
+			int16_t	m_y1;
+		};
+
+		template <typename Point>
+		bool register_color(const uint16_t *p_depth, int p_x, int p_y, int p_width, int p_height, Point *p_points);
+
+	private :
+		int							m_depth_width;
+		int							m_depth_height;
+		int							m_color_width;
+		int							m_color_height;
+		int							m_footprint_x;		// the color pixels a depth pixel covers, when its neighbours don't tell
+		int							m_footprint_y;
+		float						m_offset[3];
+		std::vector<float>			m_coef_u;
+		std::vector<float>			m_coef_v;
+		std::vector<float>			m_coef_w;
+		std::vector<ColorPoint>		m_points;			// the depth frame in color space
+		std::vector<Footprint>		m_footprints;
+		std::vector<int>			m_row_top;			// the color rows each row of depth pixels covers
+		std::vector<int>			m_row_bottom;
+};
+
+} // namespace keying
+
+#endif // KW_COORDINATE_MAPPER_H
@@ -0,0 +1,113 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	cpu_features.cpp
+//
+// Purpose	: 	detect the instruction set extensions supported by the cpu
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "cpu_features.h"
+
+#ifdef KW_SIMD_X86
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#include <immintrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#endif // KW_SIMD_X86
+
+namespace cpu {
+
+#ifdef KW_SIMD_X86
+
+namespace {
+
+inline void cpuid(int p_leaf, int p_subleaf, unsigned int p_regs[4])
+{
+#ifdef _MSC_VER
+	int f_regs[4];
+	__cpuidex(f_regs, p_leaf, p_subleaf);
+
+	for (int f_i = 0; f_i < 4; ++f_i)
+		p_regs[f_i] = static_cast<unsigned int> (f_regs[f_i]);
+#else
+	__cpuid_count(p_leaf, p_subleaf, p_regs[0], p_regs[1], p_regs[2], p_regs[3]);
+#endif
+}
+
+inline unsigned long long xgetbv0()
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	unsigned int f_eax, f_edx;
+	__asm__ volatile ("xgetbv" : "=a" (f_eax), "=d" (f_edx) : "c" (0));
+	return (static_cast<unsigned long long> (f_edx) << 32) | f_eax;
+#endif
+}
+
+} // unnamed namespace
+
+SimdLevel simd_level_supported()
+{
+	unsigned int f_regs[4] = {0};
+
+	cpuid(0, 0, f_regs);
+	const unsigned int f_max_leaf = f_regs[0];
+
+	if (f_max_leaf < 1)
+		return SIMD_NONE;
+
+	cpuid(1, 0, f_regs);
+
+	const bool f_sse2	 = (f_regs[3] & (1u << 26)) != 0;
+	const bool f_ssse3	 = (f_regs[2] & (1u << 9))  != 0;
+	const bool f_osxsave = (f_regs[2] & (1u << 27)) != 0;
+	const bool f_avx	 = (f_regs[2] & (1u << 28)) != 0;
+
+	if (!f_sse2)
+		return SIMD_NONE;
+
+	if (!f_ssse3)
+		return SIMD_SSE2;
+
+	// avx2 also requires the operating system to save the ymm registers on a context switch
+	if (f_max_leaf >= 7 && f_osxsave && f_avx && (xgetbv0() & 0x6) == 0x6)
+	{
+		cpuid(7, 0, f_regs);
+
+		if (f_regs[1] & (1u << 5))
+			return SIMD_AVX2;
+	}
+
+	return SIMD_SSSE3;
+}
+
+#else
+
+SimdLevel simd_level_supported()
+{
+	return SIMD_NONE;
+}
+
+#endif // KW_SIMD_X86
+
+const char *simd_level_name(SimdLevel p_level)
+{
+	switch (p_level)
+	{
+		case SIMD_SSE2 :	return "sse2";
+		case SIMD_SSSE3 :	return "ssse3";
+		case SIMD_AVX2 :	return "avx2";
+		default :			return "scalar";
+	}
+}
+
+} // namespace cpu
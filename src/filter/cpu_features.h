@@ -0,0 +1,39 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	cpu_features.h
+//
+// Purpose	: 	detect the instruction set extensions supported by the cpu
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef KW_CPU_FEATURES_H
+#define KW_CPU_FEATURES_H
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+	#define KW_SIMD_X86
+#endif
+
+namespace cpu {
+
+enum SimdLevel
+{
+	SIMD_NONE,
+	SIMD_SSE2,
+	SIMD_SSSE3,
+	SIMD_AVX2
+};
+
+// highest simd level supported by both the cpu and the operating system
+SimdLevel simd_level_supported();
+
+const char *simd_level_name(SimdLevel p_level);
+
+} // namespace cpu
+
+#endif // KW_CPU_FEATURES_H
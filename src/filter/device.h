@@ -15,6 +15,8 @@
 #ifndef KW_DEVICE_H
 #define KW_DEVICE_H
 
+#include "image.h"
+
 //
 // interface
 //
@@ -25,9 +27,24 @@ enum DevicePixelFormat
 {
 	DPF_RGB,
 	DPF_RGBA,
-	DPF_YUY2
+	DPF_YUY2,
+	DPF_NV12,
+	DPF_I420
 };
 
+// the format of the image data delivered by color_data
+inline img::PixelFormat image_format(DevicePixelFormat p_format)
+{
+	switch (p_format)
+	{
+		case DPF_RGB :	return img::PF_BGR24;
+		case DPF_YUY2 :	return img::PF_YUY2;
+		case DPF_NV12 :	return img::PF_NV12;
+		case DPF_I420 :	return img::PF_I420;
+		default :		return img::PF_BGRA32;
+	}
+}
+
 struct DeviceVideoResolution
 {
 	int					m_width;
@@ -35,6 +52,7 @@ struct DeviceVideoResolution
 	int					m_bits_per_pixel;
 	int					m_framerate;
 	DevicePixelFormat	m_pixel_format;
+	bool				m_scaled;			// scale the entire sensor image instead of cropping it
 };
 
 struct Point2D {
@@ -42,6 +60,85 @@ struct Point2D {
 	int m_y;
 };
 
+struct Region2D {
+	int m_x;
+	int m_y;
+	int m_width;
+	int m_height;
+};
+
+// a tracked person : where its focus joint is in the color image
+struct TrackedBody {
+	Point2D	m_focus;
+	float	m_depth;			// distance to the focus joint in meters
+	float	m_scale;			// color pixels per meter at that distance (the size of the person in the image)
+};
+
+const int MAX_TRACKED_BODIES = 6;
+
+// which pixels the green screen keeps
+//	- depth range keying is cheaper than the body index (and needs no body tracking), but keeps everything inside the range
+enum GreenScreenKeying
+{
+	GSK_BODY_INDEX,				// the pixels of the tracked bodies
+	GSK_DEPTH_RANGE,			// the pixels between the near and the far distance
+	GSK_BODY_INDEX_IN_RANGE		// the pixels of the tracked bodies, between the near and the far distance
+};
+
+// how often the green screen mask could be reused instead of rebuilt
+//	- the mask only has to be rebuilt when a new depth (or body index) frame arrived since the previous video frame
+struct GreenScreenStatistics {
+	unsigned int m_mask_requests;		// video frames that needed a mask
+	unsigned int m_mask_builds;			// of which the mask had to be rebuilt
+	unsigned int m_mask_dropped;		// video frames shown without the mask (its inputs were too old or it failed)
+	bool		 m_software_mapping;	// the coordinate mapper in software replaced the one of the sensor runtime
+	float		 m_mapping_error;		// how far apart they were when they were compared (mean, in color pixels)
+
+	float hit_rate() const
+	{
+		return (m_mask_requests > 0) ? static_cast<float> (m_mask_requests - m_mask_builds) / m_mask_requests : 0.0f;
+	}
+};
+
+// true when p_inner lies completely inside p_outer
+inline bool region_contains(Region2D p_outer, Region2D p_inner)
+{
+	return	p_inner.m_x >= p_outer.m_x && p_inner.m_x + p_inner.m_width <= p_outer.m_x + p_outer.m_width &&
+			p_inner.m_y >= p_outer.m_y && p_inner.m_y + p_inner.m_height <= p_outer.m_y + p_outer.m_height;
+}
+
+// the region of the sensor image that is shown in an output of p_width x p_height
+//	- p_scale times the size of the output (1 = plain crop), limited to the sensor image without changing the aspect ratio
+//	- centered on the focus point, but never extends past the border of the sensor image
+inline Region2D focus_region(int p_sensor_width, int p_sensor_height, Point2D p_focus, int p_width, int p_height, float p_scale)
+{
+	// plain comparisons : windows.h may or may not have defined min/max at this point
+	const float f_max_hor	= static_cast<float> (p_sensor_width) / p_width;
+	const float f_max_ver	= static_cast<float> (p_sensor_height) / p_height;
+	const float f_max_scale	= (f_max_hor < f_max_ver) ? f_max_hor : f_max_ver;
+	const float f_scale		= (p_scale > f_max_scale) ? f_max_scale : p_scale;
+
+	Region2D f_region = {0, 0, p_width, p_height};
+
+	// keep the dimensions even : YUY2 data can only be cropped at macropixel boundaries
+	if (f_scale > 1.0f)
+	{
+		f_region.m_width  = static_cast<int> (p_width * f_scale + 0.5f) & ~1;
+		f_region.m_height = static_cast<int> (p_height * f_scale + 0.5f) & ~1;
+
+		if (f_region.m_width > p_sensor_width)		f_region.m_width  = p_sensor_width;
+		if (f_region.m_height > p_sensor_height)	f_region.m_height = p_sensor_height;
+	}
+
+	f_region.m_x = p_focus.m_x - (f_region.m_width / 2);
+	f_region.m_x = (f_region.m_x < 0) ? 0 : (f_region.m_x > p_sensor_width - f_region.m_width) ? p_sensor_width - f_region.m_width : f_region.m_x;
+
+	f_region.m_y = p_focus.m_y - (f_region.m_height / 2);
+	f_region.m_y = (f_region.m_y < 0) ? 0 : (f_region.m_y > p_sensor_height - f_region.m_height) ? p_sensor_height - f_region.m_height : f_region.m_y;
+
+	return f_region;
+}
+
 class Device
 {
 	public :
@@ -58,21 +155,34 @@ class Device
 		virtual int					  video_resolution_native() = 0;
 		virtual DeviceVideoResolution video_resolution(int p_index) = 0;
 		virtual void				  video_flip_output(bool p_flip) = 0;
+		virtual void				  video_mirror_output(bool p_mirror) = 0;
 		virtual void				  video_set_resolution(DeviceVideoResolution p_devres) = 0;
+		virtual void				  video_set_crop_scale(float p_scale) = 0;		// see focus_region
+		virtual double				  video_time() = 0;		// when the last color frame was captured, in seconds on the clock of the sensor (0 = unknown)
 
 		// body tracking
+		virtual void				  focus_enable(bool p_enable) = 0;		// off : the device doesn't track bodies at all (no focus point)
 		virtual void				  focus_set_joint(int p_joint) = 0;
 		virtual bool				  focus_availabe() = 0;
 		virtual Point2D				  focus_point() = 0;
+		virtual float				  focus_depth() = 0;		// distance to the focus joint in meters (0 = unknown)
+		virtual double				  focus_time() = 0;		// when the body frame of the focus point was captured, on the clock of video_time (0 = unknown)
+		virtual int					  focus_bodies(TrackedBody *p_bodies) = 0;		// all tracked bodies (up to MAX_TRACKED_BODIES), the first has the focus point
 
 		// green screen
 		virtual void				  green_screen_enable(bool p_enable) = 0;
+		virtual void				  green_screen_low_res(bool p_enable) = 0;		// build the mask at depth resolution (when the device supports it)
+		virtual void				  green_screen_soft_edges(bool p_enable) = 0;		// refine the mask into an alpha matte (soft, stable edges)
+		virtual void				  green_screen_keying(GreenScreenKeying p_keying, int p_near, int p_far) = 0;	// the depth range is in millimeters
+		virtual void				  green_screen_background(const img::ImageView *p_background) = 0;	// nullptr = black (see img::MaskView::m_background)
+		virtual void				  green_screen_blur(int p_level) = 0;		// blur the background instead (0 = off, see keying::BackgroundBlur)
+		virtual GreenScreenStatistics green_screen_statistics() = 0;
 
 		// update
 		virtual bool update() = 0;
 
-		// access to image data
-		virtual bool color_data(int p_hor_focus, int p_ver_focus, int p_width, int p_height, int p_bpp, unsigned char *p_data) = 0;
+		// access to image data : the output has the size, format and stride of the negotiated media type
+		virtual bool color_data(int p_hor_focus, int p_ver_focus, const img::ImageView &p_output) = 0;
 };
 
 } // namespace motion
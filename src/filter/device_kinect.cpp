@@ -14,14 +14,57 @@
 
 #include "device_kinect.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <vector>
 
 #include "kinect_wrapper.h"
 #include "image.h"
+#include "image_kernels.h"
+#include "keying.h"
+#include "coordinate_mapper.h"
 #include "com_utils.h"
+#include "thread_pool.h"
 
 namespace device {
 
+namespace {
+
+// the kinect delivers raw YUY2 data when YUY2 output is requested, 32bpp data for all the other formats
+img::PixelFormat source_format(DevicePixelFormat p_format)
+{
+	return (p_format == DPF_YUY2) ? img::PF_YUY2 : img::PF_BGRA32;
+}
+
+static_assert(sizeof(NUI_DEPTH_IMAGE_POINT) == 4 * sizeof(int), "the body lookup kernels expect NUI_DEPTH_IMAGE_POINT to be x, y, depth, reserved");
+static_assert(sizeof(NUI_DEPTH_IMAGE_PIXEL) == sizeof(unsigned int), "the body lookup kernels expect NUI_DEPTH_IMAGE_PIXEL to be a player index and a depth");
+static_assert(sizeof(keying::DepthPixelPoint) == sizeof(NUI_DEPTH_IMAGE_POINT), "keying::DepthPixelPoint has to match NUI_DEPTH_IMAGE_POINT");
+
+// the flat depth frame (in millimeters) the runtime maps to measure what the projection of the software mapper misses
+const USHORT CALIBRATION_DEPTH = 2000;
+
+// the runtime maps to whole color pixels
+keying::ColorPoint color_point(const NUI_COLOR_IMAGE_POINT &p_point)
+{
+	return {static_cast<float> (p_point.x), static_cast<float> (p_point.y)};
+}
+
+// soft edges : feather over the size of about one depth pixel on either side, the new frame weighs 5/8 against the previous one
+const int SOFT_EDGE_RADIUS = 2;
+const int SOFT_EDGE_WEIGHT = 80;
+
+// the size of a tracked person in the color image is measured over this distance next to the focus joint (meters)
+const FLOAT BODY_SCALE_PROBE = 0.1f;
+
+// the focus joint is mapped to the color image, the runtime returns coordinates outside of it for points it can't see
+bool color_point_inside(LONG p_x, LONG p_y, int p_width, int p_height)
+{
+	return p_x >= 0 && p_x < p_width && p_y >= 0 && p_y < p_height;
+}
+
+} // unnamed namespace
+
 struct DeviceKinectPrivate
 {
 	KinectFuncs	*			m_kinect_lib;
@@ -39,8 +82,12 @@ struct DeviceKinectPrivate
     NUI_IMAGE_RESOLUTION	m_nui_color_resolution;
 
 	bool					m_flip_output;
+	bool					m_mirror_output;
 	bool					m_high_res;
 	bool					m_green_screen;
+	bool					m_tracking;
+	bool					m_skeleton_tracking;			// the sensor tracks skeletons (see kinect_skeleton_tracking)
+	float					m_crop_scale;
 
 	int									m_depth_width;
 	int									m_depth_height;
@@ -48,13 +95,187 @@ struct DeviceKinectPrivate
     NUI_IMAGE_RESOLUTION				m_nui_depth_resolution;
 
 	std::vector<BYTE>					m_body_mask;
+	img::MaskView						m_body_mask_view;
+	const img::ImageView *				m_background;			// replaces the masked out pixels (nullptr = black)
+	keying::BackgroundBlur				m_blur;					// or a blurred copy of the color image does
 	std::vector<NUI_DEPTH_IMAGE_POINT>	m_depth_points;
 
+	// the coordinate mapper in software : calibrated from the runtime at the first depth frame, the runtime only maps when that fails
+	keying::CoordinateMapper			m_mapper;
+	bool								m_mapper_checked;
+	unsigned int						m_mapper_depth_generation;	// the depth frame the calibration was last tried on
+	std::vector<uint16_t>				m_depth_values;				// the depth of m_depth_data, the input of the software mapper
+
+	// optionally : the mask refined into an alpha matte
+	bool								m_soft_edges;
+	keying::SoftMatte					m_body_matte;
+
+	// the depth range keying relabels the depth frame (a player index of 1 for the pixels that are kept) before the mask is built
+	GreenScreenKeying					m_keying;
+	int									m_keying_near;
+	int									m_keying_far;
+	std::vector<unsigned int>			m_keying_labels;
+	bool								m_labels_valid;				// m_keying_labels belongs to m_labels_depth_generation
+	unsigned int						m_labels_depth_generation;
+
+	// the mask is only rebuilt when a new depth frame (which includes the player index) arrived
+	unsigned int						m_depth_generation;
+	bool								m_points_valid;				// m_depth_points belongs to m_points_depth_generation
+	unsigned int						m_points_depth_generation;
+	Region2D							m_points_region;			// and is valid in this region of the color image
+	bool								m_mask_valid;				// m_body_mask belongs to the generation and the region below
+	Region2D							m_mask_region;				// only this region of the color image has a valid mask
+	unsigned int						m_mask_depth_generation;
+	bool								m_mask_shown;				// color_data applies the mask to the current video frame
+	GreenScreenStatistics				m_mask_statistics;
+
 	int									m_focus_joint;
 	bool								m_focus_available;
 	Point2D								m_focus;
+	float								m_focus_depth;
+	LONGLONG							m_focus_time;				// timestamp of the skeleton frame of the focus point (ms)
+	LONGLONG							m_color_time;				// and of the last color frame
+	TrackedBody							m_bodies[NUI_SKELETON_COUNT];	// the tracked skeletons, in the order of the sensor
+	int									m_body_count;
 };
 
+static_assert(NUI_SKELETON_COUNT <= MAX_TRACKED_BODIES, "every skeleton the sensor tracks has to fit in focus_bodies");
+
+// the depth of every pixel of the depth frame, without the player index
+void kinect_depth_values(DeviceKinectPrivate *p_private)
+{
+	p_private->m_depth_values.resize(p_private->m_depth_data.size());
+
+	for (size_t f_i = 0; f_i < p_private->m_depth_data.size(); ++f_i)
+		p_private->m_depth_values[f_i] = p_private->m_depth_data[f_i].depth;
+}
+
+// replace the coordinate mapper of the runtime with the software mapper (see keying::CoordinateMapper)
+//	- the calibration comes from the runtime : the rays of the depth pixels, a projection fitted to points it maps to the color image
+//	  and what that projection misses on a flat depth frame
+//	- the software mapper is only used when it agrees with the runtime on the current depth frame
+//	- returns false to try again on a later depth frame : nothing is in view
+bool kinect_calibrate_mapper(DeviceKinectPrivate *p_private)
+{
+	INuiCoordinateMapper *	f_mapper = p_private->m_sensor_coordinate_mapper;
+	const int				f_size	 = p_private->m_depth_width * p_private->m_depth_height;
+
+	p_private->m_mapper.reset();
+	p_private->m_mask_statistics.m_software_mapping = false;
+
+	keying::CameraCalibration f_calibration;
+	f_calibration.m_depth_width	 = p_private->m_depth_width;
+	f_calibration.m_depth_height = p_private->m_depth_height;
+	f_calibration.m_depth_rays.resize(f_size);
+
+	// the ray of every depth pixel : the pixel at a depth of one meter in skeleton space
+	for (int f_i = 0; f_i < f_size; ++f_i)
+	{
+		NUI_DEPTH_IMAGE_POINT	f_point = {f_i % p_private->m_depth_width, f_i / p_private->m_depth_width, 1000, 0};
+		Vector4					f_skeleton;
+
+		if (FAILED(f_mapper->MapDepthPointToSkeletonPoint(p_private->m_nui_depth_resolution, &f_point, &f_skeleton)) || f_skeleton.z <= 0.0f)
+			return true;
+
+		f_calibration.m_depth_rays[f_i] = {f_skeleton.x / f_skeleton.z, f_skeleton.y / f_skeleton.z};
+	}
+
+	std::vector<float>					f_samples = keying::projection_samples(f_calibration);
+	const int							f_samples_count = static_cast<int> (f_samples.size() / 3);
+	std::vector<keying::ColorPoint>		f_sample_colors(f_samples_count);
+
+	for (int f_i = 0; f_i < f_samples_count; ++f_i)
+	{
+		Vector4					f_skeleton = {f_samples[(f_i * 3)], f_samples[(f_i * 3) + 1], f_samples[(f_i * 3) + 2], 1.0f};
+		NUI_COLOR_IMAGE_POINT	f_color;
+
+		if (FAILED(f_mapper->MapSkeletonPointToColorPoint(&f_skeleton, p_private->m_nui_color_type, p_private->m_nui_color_resolution, &f_color)))
+			return true;
+
+		f_sample_colors[f_i] = color_point(f_color);
+	}
+
+	if (!keying::fit_color_projection(f_samples.data(), f_sample_colors.data(), f_samples_count, f_calibration.m_color_projection))
+		return true;
+
+	std::vector<NUI_DEPTH_IMAGE_PIXEL>	f_flat(f_size, NUI_DEPTH_IMAGE_PIXEL{0, CALIBRATION_DEPTH});
+	std::vector<NUI_COLOR_IMAGE_POINT>	f_sdk_points(f_size);
+	std::vector<keying::ColorPoint>		f_expected(f_size);
+	std::vector<keying::ColorPoint>		f_points(f_size);
+
+	if (FAILED(f_mapper->MapDepthFrameToColorFrame(	p_private->m_nui_depth_resolution, f_size, f_flat.data(),
+													p_private->m_nui_color_type, p_private->m_nui_color_resolution,
+													f_size, f_sdk_points.data())))
+	{
+		return true;
+	}
+
+	std::transform(f_sdk_points.begin(), f_sdk_points.end(), f_expected.begin(), color_point);
+	keying::fit_color_offsets(f_calibration, f_expected.data(), CALIBRATION_DEPTH);
+
+	if (!p_private->m_mapper.configure(f_calibration, p_private->m_color_width, p_private->m_color_height))
+		return true;
+
+	// compare both mappers on the depth frame (the runtime also maps the pixels without a depth, the software mapper skips them)
+	kinect_depth_values(p_private);
+
+	if (FAILED(f_mapper->MapDepthFrameToColorFrame(	p_private->m_nui_depth_resolution, f_size, p_private->m_depth_data.data(),
+													p_private->m_nui_color_type, p_private->m_nui_color_resolution,
+													f_size, f_sdk_points.data())) ||
+		!p_private->m_mapper.depth_to_color(p_private->m_depth_values.data(), f_points.data()))
+	{
+		p_private->m_mapper.reset();
+		return true;
+	}
+
+	for (int f_i = 0; f_i < f_size; ++f_i)
+	{
+		f_expected[f_i] = (p_private->m_depth_values[f_i] != 0) ? color_point(f_sdk_points[f_i])
+																: keying::ColorPoint{-std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity()};
+	}
+
+	const keying::MappingError f_error = keying::compare_mappings(	f_expected.data(), f_points.data(), f_size,
+																	p_private->m_color_width, p_private->m_color_height);
+
+	// nothing in view : try again on the next depth frame
+	if (f_error.m_compared == 0)
+	{
+		p_private->m_mapper.reset();
+		return false;
+	}
+
+	p_private->m_mask_statistics.m_mapping_error = f_error.m_mean;
+
+	if (!keying::mappings_match(f_error))
+	{
+		p_private->m_mapper.reset();
+		return true;
+	}
+
+	p_private->m_mask_statistics.m_software_mapping = true;
+	p_private->m_points_valid						= false;
+	return true;
+}
+
+// skeleton tracking costs CPU on every frame : the sensor only tracks skeletons when the settings need them, to follow a
+// person or for the player index of the depth frame
+//	(the depth stream can't be closed without initializing the sensor again : it stays open, its frames are just not read)
+HRESULT kinect_skeleton_tracking(DeviceKinectPrivate *p_private)
+{
+	const bool f_needed = p_private->m_tracking || (p_private->m_green_screen && p_private->m_keying != GSK_DEPTH_RANGE);
+
+	if (!p_private->m_sensor || f_needed == p_private->m_skeleton_tracking)
+		return S_OK;
+
+	HRESULT f_result = (f_needed) ? p_private->m_sensor->NuiSkeletonTrackingEnable(nullptr, NUI_SKELETON_TRACKING_FLAG_ENABLE_SEATED_SUPPORT)
+								  : p_private->m_sensor->NuiSkeletonTrackingDisable();
+
+	if (SUCCEEDED(f_result))
+		p_private->m_skeleton_tracking = f_needed;
+
+	return f_result;
+}
+
 //
 // construction
 //
@@ -63,8 +284,28 @@ DeviceKinect::DeviceKinect() :	m_private(std::make_unique<DeviceKinectPrivate>()
 {
 	m_private->m_sensor				= nullptr;
 	m_private->m_sensor_data_event	= INVALID_HANDLE_VALUE;
+	m_private->m_color_format		= DPF_RGBA;
+	m_private->m_high_res			= false;
 	m_private->m_flip_output		= false;
+	m_private->m_mirror_output		= false;
 	m_private->m_green_screen		= false;
+	m_private->m_tracking			= true;
+	m_private->m_skeleton_tracking	= false;
+	m_private->m_crop_scale			= 1.0f;
+	m_private->m_body_mask_view		= {nullptr, 0, 0, 0, 1, false, nullptr};
+	m_private->m_background			= nullptr;
+	m_private->m_soft_edges			= false;
+	m_private->m_keying				= GSK_BODY_INDEX;
+	m_private->m_keying_near		= 500;
+	m_private->m_keying_far			= 2000;
+	m_private->m_labels_valid		= false;
+	m_private->m_depth_generation	= 0;
+	m_private->m_points_valid		= false;
+	m_private->m_mapper_checked		= false;
+	m_private->m_mapper_depth_generation = 0;
+	m_private->m_mask_valid			= false;
+	m_private->m_mask_shown			= false;
+	m_private->m_mask_statistics	= {0, 0, 0, false, 0.0f};
 }
 
 DeviceKinect::~DeviceKinect()
@@ -144,13 +385,17 @@ bool DeviceKinect::connect_to_first()
 
 		if (SUCCEEDED(f_result))
 		{
-			// enable skeletal tracking
-			f_result = m_private->m_sensor->NuiSkeletonTrackingEnable(nullptr, NUI_SKELETON_TRACKING_FLAG_ENABLE_SEATED_SUPPORT);
+			// enable skeletal tracking (when the settings need it)
+			m_private->m_skeleton_tracking = false;
+			f_result = kinect_skeleton_tracking(m_private.get());
 		}
 
 		if (SUCCEEDED(f_result))
 		{
 			f_result = m_private->m_sensor->NuiGetCoordinateMapper(&m_private->m_sensor_coordinate_mapper);
+			m_private->m_mapper.reset();
+			m_private->m_mapper_checked			 = false;
+			m_private->m_mapper_depth_generation = m_private->m_depth_generation;
 		}
 
 		if (FAILED(f_result))
@@ -166,6 +411,10 @@ bool DeviceKinect::connect_to_first()
 		m_private->m_focus_joint	 = NUI_SKELETON_POSITION_HEAD;
 		m_private->m_focus_available = false;
 		m_private->m_focus			 = {0, 0};
+		m_private->m_focus_depth	 = 0.0f;
+		m_private->m_focus_time		 = 0;
+		m_private->m_color_time		 = 0;
+		m_private->m_body_count		 = 0;
 		return true;
 	}
 
@@ -189,7 +438,13 @@ bool DeviceKinect::disconnect()
 		m_private->m_sensor = nullptr;
 	}
 
+	m_private->m_skeleton_tracking = false;
 	m_private->m_color_data.clear();
+	m_private->m_mapper.reset();
+	m_private->m_points_valid	= false;
+	m_private->m_mapper_checked = false;
+	m_private->m_mask_valid		= false;
+	m_private->m_labels_valid	= false;
 
 	kinect_free_library();
 
@@ -205,7 +460,13 @@ DeviceVideoResolution DeviceKinect::m_video_resolutions[] = {	{ 320,  240, 32, 3
 																{1280,  960, 32, 12, DPF_RGBA},
 																{ 320,  240, 24, 30, DPF_RGB},
 																{ 640,  480, 24, 30, DPF_RGB},
-																{ 640,  480, 16, 15, DPF_YUY2}
+																{ 640,  480, 16, 15, DPF_YUY2},
+																{ 320,  240, 12, 30, DPF_NV12},
+																{ 640,  480, 12, 30, DPF_NV12},
+																{1280,  960, 12, 12, DPF_NV12},
+																{ 320,  240, 12, 30, DPF_I420},
+																{ 640,  480, 12, 30, DPF_I420},
+																{1280,  960, 12, 12, DPF_I420}
 															};
 
 int	DeviceKinect::video_resolution_count()
@@ -234,16 +495,43 @@ void DeviceKinect::video_set_resolution(DeviceVideoResolution p_devres)
 	m_private->m_color_format = p_devres.m_pixel_format;
 }
 
+void DeviceKinect::video_set_crop_scale(float p_scale)
+{
+	m_private->m_crop_scale = p_scale;
+}
+
+double DeviceKinect::video_time()
+{
+	// the image and skeleton frames are stamped by the same clock (in milliseconds)
+	return static_cast<double> (m_private->m_color_time) / 1000.0;
+}
+
 void DeviceKinect::video_flip_output(bool p_flip)
 {
 	m_private->m_flip_output = p_flip;
 }
 
+void DeviceKinect::video_mirror_output(bool p_mirror)
+{
+	m_private->m_mirror_output = p_mirror;
+}
+
 //
 // body tracking
 //
 
 
+void DeviceKinect::focus_enable(bool p_enable)
+{
+	if (p_enable == m_private->m_tracking)
+		return;
+
+	m_private->m_tracking		 = p_enable;
+	m_private->m_focus_available = false;
+	m_private->m_body_count		 = 0;
+	kinect_skeleton_tracking(m_private.get());
+}
+
 void DeviceKinect::focus_set_joint(int p_joint)
 {
 	if (p_joint >= 0 && p_joint < NUI_SKELETON_POSITION_COUNT)
@@ -260,13 +548,90 @@ Point2D	DeviceKinect::focus_point()
 	return m_private->m_focus;
 }
 
+float DeviceKinect::focus_depth()
+{
+	return (m_private->m_focus_available) ? m_private->m_focus_depth : 0.0f;
+}
+
+double DeviceKinect::focus_time()
+{
+	return (m_private->m_focus_available) ? static_cast<double> (m_private->m_focus_time) / 1000.0 : 0.0;
+}
+
+int DeviceKinect::focus_bodies(TrackedBody *p_bodies)
+{
+	if (!m_private->m_focus_available)
+		return 0;
+
+	std::copy(m_private->m_bodies, m_private->m_bodies + m_private->m_body_count, p_bodies);
+	return m_private->m_body_count;
+}
+
 //
 // green screen
 //
 
 void DeviceKinect::green_screen_enable(bool p_enable)
 {
+	// the matte of the last frame before the green screen was disabled is no longer relevant
+	if (p_enable && !m_private->m_green_screen)
+		m_private->m_body_matte.reset();
+
 	m_private->m_green_screen = p_enable;
+	kinect_skeleton_tracking(m_private.get());
+}
+
+void DeviceKinect::green_screen_low_res(bool p_enable)
+{
+	// the depth frame (320x240) already has a lower resolution than the color frame, the mask is always built per color pixel
+}
+
+void DeviceKinect::green_screen_soft_edges(bool p_enable)
+{
+	if (p_enable != m_private->m_soft_edges)
+	{
+		m_private->m_soft_edges = p_enable;
+		m_private->m_mask_valid = false;
+		m_private->m_body_matte.reset();
+	}
+}
+
+void DeviceKinect::green_screen_keying(GreenScreenKeying p_keying, int p_near, int p_far)
+{
+	if (p_keying != GSK_DEPTH_RANGE && p_keying != GSK_BODY_INDEX_IN_RANGE)
+		p_keying = GSK_BODY_INDEX;
+
+	// depth 0 means unknown : never part of the range
+	//	(the player index is part of the depth stream : there is no separate stream to skip)
+	p_near = (p_near < 1) ? 1 : (p_near > 0xffff) ? 0xffff : p_near;
+	p_far  = (p_far < p_near) ? p_near : (p_far > 0xffff) ? 0xffff : p_far;
+
+	if (p_keying != m_private->m_keying || p_near != m_private->m_keying_near || p_far != m_private->m_keying_far)
+	{
+		m_private->m_keying		  = p_keying;
+		m_private->m_keying_near  = p_near;
+		m_private->m_keying_far	  = p_far;
+		m_private->m_labels_valid = false;
+		m_private->m_mask_valid	  = false;
+		kinect_skeleton_tracking(m_private.get());
+	}
+}
+
+void DeviceKinect::green_screen_background(const img::ImageView *p_background)
+{
+	// the image is owned by the caller, it has to stay valid until it is replaced
+	m_private->m_background = p_background;
+}
+
+void DeviceKinect::green_screen_blur(int p_level)
+{
+	if (p_level != m_private->m_blur.level())
+		m_private->m_blur.configure(p_level);
+}
+
+GreenScreenStatistics DeviceKinect::green_screen_statistics()
+{
+	return m_private->m_mask_statistics;
 }
 
 //
@@ -284,10 +649,14 @@ bool DeviceKinect::update()
 		return false;									// exit !!!
 	}
 
-	// retrieve updated data from the device
+	// retrieve updated data from the device : only the streams the settings need
 	bool f_result = read_color_frame();
-	f_result &= read_depth_frame();
-	f_result &= read_skeleton_frame();
+
+	if (m_private->m_green_screen)
+		f_result &= read_depth_frame();
+
+	if (m_private->m_tracking && m_private->m_skeleton_tracking)
+		f_result &= read_skeleton_frame();
 
 	return f_result;
 }
@@ -296,53 +665,69 @@ bool DeviceKinect::update()
 // access to image data
 //
 
-bool DeviceKinect::color_data(int p_hor_focus, int p_ver_focus, int p_width, int p_height, int p_bpp, unsigned char *p_data)
+bool DeviceKinect::color_data(int p_hor_focus, int p_ver_focus, const img::ImageView &p_output)
 {
 	if (m_private->m_color_data.empty())
 		return false;
 
-	if (p_width  > m_private->m_color_width  ||
-	    p_height > m_private->m_color_height)
+	if (p_output.m_width  > m_private->m_color_width  ||
+	    p_output.m_height > m_private->m_color_height)
 	{
 		return false;
 	}
 
-	// offsets
-	int f_hor_offset = p_hor_focus - (p_width / 2);
-	f_hor_offset	 = min(max(f_hor_offset, 0), m_private->m_color_width - p_width);
+	// the region of the color image to show : a (zoomed) crop around the focus point
+	Region2D f_region = focus_region(m_private->m_color_width, m_private->m_color_height, {p_hor_focus, p_ver_focus}, p_output.m_width, p_output.m_height, m_private->m_crop_scale);
 
-	int f_ver_offset = p_ver_focus - (p_height / 2);
-	f_ver_offset	 = min(max(f_ver_offset, 0), m_private->m_color_height - p_height);
+	// YUY2 crops have to start on a macropixel boundary (or the chroma gets swapped)
+	if (m_private->m_color_format == DPF_YUY2)
+		f_region.m_x &= ~1;
 
-	if (m_private->m_green_screen)
-		build_index_mask();
+	// only the pixels that are shown need a mask
+	//	when the mask fails the color image is passed through instead of keyed with a stale mask
+	m_private->m_mask_shown = m_private->m_green_screen && build_index_mask(f_region);
+
+	if (m_private->m_green_screen && !m_private->m_mask_shown)
+		++m_private->m_mask_statistics.m_mask_dropped;
 
-	switch (p_bpp)
+	if (m_private->m_mask_shown)
 	{
-		case 32 :
-			if (m_private->m_green_screen)
-				return img::copy_region_32bpp_32bpp_mask(	m_private->m_color_width, m_private->m_color_height, m_private->m_color_data.data(), m_private->m_body_mask.data(),
-															f_hor_offset, f_ver_offset, p_width, p_height, p_data,
-															m_private->m_flip_output);
-			else
-				return img::copy_region_32bpp_32bpp(m_private->m_color_width, m_private->m_color_height, m_private->m_color_data.data(),
-													f_hor_offset, f_ver_offset, p_width, p_height, p_data,
-													m_private->m_flip_output);
-
-		case 24 :
-			if (m_private->m_green_screen)
-				return img::copy_region_32bpp_24bpp_mask(	m_private->m_color_width, m_private->m_color_height, m_private->m_color_data.data(), m_private->m_body_mask.data(),
-															f_hor_offset, f_ver_offset, p_width, p_height, p_data,
-															m_private->m_flip_output);
-			else
-				return img::copy_region_32bpp_24bpp(m_private->m_color_width, m_private->m_color_height, m_private->m_color_data.data(),
-													f_hor_offset, f_ver_offset, p_width, p_height, p_data,
-													m_private->m_flip_output);
-
-		default :
-			return false;
+		const img::ImageView *f_background = m_private->m_background;
+
+		if (m_private->m_blur.level() > 0)
+		{
+			const img::ImageView f_color = img::packed_view(m_private->m_color_data.data(), m_private->m_color_width, m_private->m_color_height,
+															source_format(m_private->m_color_format));
+
+			f_background = m_private->m_blur.apply(	f_color, f_region.m_x, f_region.m_y, f_region.m_width, f_region.m_height,
+													p_output.m_width, p_output.m_height, p_output.m_format);
+		}
+
+		m_private->m_body_mask_view.m_background = f_background;
 	}
 
+	if (f_region.m_width != p_output.m_width || f_region.m_height != p_output.m_height)
+		return scaled_color_data(f_region, p_output);
+
+	const img::ImageView f_color = img::packed_view(m_private->m_color_data.data(), m_private->m_color_width, m_private->m_color_height,
+													source_format(m_private->m_color_format));
+
+	return img::copy_region(f_color, (m_private->m_mask_shown) ? &m_private->m_body_mask_view : nullptr,
+							f_region.m_x, f_region.m_y,
+							p_output, m_private->m_flip_output, m_private->m_mirror_output);
+}
+
+bool DeviceKinect::scaled_color_data(Region2D p_region, const img::ImageView &p_output)
+{
+	const img::ImageView f_color = img::packed_view(m_private->m_color_data.data(), m_private->m_color_width, m_private->m_color_height,
+													source_format(m_private->m_color_format));
+	const img::MaskView *f_mask	 = (m_private->m_mask_shown) ? &m_private->m_body_mask_view : nullptr;
+
+	// two taps (bilinear) up to a factor 2, the area filter only kicks in for the larger factors
+	const img::ScaleFilter f_filter = (p_region.m_width < p_output.m_width * 2) ? img::SCALE_BILINEAR : img::SCALE_AREA;
+
+	return img::scale_region(	f_color, f_mask, p_region.m_x, p_region.m_y, p_region.m_width, p_region.m_height,
+								p_output, f_filter, m_private->m_flip_output, m_private->m_mirror_output);
 }
 
 bool DeviceKinect::init_color_stream(DevicePixelFormat p_format, bool p_high_res)
@@ -398,10 +783,16 @@ bool DeviceKinect::init_depth_stream()
 		m_private->m_depth_width  = 320;
 		m_private->m_depth_height = 240;
 		m_private->m_depth_data.resize(320 * 240);
+		m_private->m_keying_labels.resize(320 * 240);
 
 		m_private->m_body_mask.resize(m_private->m_color_width * m_private->m_color_height);
+		m_private->m_body_mask_view = {m_private->m_body_mask.data(), m_private->m_color_width, m_private->m_color_height, m_private->m_color_width, 1, false, nullptr};
+		m_private->m_body_matte.reset();
 		m_private->m_depth_points.resize(m_private->m_color_width * m_private->m_color_height);
 		m_private->m_nui_depth_resolution = NUI_IMAGE_RESOLUTION_320x240;
+		m_private->m_points_valid		  = false;
+		m_private->m_mask_valid			  = false;
+		m_private->m_labels_valid		  = false;
 	}
 
 	return SUCCEEDED (f_result);
@@ -426,6 +817,7 @@ bool DeviceKinect::read_color_frame()
 
 	// process it
 	std::memcpy(m_private->m_color_data.data(), static_cast<BYTE *>(f_locked_rect.pBits), f_locked_rect.size);
+	m_private->m_color_time = f_frame.liTimeStamp.QuadPart;
 
 	// we're done with the texture so unlock it
     f_texture->UnlockRect(0);
@@ -465,6 +857,7 @@ bool DeviceKinect::read_depth_frame()
 
     // release the frame
     m_private->m_sensor->NuiImageStreamReleaseFrame(m_private->m_sensor_depth_stream, &f_frame);
+	++m_private->m_depth_generation;
 	return true;
 }
 
@@ -486,36 +879,64 @@ bool DeviceKinect::read_skeleton_frame()
 
     f_result = m_private->m_sensor->NuiTransformSmooth(&f_kinect_skeletons, &SomewhatLatentParams);
 
-	// iterate of the skeletons and focus on the first
+	// without smoothed skeletons the previous bodies and focus are kept
+	if (FAILED(f_result))
+	{
+		return false;
+	}
+
+	m_private->m_focus_time = f_kinect_skeletons.liTimeStamp.QuadPart;
+
+	// iterate over the skeletons : all tracked skeletons are reported, the first one has the focus
 	m_private->m_focus_available = false;
+	m_private->m_body_count		 = 0;
 
-	for (auto f_idx = 0; SUCCEEDED(f_result) && !m_private->m_focus_available && f_idx < NUI_SKELETON_COUNT; ++f_idx)
+	for (auto f_idx = 0; f_idx < NUI_SKELETON_COUNT; ++f_idx)
 	{
 		auto &f_kinect_skeleton = f_kinect_skeletons.SkeletonData[f_idx];
 
 		// is the body tracked ?
 		bool f_is_tracked = (f_kinect_skeleton.eTrackingState == NUI_SKELETON_TRACKED);
 
-		// convert the location of the focus joint to color space
+		// convert the location of the focus joint to color space, along with a point next to it for the size of the person
 		if (f_is_tracked)
 		{
-			LONG	f_depth_x, f_depth_y;
-			LONG	f_color_x, f_color_y;
-			USHORT	f_depth;
+			Vector4	f_joints[2] = {f_kinect_skeleton.SkeletonPositions[m_private->m_focus_joint], f_kinect_skeleton.SkeletonPositions[m_private->m_focus_joint]};
+			LONG	f_color_x[2], f_color_y[2];
+
+			f_joints[1].x += BODY_SCALE_PROBE;
+
+			// a joint that fails to map only skips its own body
+			HRESULT f_mapped = S_OK;
 
-			NuiTransformSkeletonToDepthImage(f_kinect_skeleton.SkeletonPositions[m_private->m_focus_joint],
-											 &f_depth_x, &f_depth_y, &f_depth);
+			for (int f_j = 0; SUCCEEDED(f_mapped) && f_j < 2; ++f_j)
+			{
+				LONG	f_depth_x, f_depth_y;
+				USHORT	f_depth;
+
+				NuiTransformSkeletonToDepthImage(f_joints[f_j], &f_depth_x, &f_depth_y, &f_depth);
 
-			f_result = m_private->m_kinect_lib->NuiImageGetColorPixelCoordinatesFromDepthPixel(
-															NUI_IMAGE_RESOLUTION_640x480, nullptr,
-															f_depth_x, f_depth_y, f_depth,
-															&f_color_x, &f_color_y);
+				f_mapped = m_private->m_kinect_lib->NuiImageGetColorPixelCoordinatesFromDepthPixel(
+																m_private->m_nui_color_resolution, nullptr,
+																f_depth_x, f_depth_y, f_depth,
+																&f_color_x[f_j], &f_color_y[f_j]);
+			}
 
-			if (SUCCEEDED (f_result))
+			// a joint outside the view of the color camera maps outside the image : skip the body
+			if (SUCCEEDED (f_mapped) && color_point_inside(f_color_x[0], f_color_y[0], m_private->m_color_width, m_private->m_color_height) &&
+										color_point_inside(f_color_x[1], f_color_y[1], m_private->m_color_width, m_private->m_color_height))
 			{
-				m_private->m_focus_available = true;
-				m_private->m_focus.m_x		 = f_color_x;
-				m_private->m_focus.m_y		 = f_color_y;
+				auto &f_tracked = m_private->m_bodies[m_private->m_body_count++];
+				f_tracked.m_focus = {static_cast<int> (f_color_x[0]), static_cast<int> (f_color_y[0])};
+				f_tracked.m_depth = f_joints[0].z;
+				f_tracked.m_scale = std::abs(static_cast<float> (f_color_x[1] - f_color_x[0])) / BODY_SCALE_PROBE;
+
+				if (!m_private->m_focus_available)
+				{
+					m_private->m_focus_available = true;
+					m_private->m_focus			 = f_tracked.m_focus;
+					m_private->m_focus_depth	 = f_tracked.m_depth;
+				}
 			}
 		}
 	}
@@ -523,30 +944,116 @@ bool DeviceKinect::read_skeleton_frame()
 	return true;
 }
 
-bool DeviceKinect::build_index_mask()
+bool DeviceKinect::build_index_mask(Region2D p_region)
 {
-	HRESULT f_result = m_private->m_sensor_coordinate_mapper->MapColorFrameToDepthFrame(	m_private->m_nui_color_type,
-																							m_private->m_nui_color_resolution,
-																							m_private->m_nui_depth_resolution,
-																							m_private->m_depth_data.size(),
-																							m_private->m_depth_data.data(),
-																							m_private->m_depth_points.size(),
-																							m_private->m_depth_points.data());
+	++m_private->m_mask_statistics.m_mask_requests;
 
-	if (FAILED (f_result))
-		return false;
+	// the mask of the previous video frame is still valid when no new depth frame arrived
+	//	(and the focus did not move the region outside of the part of the mask that was built)
+	if (m_private->m_mask_valid &&
+		m_private->m_mask_depth_generation == m_private->m_depth_generation &&
+		region_contains(m_private->m_mask_region, p_region))
+	{
+		return true;
+	}
+
+	++m_private->m_mask_statistics.m_mask_builds;
+	m_private->m_mask_valid = false;
 
-	std::fill(std::begin(m_private->m_body_mask), std::end(m_private->m_body_mask), 0);
-	unsigned char *f_mask = m_private->m_body_mask.data();
+	// calibrate the software mapper at the first depth frame
+	if (!m_private->m_mapper_checked && m_private->m_mapper_depth_generation != m_private->m_depth_generation)
+	{
+		m_private->m_mapper_depth_generation = m_private->m_depth_generation;
+		m_private->m_mapper_checked			 = kinect_calibrate_mapper(m_private.get());
+	}
 
-	for (unsigned int f_idx = 0; f_idx < m_private->m_depth_points.size(); ++f_idx)
+	// only map once per depth frame (the software mapper only maps the region, the runtime always maps the entire color frame)
+	if (!m_private->m_points_valid || m_private->m_points_depth_generation != m_private->m_depth_generation ||
+		!region_contains(m_private->m_points_region, p_region))
 	{
-		int f_depth_idx = (m_private->m_depth_points[f_idx].y * m_private->m_depth_width) + m_private->m_depth_points[f_idx].x;
+		bool f_mapped = false;
+
+		if (m_private->m_mapper.valid())
+		{
+			kinect_depth_values(m_private.get());
 
-		if (f_depth_idx >= 0 && static_cast<unsigned int> (f_depth_idx) < m_private->m_depth_data.size() && m_private->m_depth_data[f_depth_idx].playerIndex != 0)
-			f_mask[f_idx] = 0xff;
+			f_mapped = m_private->m_mapper.color_to_depth(	m_private->m_depth_values.data(), p_region.m_x, p_region.m_y, p_region.m_width, p_region.m_height,
+															reinterpret_cast<keying::DepthPixelPoint *> (m_private->m_depth_points.data()));
+			m_private->m_points_region = p_region;
+		}
+		else
+		{
+			HRESULT f_result = m_private->m_sensor_coordinate_mapper->MapColorFrameToDepthFrame(	m_private->m_nui_color_type,
+																									m_private->m_nui_color_resolution,
+																									m_private->m_nui_depth_resolution,
+																									m_private->m_depth_data.size(),
+																									m_private->m_depth_data.data(),
+																									m_private->m_depth_points.size(),
+																									m_private->m_depth_points.data());
+			f_mapped				   = SUCCEEDED(f_result);
+			m_private->m_points_region = {0, 0, m_private->m_color_width, m_private->m_color_height};
+		}
+
+		m_private->m_points_valid			 = f_mapped;
+		m_private->m_points_depth_generation = m_private->m_depth_generation;
+
+		if (!f_mapped)
+			return false;
+	}
+
+	const auto &					f_kernels	 = img::kernels::row_kernels();
+	const int						f_width		 = m_private->m_color_width;
+	const int						f_depth_w	 = m_private->m_depth_width;
+	const int						f_depth_h	 = m_private->m_depth_height;
+	const NUI_DEPTH_IMAGE_POINT *	f_points	 = m_private->m_depth_points.data();
+	const NUI_DEPTH_IMAGE_PIXEL *	f_depth		 = m_private->m_depth_data.data();
+	unsigned char *					f_mask		 = m_private->m_body_mask.data();
+
+	// the player index of the depth frame, or the depth frame relabeled by the depth range
+	const unsigned int *			f_labels	 = reinterpret_cast<const unsigned int *> (f_depth);
+
+	if (m_private->m_keying != GSK_BODY_INDEX)
+	{
+		f_labels = m_private->m_keying_labels.data();
+
+		if (!m_private->m_labels_valid || m_private->m_labels_depth_generation != m_private->m_depth_generation)
+		{
+			f_kernels.m_depth_window_packed(reinterpret_cast<const unsigned int *> (f_depth), m_private->m_keying == GSK_BODY_INDEX_IN_RANGE,
+											m_private->m_keying_near, m_private->m_keying_far,
+											m_private->m_keying_labels.data(), static_cast<int> (m_private->m_keying_labels.size()));
+			m_private->m_labels_valid			 = true;
+			m_private->m_labels_depth_generation = m_private->m_depth_generation;
+		}
 	}
 
+	// every pixel of the region is written exactly once : rows can be processed in parallel without clearing the mask first
+	parallel::for_each_stripe(p_region.m_height, p_region.m_width * static_cast<int> (sizeof(NUI_DEPTH_IMAGE_POINT)), [=, &f_kernels](int p_begin, int p_end) {
+		for (int f_y = p_region.m_y + p_begin; f_y < p_region.m_y + p_end; ++f_y)
+		{
+			const int f_row = (f_y * f_width) + p_region.m_x;
+
+			f_kernels.m_body_lookup_int(reinterpret_cast<const int *> (f_points + f_row), f_labels,
+										f_depth_w, f_depth_h, f_mask + f_row, p_region.m_width);
+		}
+	});
+
+	// the hard mask is refined into a matte, the copy uses whichever one is current
+	m_private->m_body_mask_view = {f_mask, f_width, m_private->m_color_height, f_width, 1, false, nullptr};
+
+	if (m_private->m_soft_edges)
+	{
+		m_private->m_body_matte.configure(SOFT_EDGE_RADIUS, SOFT_EDGE_WEIGHT);
+
+		if (!m_private->m_body_matte.refine(m_private->m_body_mask_view, p_region.m_x, p_region.m_y, p_region.m_width, p_region.m_height))
+			return false;
+
+		m_private->m_body_mask_view = m_private->m_body_matte.view();
+	}
+
+	m_private->m_mask_region		   = p_region;
+	m_private->m_mask_valid			   = true;
+	m_private->m_mask_depth_generation = m_private->m_depth_generation;
+
 	return true;
 }
 
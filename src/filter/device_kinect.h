@@ -48,30 +48,44 @@ class DeviceKinect : public Device
 		virtual int						video_resolution_native();
 		virtual DeviceVideoResolution	video_resolution(int p_index);
 		virtual void					video_flip_output(bool p_flip);
+		virtual void					video_mirror_output(bool p_mirror);
 		virtual void					video_set_resolution(DeviceVideoResolution p_devres);
+		virtual void					video_set_crop_scale(float p_scale);
+		virtual double					video_time();
 
 		// body tracking
+		virtual void				  focus_enable(bool p_enable);
 		virtual void				  focus_set_joint(int p_joint);
 		virtual bool				  focus_availabe();
 		virtual Point2D				  focus_point();
+		virtual float				  focus_depth();
+		virtual double				  focus_time();
+		virtual int				  focus_bodies(TrackedBody *p_bodies);
 
 		// green screen
 		virtual void				  green_screen_enable(bool p_enable);
+		virtual void				  green_screen_low_res(bool p_enable);
+		virtual void				  green_screen_soft_edges(bool p_enable);
+		virtual void				  green_screen_keying(GreenScreenKeying p_keying, int p_near, int p_far);
+		virtual void				  green_screen_background(const img::ImageView *p_background);
+		virtual void				  green_screen_blur(int p_level);
+		virtual GreenScreenStatistics green_screen_statistics();
 
 		// update
 		virtual bool update();
 
 		// access to image data
-		virtual bool color_data(int p_hor_focus, int p_ver_focus, int p_width, int p_height, int p_bpp, unsigned char *p_data);
+		virtual bool color_data(int p_hor_focus, int p_ver_focus, const img::ImageView &p_output);
 
 	// helper function
 	private :
+		bool scaled_color_data(Region2D p_region, const img::ImageView &p_output);
 		bool init_color_stream(DevicePixelFormat p_format, bool p_high_res);
 		bool init_depth_stream();
 		bool read_color_frame();
 		bool read_depth_frame();
 		bool read_skeleton_frame();
-		bool build_index_mask();
+		bool build_index_mask(Region2D p_region);
 
 	// member variables
 	public :
@@ -15,46 +15,160 @@
 #include "device_kinect_v2.h"
 #include "kinect_v2_wrapper.h"
 
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "image.h"
+#include "image_kernels.h"
+#include "keying.h"
+#include "coordinate_mapper.h"
 #include "com_utils.h"
+#include "thread_pool.h"
 
 namespace device {
 
+namespace {
+
+// the raw YUY2 image is used for all YUV formats, the RGB formats are converted to 32bpp by the sdk
+img::PixelFormat source_format(DevicePixelFormat p_format)
+{
+	return (p_format == DPF_RGB || p_format == DPF_RGBA) ? img::PF_BGRA32 : img::PF_YUY2;
+}
+
+// a depth pixel covers about 3 color pixels : a mask value for each 4x4 color pixels matches the detail of the depth frame
+const int LOW_RES_MASK_SCALE = 4;
+
+// soft edges : feather over the size of about one depth pixel on either side, the new frame weighs 5/8 against the previous one
+const int SOFT_EDGE_RADIUS			= 3;
+const int SOFT_EDGE_RADIUS_LOW_RES	= 1;
+const int SOFT_EDGE_WEIGHT			= 80;
+
+static_assert(sizeof(keying::ColorPoint) == sizeof(ColorSpacePoint), "keying::ColorPoint has to match ColorSpacePoint");
+static_assert(sizeof(DepthSpacePoint) == 2 * sizeof(float), "the body lookup kernels expect DepthSpacePoint to be a pair of floats");
+static_assert(sizeof(keying::DepthPoint) == sizeof(DepthSpacePoint), "keying::DepthPoint has to match DepthSpacePoint");
+static_assert(sizeof(PointF) == sizeof(keying::ColorPoint), "the depth rays of the calibration have to match PointF");
+static_assert(sizeof(CameraSpacePoint) == 3 * sizeof(float), "the projection samples have to match CameraSpacePoint");
+
+// the size of a tracked person in the color image is measured over this distance next to the focus joint (meters)
+const float BODY_SCALE_PROBE = 0.1f;
+
+// the mapper returns -infinity for points the color camera can't see
+bool color_point_inside(const ColorSpacePoint &p_point, int p_width, int p_height)
+{
+	return	std::isfinite(p_point.X) && std::isfinite(p_point.Y) &&
+			p_point.X >= 0.0f && p_point.X < static_cast<float> (p_width) &&
+			p_point.Y >= 0.0f && p_point.Y < static_cast<float> (p_height);
+}
+
+// the flat depth frame (in millimeters) the runtime maps to measure what the projection of the software mapper misses
+const UINT16 CALIBRATION_DEPTH = 2000;
+
+// the mask is held while depth or body index frames are dropped, up to this age (relative to the color frame, in 100 ns)
+//	older masks no longer match the people in front of the sensor : the color image is shown as it is
+const TIMESPAN MASK_MAX_AGE = 5000000;
+
+// map depth frames to color space with the coordinate mapper of the sensor runtime
+keying::DepthToColorFunc sdk_depth_to_color(ICoordinateMapper *p_mapper, int p_depth_size)
+{
+	return [p_mapper, p_depth_size](const uint16_t *p_depth, keying::ColorPoint *p_points) -> bool {
+		return SUCCEEDED(p_mapper->MapDepthFrameToColorSpace(	p_depth_size, p_depth,
+																p_depth_size, reinterpret_cast<ColorSpacePoint *> (p_points)));
+	};
+}
+
+} // unnamed namespace
+
 struct DeviceKinectV2Private
 {
 	Kinect2Funcs *					m_kinect_lib;
 	IKinectSensor *					m_sensor;
 	IColorFrameReader *				m_sensor_color_reader;
 	IMultiSourceFrameReader	*		m_sensor_multi_reader;
+	DWORD							m_multi_sources;			// the frame sources the multi-source reader delivers (0 = no reader)
 	ICoordinateMapper *				m_sensor_coordinate_mapper;
 
 	int								m_color_width;
 	int								m_color_height;
 	std::vector<BYTE>				m_color_data;
 	DevicePixelFormat				m_color_format;
+	TIMESPAN						m_color_time;				// relative time of the last color frame
 
 	bool							m_flip_output;
+	bool							m_mirror_output;
 	bool							m_green_screen;
+	bool							m_tracking;
+	bool							m_scale_output;
+	float							m_crop_scale;
 
 	int								m_depth_width;
 	int								m_depth_height;
 	std::vector<UINT16>				m_depth_data;
+	TIMESPAN						m_depth_time;				// relative time of the last depth frame
 	std::vector<BYTE>				m_body_index_data;
 
+	// the frames are read into these and only swapped with the data above as a complete set (see update)
+	std::vector<UINT16>				m_depth_staging;
+	std::vector<BYTE>				m_body_index_staging;
+
 	std::vector<DepthSpacePoint>	m_depth_points;
 	std::vector<unsigned char>		m_body_mask;
 
+	// the coordinate mapper in software : calibrated from the runtime at the first depth frame, the runtime only maps when that fails
+	keying::CoordinateMapper		m_mapper;
+	bool							m_mapper_checked;
+	unsigned int					m_mapper_depth_generation;	// the depth frame the calibration was last tried on
+
+	// alternative : the body pixels of the depth frame mapped to a low resolution mask
+	bool							m_low_res_mask;
+	keying::LowResBodyMask			m_body_mask_low_res;
+	keying::DepthToColorFunc		m_depth_to_color;
+	img::MaskView					m_body_mask_view;			// the mask used by color_data
+	const img::ImageView *			m_background;				// replaces the masked out pixels (nullptr = black)
+	keying::BackgroundBlur			m_blur;						// or a blurred copy of the color image does
+
+	// optionally : the mask refined into an alpha matte
+	bool							m_soft_edges;
+	keying::SoftMatte				m_body_matte;
+
+	// the depth range keying relabels the depth frame (in the format of the body index frame) before the mask is built
+	GreenScreenKeying				m_keying;
+	int								m_keying_near;
+	int								m_keying_far;
+	std::vector<BYTE>				m_keying_labels;
+	bool							m_labels_valid;				// m_keying_labels belongs to the generations below
+	unsigned int					m_labels_depth_generation;
+	unsigned int					m_labels_body_index_generation;
+	// the mask is only rebuilt when its inputs changed : incremented for every depth and body index frame that is swapped in
+	// the mask is only rebuilt when its inputs changed : incremented for every new depth and body index frame
+	unsigned int					m_depth_generation;
+	unsigned int					m_body_index_generation;
+	unsigned int					m_input_generation;			// incremented for every complete set of inputs (depth and, if used, body index)
+	TIMESPAN						m_input_time;				// relative time of the depth frame of the last complete set (0 = none yet)
+	bool							m_points_valid;				// m_depth_points belongs to m_points_depth_generation
+	unsigned int					m_points_depth_generation;
+	Region2D						m_points_region;			// and is valid in this region of the color image
+	bool							m_mask_valid;				// m_body_mask belongs to the input generation and the region below
+	Region2D						m_mask_region;				// only this region of the color image has a valid mask
+	unsigned int					m_mask_input_generation;
+	bool							m_mask_shown;				// color_data applies the mask to the current video frame
+	GreenScreenStatistics			m_mask_statistics;
+
 	static const int				MAX_BODIES = 6;
 	IBody *							m_kinect_bodies[MAX_BODIES];
+	TrackedBody						m_bodies[MAX_BODIES];		// the tracked ones, in the order of the sensor
+	int								m_body_count;
 	int								m_focus_joint;
 	bool							m_focus_available;
 	Point2D							m_focus;
+	float							m_focus_depth;
+	TIMESPAN						m_focus_time;				// relative time of the body frame of the focus point
 
 	bool							m_reconnect;
 };
 
+static_assert(DeviceKinectV2Private::MAX_BODIES <= MAX_TRACKED_BODIES, "every body the sensor tracks has to fit in focus_bodies");
+
 HRESULT kinectv2_init_color_image(IColorFrameSource *p_source, DeviceKinectV2Private *p_private)
 {
 	com_safe_ptr_t<IFrameDescription>	f_frame_desc = nullptr;
@@ -84,6 +198,7 @@ HRESULT kinectv2_init_depth_image(IDepthFrameSource *p_source, DeviceKinectV2Pri
 	if (SUCCEEDED(f_result))
 	{
 		p_private->m_depth_data.resize(p_private->m_depth_width * p_private->m_depth_height);
+		p_private->m_depth_staging.resize(p_private->m_depth_data.size());
 	}
 
 	return f_result;
@@ -93,10 +208,205 @@ HRESULT kinectv2_init_mask(DeviceKinectV2Private *p_private)
 {
 	p_private->m_depth_points.resize(p_private->m_color_width * p_private->m_color_height);
 	p_private->m_body_mask.resize(p_private->m_color_width * p_private->m_color_height);
+	p_private->m_body_mask_low_res.configure(	p_private->m_depth_width, p_private->m_depth_height,
+												p_private->m_color_width, p_private->m_color_height, LOW_RES_MASK_SCALE);
+	p_private->m_body_mask_view = {nullptr, 0, 0, 0, 1, false, nullptr};
+	p_private->m_points_valid	= false;
+	p_private->m_mask_valid		= false;
+	p_private->m_labels_valid	= false;
+	p_private->m_body_matte.reset();
 
 	return S_OK;
 }
 
+// replace the coordinate mapper of the runtime with the software mapper (see keying::CoordinateMapper)
+//	- the calibration comes from the runtime : the rays of the depth pixels, a projection fitted to points it maps to the color image
+//	  and what that projection misses on a flat depth frame
+//	- the software mapper is only used when it agrees with the runtime on the current depth frame
+//	- returns false to try again on a later depth frame : the runtime does not know the calibration yet, or nothing is in view
+bool kinectv2_calibrate_mapper(DeviceKinectV2Private *p_private)
+{
+	ICoordinateMapper *	f_mapper = p_private->m_sensor_coordinate_mapper;
+	const UINT			f_size	 = p_private->m_depth_width * p_private->m_depth_height;
+
+	keying::CameraCalibration f_calibration;
+	f_calibration.m_depth_width	 = p_private->m_depth_width;
+	f_calibration.m_depth_height = p_private->m_depth_height;
+
+	UINT32	 f_count = 0;
+	PointF * f_table = nullptr;
+
+	if (FAILED(f_mapper->GetDepthFrameToCameraSpaceTable(&f_count, &f_table)))
+		return false;
+
+	if (f_count == f_size)
+	{
+		const keying::ColorPoint *f_rays = reinterpret_cast<const keying::ColorPoint *> (f_table);
+		f_calibration.m_depth_rays.assign(f_rays, f_rays + f_count);
+	}
+
+	CoTaskMemFree(f_table);
+
+	// the table is empty until the runtime has read the calibration from the sensor
+	if (f_calibration.m_depth_rays.empty() || f_calibration.m_depth_rays.front().m_x == f_calibration.m_depth_rays.back().m_x)
+		return false;
+
+	p_private->m_mapper.reset();
+	p_private->m_mask_statistics.m_software_mapping = false;
+
+	std::vector<float>				f_samples = keying::projection_samples(f_calibration);
+	const UINT						f_samples_count = static_cast<UINT> (f_samples.size() / 3);
+	std::vector<keying::ColorPoint>	f_sample_colors(f_samples_count);
+	std::vector<UINT16>				f_flat(f_size, CALIBRATION_DEPTH);
+	std::vector<keying::ColorPoint>	f_sdk_points(f_size);
+	std::vector<keying::ColorPoint>	f_points(f_size);
+
+	HRESULT f_result = f_mapper->MapCameraPointsToColorSpace(	f_samples_count, reinterpret_cast<const CameraSpacePoint *> (f_samples.data()),
+																f_samples_count, reinterpret_cast<ColorSpacePoint *> (f_sample_colors.data()));
+
+	if (SUCCEEDED(f_result) &&
+		keying::fit_color_projection(f_samples.data(), f_sample_colors.data(), f_samples_count, f_calibration.m_color_projection))
+	{
+		f_result = f_mapper->MapDepthFrameToColorSpace(f_size, f_flat.data(), f_size, reinterpret_cast<ColorSpacePoint *> (f_sdk_points.data()));
+
+		if (SUCCEEDED(f_result))
+		{
+			keying::fit_color_offsets(f_calibration, f_sdk_points.data(), CALIBRATION_DEPTH);
+			p_private->m_mapper.configure(f_calibration, p_private->m_color_width, p_private->m_color_height);
+		}
+	}
+
+	// compare both mappers on the depth frame
+	if (p_private->m_mapper.valid() &&
+		SUCCEEDED(f_mapper->MapDepthFrameToColorSpace(f_size, p_private->m_depth_data.data(), f_size, reinterpret_cast<ColorSpacePoint *> (f_sdk_points.data()))) &&
+		p_private->m_mapper.depth_to_color(p_private->m_depth_data.data(), f_points.data()))
+	{
+		const keying::MappingError f_error = keying::compare_mappings(	f_sdk_points.data(), f_points.data(), f_size,
+																		p_private->m_color_width, p_private->m_color_height);
+
+		// nothing in view : try again on the next depth frame
+		if (f_error.m_compared == 0)
+		{
+			p_private->m_mapper.reset();
+			return false;
+		}
+
+		p_private->m_mask_statistics.m_mapping_error = f_error.m_mean;
+
+		if (keying::mappings_match(f_error))
+		{
+			p_private->m_mask_statistics.m_software_mapping = true;
+			p_private->m_depth_to_color						= p_private->m_mapper.depth_to_color_func();
+			p_private->m_points_valid						= false;
+			return true;
+		}
+	}
+
+	p_private->m_mapper.reset();
+	return true;
+}
+
+// the streams the settings need : the body frame to track the focus point, the depth and body index frames for the green
+// screen (depth range keying does not need the body index frame)
+DWORD kinectv2_frame_sources(DeviceKinectV2Private *p_private)
+{
+	DWORD f_sources = 0;
+
+	if (p_private->m_tracking)
+		f_sources |= FrameSourceTypes_Body;
+
+	if (p_private->m_green_screen)
+		f_sources |= FrameSourceTypes_Depth;
+
+	if (p_private->m_green_screen && p_private->m_keying != GSK_DEPTH_RANGE)
+		f_sources |= FrameSourceTypes_BodyIndex;
+
+	return f_sources;
+}
+
+// the multi-source reader only delivers the streams that are used, without any there is no reader at all
+//	(the runtime processes every stream that is opened : with tracking and the green screen off, bodies and depth cost nothing)
+HRESULT kinectv2_open_multi_reader(DeviceKinectV2Private *p_private)
+{
+	const DWORD f_sources = kinectv2_frame_sources(p_private);
+
+	com_safe_release(&p_private->m_sensor_multi_reader);
+	p_private->m_multi_sources = 0;
+
+	if (f_sources == 0)
+		return S_OK;
+
+	HRESULT f_result = p_private->m_sensor->OpenMultiSourceFrameReader(f_sources, &p_private->m_sensor_multi_reader);
+
+	if (SUCCEEDED(f_result))
+		p_private->m_multi_sources = f_sources;
+
+	return f_result;
+}
+
+// reopen the multi-source reader when the settings need other streams
+//	(the last frames of a stream that is dropped are outdated by the time it is used again)
+void kinectv2_update_multi_reader(DeviceKinectV2Private *p_private)
+{
+	const DWORD f_sources = kinectv2_frame_sources(p_private);
+
+	if (!p_private->m_sensor || f_sources == p_private->m_multi_sources)
+		return;
+
+	const DWORD f_dropped = p_private->m_multi_sources & ~f_sources;
+
+	if (f_dropped & FrameSourceTypes_BodyIndex)
+		std::fill(p_private->m_body_index_data.begin(), p_private->m_body_index_data.end(), BYTE(0xff));
+
+	if (f_dropped & FrameSourceTypes_Body)
+	{
+		p_private->m_focus_available = false;
+		p_private->m_body_count		 = 0;
+	}
+
+	if (FAILED(kinectv2_open_multi_reader(p_private)))
+		com_safe_release(&p_private->m_sensor_multi_reader);
+}
+
+// the labels the body lookups use : the body index frame, or the depth frame relabeled by the depth range
+const BYTE *kinectv2_keying_labels(DeviceKinectV2Private *p_private)
+{
+	if (p_private->m_keying == GSK_BODY_INDEX)
+		return p_private->m_body_index_data.data();
+
+	if (p_private->m_labels_valid &&
+		p_private->m_labels_depth_generation == p_private->m_depth_generation &&
+		p_private->m_labels_body_index_generation == p_private->m_body_index_generation)
+	{
+		return p_private->m_keying_labels.data();
+	}
+
+	// a single pass over the depth frame : too little work to split it over the thread pool
+	img::kernels::row_kernels().m_depth_window(	p_private->m_depth_data.data(),
+												(p_private->m_keying == GSK_BODY_INDEX_IN_RANGE) ? p_private->m_body_index_data.data() : nullptr,
+												p_private->m_keying_near, p_private->m_keying_far,
+												p_private->m_keying_labels.data(), static_cast<int> (p_private->m_keying_labels.size()));
+
+	p_private->m_labels_valid					= true;
+	p_private->m_labels_depth_generation		= p_private->m_depth_generation;
+	p_private->m_labels_body_index_generation	= p_private->m_body_index_generation;
+
+	return p_private->m_keying_labels.data();
+}
+
+// replace the mask that was just built by its alpha matte (p_region is in mask values)
+bool kinectv2_soften_mask(DeviceKinectV2Private *p_private, Region2D p_region)
+{
+	const int f_radius = (p_private->m_body_mask_view.m_scale > 1) ? SOFT_EDGE_RADIUS_LOW_RES : SOFT_EDGE_RADIUS;
+	p_private->m_body_matte.configure(f_radius, SOFT_EDGE_WEIGHT);
+
+	if (!p_private->m_body_matte.refine(p_private->m_body_mask_view, p_region.m_x, p_region.m_y, p_region.m_width, p_region.m_height))
+		return false;
+
+	p_private->m_body_mask_view = p_private->m_body_matte.view();
+	return true;
+}
+
 //
 // construction
 //
@@ -106,11 +416,36 @@ DeviceKinectV2::DeviceKinectV2() :	m_private(std::make_unique<DeviceKinectV2Priv
 	m_private->m_sensor						= nullptr;
 	m_private->m_sensor_color_reader		= nullptr;
 	m_private->m_sensor_multi_reader		= nullptr;
+	m_private->m_multi_sources				= 0;
 	m_private->m_sensor_coordinate_mapper	= nullptr;
 	m_private->m_color_format				= DPF_RGBA;
 	m_private->m_flip_output				= true;
+	m_private->m_mirror_output				= false;
 	m_private->m_green_screen				= false;
+	m_private->m_tracking					= true;
+	m_private->m_scale_output				= false;
+	m_private->m_crop_scale					= 1.0f;
 	m_private->m_reconnect					= false;
+	m_private->m_low_res_mask				= false;
+	m_private->m_soft_edges					= false;
+	m_private->m_keying						= GSK_BODY_INDEX;
+	m_private->m_keying_near				= 500;
+	m_private->m_keying_far					= 2000;
+	m_private->m_labels_valid				= false;
+	m_private->m_body_mask_view				= {nullptr, 0, 0, 0, 1, false, nullptr};
+	m_private->m_background					= nullptr;
+	m_private->m_depth_generation			= 0;
+	m_private->m_body_index_generation		= 0;
+	m_private->m_input_generation			= 0;
+	m_private->m_input_time					= 0;
+	m_private->m_depth_time					= 0;
+	m_private->m_color_time					= 0;
+	m_private->m_points_valid				= false;
+	m_private->m_mapper_checked				= false;
+	m_private->m_mapper_depth_generation	= 0;
+	m_private->m_mask_valid					= false;
+	m_private->m_mask_shown					= false;
+	m_private->m_mask_statistics			= {0, 0, 0, false, 0.0f};
 }
 
 DeviceKinectV2::~DeviceKinectV2()
@@ -126,6 +461,7 @@ bool DeviceKinectV2::connect_to_first()
 	m_private->m_sensor						= nullptr;
 	m_private->m_sensor_color_reader		= nullptr;
 	m_private->m_sensor_multi_reader		= nullptr;
+	m_private->m_multi_sources				= 0;
 	m_private->m_sensor_coordinate_mapper	= nullptr;
 
 	std::fill(std::begin(m_private->m_kinect_bodies), std::end(m_private->m_kinect_bodies), nullptr);
@@ -195,11 +531,10 @@ bool DeviceKinectV2::connect_to_first()
 		}
 	}
 
-	// obtain a multisource-reader for the other sources
+	// obtain a multisource-reader for the other sources (the ones the settings need)
 	if (SUCCEEDED(f_result))
 	{
-		f_result = m_private->m_sensor->OpenMultiSourceFrameReader(	FrameSourceTypes_BodyIndex | FrameSourceTypes_Body | FrameSourceTypes_Depth,
-																	&m_private->m_sensor_multi_reader);
+		f_result = kinectv2_open_multi_reader(m_private.get());
 	}
 
 	// initialization for the depth reader
@@ -218,8 +553,10 @@ bool DeviceKinectV2::connect_to_first()
 	// initialization for the body index reader
 	if (SUCCEEDED(f_result))
 	{
-		// dimensions are the same as the depth buffer
-		m_private->m_body_index_data.resize(m_private->m_depth_width * m_private->m_depth_height);
+		// dimensions are the same as the depth buffer (512 x 424 : a multiple of 4, as the body lookup kernels require)
+		m_private->m_body_index_data.resize(m_private->m_depth_width * m_private->m_depth_height, 0xff);
+		m_private->m_body_index_staging.resize(m_private->m_body_index_data.size());
+		m_private->m_keying_labels.resize(m_private->m_depth_width * m_private->m_depth_height);
 
 		if (SUCCEEDED(f_result))
 		{
@@ -233,6 +570,14 @@ bool DeviceKinectV2::connect_to_first()
 		f_result = m_private->m_sensor->get_CoordinateMapper(&m_private->m_sensor_coordinate_mapper);
 	}
 
+	if (SUCCEEDED(f_result))
+	{
+		m_private->m_depth_to_color = sdk_depth_to_color(m_private->m_sensor_coordinate_mapper, m_private->m_depth_width * m_private->m_depth_height);
+		m_private->m_mapper.reset();
+		m_private->m_mapper_checked			 = false;
+		m_private->m_mapper_depth_generation = m_private->m_depth_generation;
+	}
+
 	// release resources if something failed
 	if (FAILED(f_result))
 	{
@@ -247,6 +592,9 @@ bool DeviceKinectV2::connect_to_first()
 		m_private->m_focus_joint	 = JointType_Head;
 		m_private->m_focus_available = false;
 		m_private->m_focus			 = {0, 0};
+		m_private->m_focus_depth	 = 0.0f;
+		m_private->m_focus_time		 = 0;
+		m_private->m_body_count		 = 0;
 		return true;
 	}
 
@@ -256,6 +604,8 @@ bool DeviceKinectV2::connect_to_first()
 bool DeviceKinectV2::disconnect()
 {
 	com_safe_release(&m_private->m_sensor_color_reader);
+	com_safe_release(&m_private->m_sensor_multi_reader);
+	m_private->m_multi_sources = 0;
 
 	if (m_private->m_sensor)
 	{
@@ -266,6 +616,15 @@ bool DeviceKinectV2::disconnect()
 	m_private->m_color_data.clear();
 	m_private->m_depth_data.clear();
 	m_private->m_body_index_data.clear();
+	m_private->m_depth_staging.clear();
+	m_private->m_body_index_staging.clear();
+	m_private->m_keying_labels.clear();
+	m_private->m_mapper.reset();
+	m_private->m_points_valid	= false;
+	m_private->m_mapper_checked = false;
+	m_private->m_mask_valid		= false;
+	m_private->m_labels_valid	= false;
+	m_private->m_input_time		= 0;		// the relative times of the next connection start over
 
 	return true;
 }
@@ -281,7 +640,29 @@ DeviceVideoResolution DeviceKinectV2::m_video_resolutions[] = { { 320,  240, 32,
 																{ 640,  480, 24, 30, DPF_RGB},
 																{1920, 1080, 24, 30, DPF_RGB},
 																{ 320,  240, 16, 30, DPF_YUY2},		// XXX do not assume the native format is YUY2
-																{1920, 1080, 16, 30, DPF_YUY2}
+																{1920, 1080, 16, 30, DPF_YUY2},
+																{ 320,  240, 12, 30, DPF_NV12},
+																{ 640,  480, 12, 30, DPF_NV12},
+																{1920, 1080, 12, 30, DPF_NV12},
+																{ 320,  240, 12, 30, DPF_I420},
+																{ 640,  480, 12, 30, DPF_I420},
+																{1920, 1080, 12, 30, DPF_I420},
+																// the full field of view, scaled down
+																{1280,  720, 32, 30, DPF_RGBA, true},
+																{ 960,  540, 32, 30, DPF_RGBA, true},
+																{ 640,  360, 32, 30, DPF_RGBA, true},
+																{1280,  720, 24, 30, DPF_RGB,  true},
+																{ 960,  540, 24, 30, DPF_RGB,  true},
+																{ 640,  360, 24, 30, DPF_RGB,  true},
+																{1280,  720, 16, 30, DPF_YUY2, true},
+																{ 960,  540, 16, 30, DPF_YUY2, true},
+																{ 640,  360, 16, 30, DPF_YUY2, true},
+																{1280,  720, 12, 30, DPF_NV12, true},
+																{ 960,  540, 12, 30, DPF_NV12, true},
+																{ 640,  360, 12, 30, DPF_NV12, true},
+																{1280,  720, 12, 30, DPF_I420, true},
+																{ 960,  540, 12, 30, DPF_I420, true},
+																{ 640,  360, 12, 30, DPF_I420, true}
 															  };
 
 int	DeviceKinectV2::video_resolution_count()
@@ -307,6 +688,26 @@ DeviceVideoResolution DeviceKinectV2::video_resolution(int p_index)
 void DeviceKinectV2::video_set_resolution(DeviceVideoResolution p_devres)
 {
 	m_private->m_color_format = p_devres.m_pixel_format;
+	m_private->m_scale_output = false;
+
+	for (int f_idx = 0; f_idx < video_resolution_count(); ++f_idx)
+	{
+		const auto &f_res = m_video_resolutions[f_idx];
+
+		if (f_res.m_width == p_devres.m_width && f_res.m_height == abs(p_devres.m_height) && f_res.m_pixel_format == p_devres.m_pixel_format)
+			m_private->m_scale_output = f_res.m_scaled;
+	}
+}
+
+void DeviceKinectV2::video_set_crop_scale(float p_scale)
+{
+	m_private->m_crop_scale = p_scale;
+}
+
+double DeviceKinectV2::video_time()
+{
+	// the color and body frames carry the time of the sensor (in 100 ns)
+	return static_cast<double> (m_private->m_color_time) / 10000000.0;
 }
 
 void DeviceKinectV2::video_flip_output(bool p_flip)
@@ -314,10 +715,24 @@ void DeviceKinectV2::video_flip_output(bool p_flip)
 	m_private->m_flip_output = p_flip;
 }
 
+void DeviceKinectV2::video_mirror_output(bool p_mirror)
+{
+	m_private->m_mirror_output = p_mirror;
+}
+
 //
 // body tracking
 //
 
+void DeviceKinectV2::focus_enable(bool p_enable)
+{
+	if (p_enable != m_private->m_tracking)
+	{
+		m_private->m_tracking = p_enable;
+		kinectv2_update_multi_reader(m_private.get());
+	}
+}
+
 void DeviceKinectV2::focus_set_joint(int p_joint)
 {
 	if (p_joint >= 0 && p_joint < JointType_Count)
@@ -334,13 +749,95 @@ Point2D	DeviceKinectV2::focus_point()
 	return m_private->m_focus;
 }
 
+float DeviceKinectV2::focus_depth()
+{
+	return (m_private->m_focus_available) ? m_private->m_focus_depth : 0.0f;
+}
+
+double DeviceKinectV2::focus_time()
+{
+	return (m_private->m_focus_available) ? static_cast<double> (m_private->m_focus_time) / 10000000.0 : 0.0;
+}
+
+int DeviceKinectV2::focus_bodies(TrackedBody *p_bodies)
+{
+	if (!m_private->m_focus_available)
+		return 0;
+
+	std::copy(m_private->m_bodies, m_private->m_bodies + m_private->m_body_count, p_bodies);
+	return m_private->m_body_count;
+}
+
 //
 // green screen
 //
 
 void DeviceKinectV2::green_screen_enable(bool p_enable)
 {
+	// the matte of the last frame before the green screen was disabled is no longer relevant
+	if (p_enable && !m_private->m_green_screen)
+		m_private->m_body_matte.reset();
+
 	m_private->m_green_screen = p_enable;
+	kinectv2_update_multi_reader(m_private.get());
+}
+
+void DeviceKinectV2::green_screen_low_res(bool p_enable)
+{
+	if (p_enable != m_private->m_low_res_mask)
+	{
+		m_private->m_low_res_mask = p_enable;
+		m_private->m_mask_valid	  = false;
+	}
+}
+
+void DeviceKinectV2::green_screen_soft_edges(bool p_enable)
+{
+	if (p_enable != m_private->m_soft_edges)
+	{
+		m_private->m_soft_edges = p_enable;
+		m_private->m_mask_valid = false;
+		m_private->m_body_matte.reset();
+	}
+}
+
+void DeviceKinectV2::green_screen_keying(GreenScreenKeying p_keying, int p_near, int p_far)
+{
+	if (p_keying != GSK_DEPTH_RANGE && p_keying != GSK_BODY_INDEX_IN_RANGE)
+		p_keying = GSK_BODY_INDEX;
+
+	// depth 0 means unknown : never part of the range
+	p_near = (p_near < 1) ? 1 : (p_near > 0xffff) ? 0xffff : p_near;
+	p_far  = (p_far < p_near) ? p_near : (p_far > 0xffff) ? 0xffff : p_far;
+
+	if (p_keying == m_private->m_keying && p_near == m_private->m_keying_near && p_far == m_private->m_keying_far)
+		return;
+
+	m_private->m_keying		  = p_keying;
+	m_private->m_keying_near  = p_near;
+	m_private->m_keying_far	  = p_far;
+	m_private->m_labels_valid = false;
+	m_private->m_mask_valid	  = false;
+
+	// (un)subscribe from the body index stream
+	kinectv2_update_multi_reader(m_private.get());
+}
+
+void DeviceKinectV2::green_screen_background(const img::ImageView *p_background)
+{
+	// the image is owned by the caller, it has to stay valid until it is replaced
+	m_private->m_background = p_background;
+}
+
+void DeviceKinectV2::green_screen_blur(int p_level)
+{
+	if (p_level != m_private->m_blur.level())
+		m_private->m_blur.configure(p_level);
+}
+
+GreenScreenStatistics DeviceKinectV2::green_screen_statistics()
+{
+	return m_private->m_mask_statistics;
 }
 
 //
@@ -361,9 +858,29 @@ bool DeviceKinectV2::update()
 	com_safe_ptr_t<IMultiSourceFrame>	f_multi_frame = nullptr;
 	if (m_private->m_sensor_multi_reader && SUCCEEDED (m_private->m_sensor_multi_reader->AcquireLatestFrame(&f_multi_frame)))
 	{
-		f_new_data |= read_body_index_frame(f_multi_frame.get());
-		f_new_data |= read_body_frame(f_multi_frame.get());
-		f_new_data |= read_depth_frame(f_multi_frame.get());
+		const DWORD f_sources	= m_private->m_multi_sources;
+		const bool f_body_index = (f_sources & FrameSourceTypes_BodyIndex) && read_body_index_frame(f_multi_frame.get());
+		const bool f_body		= (f_sources & FrameSourceTypes_Body) && read_body_frame(f_multi_frame.get());
+		const bool f_depth		= (f_sources & FrameSourceTypes_Depth) && read_depth_frame(f_multi_frame.get());
+
+		f_new_data |= f_body_index || f_body || f_depth;
+
+		// the mask only follows complete sets of inputs : a depth frame without its body index frame (or the other way around)
+		//	would mix two points in time, the last set is held instead (also when the mask is rebuilt for another region)
+		if (f_depth && (f_body_index || m_private->m_keying == GSK_DEPTH_RANGE))
+		{
+			m_private->m_depth_data.swap(m_private->m_depth_staging);
+			++m_private->m_depth_generation;
+
+			if (f_body_index)
+			{
+				m_private->m_body_index_data.swap(m_private->m_body_index_staging);
+				++m_private->m_body_index_generation;
+			}
+
+			++m_private->m_input_generation;
+			m_private->m_input_time = m_private->m_depth_time;
+		}
 	}
 
 	return f_new_data;
@@ -374,55 +891,83 @@ bool DeviceKinectV2::update()
 // access to image data
 //
 
-bool DeviceKinectV2::color_data(int p_hor_focus, int p_ver_focus, int p_width, int p_height, int p_bpp, unsigned char *p_data)
+bool DeviceKinectV2::color_data(int p_hor_focus, int p_ver_focus, const img::ImageView &p_output)
 {
 	if (m_private->m_color_data.empty())
 		return false;
 
-	if (p_width  > m_private->m_color_width  ||
-	    p_height > m_private->m_color_height)
+	if (p_output.m_width  > m_private->m_color_width  ||
+	    p_output.m_height > m_private->m_color_height)
 	{
 		return false;
 	}
 
-	// offsets
-	int f_hor_offset = p_hor_focus - (p_width / 2);
-	f_hor_offset	 = min(max(f_hor_offset, 0), m_private->m_color_width - p_width);
+	// the region of the color image to show : the full image or (a zoomed) crop around the focus point
+	Region2D f_region = {0, 0, m_private->m_color_width, m_private->m_color_height};
+
+	if (!m_private->m_scale_output)
+		f_region = focus_region(m_private->m_color_width, m_private->m_color_height, {p_hor_focus, p_ver_focus}, p_output.m_width, p_output.m_height, m_private->m_crop_scale);
+
+	// the raw YUY2 image is used for all YUV formats: crops have to start on a macropixel boundary (or the chroma gets swapped)
+	if (m_private->m_color_format != DPF_RGB && m_private->m_color_format != DPF_RGBA)
+		f_region.m_x &= ~1;
 
-	int f_ver_offset = p_ver_focus - (p_height / 2);
-	f_ver_offset	 = min(max(f_ver_offset, 0), m_private->m_color_height - p_height);
+	// only the pixels that are shown need a mask
+	//	without recent inputs (or when the mask fails) the color image is passed through instead of keyed with a stale mask
+	m_private->m_mask_shown = false;
 
 	if (m_private->m_green_screen)
-		build_index_mask();
-
-	switch (m_private->m_color_format)
-	{
-		case DPF_RGBA :
-			if (m_private->m_green_screen)
-				return img::copy_region_32bpp_32bpp_mask(	m_private->m_color_width, m_private->m_color_height, m_private->m_color_data.data(), m_private->m_body_mask.data(),
-															f_hor_offset, f_ver_offset, p_width, p_height, p_data,
-															m_private->m_flip_output);
-			else
-				return img::copy_region_32bpp_32bpp(m_private->m_color_width, m_private->m_color_height, m_private->m_color_data.data(),
-													f_hor_offset, f_ver_offset, p_width, p_height, p_data,
-													m_private->m_flip_output);
-		case DPF_RGB :
-			if (m_private->m_green_screen)
-				return img::copy_region_32bpp_24bpp_mask(	m_private->m_color_width, m_private->m_color_height, m_private->m_color_data.data(), m_private->m_body_mask.data(),
-															f_hor_offset, f_ver_offset, p_width, p_height, p_data,
-															m_private->m_flip_output);
-			else
-				return img::copy_region_32bpp_24bpp(m_private->m_color_width, m_private->m_color_height, m_private->m_color_data.data(),
-													f_hor_offset, f_ver_offset, p_width, p_height, p_data,
-													m_private->m_flip_output);
-
-		case DPF_YUY2 :
-			return img::copy_region_yuy2(	m_private->m_color_width, m_private->m_color_height, m_private->m_color_data.data(),
-											f_hor_offset, f_ver_offset, p_width, p_height, p_data);
-
-		default :
-			return false;
+	{
+		const bool f_inputs_recent = m_private->m_input_time != 0 && m_private->m_color_time - m_private->m_input_time <= MASK_MAX_AGE;
+
+		m_private->m_mask_shown = f_inputs_recent && build_index_mask(f_region);
+
+		if (!m_private->m_mask_shown)
+			++m_private->m_mask_statistics.m_mask_dropped;
+	}
+
+	if (m_private->m_mask_shown)
+	{
+		const img::ImageView *f_background = m_private->m_background;
+
+		if (m_private->m_blur.level() > 0)
+		{
+			const img::ImageView f_color = img::packed_view(m_private->m_color_data.data(), m_private->m_color_width, m_private->m_color_height,
+															source_format(m_private->m_color_format));
+
+			f_background = m_private->m_blur.apply(	f_color, f_region.m_x, f_region.m_y, f_region.m_width, f_region.m_height,
+													p_output.m_width, p_output.m_height, p_output.m_format);
+		}
+
+		m_private->m_body_mask_view.m_background = f_background;
 	}
+
+	if (f_region.m_width != p_output.m_width || f_region.m_height != p_output.m_height)
+		return scaled_color_data(f_region, p_output);
+
+	const img::ImageView f_color = img::packed_view(m_private->m_color_data.data(), m_private->m_color_width, m_private->m_color_height,
+													source_format(m_private->m_color_format));
+
+	return img::copy_region(f_color, (m_private->m_mask_shown) ? &m_private->m_body_mask_view : nullptr,
+							f_region.m_x, f_region.m_y,
+							p_output, m_private->m_flip_output, m_private->m_mirror_output);
+}
+
+bool DeviceKinectV2::scaled_color_data(Region2D p_region, const img::ImageView &p_output)
+{
+	const img::ImageView f_color = img::packed_view(m_private->m_color_data.data(), m_private->m_color_width, m_private->m_color_height,
+													source_format(m_private->m_color_format));
+	const img::MaskView *f_mask	 = (m_private->m_mask_shown) ? &m_private->m_body_mask_view : nullptr;
+
+	// the fixed scaled resolutions get the best quality, a zoomed crop stays within a fixed budget :
+	//	two taps (bilinear) up to a factor 2, the area filter only kicks in for the larger factors
+	img::ScaleFilter f_filter = img::SCALE_AREA;
+
+	if (!m_private->m_scale_output && p_region.m_width < p_output.m_width * 2)
+		f_filter = img::SCALE_BILINEAR;
+
+	return img::scale_region(	f_color, f_mask, p_region.m_x, p_region.m_y, p_region.m_width, p_region.m_height,
+								p_output, f_filter, m_private->m_flip_output, m_private->m_mirror_output);
 }
 
 bool DeviceKinectV2::read_color_frame()
@@ -440,11 +985,14 @@ bool DeviceKinectV2::read_color_frame()
 		f_result = f_frame->CopyConvertedFrameDataToArray(static_cast<UINT> (m_private->m_color_data.size()), m_private->m_color_data.data(), ColorImageFormat_Bgra);
 	}
 
-	if (SUCCEEDED(f_result) && m_private->m_color_format == DPF_YUY2)
+	if (SUCCEEDED(f_result) && (m_private->m_color_format == DPF_YUY2 || m_private->m_color_format == DPF_NV12 || m_private->m_color_format == DPF_I420))
 	{
 		f_result = f_frame->CopyRawFrameDataToArray(static_cast<UINT> (m_private->m_color_data.size() / 2), m_private->m_color_data.data());
 	}
 
+	if (SUCCEEDED(f_result))
+		f_result = f_frame->get_RelativeTime(&m_private->m_color_time);
+
 	return SUCCEEDED(f_result);
 }
 
@@ -466,7 +1014,7 @@ bool DeviceKinectV2::read_body_index_frame(IMultiSourceFrame *p_multi_source_fra
 
 	if (SUCCEEDED(f_result))
 	{
-		f_result = f_frame->CopyFrameDataToArray(static_cast<UINT> (m_private->m_body_index_data.size()), reinterpret_cast<BYTE *> (m_private->m_body_index_data.data()));
+		f_result = f_frame->CopyFrameDataToArray(static_cast<UINT> (m_private->m_body_index_staging.size()), reinterpret_cast<BYTE *> (m_private->m_body_index_staging.data()));
 	}
 
 	return SUCCEEDED(f_result);
@@ -493,10 +1041,16 @@ bool DeviceKinectV2::read_body_frame(IMultiSourceFrame *p_multi_source_frame)
 		f_result = f_frame->GetAndRefreshBodyData(DeviceKinectV2Private::MAX_BODIES, m_private->m_kinect_bodies);
 	}
 
-	// iterate of the bodies
+	if (SUCCEEDED(f_result))
+	{
+		f_result = f_frame->get_RelativeTime(&m_private->m_focus_time);
+	}
+
+	// iterate over the bodies : all tracked bodies are reported, the first one has the focus
 	m_private->m_focus_available = false;
+	m_private->m_body_count		 = 0;
 
-	for (auto f_idx = 0; SUCCEEDED(f_result) && !m_private->m_focus_available && f_idx < DeviceKinectV2Private::MAX_BODIES; ++f_idx)
+	for (auto f_idx = 0; SUCCEEDED(f_result) && f_idx < DeviceKinectV2Private::MAX_BODIES; ++f_idx)
 	{
 		auto *  f_body		 = m_private->m_kinect_bodies[f_idx];
 		BOOLEAN f_is_tracked = false;
@@ -514,17 +1068,30 @@ bool DeviceKinectV2::read_body_frame(IMultiSourceFrame *p_multi_source_frame)
 			f_result = f_body->GetJoints(JointType_Count, f_joints);
 		}
 
-		// convert the location of the focus joint to color space
+		// convert the location of the focus joint to color space, along with a point next to it for the size of the person
 		if (SUCCEEDED(f_result) && f_is_tracked)
 		{
-			ColorSpacePoint	f_point;
-			f_result = m_private->m_sensor_coordinate_mapper->MapCameraPointToColorSpace(f_joints[m_private->m_focus_joint].Position, &f_point);
+			CameraSpacePoint f_camera[2] = {f_joints[m_private->m_focus_joint].Position, f_joints[m_private->m_focus_joint].Position};
+			ColorSpacePoint	 f_points[2];
+
+			f_camera[1].X += BODY_SCALE_PROBE;
+			f_result = m_private->m_sensor_coordinate_mapper->MapCameraPointsToColorSpace(2, f_camera, 2, f_points);
 
-			if (SUCCEEDED (f_result))
+			// a joint that can't be seen from the color camera maps to -infinity : skip the body
+			if (SUCCEEDED (f_result) && color_point_inside(f_points[0], m_private->m_color_width, m_private->m_color_height) &&
+										color_point_inside(f_points[1], m_private->m_color_width, m_private->m_color_height))
 			{
-				m_private->m_focus_available = true;
-				m_private->m_focus.m_x		 = static_cast<int> (f_point.X);
-				m_private->m_focus.m_y		 = static_cast<int> (f_point.Y);
+				auto &f_tracked = m_private->m_bodies[m_private->m_body_count++];
+				f_tracked.m_focus = {static_cast<int> (f_points[0].X), static_cast<int> (f_points[0].Y)};
+				f_tracked.m_depth = f_camera[0].Z;
+				f_tracked.m_scale = std::abs(f_points[1].X - f_points[0].X) / BODY_SCALE_PROBE;
+
+				if (!m_private->m_focus_available)
+				{
+					m_private->m_focus_available = true;
+					m_private->m_focus			 = f_tracked.m_focus;
+					m_private->m_focus_depth	 = f_tracked.m_depth;
+				}
 			}
 		}
 	}
@@ -550,9 +1117,12 @@ bool DeviceKinectV2::read_depth_frame(IMultiSourceFrame *p_multi_source_frame)
 
 	if (SUCCEEDED(f_result))
 	{
-		f_result = f_frame->CopyFrameDataToArray(static_cast<UINT> (m_private->m_body_index_data.size()), reinterpret_cast<UINT16 *> (m_private->m_depth_data.data()));
+		f_result = f_frame->CopyFrameDataToArray(static_cast<UINT> (m_private->m_depth_staging.size()), reinterpret_cast<UINT16 *> (m_private->m_depth_staging.data()));
 	}
 
+	if (SUCCEEDED(f_result))
+		f_result = f_frame->get_RelativeTime(&m_private->m_depth_time);
+
 	return SUCCEEDED(f_result);
 }
 
@@ -590,27 +1160,110 @@ bool DeviceKinectV2::copy_index_buffer(int p_dst_x, int p_dst_y, int p_dst_width
 	return true;
 }
 
-bool DeviceKinectV2::build_index_mask()
+bool DeviceKinectV2::build_index_mask(Region2D p_region)
 {
-	HRESULT f_result = m_private->m_sensor_coordinate_mapper->MapColorFrameToDepthSpace( m_private->m_depth_width * m_private->m_depth_height,
-																						 m_private->m_depth_data.data(),
-																						 m_private->m_color_width * m_private->m_color_height,
-																						 m_private->m_depth_points.data());
+	++m_private->m_mask_statistics.m_mask_requests;
 
-	if (FAILED (f_result))
-		return false;
+	// the color stream can run slower than the video output : reuse the mask until a complete set of new inputs arrives
+	//	(or the focus moves the region outside of the part of the mask that was built)
+	if (m_private->m_mask_valid &&
+		m_private->m_mask_input_generation == m_private->m_input_generation &&
+		region_contains(m_private->m_mask_region, p_region))
+	{
+		return true;
+	}
+
+	++m_private->m_mask_statistics.m_mask_builds;
+	m_private->m_mask_valid = false;
+
+	// calibrate the software mapper at the first depth frame
+	if (!m_private->m_mapper_checked && m_private->m_mapper_depth_generation != m_private->m_depth_generation)
+	{
+		m_private->m_mapper_depth_generation = m_private->m_depth_generation;
+		m_private->m_mapper_checked			 = kinectv2_calibrate_mapper(m_private.get());
+	}
 
-	std::fill(std::begin(m_private->m_body_mask), std::end(m_private->m_body_mask), 0);
-	unsigned char *f_mask = m_private->m_body_mask.data();
+	// the body index frame, or the depth frame relabeled by the depth range
+	const BYTE *f_labels = kinectv2_keying_labels(m_private.get());
 
-	for (unsigned int f_idx = 0; f_idx < m_private->m_depth_points.size(); ++f_idx)
+	// classify the pixels of the depth frame and map only the body pixels to the color image
+	if (m_private->m_low_res_mask)
 	{
-		int f_depth_idx = (static_cast<int>(m_private->m_depth_points[f_idx].Y) * m_private->m_depth_width) + static_cast<int> (m_private->m_depth_points[f_idx].X);
+		if (!m_private->m_body_mask_low_res.build(m_private->m_depth_data.data(), f_labels, m_private->m_depth_to_color))
+			return false;
+
+		// the depth frame is mapped as a whole : the mask covers the entire color image
+		m_private->m_body_mask_view				= m_private->m_body_mask_low_res.view();
+
+		if (m_private->m_soft_edges &&
+			!kinectv2_soften_mask(m_private.get(), {0, 0, m_private->m_body_mask_view.m_width, m_private->m_body_mask_view.m_height}))
+		{
+			return false;
+		}
 
-		if (f_depth_idx >= 0 && static_cast<unsigned int> (f_depth_idx) < m_private->m_depth_data.size() && m_private->m_body_index_data[f_depth_idx] != 0xff)
-			f_mask[f_idx] = 0xff;
+		m_private->m_mask_region				= {0, 0, m_private->m_color_width, m_private->m_color_height};
+		m_private->m_mask_valid					= true;
+		m_private->m_mask_input_generation		= m_private->m_input_generation;
+		return true;
 	}
 
+	// mapping the color frame to depth space is the expensive part, it only depends on the depth frame
+	//	(the software mapper only maps the region, the runtime always maps the entire color frame)
+	if (!m_private->m_points_valid || m_private->m_points_depth_generation != m_private->m_depth_generation ||
+		!region_contains(m_private->m_points_region, p_region))
+	{
+		bool f_mapped = false;
+
+		if (m_private->m_mapper.valid())
+		{
+			f_mapped = m_private->m_mapper.color_to_depth(	m_private->m_depth_data.data(), p_region.m_x, p_region.m_y, p_region.m_width, p_region.m_height,
+															reinterpret_cast<keying::DepthPoint *> (m_private->m_depth_points.data()));
+			m_private->m_points_region = p_region;
+		}
+		else
+		{
+			HRESULT f_result = m_private->m_sensor_coordinate_mapper->MapColorFrameToDepthSpace( m_private->m_depth_width * m_private->m_depth_height,
+																								 m_private->m_depth_data.data(),
+																								 m_private->m_color_width * m_private->m_color_height,
+																								 m_private->m_depth_points.data());
+			f_mapped				   = SUCCEEDED(f_result);
+			m_private->m_points_region = {0, 0, m_private->m_color_width, m_private->m_color_height};
+		}
+
+		m_private->m_points_valid			 = f_mapped;
+		m_private->m_points_depth_generation = m_private->m_depth_generation;
+
+		if (!f_mapped)
+			return false;
+	}
+
+	const auto &			f_kernels	 = img::kernels::row_kernels();
+	const int				f_width		 = m_private->m_color_width;
+	const int				f_depth_w	 = m_private->m_depth_width;
+	const int				f_depth_h	 = m_private->m_depth_height;
+	const DepthSpacePoint *	f_points	 = m_private->m_depth_points.data();
+	unsigned char *			f_mask		 = m_private->m_body_mask.data();
+
+	// every pixel of the region is written exactly once : rows can be processed in parallel without clearing the mask first
+	parallel::for_each_stripe(p_region.m_height, p_region.m_width * static_cast<int> (sizeof(DepthSpacePoint)), [=, &f_kernels](int p_begin, int p_end) {
+		for (int f_y = p_region.m_y + p_begin; f_y < p_region.m_y + p_end; ++f_y)
+		{
+			const int f_row = (f_y * f_width) + p_region.m_x;
+
+			f_kernels.m_body_lookup_float(	reinterpret_cast<const float *> (f_points + f_row), f_labels, f_depth_w, f_depth_h,
+											f_mask + f_row, p_region.m_width);
+		}
+	});
+
+	m_private->m_body_mask_view				= {f_mask, f_width, m_private->m_color_height, f_width, 1, false, nullptr};
+
+	if (m_private->m_soft_edges && !kinectv2_soften_mask(m_private.get(), p_region))
+		return false;
+
+	m_private->m_mask_region				= p_region;
+	m_private->m_mask_valid					= true;
+	m_private->m_mask_input_generation		= m_private->m_input_generation;
+
 	return true;
 }
 
@@ -39,6 +39,7 @@ DeviceNull::DeviceNull() :	m_private(std::make_unique<DeviceNullPrivate>())
 	m_private->m_resolution.m_bits_per_pixel	= 24;
 	m_private->m_resolution.m_framerate			= 10;
 	m_private->m_resolution.m_pixel_format		= DPF_RGB;
+	m_private->m_resolution.m_scaled			= false;
 
 	m_private->m_color_data.resize(320 * 240 * 3);
 }
@@ -89,15 +90,32 @@ void DeviceNull::video_set_resolution(DeviceVideoResolution p_devres)
 {
 }
 
+void DeviceNull::video_set_crop_scale(float p_scale)
+{
+}
+
+double DeviceNull::video_time()
+{
+	return 0.0;
+}
+
 void DeviceNull::video_flip_output(bool p_flip)
 {
 }
 
+void DeviceNull::video_mirror_output(bool p_mirror)
+{
+}
+
 //
 // body tracking
 //
 
 
+void DeviceNull::focus_enable(bool p_enable)
+{
+}
+
 void DeviceNull::focus_set_joint(int p_joint)
 {
 }
@@ -112,6 +130,21 @@ Point2D	DeviceNull::focus_point()
 	return {0,0};
 }
 
+float DeviceNull::focus_depth()
+{
+	return 0.0f;
+}
+
+double DeviceNull::focus_time()
+{
+	return 0.0;
+}
+
+int DeviceNull::focus_bodies(TrackedBody *p_bodies)
+{
+	return 0;
+}
+
 //
 // green screen
 //
@@ -120,6 +153,31 @@ void DeviceNull::green_screen_enable(bool p_enable)
 {
 }
 
+void DeviceNull::green_screen_low_res(bool p_enable)
+{
+}
+
+void DeviceNull::green_screen_soft_edges(bool p_enable)
+{
+}
+
+void DeviceNull::green_screen_keying(GreenScreenKeying p_keying, int p_near, int p_far)
+{
+}
+
+void DeviceNull::green_screen_background(const img::ImageView *p_background)
+{
+}
+
+void DeviceNull::green_screen_blur(int p_level)
+{
+}
+
+GreenScreenStatistics DeviceNull::green_screen_statistics()
+{
+	return {0, 0, 0, false, 0.0f};
+}
+
 //
 // update detected data
 //
@@ -133,16 +191,21 @@ bool DeviceNull::update()
 // access to image data
 //
 
-bool DeviceNull::color_data(int p_hor_focus, int p_ver_focus, int p_width, int p_height, int p_bpp, unsigned char *p_data)
+bool DeviceNull::color_data(int p_hor_focus, int p_ver_focus, const img::ImageView &p_output)
 {
-	if (m_private->m_resolution.m_width				!= p_width ||
-		m_private->m_resolution.m_height			!= p_height ||
-		m_private->m_resolution.m_bits_per_pixel	!= p_bpp)
+	if (m_private->m_resolution.m_width	 != p_output.m_width ||
+		m_private->m_resolution.m_height != p_output.m_height ||
+		p_output.m_format				 != img::PF_BGR24)
 	{
 		return false;
 	}
 
-	std::memcpy(p_data, m_private->m_color_data.data(), m_private->m_color_data.size());
+	// the rows of the bitmap are already in the order of the output (both are bottom-up DIBs)
+	const int f_row_bytes = p_output.m_width * 3;
+
+	for (int f_y = 0; f_y < p_output.m_height; ++f_y)
+		std::memcpy(p_output.m_data + (f_y * p_output.m_stride), m_private->m_color_data.data() + (f_y * f_row_bytes), f_row_bytes);
+
 	return true;
 }
 
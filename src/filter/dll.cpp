@@ -44,6 +44,18 @@ const AMOVIESETUP_MEDIATYPE AMSMediaTypesKCam [] =
 	{
 		&MEDIATYPE_Video,
 		&MEDIASUBTYPE_RGB24
+	},
+	{
+		&MEDIATYPE_Video,
+		&MEDIASUBTYPE_YUY2
+	},
+	{
+		&MEDIATYPE_Video,
+		&MEDIASUBTYPE_NV12
+	},
+	{
+		&MEDIATYPE_Video,
+		&MEDIASUBTYPE_KW_I420
 	}
 };
 
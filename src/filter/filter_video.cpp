@@ -15,13 +15,18 @@
 #define WIN32_LEAN_AND_MEAN
 #include <streams.h>
 #include <sstream>
+#include <fstream>
 #include <stdio.h>
+#include <cmath>
 #include <olectl.h>
 #include <dvdmedia.h>
 
 #include "filter_video.h"
 #include "device.h"
 #include "device_factory.h"
+#include "image.h"
+#include "image_file.h"
+#include "thread_pool.h"
 #include "settings.h"
 #include "guid_filter.h"
 #include "com_utils.h"
@@ -45,6 +50,8 @@ inline DWORD CompressionFromPixelFormat(device::DevicePixelFormat p_pf)
 		case device::DPF_RGBA :	return BI_RGB;
 		case device::DPF_RGB :	return BI_RGB;
 		case device::DPF_YUY2 :	return MAKEFOURCC('Y','U','Y','2');
+		case device::DPF_NV12 :	return MAKEFOURCC('N','V','1','2');
+		case device::DPF_I420 :	return MAKEFOURCC('I','4','2','0');
 		default :				return BI_RGB;
 	}
 }
@@ -56,6 +63,8 @@ inline GUID MediaSubTypeFromPixelFormat(device::DevicePixelFormat p_pf)
 		case device::DPF_RGBA :	return MEDIASUBTYPE_RGB32;
 		case device::DPF_RGB :	return MEDIASUBTYPE_RGB24;
 		case device::DPF_YUY2 :	return MEDIASUBTYPE_YUY2;
+		case device::DPF_NV12 :	return MEDIASUBTYPE_NV12;
+		case device::DPF_I420 :	return MEDIASUBTYPE_KW_I420;
 		default :				return MEDIASUBTYPE_RGB32;
 	}
 }
@@ -68,30 +77,132 @@ inline device::DevicePixelFormat PixelFormatFromMediaSubType(GUID p_mst)
 		return device::DPF_RGB;
 	else if (p_mst == MEDIASUBTYPE_YUY2)
 		return device::DPF_YUY2;
+	else if (p_mst == MEDIASUBTYPE_NV12)
+		return device::DPF_NV12;
+	else if (p_mst == MEDIASUBTYPE_KW_I420)
+		return device::DPF_I420;
 
 	return device::DPF_RGBA;
 }
 
-inline device::Point2D smooth_focus_update(device::Point2D p_focus)
+// the visible width of a video format : biWidth can be larger than rcTarget when the rows of the buffer are padded
+inline int VisibleWidthFromFormat(const VIDEOINFOHEADER *p_vih)
 {
-	static const int		MAX_SMOOTH_POINTS = 30;
-	static device::Point2D	f_points[MAX_SMOOTH_POINTS] = {0};
-	static int				f_index = 0;
-	static int				f_count = 0;
+	if (!IsRectEmpty(&p_vih->rcTarget))
+		return p_vih->rcTarget.right - p_vih->rcTarget.left;
 
-	f_points[f_index] = p_focus;
-	f_index			  = (f_index + 1) % MAX_SMOOTH_POINTS;
-	f_count			  = min(f_count + 1, MAX_SMOOTH_POINTS);
+	return p_vih->bmiHeader.biWidth;
+}
+
+// the image in a media sample of the given video format
+//	- the rows are biWidth pixels apart (RGB rows are padded to a multiple of 4 bytes)
+//	- planar formats : biWidth is the pitch of the Y plane, the chroma planes follow it
+inline img::ImageView ImageViewFromFormat(const VIDEOINFOHEADER *p_vih, device::DevicePixelFormat p_pf, BYTE *p_data)
+{
+	const BITMAPINFOHEADER &f_bmi	 = p_vih->bmiHeader;
+	const img::PixelFormat	f_format = device::image_format(p_pf);
+
+	img::ImageView f_view;
+	f_view.m_data	= p_data;
+	f_view.m_width	= VisibleWidthFromFormat(p_vih);
+	f_view.m_height	= abs(f_bmi.biHeight);
+	f_view.m_format	= f_format;
+
+	if (f_bmi.biCompression == BI_RGB)
+		f_view.m_stride = ((f_bmi.biWidth * f_bmi.biBitCount + 31) & ~31) / 8;
+	else
+		f_view.m_stride = img::packed_stride(f_format, f_bmi.biWidth);
+
+	return f_view;
+}
+
+// the prediction of the focus only extrapolates steady motion, and never more than a fraction of the output
+const float PREDICTION_MAX_OFFSET	  = 100.0f;
+const float PREDICTION_MIN_CONFIDENCE = 0.3f;
+
+inline tracking::FocusPoint smooth_focus_update(	tracking::FocusPredictor *p_predictor, tracking::FocusFilter &p_filter,
+												device::Point2D p_focus, double p_measured, double p_shown, double p_time)
+{
+	tracking::FocusPoint f_result = {static_cast<float> (p_focus.m_x), static_cast<float> (p_focus.m_y)};
+
+	// make up for the latency of the body tracking : extrapolate to the time of the color frame (both on the clock of the sensor)
+	if (p_predictor)
+		f_result = p_predictor->update(f_result, p_measured, p_shown);
+
+	return p_filter.update(f_result, p_time);
+}
+
+inline device::Point2D round_point(tracking::FocusPoint p_point)
+{
+	return {static_cast<int> (floor(p_point.m_x + 0.5f)), static_cast<int> (floor(p_point.m_y + 0.5f))};
+}
+
+// the camera operator : the dead zone and the pan speed are relative to the size of the crop (see TrackingDeadZone and TrackingPanSpeed)
+const float OPERATOR_EASE_TIME = 0.5f;
 
-	device::Point2D	f_result = f_points[0];
+inline tracking::OperatorSettings operator_settings(int p_crop_width, int p_crop_height)
+{
+	const float f_dead_zone = max(settings::TrackingDeadZone, 0) / 100.0f;
+	const float f_speed		= max(settings::TrackingPanSpeed, 1) / 100.0f;
+
+	return {p_crop_width * f_dead_zone, p_crop_height * f_dead_zone, p_crop_width * f_speed, OPERATOR_EASE_TIME};
+}
+
+// the crop is as large as the output with the person at the reference distance and widens as they come closer
+//	(the zoom is limited to keep the cost of the scaler within a fixed budget)
+const float ZOOM_REFERENCE_DEPTH = 2.0f;
+const float ZOOM_MAX			 = 3.0f;
+
+// multi-person framing keeps the heads of everyone in view with some room above them, their shoulders and their chest
+const tracking::FramingRules FRAMING_RULES = {0.3f, 0.6f, 0.4f};
+
+inline float zoom_from_depth(float p_depth)
+{
+	if (p_depth <= 0.0f)
+		return 0.0f;
+
+	return min(max(ZOOM_REFERENCE_DEPTH / p_depth, 1.0f), ZOOM_MAX);
+}
 
-	for (int f_i = 1; f_i < MAX_SMOOTH_POINTS; ++f_i)
+inline float zoom_update(float p_zoom, float p_target)
+{
+	static const float ZOOM_SMOOTHING = 0.1f;
+
+	if (p_target <= 0.0f)
+		return p_zoom;
+
+	return p_zoom + ((p_target - p_zoom) * ZOOM_SMOOTHING);
+}
+
+// the center and the zoom that keep all tracked people in view
+inline tracking::Framing frame_all_bodies(device::Device *p_device, int p_output_width, int p_output_height)
+{
+	device::TrackedBody		f_tracked[device::MAX_TRACKED_BODIES];
+	tracking::FramingBody	f_bodies[device::MAX_TRACKED_BODIES];
+
+	const int f_count = p_device->focus_bodies(f_tracked);
+
+	for (int f_idx = 0; f_idx < f_count; ++f_idx)
 	{
-		f_result.m_x += f_points[f_i].m_x;
-		f_result.m_y += f_points[f_i].m_y;
+		f_bodies[f_idx].m_focus = {static_cast<float> (f_tracked[f_idx].m_focus.m_x), static_cast<float> (f_tracked[f_idx].m_focus.m_y)};
+		f_bodies[f_idx].m_scale = f_tracked[f_idx].m_scale;
 	}
 
-	return {f_result.m_x / f_count, f_result.m_y / f_count};
+	return tracking::frame_bodies(f_bodies, f_count, FRAMING_RULES, p_output_width, p_output_height, ZOOM_MAX);
+}
+
+inline float zoom_quantize(float p_current, float p_zoom)
+{
+	// only pass on noticeable changes : as long as the zoom is stable the scaler reuses its coefficients
+	static const float ZOOM_STEP = 1.0f / 32.0f;
+
+	if (p_zoom <= 1.0f)
+		return 1.0f;
+
+	if (std::fabs(p_zoom - p_current) < ZOOM_STEP)
+		return p_current;
+
+	return std::floor((p_zoom / ZOOM_STEP) + 0.5f) * ZOOM_STEP;
 }
 
 struct DeviceEnumeration
@@ -146,8 +257,12 @@ CKCamStream::CKCamStream(HRESULT *phr, CKCam *pParent, LPCWSTR pPinName) :
     CSourceStream(NAME("KinectWebCam"), phr, pParent, pPinName),
 	m_num_frames(0),
 	m_num_dropped(0),
+	m_zoom(1.0f),
+	m_zoom_applied(1.0f),
 	m_pParent(pParent)
 {
+	DbgLog((LOG_TRACE, 1, "CKCamStream : image functions use %s", img::simd_level_name()));
+
 	// try to load the settings
 	settings::load();
 
@@ -232,18 +347,97 @@ HRESULT CKCamStream::FillBuffer(IMediaSample *pms)
 	if (settings::have_changed())
 		settings::load();
 
+	m_device->focus_enable(settings::TrackingEnabled);
 	m_device->focus_set_joint(settings::TrackingJoint);
 	m_device->green_screen_enable(settings::GreenScreenEnabled);
+	m_device->green_screen_low_res(settings::GreenScreenLowRes);
+	m_device->green_screen_soft_edges(settings::GreenScreenSoftEdges);
+	m_device->green_screen_keying(static_cast<device::GreenScreenKeying> (settings::GreenScreenKeying), settings::GreenScreenNear, settings::GreenScreenFar);
+	m_device->green_screen_blur(settings::GreenScreenBlur);
+	m_device->video_mirror_output(settings::MirrorOutput);
+
+	// (re)load the background image when another file is selected
+	if (settings::GreenScreenBackground != m_background_file)
+	{
+		std::vector<unsigned char>	f_pixels;
+		int							f_width	 = 0;
+		int							f_height = 0;
+
+		m_background_file = settings::GreenScreenBackground;
+
+		if (img::load_image_file(m_background_file.c_str(), f_pixels, f_width, f_height))
+			m_background.assign(std::move(f_pixels), f_width, f_height);
+		else
+			m_background.clear();
+	}
 
 	// let the device update itself
 	m_device->update();
 
+	// the focus is filtered on the timestamps of the samples : real time, also when frames were dropped
+	REFERENCE_TIME f_sample_start = 0;
+	REFERENCE_TIME f_sample_end	  = 0;
+
+	if (FAILED(pms->GetTime(&f_sample_start, &f_sample_end)))
+		f_sample_start = m_num_frames * reinterpret_cast<VIDEOINFOHEADER *> (m_mt.pbFormat)->AvgTimePerFrame;
+
+	m_focus_filter.set_type(static_cast<tracking::FocusFilterType> (min(max(settings::TrackingFilter, 0), 2)));
+
+	m_focus_predictor.configure({settings::TrackingPrediction / 1000.0f, PREDICTION_MAX_OFFSET, PREDICTION_MIN_CONFIDENCE});
+
+	const auto *f_vih			= reinterpret_cast<VIDEOINFOHEADER *> (m_mt.pbFormat);
+	const int	f_output_width	= VisibleWidthFromFormat(f_vih);
+	const int	f_output_height	= abs(f_vih->bmiHeader.biHeight);
+
 	if (settings::TrackingEnabled && m_device->focus_availabe())
 	{
-		m_focus = smooth_focus_update(m_device->focus_point());
+		device::Point2D			f_point	   = m_device->focus_point();
+		float					f_zoom	   = zoom_from_depth(m_device->focus_depth());
+		const double			f_time	   = static_cast<double> (f_sample_start) / UNITS;
+		const double			f_measured = m_device->focus_time();
+		const double			f_shown	   = m_device->video_time();
+
+		// follow the group instead of the first person
+		if (settings::TrackingFrameAll)
+		{
+			const tracking::Framing f_framing = frame_all_bodies(m_device.get(), f_output_width, f_output_height);
+
+			f_point = round_point(f_framing.m_center);
+			f_zoom	= f_framing.m_zoom;
+		}
+
+		if (m_focus_record.is_open())
+			m_focus_record << f_shown << ' ' << f_measured << ' ' << f_point.m_x << ' ' << f_point.m_y << '\n';
+
+		// the prediction needs the timestamps of the frames : a body frame that is seen again keeps its time
+		const bool f_predict = settings::TrackingPrediction > 0 && f_measured > 0.0 && f_shown > 0.0;
+
+		const tracking::FocusPoint f_focus = smooth_focus_update(	(f_predict) ? &m_focus_predictor : nullptr, m_focus_filter,
+																	f_point, f_measured, f_shown, f_time);
+
+		// the crop only pans when the focus leaves the dead zone : a steady picture, and the caches keyed on the crop keep hitting
+		m_camera_operator.configure(operator_settings(static_cast<int> (f_output_width * m_zoom_applied), static_cast<int> (f_output_height * m_zoom_applied)));
+		m_focus = round_point(m_camera_operator.update(f_focus, f_time));
+		m_zoom	= zoom_update(m_zoom, f_zoom);
+	}
+
+	const bool f_zoom_enabled = settings::TrackingEnabled && (settings::TrackingZoom || settings::TrackingFrameAll);
+	m_zoom_applied = zoom_quantize(m_zoom_applied, (f_zoom_enabled) ? m_zoom : 1.0f);
+	m_device->video_set_crop_scale(m_zoom_applied);
+
+	// a downstream allocator can attach a new format to the sample (e.g. a wider pitch) : switch to it
+	AM_MEDIA_TYPE *f_sample_type = nullptr;
+
+	if (pms->GetMediaType(&f_sample_type) == S_OK && f_sample_type)
+	{
+		CMediaType f_type(*f_sample_type);
+		DeleteMediaType(f_sample_type);
+
+		if (f_type.formattype == FORMAT_VideoInfo)
+			SetMediaType(&f_type);
 	}
 
-	// copy the data to the output buffer
+	// write straight into the output buffer, using its pitch
     BYTE *pData = nullptr;
     HRESULT f_result = pms->GetPointer(&pData);
 
@@ -251,7 +445,13 @@ HRESULT CKCamStream::FillBuffer(IMediaSample *pms)
 		return f_result;
 
 	auto *f_pvi = reinterpret_cast<VIDEOINFOHEADER *> (m_mt.Format());
-	m_device->color_data(m_focus.m_x, m_focus.m_y, f_pvi->bmiHeader.biWidth, f_pvi->bmiHeader.biHeight, f_pvi->bmiHeader.biBitCount, pData);
+	const img::ImageView f_output = ImageViewFromFormat(f_pvi, PixelFormatFromMediaSubType(*m_mt.Subtype()), pData);
+
+	// the background is only converted again when the output changes
+	m_device->green_screen_background(	(settings::GreenScreenEnabled && settings::GreenScreenBlur == 0) ?
+											m_background.prepare(f_output.m_width, f_output.m_height, f_output.m_format, settings::MirrorOutput) :
+											nullptr);
+	m_device->color_data(m_focus.m_x, m_focus.m_y, f_output);
 
 	++m_num_frames;
 	return S_OK;
@@ -337,18 +537,19 @@ HRESULT CKCamStream::SetMediaType(const CMediaType *pmt)
 
 	// make sure the device outputs in the correct format
 	device::DeviceVideoResolution	f_devres;
-	f_devres.m_width			= pvi->bmiHeader.biWidth;
+	f_devres.m_width			= VisibleWidthFromFormat(pvi);
 	f_devres.m_height			= pvi->bmiHeader.biHeight;
 	f_devres.m_bits_per_pixel	= pvi->bmiHeader.biBitCount;
 	f_devres.m_framerate		= FrameRateFromInterval(pvi->AvgTimePerFrame);
 	f_devres.m_pixel_format		= PixelFormatFromMediaSubType(*pmt->Subtype());
+	f_devres.m_scaled			= false;		// the device knows which of its resolutions are scaled
 	m_device->video_set_resolution(f_devres);
 
 	// see documentation of BITMAPINFOHEADER (http://msdn.microsoft.com/en-us/library/windows/desktop/dd318229%28v=vs.85%29.aspx) for more details
 	// - For uncompressed RGB bitmaps, if biHeight is positive, the bitmap is a bottom-up DIB with the origin at the lower left corner.
 	//	 If biHeight is negative, the bitmap is a top-down DIB with the origin at the upper left corner.
 	// - For YUV bitmaps, the bitmap is always top-down, regardless of the sign of biHeight.
-	if (pvi->bmiHeader.biCompression == BI_RGB || pvi->bmiHeader.biCompression)
+	if (pvi->bmiHeader.biCompression == BI_RGB)
 		m_device->video_flip_output(pvi->bmiHeader.biHeight > 0);
 	else
 		m_device->video_flip_output(false);
@@ -471,10 +672,24 @@ HRESULT CKCamStream::OnThreadCreate()
 	m_num_dropped = 0;
 	m_num_frames  = 0;
 	m_ref_time_current = 0;
+	m_focus_filter.reset();
+	m_focus_predictor.reset();
+	m_camera_operator.reset();
 
 	// be sure to refresh the settings
 	settings::load();
 
+	// record the measured focus points for tools/focus_eval
+	if (!settings::TrackingRecord.empty())
+	{
+		m_focus_record.open(settings::TrackingRecord.c_str());
+		m_focus_record.setf(std::ios::fixed);
+		m_focus_record.precision(4);
+	}
+
+	// start the worker threads that share the image processing (they park between frames)
+	parallel::acquire_shared_pool(parallel::default_thread_count());
+
 	// reconnect to the device
 	if (m_device)
 	{
@@ -489,9 +704,23 @@ HRESULT CKCamStream::OnThreadDestroy()
 	// disconnect from the device
 	if (m_device)
 	{
+		auto f_stats = m_device->green_screen_statistics();
+		DbgLog((LOG_TRACE, 1, "CKCamStream::OnThreadDestroy : green screen mask reused for %d of %d frames (%d%%)",
+				f_stats.m_mask_requests - f_stats.m_mask_builds, f_stats.m_mask_requests, static_cast<int> (f_stats.hit_rate() * 100.0f)));
+		DbgLog((LOG_TRACE, 1, "CKCamStream::OnThreadDestroy : green screen passed through for %d frames", f_stats.m_mask_dropped));
+		DbgLog((LOG_TRACE, 1, "CKCamStream::OnThreadDestroy : coordinates mapped by the %s (%d.%02d pixels from the runtime)",
+				(f_stats.m_software_mapping) ? "software mapper" : "sensor runtime",
+				static_cast<int> (f_stats.m_mapping_error), static_cast<int> (f_stats.m_mapping_error * 100.0f) % 100));
+
 		m_device->disconnect();
 	}
 
+	if (m_focus_record.is_open())
+		m_focus_record.close();
+
+	// stop the worker threads
+	parallel::release_shared_pool();
+
 	// stop monitoring settings
 	settings::cleanup();
 
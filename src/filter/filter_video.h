@@ -18,7 +18,11 @@
 #define DECLARE_PTR(type, ptr, expr) type* ptr = (type*)(expr);
 
 #include "device.h"
+#include "keying.h"
+#include "tracking.h"
+#include <fstream>
 #include <memory>
+#include <string>
 
 class CKCam : public CSource
 {
@@ -98,6 +102,14 @@ class CKCamStream : public CSourceStream,  public IAMDroppedFrames, public IAMSt
 		// the device
 		std::unique_ptr<device::Device>	m_device;
 		device::Point2D					m_focus;
+		tracking::FocusFilter			m_focus_filter;		// smooths the focus point of this stream
+		tracking::FocusPredictor		m_focus_predictor;	// extrapolates it to the time the sample is shown
+		tracking::CameraOperator		m_camera_operator;	// moves the crop after the smoothed focus
+		std::ofstream					m_focus_record;		// the measured focus points (see TrackingRecord)
+		float							m_zoom;				// smoothed zoom, following the distance to the focus joint
+		float							m_zoom_applied;		// quantized zoom, as passed to the device
+		keying::BackgroundImage			m_background;		// replaces the background of the green screen
+		std::wstring					m_background_file;
 
 		// timing (dropped frames)
 		long			m_num_frames;
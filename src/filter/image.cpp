@@ -13,137 +13,984 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "image.h"
-#include <memory>
+#include "image_formats.h"
+#include "image_kernels.h"
+#include "thread_pool.h"
 
-#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace img {
 
-bool copy_region_32bpp_32bpp(int p_src_width, int p_src_height, unsigned char *p_src_data,
-							 int p_dst_x, int p_dst_y, int p_dst_width, int p_dst_height, unsigned char *p_dst_data,
-							 bool p_flip)
+namespace kernels {
+
+RowKernels row_kernels_for_level(cpu::SimdLevel p_level)
 {
-	cv::Mat f_src(p_src_height, p_src_width, CV_8UC4, p_src_data);
-	cv::Mat f_dst(p_dst_height, p_dst_width, CV_8UC4, p_dst_data);
+	RowKernels f_kernels;
 
-	// cropping
-	cv::Mat f_src_cropped(f_src, cv::Rect(p_dst_x, p_dst_y, p_dst_width, p_dst_height));
+	install_kernels_scalar(f_kernels);
 
-	// copy to output (flipped or not)
-	if (p_flip)
-		cv::flip(f_src_cropped, f_dst, 0);
-	else
-		f_src_cropped.copyTo(f_dst);
+	if (p_level >= cpu::SIMD_SSE2)
+		install_kernels_sse2(f_kernels);
 
-	return true;
+	if (p_level >= cpu::SIMD_SSSE3)
+		install_kernels_ssse3(f_kernels);
+
+	if (p_level >= cpu::SIMD_AVX2)
+		install_kernels_avx2(f_kernels);
+
+	return f_kernels;
 }
 
-bool copy_region_32bpp_32bpp_mask(	int p_src_width, int p_src_height, unsigned char *p_src_data, unsigned char *p_mask_channel,
-									int p_dst_x, int p_dst_y, int p_dst_width, int p_dst_height, unsigned char *p_dst_data,
-									bool p_flip)
+// selected once, when the filter is loaded
+static const RowKernels g_row_kernels = row_kernels_for_level(cpu::simd_level_supported());
+
+const RowKernels &row_kernels()
 {
-	cv::Mat f_src(p_src_height, p_src_width, CV_8UC4, p_src_data);
-	cv::Mat f_dst(p_dst_height, p_dst_width, CV_8UC4, p_dst_data);
-	cv::Mat f_msk(p_src_height, p_src_width, CV_8UC1, p_mask_channel);
+	return g_row_kernels;
+}
 
-	// cropping
-	cv::Mat f_src_cropped(f_src, cv::Rect(p_dst_x, p_dst_y, p_dst_width, p_dst_height));
-	cv::Mat f_msk_cropped(f_msk, cv::Rect(p_dst_x, p_dst_y, p_dst_width, p_dst_height));
+} // namespace kernels
 
-	if (p_flip)
+namespace {
+
+// helper to find the rows of the cropped region of the source and the matching rows of the destination
+struct RegionRows
+{
+	RegionRows(const ImageView &p_src, int p_src_bpp, int p_src_x, int p_src_y, const ImageView &p_dst, bool p_flip) :
+		m_src_stride(p_src.m_stride),
+		m_dst_step(p_flip ? -p_dst.m_stride : p_dst.m_stride),
+		m_src_first(p_src.m_data + (p_src_y * m_src_stride) + (p_src_x * p_src_bpp)),
+		m_dst_first(p_flip ? p_dst.m_data + ((p_dst.m_height - 1) * p_dst.m_stride) : p_dst.m_data)
 	{
-		// mask to a new matrix
-		cv::Mat f_masked;
-		f_src_cropped.copyTo(f_masked, f_msk_cropped);
+	}
 
-		// flip and copy masked temporary to destination
-		cv::flip(f_masked, f_dst, 0);
+	const unsigned char *src_line(int p_y) const
+	{
+		return m_src_first + (p_y * m_src_stride);
 	}
-	else
+
+	unsigned char *dst_line(int p_y) const
 	{
-		// mask to the destination
-		f_src_cropped.copyTo(f_dst, f_msk_cropped);
+		return m_dst_first + (p_y * m_dst_step);
 	}
 
-	return true;
+	const int				m_src_stride;
+	const int				m_dst_step;
+	const unsigned char *	m_src_first;
+	unsigned char *			m_dst_first;
+};
+
+//
+// masks
+//
+
+// a low resolution mask value and the weight (of 256) of the next one, for a position at full resolution
+struct MaskTap
+{
+	int	m_first;
+	int	m_second;
+	int	m_weight;
+};
+
+MaskTap mask_tap(int p_pos, int p_scale, int p_size)
+{
+	// align the centers of the pixels : the position in the mask is ((p_pos + 0.5) / p_scale) - 0.5, in units of 1 / (2 * p_scale)
+	const int f_unit	= 2 * p_scale;
+	const int f_pos		= (2 * p_pos) + 1 - p_scale;
+	const int f_first	= (f_pos >= 0) ? f_pos / f_unit : -((f_unit - 1 - f_pos) / f_unit);
+
+	if (f_first < 0)
+		return {0, 0, 0};
+
+	if (f_first >= p_size - 1)
+		return {p_size - 1, p_size - 1, 0};
+
+	return {f_first, f_first + 1, ((f_pos - (f_first * f_unit)) * 256) / f_unit};
 }
 
-bool copy_region_32bpp_24bpp(int p_src_width, int p_src_height, unsigned char *p_src_data,
-							 int p_dst_x, int p_dst_y, int p_dst_width, int p_dst_height, unsigned char *p_dst_data,
-							 bool p_flip)
+// working memory for the mask rows, reused from frame to frame (each thread that processes rows has its own)
+//	- m_taps belongs to the region being converted by the thread that owns it : the workers read it while that thread waits
+struct MaskScratch
 {
-	cv::Mat f_src(p_src_height, p_src_width, CV_8UC4, p_src_data);
-	cv::Mat f_dst(p_dst_height, p_dst_width, CV_8UC3, p_dst_data);
+	std::vector<MaskTap>		m_taps;
+	std::vector<int>			m_blend;
+	std::vector<unsigned char>	m_row[2];
+};
 
-	// cropping
-	cv::Mat f_src_cropped(f_src, cv::Rect(p_dst_x, p_dst_y, p_dst_width, p_dst_height));
+thread_local MaskScratch g_mask_scratch;
 
-	// color space conversion
-	cv::Mat f_src_rgb;
+// the mask values of the rows of a region, one for each pixel of the source region
+//	- the columns are either all the columns of the region, or a selection of them (the nearest pixels of a scaled region)
+//	- a full resolution mask is used in place when possible, a low resolution mask is interpolated and thresholded
+//	- p_alpha : the rows are used as an alpha matte, the values of a soft mask are passed on instead of thresholded
+class RegionMask
+{
+	public :
+		RegionMask(const MaskView &p_mask, int p_src_x, int p_src_y, int p_width, const int *p_columns, bool p_alpha) :
+			m_mask(p_mask),
+			m_src_x(p_src_x),
+			m_src_y(p_src_y),
+			m_width(p_width),
+			m_columns(p_columns),
+			m_alpha(p_mask.m_soft && p_alpha),
+			m_threshold(p_mask.m_soft && !p_alpha),
+			m_taps(nullptr),
+			m_blend_first(0),
+			m_blend_count(0)
+		{
+			if (m_mask.m_scale <= 1 || m_width <= 0)
+				return;
 
-	cv::cvtColor(f_src_cropped, f_src_rgb, cv::COLOR_RGBA2RGB);
+			auto &f_taps = g_mask_scratch.m_taps;
+			f_taps.resize(m_width);
 
-	// copy to output (flipped or not)
-	if (p_flip)
-		cv::flip(f_src_rgb, f_dst, 0);
-	else
-		f_src_rgb.copyTo(f_dst);
+			for (int f_x = 0; f_x < m_width; ++f_x)
+				f_taps[f_x] = mask_tap(m_src_x + column(f_x), m_mask.m_scale, m_mask.m_width);
+
+			// the columns are in increasing order
+			m_blend_first = f_taps.front().m_first;
+			m_blend_count = f_taps.back().m_second - m_blend_first + 1;
+
+			for (auto &f_tap : f_taps)
+			{
+				f_tap.m_first  -= m_blend_first;
+				f_tap.m_second -= m_blend_first;
+			}
+
+			m_taps = f_taps.data();
+		}
+
+		// the mask of row p_y of the region, valid until the next call with the same slot on this thread
+		const unsigned char *row(int p_y, int p_slot) const
+		{
+			const int f_y = m_src_y + p_y;
+
+			if (m_mask.m_scale <= 1 && !m_columns && !m_threshold)
+				return m_mask.m_data + (f_y * m_mask.m_stride) + m_src_x;
 
-	return true;
+			auto &f_scratch = g_mask_scratch;
+			f_scratch.m_row[p_slot].resize(m_width);
+			unsigned char *f_dst = f_scratch.m_row[p_slot].data();
+
+			if (m_mask.m_scale <= 1)
+			{
+				const unsigned char *f_src = m_mask.m_data + (f_y * m_mask.m_stride) + m_src_x;
+
+				for (int f_x = 0; f_x < m_width; ++f_x)
+					f_dst[f_x] = f_src[column(f_x)];
+
+				if (m_threshold)
+				{
+					for (int f_x = 0; f_x < m_width; ++f_x)
+						f_dst[f_x] = (f_dst[f_x] >= 0x80) ? 0xff : 0;
+				}
+
+				return f_dst;
+			}
+
+			// interpolate vertically once for each mask value, then horizontally for each pixel
+			const MaskTap			f_ver	= mask_tap(f_y, m_mask.m_scale, m_mask.m_height);
+			const unsigned char *	f_src_0 = m_mask.m_data + (f_ver.m_first * m_mask.m_stride) + m_blend_first;
+			const unsigned char *	f_src_1 = m_mask.m_data + (f_ver.m_second * m_mask.m_stride) + m_blend_first;
+
+			f_scratch.m_blend.resize(m_blend_count);
+			int *f_blend = f_scratch.m_blend.data();
+
+			for (int f_c = 0; f_c < m_blend_count; ++f_c)
+				f_blend[f_c] = (f_src_0[f_c] * (256 - f_ver.m_weight)) + (f_src_1[f_c] * f_ver.m_weight);
+
+			if (m_alpha)
+			{
+				for (int f_x = 0; f_x < m_width; ++f_x)
+				{
+					const MaskTap &f_hor = m_taps[f_x];
+					const int	   f_val = (f_blend[f_hor.m_first] * (256 - f_hor.m_weight)) + (f_blend[f_hor.m_second] * f_hor.m_weight);
+
+					f_dst[f_x] = static_cast<unsigned char> ((f_val + (1 << 15)) >> 16);
+				}
+
+				return f_dst;
+			}
+
+			const int f_threshold = 255 * 256 * 128;
+
+			for (int f_x = 0; f_x < m_width; ++f_x)
+			{
+				const MaskTap &f_hor = m_taps[f_x];
+				const int	   f_val = (f_blend[f_hor.m_first] * (256 - f_hor.m_weight)) + (f_blend[f_hor.m_second] * f_hor.m_weight);
+
+				f_dst[f_x] = (f_val >= f_threshold) ? 0xff : 0;
+			}
+
+			return f_dst;
+		}
+
+	private :
+		int column(int p_x) const
+		{
+			return (m_columns) ? m_columns[p_x] : p_x;
+		}
+
+	private :
+		const MaskView			m_mask;
+		const int				m_src_x;
+		const int				m_src_y;
+		const int				m_width;
+		const int *				m_columns;
+		const bool				m_alpha;
+		const bool				m_threshold;
+		const MaskTap *			m_taps;
+		int						m_blend_first;
+		int						m_blend_count;
+};
+
+// a mask has to cover the entire source
+bool mask_fits(const MaskView *p_mask, const ImageView &p_src)
+{
+	if (!p_mask)
+		return true;
+
+	return	p_mask->m_data != nullptr && p_mask->m_scale >= 1 && p_mask->m_width > 0 && p_mask->m_height > 0 &&
+			p_mask->m_stride >= p_mask->m_width &&
+			p_mask->m_width * p_mask->m_scale >= p_src.m_width && p_mask->m_height * p_mask->m_scale >= p_src.m_height;
 }
 
-bool copy_region_32bpp_24bpp_mask(	int p_src_width, int p_src_height, unsigned char *p_src_data, unsigned char *p_mask_channel,
-									int p_dst_x, int p_dst_y, int p_dst_width, int p_dst_height, unsigned char *p_dst_data,
-									bool p_flip)
+// the background of a mask, when it matches the destination (nullptr otherwise : the masked out pixels are black)
+const ImageView *mask_background(const MaskView *p_mask, const ImageView &p_dst)
 {
-	cv::Mat f_src(p_src_height, p_src_width, CV_8UC4, p_src_data);
-	cv::Mat f_dst(p_dst_height, p_dst_width, CV_8UC4, p_dst_data);
-	cv::Mat f_msk(p_src_height, p_src_width, CV_8UC1, p_mask_channel);
+	if (!p_mask || !p_mask->m_background)
+		return nullptr;
+
+	const ImageView &f_bg = *p_mask->m_background;
 
-	// cropping
-	cv::Mat f_src_cropped(f_src, cv::Rect(p_dst_x, p_dst_y, p_dst_width, p_dst_height));
-	cv::Mat f_msk_cropped(f_msk, cv::Rect(p_dst_x, p_dst_y, p_dst_width, p_dst_height));
+	if (f_bg.m_data == nullptr || f_bg.m_format != p_dst.m_format || f_bg.m_width != p_dst.m_width || f_bg.m_height != p_dst.m_height ||
+		f_bg.m_stride < packed_stride(f_bg.m_format, f_bg.m_width))
+	{
+		return nullptr;
+	}
 
-	// color space conversion
-	cv::Mat f_src_rgb;
+	return &f_bg;
+}
 
-	cv::cvtColor(f_src_cropped, f_src_rgb, cv::COLOR_RGBA2RGB);
+inline const unsigned char *background_row(const ImageView *p_background, int p_y)
+{
+	return (p_background) ? p_background->m_data + (p_y * p_background->m_stride) : nullptr;
+}
+
+// the destination rows of a 4:2:0 planar image that belong to each pair of source rows
+struct Yuv420Rows
+{
+	unsigned char *	m_y_0;
+	unsigned char *	m_y_1;
+	unsigned char *	m_u;
+	unsigned char *	m_v;
+};
+
+struct Yuv420Planes
+{
+	Yuv420Planes(const ImageView &p_image, bool p_interleaved, bool p_flip) :
+		m_stride(p_image.m_stride),
+		m_height(p_image.m_height),
+		m_chroma_height(p_image.m_height / 2),
+		m_chroma_stride((p_interleaved) ? p_image.m_stride : p_image.m_stride / 2),
+		m_plane_y(p_image.m_data),
+		m_plane_u(m_plane_y + (p_image.m_stride * p_image.m_height)),
+		m_plane_v((p_interleaved) ? m_plane_u + 1 : m_plane_u + (m_chroma_stride * m_chroma_height)),
+		m_flip(p_flip)
+	{
+	}
 
-	if (p_flip)
+	Yuv420Rows rows(int p_pair) const
 	{
-		// mask to a new matrix
-		cv::Mat f_masked;
-		f_src_rgb.copyTo(f_masked, f_msk_cropped);
+		const int f_dst_y	   = (m_flip) ? m_height - 1 - (p_pair * 2) : p_pair * 2;
+		const int f_dst_y_next = (m_flip) ? f_dst_y - 1 : f_dst_y + 1;
+		const int f_dst_c	   = (m_flip) ? m_chroma_height - 1 - p_pair : p_pair;
 
-		// flip and copy masked temporary to destination
-		cv::flip(f_masked, f_dst, 0);
+		return {m_plane_y + (f_dst_y * m_stride),
+				m_plane_y + (f_dst_y_next * m_stride),
+				m_plane_u + (f_dst_c * m_chroma_stride),
+				m_plane_v + (f_dst_c * m_chroma_stride)};
 	}
+
+	const int		m_stride;
+	const int		m_height;
+	const int		m_chroma_height;
+	const int		m_chroma_stride;
+	unsigned char *	m_plane_y;
+	unsigned char *	m_plane_u;
+	unsigned char *	m_plane_v;
+	const bool		m_flip;
+};
+
+//
+// scaling
+//
+
+// filter coefficients for one direction
+struct ScaleAxis
+{
+	int					m_taps;
+	std::vector<int>	m_offset;
+	std::vector<short>	m_weights;
+	std::vector<int>	m_nearest;		// nearest source sample of each output sample (used for the mask)
+
+	kernels::ScaleTaps taps() const
+	{
+		return {m_taps, m_offset.data(), m_weights.data()};
+	}
+};
+
+struct ScaleCoefficients
+{
+	int			m_src_w;
+	int			m_src_h;
+	int			m_dst_width;
+	int			m_dst_height;
+	ScaleFilter	m_filter;
+
+	ScaleAxis	m_hor;
+	ScaleAxis	m_hor_chroma;			// half the horizontal resolution, for the chroma of YUY2 data
+	ScaleAxis	m_ver;
+};
+
+// the unquantized weights of one output sample, reused by build_scale_axis
+thread_local std::vector<double> g_axis_weights;
+
+void build_scale_axis(int p_src, int p_dst, ScaleFilter p_filter, ScaleAxis &p_axis)
+{
+	const double f_scale = static_cast<double> (p_src) / p_dst;
+	const int	 f_one	 = 1 << 14;
+
+	// the simd kernels process two taps at a time
+	int f_taps = (p_filter == SCALE_AREA) ? static_cast<int> (std::ceil(f_scale)) + 1 : 2;
+	f_taps	   = (f_taps + 1) & ~1;
+
+	p_axis.m_taps = f_taps;
+	p_axis.m_offset.resize(p_dst);
+	p_axis.m_weights.assign(p_dst * f_taps, 0);
+	p_axis.m_nearest.resize(p_dst);
+
+	auto &f_weights = g_axis_weights;
+	f_weights.resize(f_taps);
+
+	for (int f_i = 0; f_i < p_dst; ++f_i)
+	{
+		int f_first = 0;
+		std::fill(std::begin(f_weights), std::end(f_weights), 0.0);
+
+		if (p_filter == SCALE_AREA)
+		{
+			// the output sample covers [f_lo, f_hi) of the source : weigh each source sample by its overlap
+			const double f_lo = f_i * f_scale;
+			const double f_hi = (f_i + 1) * f_scale;
+			f_first = static_cast<int> (f_lo);
+
+			for (int f_t = 0; f_t < f_taps && f_first + f_t < p_src; ++f_t)
+			{
+				const int	 f_j		= f_first + f_t;
+				const double f_overlap	= std::min<double>(f_j + 1, f_hi) - std::max<double>(f_j, f_lo);
+
+				if (f_overlap > 0.0)
+					f_weights[f_t] = f_overlap / f_scale;
+			}
+		}
+		else
+		{
+			// align the centers of the source and the destination pixels
+			const double f_center = std::min(std::max(((f_i + 0.5) * f_scale) - 0.5, 0.0), p_src - 1.0);
+			f_first = static_cast<int> (f_center);
+
+			f_weights[1] = f_center - f_first;
+			f_weights[0] = 1.0 - f_weights[1];
+		}
+
+		// quantize : rounding errors go to the largest weight so the sum is exactly one
+		short *f_quantized = &p_axis.m_weights[f_i * f_taps];
+		int	   f_sum	   = 0;
+		int	   f_largest   = 0;
+
+		for (int f_t = 0; f_t < f_taps; ++f_t)
+		{
+			f_quantized[f_t] = static_cast<short> (std::lround(f_weights[f_t] * f_one));
+			f_sum			+= f_quantized[f_t];
+
+			if (f_quantized[f_t] > f_quantized[f_largest])
+				f_largest = f_t;
+		}
+
+		f_quantized[f_largest] += static_cast<short> (f_one - f_sum);
+
+		p_axis.m_offset[f_i]  = f_first;
+		p_axis.m_nearest[f_i] = std::min(static_cast<int> ((f_i + 0.5) * f_scale), p_src - 1);
+	}
+}
+
+// the coefficients of the most recently used scale operations
+//	- an entry that is no longer used by a scaler is rebuilt in place on a miss : its vectors keep their memory
+const size_t										SCALE_CACHE_SIZE = 4;
+std::mutex											g_scale_cache_lock;
+std::vector<std::shared_ptr<ScaleCoefficients>>		g_scale_cache;
+
+std::shared_ptr<const ScaleCoefficients> scale_coefficients(int p_src_w, int p_src_h, int p_dst_width, int p_dst_height, ScaleFilter p_filter)
+{
+	std::lock_guard<std::mutex> f_lock(g_scale_cache_lock);
+
+	for (auto f_iter = std::begin(g_scale_cache); f_iter != std::end(g_scale_cache); ++f_iter)
+	{
+		const auto &f_coef = **f_iter;
+
+		if (f_coef.m_src_w == p_src_w && f_coef.m_src_h == p_src_h &&
+			f_coef.m_dst_width == p_dst_width && f_coef.m_dst_height == p_dst_height &&
+			f_coef.m_filter == p_filter)
+		{
+			std::rotate(std::begin(g_scale_cache), f_iter, f_iter + 1);
+			return g_scale_cache.front();
+		}
+	}
+
+	// reuse the least recently used entry nobody else holds, allocate a new one while the cache is filling up (or all are in use)
+	auto f_reuse = std::end(g_scale_cache);
+
+	if (g_scale_cache.size() >= SCALE_CACHE_SIZE)
+	{
+		for (auto f_iter = std::end(g_scale_cache); f_iter != std::begin(g_scale_cache) && f_reuse == std::end(g_scale_cache); )
+		{
+			if ((--f_iter)->use_count() == 1)
+				f_reuse = f_iter;
+		}
+	}
+
+	if (f_reuse != std::end(g_scale_cache))
+	{
+		std::rotate(std::begin(g_scale_cache), f_reuse, f_reuse + 1);
+	}
+	else
+	{
+		if (g_scale_cache.size() >= SCALE_CACHE_SIZE)
+			g_scale_cache.pop_back();
+
+		g_scale_cache.reserve(SCALE_CACHE_SIZE);
+		g_scale_cache.insert(std::begin(g_scale_cache), std::make_shared<ScaleCoefficients>());
+	}
+
+	ScaleCoefficients &f_coef = *g_scale_cache.front();
+	f_coef.m_src_w		= p_src_w;
+	f_coef.m_src_h		= p_src_h;
+	f_coef.m_dst_width	= p_dst_width;
+	f_coef.m_dst_height	= p_dst_height;
+	f_coef.m_filter		= p_filter;
+
+	build_scale_axis(p_src_w, p_dst_width, p_filter, f_coef.m_hor);
+	build_scale_axis(p_src_h, p_dst_height, p_filter, f_coef.m_ver);
+
+	if (p_src_w >= 2 && p_dst_width >= 2)
+		build_scale_axis(p_src_w / 2, p_dst_width / 2, p_filter, f_coef.m_hor_chroma);
 	else
+		f_coef.m_hor_chroma = f_coef.m_hor;
+
+	return g_scale_cache.front();
+}
+
+// working memory of the scaler, reused from frame to frame (each thread that scales rows has its own)
+struct ScaleScratch
+{
+	std::vector<const unsigned char *>	m_rows;
+	std::vector<short>					m_row;
+	std::vector<unsigned char>			m_scaled[2];
+};
+
+thread_local ScaleScratch g_scale_scratch;
+
+// produces the rows of a scaled region, in the pixel format of the source
+class RegionScaler
+{
+	public :
+		RegionScaler(	const ImageView &p_src, int p_src_bpp, const MaskView *p_mask, bool p_mask_alpha,
+						int p_src_x, int p_src_y, int p_src_w, int p_src_h,
+						int p_dst_width, int p_dst_height, ScaleFilter p_filter) :
+			m_src_width(p_src.m_width),
+			m_src_bpp(p_src_bpp),
+			m_src_stride(p_src.m_stride),
+			m_src_w(p_src_w),
+			m_src_h(p_src_h),
+			m_dst_width(p_dst_width),
+			m_coef(region_coefficients(p_src, p_src_x, p_src_y, p_src_w, p_src_h, p_dst_width, p_dst_height, p_filter)),
+			m_src_line(nullptr),
+			m_mask(	(p_mask && m_coef) ? *p_mask : MaskView(), p_src_x, p_src_y, (p_mask && m_coef) ? m_dst_width : 0,
+					(m_coef) ? m_coef->m_hor.m_nearest.data() : nullptr, p_mask_alpha)
+		{
+			if (!m_coef)
+				return;
+
+			m_hor			= m_coef->m_hor.taps();
+			m_hor_chroma	= m_coef->m_hor_chroma.taps();
+			m_src_line		= p_src.m_data + (p_src_y * m_src_stride) + (p_src_x * p_src_bpp);
+		}
+
+		bool valid() const
+		{
+			return m_coef != nullptr;
+		}
+
+		// bytes of source data read for each output row
+		int row_cost() const
+		{
+			return m_src_w * m_src_bpp * m_coef->m_ver.m_taps;
+		}
+
+		// the working memory of the calling thread, sized for this scaler
+		ScaleScratch &scratch() const
+		{
+			// the horizontal pass may read a few samples past the end of the intermediate row : these have to be zero
+			const int f_taps  = std::max(m_hor.m_taps, m_hor_chroma.m_taps);
+			const int f_count = m_src_w * m_src_bpp;
+
+			auto &f_scratch = g_scale_scratch;
+			f_scratch.m_rows.resize(m_coef->m_ver.m_taps);
+			f_scratch.m_row.resize((m_src_w + (2 * f_taps) + 2) * m_src_bpp);
+			std::fill(std::begin(f_scratch.m_row) + f_count, std::end(f_scratch.m_row), 0);
+
+			for (auto &f_buffer : f_scratch.m_scaled)
+				f_buffer.resize(m_dst_width * m_src_bpp);
+
+			return f_scratch;
+		}
+
+		void scale_row(int p_y, unsigned char *p_dst, ScaleScratch &p_scratch) const
+		{
+			const auto &f_kernels = kernels::row_kernels();
+			const auto &f_ver	  = m_coef->m_ver;
+
+			for (int f_t = 0; f_t < f_ver.m_taps; ++f_t)
+			{
+				// taps past the bottom of the region have no weight, but still need a valid row
+				const int f_row = std::min(f_ver.m_offset[p_y] + f_t, m_src_h - 1);
+				p_scratch.m_rows[f_t] = m_src_line + (f_row * m_src_stride);
+			}
+
+			f_kernels.m_scale_rows(p_scratch.m_rows.data(), &f_ver.m_weights[p_y * f_ver.m_taps], f_ver.m_taps, p_scratch.m_row.data(), m_src_w * m_src_bpp);
+
+			if (m_src_bpp == 4)
+				f_kernels.m_scale_cols_32bpp(p_scratch.m_row.data(), m_hor, m_hor_chroma, p_dst, m_dst_width);
+			else
+				f_kernels.m_scale_cols_16bpp(p_scratch.m_row.data(), m_hor, m_hor_chroma, p_dst, m_dst_width);
+		}
+
+		const unsigned char *mask_row(int p_y, int p_slot) const
+		{
+			return m_mask.row(m_coef->m_ver.m_nearest[p_y], p_slot);
+		}
+
+	private :
+		// the coefficients of a region that fits in the source (nullptr otherwise)
+		static std::shared_ptr<const ScaleCoefficients> region_coefficients(const ImageView &p_src, int p_src_x, int p_src_y, int p_src_w, int p_src_h,
+																			int p_dst_width, int p_dst_height, ScaleFilter p_filter)
+		{
+			if (p_src_x < 0 || p_src_y < 0 || p_src_w <= 0 || p_src_h <= 0 || p_dst_width <= 0 || p_dst_height <= 0 ||
+				p_src_x + p_src_w > p_src.m_width || p_src_y + p_src_h > p_src.m_height)
+			{
+				return nullptr;
+			}
+
+			return scale_coefficients(p_src_w, p_src_h, p_dst_width, p_dst_height, p_filter);
+		}
+
+	private :
+		const int									m_src_width;
+		const int									m_src_bpp;
+		const int									m_src_stride;
+		const int									m_src_w;
+		const int									m_src_h;
+		const int									m_dst_width;
+		std::shared_ptr<const ScaleCoefficients>	m_coef;
+		kernels::ScaleTaps							m_hor;
+		kernels::ScaleTaps							m_hor_chroma;
+		const unsigned char *						m_src_line;
+		const RegionMask							m_mask;
+};
+
+inline unsigned char *destination_row(const ImageView &p_dst, int p_y, bool p_flip)
+{
+	return p_dst.m_data + (((p_flip) ? p_dst.m_height - 1 - p_y : p_y) * p_dst.m_stride);
+}
+
+//
+// conversion of a region : an instance for each combination of formats and options, so the row loops contain no decisions
+//
+
+// a region of the source and the destination it is copied or scaled into (a copy uses the size of the destination)
+struct RegionArgs
+{
+	ImageView				m_src;
+	const MaskView *		m_mask;
+	int						m_src_x;
+	int						m_src_y;
+	int						m_src_w;
+	int						m_src_h;
+	ImageView				m_dst;
+	ScaleFilter				m_filter;
+};
+
+typedef bool (*RegionFunc) (RegionArgs p_args);
+
+struct RegionFuncs
+{
+	RegionFunc	m_copy;
+	RegionFunc	m_scale;
+};
+
+// move the region onto the pixel grid of the formats and check that it fits in the source
+template <PixelFormat Src, PixelFormat Dst>
+bool align_region(RegionArgs &p_args)
+{
+	typedef formats::FormatTraits<Src>	SrcTraits;
+	typedef formats::FormatTraits<Dst>	DstTraits;
+
+	const ImageView &f_src = p_args.m_src;
+	const ImageView &f_dst = p_args.m_dst;
+
+	p_args.m_src_x &= ~(SrcTraits::PIXEL_ALIGN - 1);
+
+	// the chroma planes of I420 use half the stride of the luma plane
+	return	(p_args.m_src_w % SrcTraits::PIXEL_ALIGN) == 0 &&
+			(f_dst.m_width % DstTraits::PIXEL_ALIGN) == 0 && (f_dst.m_height % DstTraits::LINE_ALIGN) == 0 &&
+			(f_dst.m_stride % DstTraits::PIXEL_ALIGN) == 0 &&
+			p_args.m_src_x >= 0 && p_args.m_src_y >= 0 && p_args.m_src_w > 0 && p_args.m_src_h > 0 &&
+			p_args.m_src_x + p_args.m_src_w <= f_src.m_width && p_args.m_src_y + p_args.m_src_h <= f_src.m_height &&
+			f_src.m_stride >= f_src.m_width * SrcTraits::BYTES_PER_PIXEL &&
+			f_dst.m_width > 0 && f_dst.m_height > 0 && f_dst.m_stride >= f_dst.m_width * DstTraits::BYTES_PER_PIXEL;
+}
+
+// packed destinations are written one row at a time
+template <PixelFormat Src, PixelFormat Dst, bool Flip, bool Mask, bool Mirror>
+struct PackedRegion
+{
+	typedef formats::FormatTraits<Src>			SrcTraits;
+	typedef formats::FormatTraits<Dst>			DstTraits;
+	typedef formats::ConvertTraits<Src, Dst>	Conversion;
+
+	// a soft mask is applied as an alpha matte when the destination has a kernel for it (and thresholded otherwise)
+	static kernels::MaskRowFunc mask_kernel(const kernels::RowKernels &p_kernels, const MaskView *p_mask)
+	{
+		const kernels::MaskRowFunc f_matte = Conversion::matte(p_kernels);
+		return (Mask && p_mask->m_soft && f_matte) ? f_matte : Conversion::mask(p_kernels);
+	}
+
+	// a hard mask with a background is applied in one pass, an alpha matte needs the premultiplied row first
+	static kernels::SelectRowFunc select_kernel(const kernels::RowKernels &p_kernels, bool p_alpha, const ImageView *p_background)
+	{
+		return (Mask && !p_alpha && p_background) ? Conversion::select(p_kernels) : nullptr;
+	}
+
+	// the background is filled in before the row is mirrored : it is stored the way the region looks before mirroring
+	static void write_row(	const kernels::RowKernels &p_kernels, kernels::MaskRowFunc p_mask_kernel, kernels::SelectRowFunc p_select_kernel,
+							const unsigned char *p_src, const unsigned char *p_mask, const unsigned char *p_background,
+							unsigned char *p_dst, int p_width)
 	{
-		// mask to the destination
-		f_src_rgb.copyTo(f_dst, f_msk_cropped);
+		if (Mask && p_select_kernel)
+			p_select_kernel(p_src, p_mask, p_background, p_dst, p_width);
+		else if (Mask)
+			p_mask_kernel(p_src, p_mask, p_dst, p_width);
+		else
+			Conversion::copy(p_kernels)(p_src, p_dst, p_width);
+
+		if (Mask && p_background && !p_select_kernel)
+			Conversion::background(p_kernels)(p_background, p_mask, p_dst, p_width);
+
+		if (Mirror)
+			DstTraits::mirror_row(p_dst, p_width);
+	}
+
+	static bool copy(RegionArgs p_args)
+	{
+		if (!align_region<Src, Dst>(p_args))
+			return false;
+
+		const auto &				f_kernels	  = kernels::row_kernels();
+		const kernels::MaskRowFunc	f_mask_kernel = mask_kernel(f_kernels, p_args.m_mask);
+		const bool					f_alpha		  = Mask && f_mask_kernel == Conversion::matte(f_kernels);
+		const RegionRows			f_rows(p_args.m_src, SrcTraits::BYTES_PER_PIXEL, p_args.m_src_x, p_args.m_src_y, p_args.m_dst, Flip);
+		const RegionMask			f_mask((Mask) ? *p_args.m_mask : MaskView(), p_args.m_src_x, p_args.m_src_y, (Mask) ? p_args.m_dst.m_width : 0, nullptr, f_alpha);
+		const ImageView *			f_background  = (Mask) ? mask_background(p_args.m_mask, p_args.m_dst) : nullptr;
+		const kernels::SelectRowFunc f_select	  = select_kernel(f_kernels, f_alpha, f_background);
+
+		// each source row is read once and written directly to its final position in the destination
+		parallel::for_each_stripe(p_args.m_dst.m_height, p_args.m_dst.m_width * SrcTraits::BYTES_PER_PIXEL, [&](int p_begin, int p_end) {
+			for (int f_y = p_begin; f_y < p_end; ++f_y)
+			{
+				write_row(	f_kernels, f_mask_kernel, f_select, f_rows.src_line(f_y), (Mask) ? f_mask.row(f_y, 0) : nullptr, background_row(f_background, f_y),
+							f_rows.dst_line(f_y), p_args.m_dst.m_width);
+			}
+		});
+
+		return true;
 	}
 
-	return true;
+	static bool scale(RegionArgs p_args)
+	{
+		if (!align_region<Src, Dst>(p_args))
+			return false;
+
+		const auto &				f_kernels	  = kernels::row_kernels();
+		const kernels::MaskRowFunc	f_mask_kernel = mask_kernel(f_kernels, p_args.m_mask);
+		const bool					f_alpha		  = Mask && f_mask_kernel == Conversion::matte(f_kernels);
+		const ImageView *			f_background  = (Mask) ? mask_background(p_args.m_mask, p_args.m_dst) : nullptr;
+		const kernels::SelectRowFunc f_select	  = select_kernel(f_kernels, f_alpha, f_background);
+
+		const RegionScaler f_scaler(p_args.m_src, SrcTraits::BYTES_PER_PIXEL, p_args.m_mask, f_alpha,
+									p_args.m_src_x, p_args.m_src_y, p_args.m_src_w, p_args.m_src_h,
+									p_args.m_dst.m_width, p_args.m_dst.m_height, p_args.m_filter);
+
+		if (!f_scaler.valid())
+			return false;
+
+		parallel::for_each_stripe(p_args.m_dst.m_height, f_scaler.row_cost(), [&](int p_begin, int p_end) {
+			auto &f_scratch = f_scaler.scratch();
+
+			for (int f_y = p_begin; f_y < p_end; ++f_y)
+			{
+				unsigned char *		 f_dst		  = destination_row(p_args.m_dst, f_y, Flip);
+				const unsigned char *f_mask		  = (Mask) ? f_scaler.mask_row(f_y, 0) : nullptr;
+				const unsigned char *f_bg_row	  = background_row(f_background, f_y);
+
+				if (Conversion::SAME_LAYOUT)
+				{
+					// scale straight into the destination, the mask (and the background) are applied in place
+					f_scaler.scale_row(f_y, f_dst, f_scratch);
+
+					if (Mask && f_select)
+						f_select(f_dst, f_mask, f_bg_row, f_dst, p_args.m_dst.m_width);
+					else if (Mask)
+						f_mask_kernel(f_dst, f_mask, f_dst, p_args.m_dst.m_width);
+
+					if (Mask && f_bg_row && !f_select)
+						Conversion::background(f_kernels)(f_bg_row, f_mask, f_dst, p_args.m_dst.m_width);
+
+					if (Mirror)
+						DstTraits::mirror_row(f_dst, p_args.m_dst.m_width);
+				}
+				else
+				{
+					unsigned char *f_scaled = f_scratch.m_scaled[0].data();
+					f_scaler.scale_row(f_y, f_scaled, f_scratch);
+					write_row(f_kernels, f_mask_kernel, f_select, f_scaled, f_mask, f_bg_row, f_dst, p_args.m_dst.m_width);
+				}
+			}
+		});
+
+		return true;
+	}
+};
+
+// planar (4:2:0) destinations are written a pair of rows at a time
+template <PixelFormat Src, PixelFormat Dst, bool Flip, bool Mask, bool Mirror>
+struct PlanarRegion
+{
+	typedef formats::FormatTraits<Src>			SrcTraits;
+	typedef formats::FormatTraits<Dst>			DstTraits;
+	typedef formats::ConvertTraits<Src, Dst>	Conversion;
+
+	// p_background : the rows of the background (nullptr without one), filled in before the rows are mirrored
+	static void write_rows(	const kernels::RowKernels &p_kernels,
+							const unsigned char *p_src_0, const unsigned char *p_src_1,
+							const unsigned char *p_mask_0, const unsigned char *p_mask_1,
+							const Yuv420Rows *p_background, const Yuv420Rows &p_dst, int p_width)
+	{
+		const kernels::PlanarRowFunc f_kernel = (Mask) ? Conversion::mask(p_kernels) : Conversion::copy(p_kernels);
+
+		f_kernel(p_src_0, p_src_1, p_mask_0, p_mask_1, p_dst.m_y_0, p_dst.m_y_1, p_dst.m_u, p_dst.m_v, p_width);
+
+		if (Mask && p_background)
+		{
+			Conversion::background(p_kernels)(	p_background->m_y_0, p_background->m_y_1, p_background->m_u, p_background->m_v,
+												p_mask_0, p_mask_1, p_dst.m_y_0, p_dst.m_y_1, p_dst.m_u, p_dst.m_v, p_width);
+		}
+
+		if (Mirror)
+		{
+			formats::mirror_elements<1>(p_dst.m_y_0, p_width);
+			formats::mirror_elements<1>(p_dst.m_y_1, p_width);
+			DstTraits::mirror_chroma(p_dst.m_u, p_dst.m_v, p_width);
+		}
+	}
+
+	static bool copy(RegionArgs p_args)
+	{
+		if (!align_region<Src, Dst>(p_args))
+			return false;
+
+		const auto &		f_kernels	 = kernels::row_kernels();
+		const int			f_src_stride = p_args.m_src.m_stride;
+		const Yuv420Planes	f_planes(p_args.m_dst, DstTraits::INTERLEAVED, Flip);
+
+		const unsigned char *f_src_first  = p_args.m_src.m_data + (p_args.m_src_y * f_src_stride) + (p_args.m_src_x * SrcTraits::BYTES_PER_PIXEL);
+		const RegionMask	 f_mask((Mask) ? *p_args.m_mask : MaskView(), p_args.m_src_x, p_args.m_src_y, (Mask) ? p_args.m_dst.m_width : 0, nullptr, false);
+		const ImageView *	 f_background = (Mask) ? mask_background(p_args.m_mask, p_args.m_dst) : nullptr;
+		const Yuv420Planes	 f_bg_planes((f_background) ? *f_background : p_args.m_dst, DstTraits::INTERLEAVED, false);
+
+		parallel::for_each_stripe(f_planes.m_chroma_height, p_args.m_dst.m_width * SrcTraits::BYTES_PER_PIXEL * 2, [&](int p_begin, int p_end) {
+			for (int f_c = p_begin; f_c < p_end; ++f_c)
+			{
+				const unsigned char *f_src = f_src_first + (f_c * 2 * f_src_stride);
+				const Yuv420Rows	 f_bg  = f_bg_planes.rows(f_c);
+
+				write_rows(	f_kernels, f_src, f_src + f_src_stride,
+							(Mask) ? f_mask.row(f_c * 2, 0) : nullptr,
+							(Mask) ? f_mask.row((f_c * 2) + 1, 1) : nullptr,
+							(f_background) ? &f_bg : nullptr, f_planes.rows(f_c), p_args.m_dst.m_width);
+			}
+		});
+
+		return true;
+	}
+
+	// scale two rows at a time and convert them with the regular 4:2:0 kernels
+	static bool scale(RegionArgs p_args)
+	{
+		if (!align_region<Src, Dst>(p_args))
+			return false;
+
+		const RegionScaler f_scaler(p_args.m_src, SrcTraits::BYTES_PER_PIXEL, p_args.m_mask, false,
+									p_args.m_src_x, p_args.m_src_y, p_args.m_src_w, p_args.m_src_h,
+									p_args.m_dst.m_width, p_args.m_dst.m_height, p_args.m_filter);
+
+		if (!f_scaler.valid())
+			return false;
+
+		const auto &		f_kernels	 = kernels::row_kernels();
+		const Yuv420Planes	f_planes(p_args.m_dst, DstTraits::INTERLEAVED, Flip);
+		const ImageView *	f_background = (Mask) ? mask_background(p_args.m_mask, p_args.m_dst) : nullptr;
+		const Yuv420Planes	f_bg_planes((f_background) ? *f_background : p_args.m_dst, DstTraits::INTERLEAVED, false);
+
+		parallel::for_each_stripe(f_planes.m_chroma_height, f_scaler.row_cost() * 2, [&](int p_begin, int p_end) {
+			auto &			f_scratch  = f_scaler.scratch();
+			unsigned char *	f_scaled_0 = f_scratch.m_scaled[0].data();
+			unsigned char *	f_scaled_1 = f_scratch.m_scaled[1].data();
+
+			for (int f_c = p_begin; f_c < p_end; ++f_c)
+			{
+				const Yuv420Rows f_bg = f_bg_planes.rows(f_c);
+
+				f_scaler.scale_row(f_c * 2, f_scaled_0, f_scratch);
+				f_scaler.scale_row((f_c * 2) + 1, f_scaled_1, f_scratch);
+
+				write_rows(	f_kernels, f_scaled_0, f_scaled_1,
+							(Mask) ? f_scaler.mask_row(f_c * 2, 0) : nullptr,
+							(Mask) ? f_scaler.mask_row((f_c * 2) + 1, 1) : nullptr,
+							(f_background) ? &f_bg : nullptr, f_planes.rows(f_c), p_args.m_dst.m_width);
+			}
+		});
+
+		return true;
+	}
+};
+
+// combinations of formats without a conversion have no functions
+template <PixelFormat Src, PixelFormat Dst, bool Flip, bool Mask, bool Mirror, bool Supported = formats::ConvertTraits<Src, Dst>::SUPPORTED>
+struct RegionConverter
+{
+	static constexpr RegionFuncs funcs()
+	{
+		return {nullptr, nullptr};
+	}
+};
+
+template <PixelFormat Src, PixelFormat Dst, bool Flip, bool Mask, bool Mirror>
+struct RegionConverter<Src, Dst, Flip, Mask, Mirror, true>
+{
+	typedef typename std::conditional<	formats::FormatTraits<Dst>::PLANAR,
+										PlanarRegion<Src, Dst, Flip, Mask, Mirror>,
+										PackedRegion<Src, Dst, Flip, Mask, Mirror>>::type Region;
+
+	static constexpr RegionFuncs funcs()
+	{
+		return {&Region::copy, &Region::scale};
+	}
+};
+
+// the dispatch table : indexed by source format, destination format, flip, mask and mirror
+const int REGION_OPTIONS	 = 8;
+const int REGION_TABLE_SIZE	 = PF_COUNT * PF_COUNT * REGION_OPTIONS;
+
+constexpr int region_index(PixelFormat p_src, PixelFormat p_dst, bool p_flip, bool p_mask, bool p_mirror)
+{
+	return (((p_src * PF_COUNT) + p_dst) * REGION_OPTIONS) + ((p_flip) ? 4 : 0) + ((p_mask) ? 2 : 0) + ((p_mirror) ? 1 : 0);
+}
+
+template <size_t Index>
+constexpr RegionFuncs region_entry()
+{
+	return RegionConverter<	static_cast<PixelFormat> (Index / (PF_COUNT * REGION_OPTIONS)),
+							static_cast<PixelFormat> ((Index / REGION_OPTIONS) % PF_COUNT),
+							(Index & 4) != 0, (Index & 2) != 0, (Index & 1) != 0>::funcs();
+}
+
+template <size_t... Indices>
+constexpr std::array<RegionFuncs, sizeof...(Indices)> build_region_table(std::index_sequence<Indices...>)
+{
+	return {{region_entry<Indices>()...}};
+}
+
+constexpr std::array<RegionFuncs, REGION_TABLE_SIZE> g_region_table = build_region_table(std::make_index_sequence<REGION_TABLE_SIZE>());
+
+const RegionFuncs *region_funcs(PixelFormat p_src, PixelFormat p_dst, bool p_flip, bool p_mask, bool p_mirror)
+{
+	if (p_src < 0 || p_src >= PF_COUNT || p_dst < 0 || p_dst >= PF_COUNT)
+		return nullptr;
+
+	return &g_region_table[region_index(p_src, p_dst, p_flip, p_mask, p_mirror)];
 }
 
+} // unnamed namespace
 
-bool copy_region_yuy2(int p_src_width, int p_src_height, unsigned char *p_src_data,
-					  int p_dst_x, int p_dst_y, int p_dst_width, int p_dst_height, unsigned char *p_dst_data)
+const char *simd_level_name()
 {
-	const int	f_pixel_size	= 2;
-	int			f_line_size		= p_dst_width * f_pixel_size;
-	int			f_line_stride	= p_src_width * f_pixel_size;
-	const auto *f_dst_end		= p_dst_data + (f_line_size * p_dst_height);
+	return cpu::simd_level_name(kernels::row_kernels().m_level);
+}
 
-	for (const auto *f_src_line = p_src_data + (p_dst_x * f_pixel_size) + (p_dst_y * f_line_stride);
-		 p_dst_data < f_dst_end;
-		 f_src_line += f_line_stride, p_dst_data += f_line_size)
+int packed_stride(PixelFormat p_format, int p_width)
+{
+	switch (p_format)
 	{
-		memcpy(p_dst_data, f_src_line, f_line_size);
+		case PF_BGRA32 :	return p_width * 4;
+		case PF_BGR24 :		return p_width * 3;
+		case PF_YUY2 :		return p_width * 2;
+		default :			return p_width;
 	}
+}
+
+ImageView packed_view(unsigned char *p_data, int p_width, int p_height, PixelFormat p_format)
+{
+	return {p_data, p_width, p_height, packed_stride(p_format, p_width), p_format};
+}
+
+bool copy_region(	const ImageView &p_src, const MaskView *p_mask, int p_src_x, int p_src_y,
+					const ImageView &p_dst, bool p_flip, bool p_mirror)
+{
+	const RegionFuncs *f_funcs = region_funcs(p_src.m_format, p_dst.m_format, p_flip, p_mask != nullptr, p_mirror);
+
+	if (!f_funcs || !f_funcs->m_copy || !mask_fits(p_mask, p_src))
+		return false;
+
+	return f_funcs->m_copy({p_src, p_mask, p_src_x, p_src_y, p_dst.m_width, p_dst.m_height, p_dst, SCALE_AREA});
+}
+
+bool scale_region(	const ImageView &p_src, const MaskView *p_mask, int p_src_x, int p_src_y, int p_src_w, int p_src_h,
+					const ImageView &p_dst, ScaleFilter p_filter, bool p_flip, bool p_mirror)
+{
+	const RegionFuncs *f_funcs = region_funcs(p_src.m_format, p_dst.m_format, p_flip, p_mask != nullptr, p_mirror);
+
+	if (!f_funcs || !f_funcs->m_scale || !mask_fits(p_mask, p_src))
+		return false;
 
-	return true;
+	return f_funcs->m_scale({p_src, p_mask, p_src_x, p_src_y, p_src_w, p_src_h, p_dst, p_filter});
 }
 
 } // namespace img
@@ -17,24 +17,80 @@
 
 namespace img {
 
-bool copy_region_32bpp_32bpp(int p_src_width, int p_src_height, unsigned char *p_src_data,
-							 int p_dst_x, int p_dst_y, int p_dst_width, int p_dst_height, unsigned char *p_dst_data,
-							 bool p_flip = false);
+enum PixelFormat
+{
+	PF_BGRA32,			// 4 bytes per pixel, the 4th byte is unused
+	PF_BGR24,			// 3 bytes per pixel
+	PF_YUY2,			// packed 4:2:2, Y0-U-Y1-V macropixels
+	PF_NV12,			// planar 4:2:0, Y plane followed by an interleaved U/V plane
+	PF_I420,			// planar 4:2:0, Y plane followed by the U and the V plane
+	PF_COUNT
+};
 
-bool copy_region_32bpp_32bpp_mask(	int p_src_width, int p_src_height, unsigned char *p_src_data, unsigned char *p_mask_channel,
-									int p_dst_x, int p_dst_y, int p_dst_width, int p_dst_height, unsigned char *p_dst_data,
-									bool p_flip = false);
+enum ScaleFilter
+{
+	SCALE_AREA,			// average of the covered source pixels (best for downscaling)
+	SCALE_BILINEAR		// interpolation between the nearest 2x2 source pixels
+};
 
-bool copy_region_32bpp_24bpp(int p_src_width, int p_src_height, unsigned char *p_src_data,
-							 int p_dst_x, int p_dst_y, int p_dst_width, int p_dst_height, unsigned char *p_dst_data,
-							 bool p_flip = false);
+// image data owned by somebody else
+//	- m_stride is the distance in bytes between the start of two rows, it can be larger than the pixels of the row need
+//	- planar formats : m_stride applies to the Y plane, the chroma planes follow it (NV12 : m_height / 2 rows of m_stride bytes,
+//	  I420 : two planes of m_height / 2 rows of m_stride / 2 bytes)
+struct ImageView
+{
+	unsigned char *	m_data;
+	int				m_width;
+	int				m_height;
+	int				m_stride;
+	PixelFormat		m_format;
+};
 
-bool copy_region_32bpp_24bpp_mask(	int p_src_width, int p_src_height, unsigned char *p_src_data, unsigned char *p_mask_channel,
-									int p_dst_x, int p_dst_y, int p_dst_width, int p_dst_height, unsigned char *p_dst_data,
-									bool p_flip = false);
+// a mask for an image : zero means masked out (black), 0xff means visible
+//	- m_scale : every mask value covers m_scale x m_scale image pixels (1 = one mask value for each image pixel)
+//	- a low resolution mask is interpolated bilinearly between the nearest 2x2 mask values when it is applied and thresholded
+//	  at half : the edges don't show m_scale x m_scale blocks, but they don't follow the edges of the image either
+//	  (the upsampling only looks at the mask)
+//	- m_soft : the values are an alpha matte (0 = background, 0xff = foreground, anything in between is an edge) :
+//	  32bpp destinations get premultiplied color and the matte in their alpha channel, 24bpp destinations blend the edges
+//	  to black, the other formats keep the pixels with a value of at least 0x80
+//	- m_background : optional (nullptr = black), the masked out pixels show this image instead (edges of a matte are blended with it) :
+//	  it has the format and the size of the destination and is stored top-down, the way the region looks before p_flip and p_mirror
+//	  are applied (so a background that should not appear mirrored has to be stored mirrored for a mirrored copy, see keying::BackgroundImage)
+struct MaskView
+{
+	const unsigned char *	m_data;
+	int						m_width;
+	int						m_height;
+	int						m_stride;
+	int						m_scale;
+	bool					m_soft;
+	const ImageView *		m_background;
+};
 
-bool copy_region_yuy2(int p_src_width, int p_src_height, unsigned char *p_src_data,
-					  int p_dst_x, int p_dst_y, int p_dst_width, int p_dst_height, unsigned char *p_dst_data);
+// the stride of an image without padding
+int packed_stride(PixelFormat p_format, int p_width);
+
+// a view on an image without padding
+ImageView packed_view(unsigned char *p_data, int p_width, int p_height, PixelFormat p_format);
+
+// name of the instruction set used by the image functions (selected at load time)
+const char *simd_level_name();
+
+// copy the region of the source at (p_src_x, p_src_y) with the size of the destination into the destination, converting the pixel format
+//	- sources are PF_BGRA32 (to any format except YUY2) or PF_YUY2 (to YUY2, NV12 or I420) : returns false for other combinations
+//	- the mask is optional (nullptr = no mask), it covers the entire source image
+//	- p_flip stores the rows bottom-up, p_mirror stores every row right-to-left
+//	- YUY2 sources : p_src_x is rounded down to a macropixel boundary ; YUY2/4:2:0 destinations need an even width (and height for 4:2:0)
+bool copy_region(	const ImageView &p_src, const MaskView *p_mask, int p_src_x, int p_src_y,
+					const ImageView &p_dst, bool p_flip = false, bool p_mirror = false);
+
+// scale the region (p_src_x, p_src_y, p_src_w, p_src_h) of the source to fill the entire destination
+//	- same formats, mask and options as copy_region, YUY2 sources also need an even p_src_w
+//	- the filter coefficients are computed once for each (region size, destination size, filter) and cached
+//	- the mask is sampled at the nearest source pixel
+bool scale_region(	const ImageView &p_src, const MaskView *p_mask, int p_src_x, int p_src_y, int p_src_w, int p_src_h,
+					const ImageView &p_dst, ScaleFilter p_filter, bool p_flip = false, bool p_mirror = false);
 
 } // namespace img
 
@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	image_file.cpp
+//
+// Purpose	: 	reading image files
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "image_file.h"
+#include "com_utils.h"
+
+#include <windows.h>
+#include <wincodec.h>
+
+namespace img {
+
+namespace {
+
+bool decode_image_file(const wchar_t *p_filename, std::vector<unsigned char> &p_pixels, int &p_width, int &p_height)
+{
+	com_safe_ptr_t<IWICImagingFactory>		f_factory;
+	com_safe_ptr_t<IWICBitmapDecoder>		f_decoder;
+	com_safe_ptr_t<IWICBitmapFrameDecode>	f_frame;
+	com_safe_ptr_t<IWICFormatConverter>		f_converter;
+
+	if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&f_factory))))
+		return false;
+
+	if (FAILED(f_factory->CreateDecoderFromFilename(p_filename, nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &f_decoder)))
+		return false;
+
+	if (FAILED(f_decoder->GetFrame(0, &f_frame)))
+		return false;
+
+	if (FAILED(f_factory->CreateFormatConverter(&f_converter)))
+		return false;
+
+	if (FAILED(f_converter->Initialize(f_frame.get(), GUID_WICPixelFormat32bppBGRA, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom)))
+		return false;
+
+	UINT f_width  = 0;
+	UINT f_height = 0;
+
+	if (FAILED(f_converter->GetSize(&f_width, &f_height)) || f_width == 0 || f_height == 0 || f_width > 16384 || f_height > 16384)
+		return false;
+
+	std::vector<unsigned char> f_pixels(static_cast<size_t> (f_width) * f_height * 4);
+
+	if (FAILED(f_converter->CopyPixels(nullptr, f_width * 4, static_cast<UINT> (f_pixels.size()), f_pixels.data())))
+		return false;
+
+	p_pixels.swap(f_pixels);
+	p_width	 = static_cast<int> (f_width);
+	p_height = static_cast<int> (f_height);
+
+	return true;
+}
+
+} // unnamed namespace
+
+bool load_image_file(const wchar_t *p_filename, std::vector<unsigned char> &p_pixels, int &p_width, int &p_height)
+{
+	if (!p_filename || !p_filename[0])
+		return false;
+
+	// the thread may or may not have initialized COM already (RPC_E_CHANGED_MODE : it did, with another threading model)
+	const HRESULT f_init = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+	if (FAILED(f_init) && f_init != RPC_E_CHANGED_MODE)
+		return false;
+
+	const bool f_result = decode_image_file(p_filename, p_pixels, p_width, p_height);
+
+	if (SUCCEEDED(f_init))
+		CoUninitialize();
+
+	return f_result;
+}
+
+} // namespace img
@@ -0,0 +1,29 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	image_file.h
+//
+// Purpose	: 	reading image files
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef KW_IMAGE_FILE_H
+#define KW_IMAGE_FILE_H
+
+#include <vector>
+
+namespace img {
+
+// decode the first frame of an image file (any format the Windows Imaging Component knows : bmp, png, jpeg, ...)
+//	- p_pixels receives PF_BGRA32 data without padding, top-down
+//	- returns false when the file can't be read, p_pixels is left untouched
+bool load_image_file(const wchar_t *p_filename, std::vector<unsigned char> &p_pixels, int &p_width, int &p_height);
+
+} // namespace img
+
+#endif // KW_IMAGE_FILE_H
@@ -0,0 +1,219 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	image_formats.h
+//
+// Purpose	: 	compile-time description of the pixel formats and the conversions between them
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef KW_IMAGE_FORMATS_H
+#define KW_IMAGE_FORMATS_H
+
+#include "image.h"
+#include "image_kernels.h"
+
+#include <algorithm>
+
+namespace img {
+
+namespace formats {
+
+// reverse the order of p_count elements of Size bytes
+template <int Size>
+inline void mirror_elements(unsigned char *p_data, int p_count)
+{
+	unsigned char *f_left  = p_data;
+	unsigned char *f_right = p_data + ((p_count - 1) * Size);
+
+	for (; f_left < f_right; f_left += Size, f_right -= Size)
+		std::swap_ranges(f_left, f_left + Size, f_right);
+}
+
+//
+// pixel formats
+//	- PIXEL_ALIGN	 : horizontal positions and widths have to be a multiple of this
+//	- LINE_ALIGN	 : heights have to be a multiple of this
+//	- PLANAR		 : packed formats are handled one row at a time, planar (4:2:0) formats a pair of rows at a time
+//
+
+template <PixelFormat Format>
+struct FormatTraits;
+
+template <>
+struct FormatTraits<PF_BGRA32>
+{
+	static const int	BYTES_PER_PIXEL	= 4;
+	static const int	PIXEL_ALIGN		= 1;
+	static const int	LINE_ALIGN		= 1;
+	static const bool	PLANAR			= false;
+
+	static void mirror_row(unsigned char *p_row, int p_width)
+	{
+		mirror_elements<4>(p_row, p_width);
+	}
+};
+
+template <>
+struct FormatTraits<PF_BGR24>
+{
+	static const int	BYTES_PER_PIXEL	= 3;
+	static const int	PIXEL_ALIGN		= 1;
+	static const int	LINE_ALIGN		= 1;
+	static const bool	PLANAR			= false;
+
+	static void mirror_row(unsigned char *p_row, int p_width)
+	{
+		mirror_elements<3>(p_row, p_width);
+	}
+};
+
+template <>
+struct FormatTraits<PF_YUY2>
+{
+	static const int	BYTES_PER_PIXEL	= 2;
+	static const int	PIXEL_ALIGN		= 2;		// never split a Y0-U-Y1-V macropixel
+	static const int	LINE_ALIGN		= 1;
+	static const bool	PLANAR			= false;
+
+	static void mirror_row(unsigned char *p_row, int p_width)
+	{
+		// reverse the macropixels, then swap the luma samples inside each of them
+		mirror_elements<4>(p_row, p_width / 2);
+
+		for (int f_x = 0; f_x < p_width * 2; f_x += 4)
+			std::swap(p_row[f_x], p_row[f_x + 2]);
+	}
+};
+
+template <>
+struct FormatTraits<PF_NV12>
+{
+	static const int	BYTES_PER_PIXEL	= 1;		// of the luma plane
+	static const int	PIXEL_ALIGN		= 2;
+	static const int	LINE_ALIGN		= 2;
+	static const bool	PLANAR			= true;
+	static const bool	INTERLEAVED		= true;		// U/V share one plane
+
+	static void mirror_chroma(unsigned char *p_u, unsigned char *, int p_width)
+	{
+		mirror_elements<2>(p_u, p_width / 2);
+	}
+};
+
+template <>
+struct FormatTraits<PF_I420>
+{
+	static const int	BYTES_PER_PIXEL	= 1;		// of the luma plane
+	static const int	PIXEL_ALIGN		= 2;
+	static const int	LINE_ALIGN		= 2;
+	static const bool	PLANAR			= true;
+	static const bool	INTERLEAVED		= false;
+
+	static void mirror_chroma(unsigned char *p_u, unsigned char *p_v, int p_width)
+	{
+		mirror_elements<1>(p_u, p_width / 2);
+		mirror_elements<1>(p_v, p_width / 2);
+	}
+};
+
+//
+// conversions : the row kernels that turn a row (or a pair of rows) of the source format into the destination format
+//	- SAME_LAYOUT : the source format can be stored directly in the destination (the scaler writes straight into it)
+//	- matte : the kernel that applies a soft mask (see MaskView::m_soft) to packed destinations, nullptr when the format has no use for it
+//	- background : the kernel that fills the masked out pixels with the background (see MaskView::m_background)
+//	- select : the kernel that applies a hard mask and the background in one pass, nullptr when the format doesn't have one
+//
+
+template <PixelFormat Src, PixelFormat Dst>
+struct ConvertTraits
+{
+	static const bool	SUPPORTED = false;
+};
+
+template <>
+struct ConvertTraits<PF_BGRA32, PF_BGRA32>
+{
+	static const bool	SUPPORTED	= true;
+	static const bool	SAME_LAYOUT	= true;
+	static kernels::CopyRowFunc copy(const kernels::RowKernels &p_kernels) {return p_kernels.m_copy_32bpp_32bpp;}
+	static kernels::MaskRowFunc mask(const kernels::RowKernels &p_kernels) {return p_kernels.m_mask_32bpp_32bpp;}
+	static kernels::MaskRowFunc matte(const kernels::RowKernels &p_kernels) {return p_kernels.m_matte_32bpp_32bpp;}
+	static kernels::BackgroundRowFunc background(const kernels::RowKernels &p_kernels) {return p_kernels.m_background_32bpp;}
+	static kernels::SelectRowFunc select(const kernels::RowKernels &p_kernels) {return p_kernels.m_select_32bpp_32bpp;}
+};
+
+template <>
+struct ConvertTraits<PF_BGRA32, PF_BGR24>
+{
+	static const bool	SUPPORTED	= true;
+	static const bool	SAME_LAYOUT	= false;
+	static kernels::CopyRowFunc copy(const kernels::RowKernels &p_kernels) {return p_kernels.m_copy_32bpp_24bpp;}
+	static kernels::MaskRowFunc mask(const kernels::RowKernels &p_kernels) {return p_kernels.m_mask_32bpp_24bpp;}
+	static kernels::MaskRowFunc matte(const kernels::RowKernels &p_kernels) {return p_kernels.m_matte_32bpp_24bpp;}
+	static kernels::BackgroundRowFunc background(const kernels::RowKernels &p_kernels) {return p_kernels.m_background_24bpp;}
+	static kernels::SelectRowFunc select(const kernels::RowKernels &p_kernels) {return p_kernels.m_select_32bpp_24bpp;}
+};
+
+template <>
+struct ConvertTraits<PF_BGRA32, PF_NV12>
+{
+	static const bool	SUPPORTED	= true;
+	static const bool	SAME_LAYOUT	= false;
+	static kernels::PlanarRowFunc copy(const kernels::RowKernels &p_kernels) {return p_kernels.m_copy_32bpp_nv12;}
+	static kernels::PlanarRowFunc mask(const kernels::RowKernels &p_kernels) {return p_kernels.m_mask_32bpp_nv12;}
+	static kernels::PlanarBackgroundFunc background(const kernels::RowKernels &p_kernels) {return p_kernels.m_background_nv12;}
+};
+
+template <>
+struct ConvertTraits<PF_BGRA32, PF_I420>
+{
+	static const bool	SUPPORTED	= true;
+	static const bool	SAME_LAYOUT	= false;
+	static kernels::PlanarRowFunc copy(const kernels::RowKernels &p_kernels) {return p_kernels.m_copy_32bpp_i420;}
+	static kernels::PlanarRowFunc mask(const kernels::RowKernels &p_kernels) {return p_kernels.m_mask_32bpp_i420;}
+	static kernels::PlanarBackgroundFunc background(const kernels::RowKernels &p_kernels) {return p_kernels.m_background_i420;}
+};
+
+template <>
+struct ConvertTraits<PF_YUY2, PF_YUY2>
+{
+	static const bool	SUPPORTED	= true;
+	static const bool	SAME_LAYOUT	= true;
+	static kernels::CopyRowFunc copy(const kernels::RowKernels &p_kernels) {return p_kernels.m_copy_16bpp_16bpp;}
+	static kernels::MaskRowFunc mask(const kernels::RowKernels &p_kernels) {return p_kernels.m_mask_16bpp_16bpp;}
+	static kernels::MaskRowFunc matte(const kernels::RowKernels &) {return nullptr;}
+	static kernels::BackgroundRowFunc background(const kernels::RowKernels &p_kernels) {return p_kernels.m_background_16bpp;}
+	static kernels::SelectRowFunc select(const kernels::RowKernels &) {return nullptr;}
+};
+
+template <>
+struct ConvertTraits<PF_YUY2, PF_NV12>
+{
+	static const bool	SUPPORTED	= true;
+	static const bool	SAME_LAYOUT	= false;
+	static kernels::PlanarRowFunc copy(const kernels::RowKernels &p_kernels) {return p_kernels.m_copy_16bpp_nv12;}
+	static kernels::PlanarRowFunc mask(const kernels::RowKernels &p_kernels) {return p_kernels.m_mask_16bpp_nv12;}
+	static kernels::PlanarBackgroundFunc background(const kernels::RowKernels &p_kernels) {return p_kernels.m_background_nv12;}
+};
+
+template <>
+struct ConvertTraits<PF_YUY2, PF_I420>
+{
+	static const bool	SUPPORTED	= true;
+	static const bool	SAME_LAYOUT	= false;
+	static kernels::PlanarRowFunc copy(const kernels::RowKernels &p_kernels) {return p_kernels.m_copy_16bpp_i420;}
+	static kernels::PlanarRowFunc mask(const kernels::RowKernels &p_kernels) {return p_kernels.m_mask_16bpp_i420;}
+	static kernels::PlanarBackgroundFunc background(const kernels::RowKernels &p_kernels) {return p_kernels.m_background_i420;}
+};
+
+} // namespace formats
+
+} // namespace img
+
+#endif // KW_IMAGE_FORMATS_H
@@ -0,0 +1,280 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	image_kernels.h
+//
+// Purpose	: 	per-row image kernels with scalar and simd implementations
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef KW_IMAGE_KERNELS_H
+#define KW_IMAGE_KERNELS_H
+
+#include "cpu_features.h"
+
+namespace img {
+
+namespace kernels {
+
+// all kernels process a single row of p_width pixels
+//	- masks contain one byte per pixel : zero means the pixel is masked out (written as black)
+//	- 16bpp kernels work on YUY2 data : p_width must be even, chroma is kept if either pixel of the macropixel is kept
+typedef void (*CopyRowFunc) (const unsigned char *p_src, unsigned char *p_dst, int p_width);
+typedef void (*MaskRowFunc) (const unsigned char *p_src, const unsigned char *p_mask, unsigned char *p_dst, int p_width);
+
+// 4:2:0 planar kernels convert a pair of source rows into two luma rows and one chroma row
+//	- NV12 : U/V are interleaved, p_dst_v is ignored
+//	- I420 : U and V go into separate planes
+//	- the masks are ignored by the unmasked variants (may be nullptr)
+//	- conversion from 32bpp uses BT.601 (limited range), chroma is the average of the 2x2 block
+typedef void (*PlanarRowFunc) (	const unsigned char *p_src_0, const unsigned char *p_src_1,
+								const unsigned char *p_mask_0, const unsigned char *p_mask_1,
+								unsigned char *p_dst_y_0, unsigned char *p_dst_y_1,
+								unsigned char *p_dst_u, unsigned char *p_dst_v, int p_width);
+
+// scaling is done in two passes over an intermediate row of 16 bit values (Q7 fixed point)
+//	- the vertical pass blends p_taps source rows, byte by byte, regardless of the pixel format
+//	- the horizontal pass filters the intermediate row into the output pixels (in the source format)
+//	- weights are in Q14 and sum to (1 << 14) for each output sample, all taps counts are even
+
+// filter taps for one direction : output sample i is the weighted sum of m_taps source samples starting at m_offset[i]
+struct ScaleTaps
+{
+	int				m_taps;
+	const int *		m_offset;
+	const short *	m_weights;
+};
+
+typedef void (*ScaleRowsFunc) (const unsigned char *const *p_src, const short *p_weights, int p_taps, short *p_dst, int p_count);
+
+// 32bpp : p_luma filters all four channels (p_chroma is ignored), 16bpp : p_chroma filters the U/V samples of the macropixels
+typedef void (*ScaleColsFunc) (const short *p_src, const ScaleTaps &p_luma, const ScaleTaps &p_chroma, unsigned char *p_dst, int p_width);
+
+// soft edged mattes (see keying::SoftMatte) are built from byte rows, feathered with a box filter over 16 bit column sums
+//	- morph : the minimum or maximum of three rows (or of three neighbours when the rows are the same row, one byte apart)
+//	- slide : p_sums += p_add - p_sub, moves the vertical window of the box filter down one row
+//	- feather : the horizontal box filter of 2 * p_radius + 1 sums (p_sums has p_radius valid values before and after the row),
+//	  scaled by p_recip (Q16) and blended into the previous matte : matte += (box - matte) * p_weight / 128 (rounded)
+typedef void (*MorphRowFunc) (const unsigned char *p_a, const unsigned char *p_b, const unsigned char *p_c, unsigned char *p_dst, int p_count);
+typedef void (*SlideRowFunc) (unsigned short *p_sums, const unsigned char *p_add, const unsigned char *p_sub, int p_count);
+typedef void (*FeatherRowFunc) (const unsigned short *p_sums, int p_radius, int p_recip, int p_weight, unsigned char *p_matte, int p_count);
+
+// green screen masks : 0xff when the depth pixel a color pixel maps to belongs to a body, zero otherwise
+//	- positions outside of the depth frame (including infinity and NaN) never belong to a body
+//	- float : x/y pairs (the DepthSpacePoint of the Kinect v2 SDK), truncated towards zero ; one label byte for each depth pixel, 0xff = no body
+//	  (the labels are read in aligned groups of 4 bytes : the size of the depth frame has to be a multiple of 4)
+//	- int : x, y, depth and a reserved value (the NUI_DEPTH_IMAGE_POINT of the Kinect v1 SDK) ; one 32 bit value for each depth pixel,
+//	  the low 16 bits are the player index, 0 = no body (the NUI_DEPTH_IMAGE_PIXEL of the Kinect v1 SDK)
+typedef void (*BodyLookupFloatFunc) (	const float *p_points, const unsigned char *p_labels, int p_depth_width, int p_depth_height,
+										unsigned char *p_mask, int p_count);
+typedef void (*BodyLookupIntFunc) (	const int *p_points, const unsigned int *p_labels, int p_depth_width, int p_depth_height,
+									unsigned char *p_mask, int p_count);
+
+// backgrounds : the masked out pixels of a destination row show the background instead of black (p_background has the format of the destination)
+//	- 32/24bpp : p_dst += p_background * (255 - mask) / 255 for every byte, the masked row has black (or premultiplied color
+//	  at the edges of an alpha matte) where the mask is not 0xff : hard masks contain only 0 and 0xff
+//	- 16bpp and 4:2:0 : the masks are hard, luma is taken from the background where the mask is zero,
+//	  chroma where all the pixels that share it are masked out
+typedef void (*BackgroundRowFunc) (const unsigned char *p_background, const unsigned char *p_mask, unsigned char *p_dst, int p_width);
+typedef void (*PlanarBackgroundFunc) (	const unsigned char *p_bg_y_0, const unsigned char *p_bg_y_1, const unsigned char *p_bg_u, const unsigned char *p_bg_v,
+										const unsigned char *p_mask_0, const unsigned char *p_mask_1,
+										unsigned char *p_dst_y_0, unsigned char *p_dst_y_1, unsigned char *p_dst_u, unsigned char *p_dst_v, int p_width);
+
+// hard masks with a background in one pass (32/24bpp) : p_dst = (mask != 0) ? p_src (converted) : p_background
+//	- the same pixels as the mask kernel followed by the background kernel, without writing the destination twice
+//	- the source is only read where the mask keeps pixels, the background only where it drops them
+//	- p_src may be p_dst when the formats match (in place)
+typedef void (*SelectRowFunc) (const unsigned char *p_src, const unsigned char *p_mask, const unsigned char *p_background, unsigned char *p_dst, int p_width);
+
+// depth range keying : relabel the pixels of a depth frame so the body lookups keep the pixels in [p_near, p_far] (millimeters, p_near > 0)
+//	- 16 bit : Kinect v2 depth values, optionally combined with the body index labels (nullptr = depth only) ; writes 0 = keep, 0xff = drop
+//	- packed : Kinect v1 pixels (depth in the high 16 bits), optionally also requiring a player index ; writes 1 = keep, 0 = drop
+typedef void (*DepthWindowFunc) (	const unsigned short *p_depth, const unsigned char *p_body_index, int p_near, int p_far,
+									unsigned char *p_labels, int p_count);
+typedef void (*DepthWindowPackedFunc) (const unsigned int *p_pixels, bool p_player_index, int p_near, int p_far, unsigned int *p_labels, int p_count);
+
+// background blur (see keying::BackgroundBlur) : box filters over 4 byte elements (a 32bpp pixel or a YUY2 macropixel)
+//	- rows : the average of p_count rows (at most 15), byte by byte
+//	- cols : the average of the 2 * p_radius + 1 elements around each element (at most 15), the edge elements are repeated
+//	- both scale the sums by p_recip (Q16, see box_recip) : avg = ((sum + count / 2) * p_recip) >> 16
+//	- upsample : one output row of a 2x larger image, from its nearest source row and the row next to it (weights 3/4 and 1/4) ;
+//	  writes 2 * p_count elements, each 3/4 of its nearest element and 1/4 of the neighbour on its side (the edge elements are repeated)
+//	  the weights are made of rounded averages of byte pairs : avg(avg(a, b), a)
+typedef void (*BlurRowsFunc) (const unsigned char *const *p_rows, int p_count, int p_recip, unsigned char *p_dst, int p_bytes);
+typedef void (*BlurColsFunc) (const unsigned char *p_src, int p_radius, int p_recip, unsigned char *p_dst, int p_count);
+typedef void (*UpsampleRowFunc) (const unsigned char *p_near, const unsigned char *p_far, unsigned char *p_dst, int p_count);
+
+inline int box_recip(int p_count)
+{
+	return (65536 + p_count - 1) / p_count;
+}
+
+// depth to color (see keying::CoordinateMapper) : every depth pixel has three coefficients, precomputed from its ray and the calibration
+//	- with z the depth in meters : x = (z * u + offset[0]) / w', y = (z * v + offset[1]) / w', w' = z * w + offset[2]
+//	- writes x/y pairs (the ColorSpacePoint of the Kinect v2 SDK), -infinity for a depth of zero and points behind the color camera
+//	- the divisions are exact (no reciprocal estimates) : all the implementations return the same points
+struct DepthColorCoefficients
+{
+	const float *	m_u;
+	const float *	m_v;
+	const float *	m_w;
+	float			m_offset[3];
+};
+
+typedef void (*DepthToColorRowFunc) (const unsigned short *p_depth, const DepthColorCoefficients &p_coefficients, float *p_points, int p_count);
+
+struct RowKernels
+{
+	cpu::SimdLevel	m_level;
+	CopyRowFunc		m_copy_32bpp_32bpp;
+	CopyRowFunc		m_copy_32bpp_24bpp;
+	MaskRowFunc		m_mask_32bpp_32bpp;
+	MaskRowFunc		m_mask_32bpp_24bpp;
+	CopyRowFunc		m_copy_16bpp_16bpp;
+	MaskRowFunc		m_mask_16bpp_16bpp;
+	PlanarRowFunc	m_copy_32bpp_nv12;
+	PlanarRowFunc	m_mask_32bpp_nv12;
+	PlanarRowFunc	m_copy_32bpp_i420;
+	PlanarRowFunc	m_mask_32bpp_i420;
+	PlanarRowFunc	m_copy_16bpp_nv12;
+	PlanarRowFunc	m_mask_16bpp_nv12;
+	PlanarRowFunc	m_copy_16bpp_i420;
+	PlanarRowFunc	m_mask_16bpp_i420;
+	ScaleRowsFunc	m_scale_rows;
+	ScaleColsFunc	m_scale_cols_32bpp;
+	ScaleColsFunc	m_scale_cols_16bpp;
+	MaskRowFunc		m_matte_32bpp_32bpp;		// the mask is an alpha matte : premultiplied color, the matte in the alpha channel
+	MaskRowFunc		m_matte_32bpp_24bpp;		// the mask is an alpha matte : premultiplied color (blends to black)
+	MorphRowFunc	m_matte_min;
+	MorphRowFunc	m_matte_max;
+	SlideRowFunc	m_matte_slide;
+	FeatherRowFunc	m_matte_feather;
+	BodyLookupFloatFunc	m_body_lookup_float;
+	BodyLookupIntFunc	m_body_lookup_int;
+	DepthWindowFunc		m_depth_window;
+	DepthWindowPackedFunc	m_depth_window_packed;
+	BackgroundRowFunc	m_background_32bpp;
+	BackgroundRowFunc	m_background_24bpp;
+	BackgroundRowFunc	m_background_16bpp;
+	PlanarBackgroundFunc	m_background_nv12;
+	PlanarBackgroundFunc	m_background_i420;
+	SelectRowFunc		m_select_32bpp_32bpp;
+	SelectRowFunc		m_select_32bpp_24bpp;
+	BlurRowsFunc		m_blur_rows;
+	BlurColsFunc		m_blur_cols;
+	UpsampleRowFunc		m_upsample_2x;
+	DepthToColorRowFunc	m_depth_to_color;
+};
+
+// the kernel table used by the img:: functions
+const RowKernels &row_kernels();
+
+// build a table with the best kernels available up to (and including) the requested level
+RowKernels row_kernels_for_level(cpu::SimdLevel p_level);
+
+// scalar reference implementations (also used for the tail of the simd kernels)
+void copy_32bpp_32bpp_scalar(const unsigned char *p_src, unsigned char *p_dst, int p_width);
+void copy_32bpp_24bpp_scalar(const unsigned char *p_src, unsigned char *p_dst, int p_width);
+void mask_32bpp_32bpp_scalar(const unsigned char *p_src, const unsigned char *p_mask, unsigned char *p_dst, int p_width);
+void mask_32bpp_24bpp_scalar(const unsigned char *p_src, const unsigned char *p_mask, unsigned char *p_dst, int p_width);
+void copy_16bpp_16bpp_scalar(const unsigned char *p_src, unsigned char *p_dst, int p_width);
+void mask_16bpp_16bpp_scalar(const unsigned char *p_src, const unsigned char *p_mask, unsigned char *p_dst, int p_width);
+
+#define KW_PLANAR_ROW_ARGS	const unsigned char *p_src_0, const unsigned char *p_src_1,						\
+							const unsigned char *p_mask_0, const unsigned char *p_mask_1,					\
+							unsigned char *p_dst_y_0, unsigned char *p_dst_y_1,								\
+							unsigned char *p_dst_u, unsigned char *p_dst_v, int p_width
+
+void copy_32bpp_nv12_scalar(KW_PLANAR_ROW_ARGS);
+void mask_32bpp_nv12_scalar(KW_PLANAR_ROW_ARGS);
+void copy_32bpp_i420_scalar(KW_PLANAR_ROW_ARGS);
+void mask_32bpp_i420_scalar(KW_PLANAR_ROW_ARGS);
+void copy_16bpp_nv12_scalar(KW_PLANAR_ROW_ARGS);
+void mask_16bpp_nv12_scalar(KW_PLANAR_ROW_ARGS);
+void copy_16bpp_i420_scalar(KW_PLANAR_ROW_ARGS);
+void mask_16bpp_i420_scalar(KW_PLANAR_ROW_ARGS);
+
+void scale_rows_scalar(const unsigned char *const *p_src, const short *p_weights, int p_taps, short *p_dst, int p_count);
+void scale_cols_32bpp_scalar(const short *p_src, const ScaleTaps &p_luma, const ScaleTaps &p_chroma, unsigned char *p_dst, int p_width);
+void scale_cols_16bpp_scalar(const short *p_src, const ScaleTaps &p_luma, const ScaleTaps &p_chroma, unsigned char *p_dst, int p_width);
+
+void matte_32bpp_32bpp_scalar(const unsigned char *p_src, const unsigned char *p_mask, unsigned char *p_dst, int p_width);
+void matte_32bpp_24bpp_scalar(const unsigned char *p_src, const unsigned char *p_mask, unsigned char *p_dst, int p_width);
+void matte_min_scalar(const unsigned char *p_a, const unsigned char *p_b, const unsigned char *p_c, unsigned char *p_dst, int p_count);
+void matte_max_scalar(const unsigned char *p_a, const unsigned char *p_b, const unsigned char *p_c, unsigned char *p_dst, int p_count);
+void matte_slide_scalar(unsigned short *p_sums, const unsigned char *p_add, const unsigned char *p_sub, int p_count);
+void matte_feather_scalar(const unsigned short *p_sums, int p_radius, int p_recip, int p_weight, unsigned char *p_matte, int p_count);
+void body_lookup_float_scalar(const float *p_points, const unsigned char *p_labels, int p_depth_width, int p_depth_height, unsigned char *p_mask, int p_count);
+void body_lookup_int_scalar(const int *p_points, const unsigned int *p_labels, int p_depth_width, int p_depth_height, unsigned char *p_mask, int p_count);
+void depth_window_scalar(const unsigned short *p_depth, const unsigned char *p_body_index, int p_near, int p_far, unsigned char *p_labels, int p_count);
+void depth_window_packed_scalar(const unsigned int *p_pixels, bool p_player_index, int p_near, int p_far, unsigned int *p_labels, int p_count);
+void background_32bpp_scalar(const unsigned char *p_background, const unsigned char *p_mask, unsigned char *p_dst, int p_width);
+void background_24bpp_scalar(const unsigned char *p_background, const unsigned char *p_mask, unsigned char *p_dst, int p_width);
+void background_16bpp_scalar(const unsigned char *p_background, const unsigned char *p_mask, unsigned char *p_dst, int p_width);
+void select_32bpp_32bpp_scalar(const unsigned char *p_src, const unsigned char *p_mask, const unsigned char *p_background, unsigned char *p_dst, int p_width);
+void select_32bpp_24bpp_scalar(const unsigned char *p_src, const unsigned char *p_mask, const unsigned char *p_background, unsigned char *p_dst, int p_width);
+
+#define KW_PLANAR_BACKGROUND_ARGS	const unsigned char *p_bg_y_0, const unsigned char *p_bg_y_1,							\
+									const unsigned char *p_bg_u, const unsigned char *p_bg_v,								\
+									const unsigned char *p_mask_0, const unsigned char *p_mask_1,							\
+									unsigned char *p_dst_y_0, unsigned char *p_dst_y_1,										\
+									unsigned char *p_dst_u, unsigned char *p_dst_v, int p_width
+
+void background_nv12_scalar(KW_PLANAR_BACKGROUND_ARGS);
+void background_i420_scalar(KW_PLANAR_BACKGROUND_ARGS);
+
+void blur_rows_scalar(const unsigned char *const *p_rows, int p_count, int p_recip, unsigned char *p_dst, int p_bytes);
+void blur_cols_scalar(const unsigned char *p_src, int p_radius, int p_recip, unsigned char *p_dst, int p_count);
+void upsample_2x_scalar(const unsigned char *p_near, const unsigned char *p_far, unsigned char *p_dst, int p_count);
+void depth_to_color_scalar(const unsigned short *p_depth, const DepthColorCoefficients &p_coefficients, float *p_points, int p_count);
+
+// c * a / 255, rounded
+inline unsigned char premultiply(int p_c, int p_a)
+{
+	const int f_t = (p_c * p_a) + 128;
+	return static_cast<unsigned char> ((f_t + (f_t >> 8)) >> 8);
+}
+
+// vertical pass for the samples [p_from, p_count) (also used for the tail of the simd kernels)
+inline void scale_rows_tail(const unsigned char *const *p_src, const short *p_weights, int p_taps, short *p_dst, int p_from, int p_count)
+{
+	for (int f_i = p_from; f_i < p_count; ++f_i)
+	{
+		int f_sum = 1 << 6;
+
+		for (int f_t = 0; f_t < p_taps; ++f_t)
+			f_sum += p_src[f_t][f_i] * p_weights[f_t];
+
+		p_dst[f_i] = static_cast<short> (f_sum >> 7);
+	}
+}
+
+// finish a row with a (scalar) kernel, starting at pixel p_x
+inline void planar_row_tail(PlanarRowFunc p_kernel, int p_src_bpp, bool p_nv12, KW_PLANAR_ROW_ARGS, int p_x)
+{
+	if (p_x >= p_width)
+		return;
+
+	p_kernel(	p_src_0 + p_x * p_src_bpp, p_src_1 + p_x * p_src_bpp,
+				p_mask_0 ? p_mask_0 + p_x : nullptr, p_mask_1 ? p_mask_1 + p_x : nullptr,
+				p_dst_y_0 + p_x, p_dst_y_1 + p_x,
+				p_nv12 ? p_dst_u + p_x : p_dst_u + p_x / 2, p_nv12 ? p_dst_v : p_dst_v + p_x / 2,
+				p_width - p_x);
+}
+
+// each instruction set overrides the kernels it can improve upon
+void install_kernels_scalar(RowKernels &p_kernels);
+void install_kernels_sse2(RowKernels &p_kernels);
+void install_kernels_ssse3(RowKernels &p_kernels);
+void install_kernels_avx2(RowKernels &p_kernels);
+
+} // namespace kernels
+
+} // namespace img
+
+#endif // KW_IMAGE_KERNELS_H
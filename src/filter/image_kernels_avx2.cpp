@@ -0,0 +1,297 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	image_kernels_avx2.cpp
+//
+// Purpose	: 	per-row image kernels - AVX2 implementation
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "image_kernels.h"
+
+#ifdef KW_SIMD_X86
+#include <immintrin.h>
+#endif // KW_SIMD_X86
+
+namespace img {
+
+namespace kernels {
+
+#ifdef KW_SIMD_X86
+
+namespace {
+
+inline void copy_bytes_avx2(const unsigned char *p_src, unsigned char *p_dst, int p_count)
+{
+	int f_i = 0;
+
+	for (; f_i + 128 <= p_count; f_i += 128)
+	{
+		__m256i f_a = _mm256_loadu_si256(reinterpret_cast<const __m256i *> (p_src + f_i));
+		__m256i f_b = _mm256_loadu_si256(reinterpret_cast<const __m256i *> (p_src + f_i + 32));
+		__m256i f_c = _mm256_loadu_si256(reinterpret_cast<const __m256i *> (p_src + f_i + 64));
+		__m256i f_d = _mm256_loadu_si256(reinterpret_cast<const __m256i *> (p_src + f_i + 96));
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i *> (p_dst + f_i), f_a);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *> (p_dst + f_i + 32), f_b);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *> (p_dst + f_i + 64), f_c);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *> (p_dst + f_i + 96), f_d);
+	}
+
+	for (; f_i + 32 <= p_count; f_i += 32)
+	{
+		_mm256_storeu_si256(reinterpret_cast<__m256i *> (p_dst + f_i), _mm256_loadu_si256(reinterpret_cast<const __m256i *> (p_src + f_i)));
+	}
+
+	for (; f_i < p_count; ++f_i)
+	{
+		p_dst[f_i] = p_src[f_i];
+	}
+}
+
+// drop the alpha channel of 8 pixels : 24 packed bytes in the low part of the register
+inline __m256i bgra_to_bgr_avx2(__m256i p_src)
+{
+	const __m256i f_shuffle = _mm256_setr_epi8(	0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+												0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+	const __m256i f_permute = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+	return _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(p_src, f_shuffle), f_permute);
+}
+
+inline void store_24_bytes(unsigned char *p_dst, __m256i p_packed)
+{
+	_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst), _mm256_castsi256_si128(p_packed));
+	_mm_storel_epi64(reinterpret_cast<__m128i *> (p_dst + 16), _mm256_extracti128_si256(p_packed, 1));
+}
+
+// all bits set for the pixels that are masked out
+inline __m256i mask_drop_avx2(const unsigned char *p_mask)
+{
+	__m256i f_m = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *> (p_mask)));
+	return _mm256_cmpeq_epi32(f_m, _mm256_setzero_si256());
+}
+
+void copy_32bpp_32bpp_avx2(const unsigned char *p_src, unsigned char *p_dst, int p_width)
+{
+	copy_bytes_avx2(p_src, p_dst, p_width * 4);
+}
+
+void copy_16bpp_16bpp_avx2(const unsigned char *p_src, unsigned char *p_dst, int p_width)
+{
+	copy_bytes_avx2(p_src, p_dst, p_width * 2);
+}
+
+void copy_32bpp_24bpp_avx2(const unsigned char *p_src, unsigned char *p_dst, int p_width)
+{
+	int f_w = 0;
+
+	for (; f_w + 8 <= p_width; f_w += 8)
+	{
+		__m256i f_src = _mm256_loadu_si256(reinterpret_cast<const __m256i *> (p_src + f_w * 4));
+		store_24_bytes(p_dst + f_w * 3, bgra_to_bgr_avx2(f_src));
+	}
+
+	copy_32bpp_24bpp_scalar(p_src + f_w * 4, p_dst + f_w * 3, p_width - f_w);
+}
+
+void mask_32bpp_32bpp_avx2(const unsigned char *p_src, const unsigned char *p_mask, unsigned char *p_dst, int p_width)
+{
+	int f_w = 0;
+
+	for (; f_w + 8 <= p_width; f_w += 8)
+	{
+		__m256i f_src = _mm256_loadu_si256(reinterpret_cast<const __m256i *> (p_src + f_w * 4));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *> (p_dst + f_w * 4), _mm256_andnot_si256(mask_drop_avx2(p_mask + f_w), f_src));
+	}
+
+	mask_32bpp_32bpp_scalar(p_src + f_w * 4, p_mask + f_w, p_dst + f_w * 4, p_width - f_w);
+}
+
+void mask_32bpp_24bpp_avx2(const unsigned char *p_src, const unsigned char *p_mask, unsigned char *p_dst, int p_width)
+{
+	int f_w = 0;
+
+	for (; f_w + 8 <= p_width; f_w += 8)
+	{
+		__m256i f_src = _mm256_loadu_si256(reinterpret_cast<const __m256i *> (p_src + f_w * 4));
+		store_24_bytes(p_dst + f_w * 3, bgra_to_bgr_avx2(_mm256_andnot_si256(mask_drop_avx2(p_mask + f_w), f_src)));
+	}
+
+	mask_32bpp_24bpp_scalar(p_src + f_w * 4, p_mask + f_w, p_dst + f_w * 3, p_width - f_w);
+}
+
+void select_32bpp_32bpp_avx2(const unsigned char *p_src, const unsigned char *p_mask, const unsigned char *p_background, unsigned char *p_dst, int p_width)
+{
+	const __m128i f_zero = _mm_setzero_si128();
+	int f_w = 0;
+
+	for (; f_w + 16 <= p_width; f_w += 16)
+	{
+		const __m256i *f_src = reinterpret_cast<const __m256i *> (p_src + f_w * 4);
+		const __m256i *f_bg	 = reinterpret_cast<const __m256i *> (p_background + f_w * 4);
+		__m256i *	   f_dst = reinterpret_cast<__m256i *> (p_dst + f_w * 4);
+		const int	   f_out = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *> (p_mask + f_w)), f_zero));
+
+		// hard masks : most groups are completely kept or completely dropped, only one of the inputs is read
+		if (f_out == 0 || f_out == 0xffff)
+		{
+			const __m256i *f_from = (f_out == 0) ? f_src : f_bg;
+
+			_mm256_storeu_si256(f_dst, _mm256_loadu_si256(f_from));
+			_mm256_storeu_si256(f_dst + 1, _mm256_loadu_si256(f_from + 1));
+			continue;
+		}
+
+		for (int f_i = 0; f_i < 2; ++f_i)
+		{
+			_mm256_storeu_si256(f_dst + f_i, _mm256_blendv_epi8(_mm256_loadu_si256(f_src + f_i), _mm256_loadu_si256(f_bg + f_i),
+																mask_drop_avx2(p_mask + f_w + (f_i * 8))));
+		}
+	}
+
+	select_32bpp_32bpp_scalar(p_src + f_w * 4, p_mask + f_w, p_background + f_w * 4, p_dst + f_w * 4, p_width - f_w);
+}
+
+void scale_rows_avx2(const unsigned char *const *p_src, const short *p_weights, int p_taps, short *p_dst, int p_count)
+{
+	const __m256i f_zero  = _mm256_setzero_si256();
+	const __m256i f_round = _mm256_set1_epi32(1 << 6);
+	int f_i = 0;
+
+	for (; f_i + 32 <= p_count; f_i += 32)
+	{
+		__m256i f_acc0 = f_round, f_acc1 = f_round, f_acc2 = f_round, f_acc3 = f_round;
+
+		for (int f_t = 0; f_t < p_taps; f_t += 2)
+		{
+			const __m256i f_w = _mm256_set1_epi32((p_weights[f_t] & 0xffff) | (p_weights[f_t + 1] << 16));
+			const __m256i f_a = _mm256_loadu_si256(reinterpret_cast<const __m256i *> (p_src[f_t] + f_i));
+			const __m256i f_b = _mm256_loadu_si256(reinterpret_cast<const __m256i *> (p_src[f_t + 1] + f_i));
+
+			const __m256i f_a_lo = _mm256_unpacklo_epi8(f_a, f_zero);
+			const __m256i f_a_hi = _mm256_unpackhi_epi8(f_a, f_zero);
+			const __m256i f_b_lo = _mm256_unpacklo_epi8(f_b, f_zero);
+			const __m256i f_b_hi = _mm256_unpackhi_epi8(f_b, f_zero);
+
+			f_acc0 = _mm256_add_epi32(f_acc0, _mm256_madd_epi16(_mm256_unpacklo_epi16(f_a_lo, f_b_lo), f_w));
+			f_acc1 = _mm256_add_epi32(f_acc1, _mm256_madd_epi16(_mm256_unpackhi_epi16(f_a_lo, f_b_lo), f_w));
+			f_acc2 = _mm256_add_epi32(f_acc2, _mm256_madd_epi16(_mm256_unpacklo_epi16(f_a_hi, f_b_hi), f_w));
+			f_acc3 = _mm256_add_epi32(f_acc3, _mm256_madd_epi16(_mm256_unpackhi_epi16(f_a_hi, f_b_hi), f_w));
+		}
+
+		// the unpacks work per 128 bit lane : the low lanes hold samples 0-15, the high lanes 16-31
+		const __m256i f_lo = _mm256_packs_epi32(_mm256_srai_epi32(f_acc0, 7), _mm256_srai_epi32(f_acc1, 7));
+		const __m256i f_hi = _mm256_packs_epi32(_mm256_srai_epi32(f_acc2, 7), _mm256_srai_epi32(f_acc3, 7));
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i *> (p_dst + f_i), _mm256_permute2x128_si256(f_lo, f_hi, 0x20));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *> (p_dst + f_i + 16), _mm256_permute2x128_si256(f_lo, f_hi, 0x31));
+	}
+
+	scale_rows_tail(p_src, p_weights, p_taps, p_dst, f_i, p_count);
+}
+
+// x > -1 && x < p_limit for 8 coordinates (the float to int conversion returns INT_MIN for values that don't fit)
+inline __m256i inside_avx2(__m256i p_x, __m256i p_limit)
+{
+	return _mm256_and_si256(_mm256_cmpgt_epi32(p_x, _mm256_set1_epi32(-1)), _mm256_cmpgt_epi32(p_limit, p_x));
+}
+
+// 8 lanes of all bits set or zero to 8 bytes of 0xff or zero
+inline void store_lane_bytes(unsigned char *p_dst, __m256i p_lanes)
+{
+	const __m128i f_words = _mm_packs_epi32(_mm256_castsi256_si128(p_lanes), _mm256_extracti128_si256(p_lanes, 1));
+	_mm_storel_epi64(reinterpret_cast<__m128i *> (p_dst), _mm_packs_epi16(f_words, f_words));
+}
+
+void body_lookup_float_avx2(const float *p_points, const unsigned char *p_labels, int p_depth_width, int p_depth_height, unsigned char *p_mask, int p_count)
+{
+	const __m256i f_width	= _mm256_set1_epi32(p_depth_width);
+	const __m256i f_height	= _mm256_set1_epi32(p_depth_height);
+	const __m256i f_align	= _mm256_set1_epi32(~3);
+	const __m256i f_byte	= _mm256_set1_epi32(0xff);
+	const int *	  f_labels	= reinterpret_cast<const int *> (p_labels);
+	int f_i = 0;
+
+	for (; f_i + 8 <= p_count; f_i += 8)
+	{
+		// the shuffles work per 128 bit lane : the coordinates come out as 0, 1, 4, 5, 2, 3, 6, 7
+		const __m256  f_a = _mm256_loadu_ps(p_points + (f_i * 2));
+		const __m256  f_b = _mm256_loadu_ps(p_points + (f_i * 2) + 8);
+		const __m256i f_x = _mm256_permute4x64_epi64(_mm256_cvttps_epi32(_mm256_shuffle_ps(f_a, f_b, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0));
+		const __m256i f_y = _mm256_permute4x64_epi64(_mm256_cvttps_epi32(_mm256_shuffle_ps(f_a, f_b, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0));
+
+		const __m256i f_inside = _mm256_and_si256(inside_avx2(f_x, f_width), inside_avx2(f_y, f_height));
+		const __m256i f_idx	   = _mm256_and_si256(_mm256_add_epi32(_mm256_mullo_epi32(f_y, f_width), f_x), f_inside);
+
+		// gather the aligned group of 4 labels that contains each label, then shift the right one into place
+		const __m256i f_group  = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), f_labels, _mm256_srli_epi32(_mm256_and_si256(f_idx, f_align), 2), f_inside, 4);
+		const __m256i f_label  = _mm256_and_si256(_mm256_srlv_epi32(f_group, _mm256_slli_epi32(_mm256_andnot_si256(f_align, f_idx), 3)), f_byte);
+
+		store_lane_bytes(p_mask + f_i, _mm256_andnot_si256(_mm256_cmpeq_epi32(f_label, f_byte), f_inside));
+	}
+
+	body_lookup_float_scalar(p_points + (f_i * 2), p_labels, p_depth_width, p_depth_height, p_mask + f_i, p_count - f_i);
+}
+
+void body_lookup_int_avx2(const int *p_points, const unsigned int *p_labels, int p_depth_width, int p_depth_height, unsigned char *p_mask, int p_count)
+{
+	const __m256i f_width	= _mm256_set1_epi32(p_depth_width);
+	const __m256i f_height	= _mm256_set1_epi32(p_depth_height);
+	const __m256i f_player	= _mm256_set1_epi32(0xffff);
+	const __m256i f_zero	= _mm256_setzero_si256();
+	const __m256i f_order	= _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	int f_i = 0;
+
+	for (; f_i + 8 <= p_count; f_i += 8)
+	{
+		// 8 points of x, y, depth, reserved (2 points per register) : the unpacks give the coordinates in the order 0, 2, 4, 6, 1, 3, 5, 7
+		const __m256i *f_src = reinterpret_cast<const __m256i *> (p_points + (f_i * 4));
+		const __m256i f_0123 = _mm256_unpacklo_epi32(_mm256_loadu_si256(f_src), _mm256_loadu_si256(f_src + 1));
+		const __m256i f_4567 = _mm256_unpacklo_epi32(_mm256_loadu_si256(f_src + 2), _mm256_loadu_si256(f_src + 3));
+		const __m256i f_x	 = _mm256_unpacklo_epi64(f_0123, f_4567);
+		const __m256i f_y	 = _mm256_unpackhi_epi64(f_0123, f_4567);
+
+		const __m256i f_inside = _mm256_and_si256(inside_avx2(f_x, f_width), inside_avx2(f_y, f_height));
+		const __m256i f_idx	   = _mm256_and_si256(_mm256_add_epi32(_mm256_mullo_epi32(f_y, f_width), f_x), f_inside);
+		const __m256i f_pixel  = _mm256_mask_i32gather_epi32(f_zero, reinterpret_cast<const int *> (p_labels), f_idx, f_inside, 4);
+		const __m256i f_body   = _mm256_andnot_si256(_mm256_cmpeq_epi32(_mm256_and_si256(f_pixel, f_player), f_zero), f_inside);
+
+		store_lane_bytes(p_mask + f_i, _mm256_permutevar8x32_epi32(f_body, f_order));
+	}
+
+	body_lookup_int_scalar(p_points + (f_i * 4), p_labels, p_depth_width, p_depth_height, p_mask + f_i, p_count - f_i);
+}
+
+} // unnamed namespace
+
+void install_kernels_avx2(RowKernels &p_kernels)
+{
+	p_kernels.m_level			 = cpu::SIMD_AVX2;
+	p_kernels.m_copy_32bpp_32bpp = copy_32bpp_32bpp_avx2;
+	p_kernels.m_copy_32bpp_24bpp = copy_32bpp_24bpp_avx2;
+	p_kernels.m_mask_32bpp_32bpp = mask_32bpp_32bpp_avx2;
+	p_kernels.m_mask_32bpp_24bpp = mask_32bpp_24bpp_avx2;
+	p_kernels.m_copy_16bpp_16bpp = copy_16bpp_16bpp_avx2;
+	p_kernels.m_scale_rows		 = scale_rows_avx2;
+	p_kernels.m_body_lookup_float = body_lookup_float_avx2;
+	p_kernels.m_body_lookup_int	 = body_lookup_int_avx2;
+	p_kernels.m_select_32bpp_32bpp = select_32bpp_32bpp_avx2;
+}
+
+#else
+
+void install_kernels_avx2(RowKernels &)
+{
+}
+
+#endif // KW_SIMD_X86
+
+} // namespace kernels
+
+} // namespace img
@@ -0,0 +1,609 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	image_kernels_scalar.cpp
+//
+// Purpose	: 	per-row image kernels - scalar reference implementation
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "image_kernels.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace img {
+
+namespace kernels {
+
+namespace {
+
+// BT.601 limited range
+inline unsigned char rgb_to_y(int p_r, int p_g, int p_b)
+{
+	return static_cast<unsigned char> (((66 * p_r + 129 * p_g + 25 * p_b + 128) >> 8) + 16);
+}
+
+inline unsigned char rgb_to_u(int p_r, int p_g, int p_b)
+{
+	return static_cast<unsigned char> (((-38 * p_r - 74 * p_g + 112 * p_b + 128) >> 8) + 128);
+}
+
+inline unsigned char rgb_to_v(int p_r, int p_g, int p_b)
+{
+	return static_cast<unsigned char> (((112 * p_r - 94 * p_g - 18 * p_b + 128) >> 8) + 128);
+}
+
+inline void store_chroma(unsigned char *p_dst_u, unsigned char *p_dst_v, int p_x, bool p_nv12, unsigned char p_u, unsigned char p_v)
+{
+	if (p_nv12)
+	{
+		p_dst_u[p_x]	 = p_u;
+		p_dst_u[p_x + 1] = p_v;
+	}
+	else
+	{
+		p_dst_u[p_x / 2] = p_u;
+		p_dst_v[p_x / 2] = p_v;
+	}
+}
+
+template <bool t_nv12, bool t_mask>
+void bgra_to_yuv420_scalar(KW_PLANAR_ROW_ARGS)
+{
+	for (int f_x = 0; f_x < p_width; f_x += 2, p_src_0 += 8, p_src_1 += 8)
+	{
+		// masked out pixels are black
+		const int f_k00 = (!t_mask || p_mask_0[f_x]	   != 0) ? 0xff : 0x00;
+		const int f_k01 = (!t_mask || p_mask_0[f_x + 1] != 0) ? 0xff : 0x00;
+		const int f_k10 = (!t_mask || p_mask_1[f_x]	   != 0) ? 0xff : 0x00;
+		const int f_k11 = (!t_mask || p_mask_1[f_x + 1] != 0) ? 0xff : 0x00;
+
+		const int f_b00 = p_src_0[0] & f_k00, f_g00 = p_src_0[1] & f_k00, f_r00 = p_src_0[2] & f_k00;
+		const int f_b01 = p_src_0[4] & f_k01, f_g01 = p_src_0[5] & f_k01, f_r01 = p_src_0[6] & f_k01;
+		const int f_b10 = p_src_1[0] & f_k10, f_g10 = p_src_1[1] & f_k10, f_r10 = p_src_1[2] & f_k10;
+		const int f_b11 = p_src_1[4] & f_k11, f_g11 = p_src_1[5] & f_k11, f_r11 = p_src_1[6] & f_k11;
+
+		p_dst_y_0[f_x]	   = rgb_to_y(f_r00, f_g00, f_b00);
+		p_dst_y_0[f_x + 1] = rgb_to_y(f_r01, f_g01, f_b01);
+		p_dst_y_1[f_x]	   = rgb_to_y(f_r10, f_g10, f_b10);
+		p_dst_y_1[f_x + 1] = rgb_to_y(f_r11, f_g11, f_b11);
+
+		const int f_r = (f_r00 + f_r01 + f_r10 + f_r11 + 2) >> 2;
+		const int f_g = (f_g00 + f_g01 + f_g10 + f_g11 + 2) >> 2;
+		const int f_b = (f_b00 + f_b01 + f_b10 + f_b11 + 2) >> 2;
+
+		store_chroma(p_dst_u, p_dst_v, f_x, t_nv12, rgb_to_u(f_r, f_g, f_b), rgb_to_v(f_r, f_g, f_b));
+	}
+}
+
+template <bool t_nv12, bool t_mask>
+void yuy2_to_yuv420_scalar(KW_PLANAR_ROW_ARGS)
+{
+	for (int f_x = 0; f_x < p_width; f_x += 2, p_src_0 += 4, p_src_1 += 4)
+	{
+		const bool f_k00 = !t_mask || p_mask_0[f_x]	   != 0;
+		const bool f_k01 = !t_mask || p_mask_0[f_x + 1] != 0;
+		const bool f_k10 = !t_mask || p_mask_1[f_x]	   != 0;
+		const bool f_k11 = !t_mask || p_mask_1[f_x + 1] != 0;
+		const bool f_kc	 = f_k00 || f_k01 || f_k10 || f_k11;
+
+		p_dst_y_0[f_x]	   = f_k00 ? p_src_0[0] : 16;
+		p_dst_y_0[f_x + 1] = f_k01 ? p_src_0[2] : 16;
+		p_dst_y_1[f_x]	   = f_k10 ? p_src_1[0] : 16;
+		p_dst_y_1[f_x + 1] = f_k11 ? p_src_1[2] : 16;
+
+		const unsigned char f_u = f_kc ? static_cast<unsigned char> ((p_src_0[1] + p_src_1[1] + 1) >> 1) : 128;
+		const unsigned char f_v = f_kc ? static_cast<unsigned char> ((p_src_0[3] + p_src_1[3] + 1) >> 1) : 128;
+
+		store_chroma(p_dst_u, p_dst_v, f_x, t_nv12, f_u, f_v);
+	}
+}
+
+// horizontal pass for a single output sample : the source samples are p_step values apart
+inline unsigned char scale_sample(const short *p_src, int p_step, const short *p_weights, int p_taps)
+{
+	int f_sum = 1 << 20;
+
+	for (int f_t = 0; f_t < p_taps; ++f_t, p_src += p_step)
+		f_sum += *p_src * p_weights[f_t];
+
+	f_sum >>= 21;
+	return static_cast<unsigned char> ((f_sum < 0) ? 0 : (f_sum > 255) ? 255 : f_sum);
+}
+
+} // unnamed namespace
+
+void copy_32bpp_32bpp_scalar(const unsigned char *p_src, unsigned char *p_dst, int p_width)
+{
+	std::memcpy(p_dst, p_src, p_width * 4);
+}
+
+void copy_32bpp_24bpp_scalar(const unsigned char *p_src, unsigned char *p_dst, int p_width)
+{
+	for (int f_w = 0; f_w < p_width; ++f_w, p_src += 4, p_dst += 3)
+	{
+		p_dst[0] = p_src[0];
+		p_dst[1] = p_src[1];
+		p_dst[2] = p_src[2];
+	}
+}
+
+void mask_32bpp_32bpp_scalar(const unsigned char *p_src, const unsigned char *p_mask, unsigned char *p_dst, int p_width)
+{
+	for (int f_w = 0; f_w < p_width; ++f_w, p_src += 4, p_dst += 4)
+	{
+		const unsigned char f_keep = (p_mask[f_w] != 0) ? 0xff : 0x00;
+
+		p_dst[0] = p_src[0] & f_keep;
+		p_dst[1] = p_src[1] & f_keep;
+		p_dst[2] = p_src[2] & f_keep;
+		p_dst[3] = p_src[3] & f_keep;
+	}
+}
+
+void mask_32bpp_24bpp_scalar(const unsigned char *p_src, const unsigned char *p_mask, unsigned char *p_dst, int p_width)
+{
+	for (int f_w = 0; f_w < p_width; ++f_w, p_src += 4, p_dst += 3)
+	{
+		const unsigned char f_keep = (p_mask[f_w] != 0) ? 0xff : 0x00;
+
+		p_dst[0] = p_src[0] & f_keep;
+		p_dst[1] = p_src[1] & f_keep;
+		p_dst[2] = p_src[2] & f_keep;
+	}
+}
+
+void copy_16bpp_16bpp_scalar(const unsigned char *p_src, unsigned char *p_dst, int p_width)
+{
+	std::memcpy(p_dst, p_src, p_width * 2);
+}
+
+void mask_16bpp_16bpp_scalar(const unsigned char *p_src, const unsigned char *p_mask, unsigned char *p_dst, int p_width)
+{
+	// YUY2 black : Y = 16, U = V = 128
+	for (int f_w = 0; f_w < p_width; f_w += 2, p_src += 4, p_dst += 4)
+	{
+		const bool f_keep_0 = p_mask[f_w] != 0;
+		const bool f_keep_1 = p_mask[f_w + 1] != 0;
+		const bool f_keep_c = f_keep_0 || f_keep_1;
+
+		p_dst[0] = f_keep_0 ? p_src[0] : 16;
+		p_dst[1] = f_keep_c ? p_src[1] : 128;
+		p_dst[2] = f_keep_1 ? p_src[2] : 16;
+		p_dst[3] = f_keep_c ? p_src[3] : 128;
+	}
+}
+
+void copy_32bpp_nv12_scalar(KW_PLANAR_ROW_ARGS)
+{
+	bgra_to_yuv420_scalar<true, false>(p_src_0, p_src_1, p_mask_0, p_mask_1, p_dst_y_0, p_dst_y_1, p_dst_u, p_dst_v, p_width);
+}
+
+void mask_32bpp_nv12_scalar(KW_PLANAR_ROW_ARGS)
+{
+	bgra_to_yuv420_scalar<true, true>(p_src_0, p_src_1, p_mask_0, p_mask_1, p_dst_y_0, p_dst_y_1, p_dst_u, p_dst_v, p_width);
+}
+
+void copy_32bpp_i420_scalar(KW_PLANAR_ROW_ARGS)
+{
+	bgra_to_yuv420_scalar<false, false>(p_src_0, p_src_1, p_mask_0, p_mask_1, p_dst_y_0, p_dst_y_1, p_dst_u, p_dst_v, p_width);
+}
+
+void mask_32bpp_i420_scalar(KW_PLANAR_ROW_ARGS)
+{
+	bgra_to_yuv420_scalar<false, true>(p_src_0, p_src_1, p_mask_0, p_mask_1, p_dst_y_0, p_dst_y_1, p_dst_u, p_dst_v, p_width);
+}
+
+void copy_16bpp_nv12_scalar(KW_PLANAR_ROW_ARGS)
+{
+	yuy2_to_yuv420_scalar<true, false>(p_src_0, p_src_1, p_mask_0, p_mask_1, p_dst_y_0, p_dst_y_1, p_dst_u, p_dst_v, p_width);
+}
+
+void mask_16bpp_nv12_scalar(KW_PLANAR_ROW_ARGS)
+{
+	yuy2_to_yuv420_scalar<true, true>(p_src_0, p_src_1, p_mask_0, p_mask_1, p_dst_y_0, p_dst_y_1, p_dst_u, p_dst_v, p_width);
+}
+
+void copy_16bpp_i420_scalar(KW_PLANAR_ROW_ARGS)
+{
+	yuy2_to_yuv420_scalar<false, false>(p_src_0, p_src_1, p_mask_0, p_mask_1, p_dst_y_0, p_dst_y_1, p_dst_u, p_dst_v, p_width);
+}
+
+void mask_16bpp_i420_scalar(KW_PLANAR_ROW_ARGS)
+{
+	yuy2_to_yuv420_scalar<false, true>(p_src_0, p_src_1, p_mask_0, p_mask_1, p_dst_y_0, p_dst_y_1, p_dst_u, p_dst_v, p_width);
+}
+
+void scale_rows_scalar(const unsigned char *const *p_src, const short *p_weights, int p_taps, short *p_dst, int p_count)
+{
+	scale_rows_tail(p_src, p_weights, p_taps, p_dst, 0, p_count);
+}
+
+void scale_cols_32bpp_scalar(const short *p_src, const ScaleTaps &p_luma, const ScaleTaps &, unsigned char *p_dst, int p_width)
+{
+	for (int f_x = 0; f_x < p_width; ++f_x, p_dst += 4)
+	{
+		const short *f_src	   = p_src + (p_luma.m_offset[f_x] * 4);
+		const short *f_weights = p_luma.m_weights + (f_x * p_luma.m_taps);
+
+		p_dst[0] = scale_sample(f_src + 0, 4, f_weights, p_luma.m_taps);
+		p_dst[1] = scale_sample(f_src + 1, 4, f_weights, p_luma.m_taps);
+		p_dst[2] = scale_sample(f_src + 2, 4, f_weights, p_luma.m_taps);
+		p_dst[3] = scale_sample(f_src + 3, 4, f_weights, p_luma.m_taps);
+	}
+}
+
+void scale_cols_16bpp_scalar(const short *p_src, const ScaleTaps &p_luma, const ScaleTaps &p_chroma, unsigned char *p_dst, int p_width)
+{
+	// Y0-U-Y1-V : luma samples are 2 values apart, chroma samples 4
+	for (int f_x = 0; f_x < p_width; f_x += 2, p_dst += 4)
+	{
+		const short *f_chroma  = p_src + (p_chroma.m_offset[f_x / 2] * 4);
+		const short *f_weights = p_chroma.m_weights + ((f_x / 2) * p_chroma.m_taps);
+
+		p_dst[0] = scale_sample(p_src + (p_luma.m_offset[f_x] * 2), 2, p_luma.m_weights + (f_x * p_luma.m_taps), p_luma.m_taps);
+		p_dst[1] = scale_sample(f_chroma + 1, 4, f_weights, p_chroma.m_taps);
+		p_dst[2] = scale_sample(p_src + (p_luma.m_offset[f_x + 1] * 2), 2, p_luma.m_weights + ((f_x + 1) * p_luma.m_taps), p_luma.m_taps);
+		p_dst[3] = scale_sample(f_chroma + 3, 4, f_weights, p_chroma.m_taps);
+	}
+}
+
+void matte_32bpp_32bpp_scalar(const unsigned char *p_src, const unsigned char *p_mask, unsigned char *p_dst, int p_width)
+{
+	for (int f_w = 0; f_w < p_width; ++f_w, p_src += 4, p_dst += 4)
+	{
+		const int f_alpha = p_mask[f_w];
+
+		p_dst[0] = premultiply(p_src[0], f_alpha);
+		p_dst[1] = premultiply(p_src[1], f_alpha);
+		p_dst[2] = premultiply(p_src[2], f_alpha);
+		p_dst[3] = static_cast<unsigned char> (f_alpha);
+	}
+}
+
+void matte_32bpp_24bpp_scalar(const unsigned char *p_src, const unsigned char *p_mask, unsigned char *p_dst, int p_width)
+{
+	for (int f_w = 0; f_w < p_width; ++f_w, p_src += 4, p_dst += 3)
+	{
+		const int f_alpha = p_mask[f_w];
+
+		p_dst[0] = premultiply(p_src[0], f_alpha);
+		p_dst[1] = premultiply(p_src[1], f_alpha);
+		p_dst[2] = premultiply(p_src[2], f_alpha);
+	}
+}
+
+void matte_min_scalar(const unsigned char *p_a, const unsigned char *p_b, const unsigned char *p_c, unsigned char *p_dst, int p_count)
+{
+	for (int f_i = 0; f_i < p_count; ++f_i)
+		p_dst[f_i] = std::min(std::min(p_a[f_i], p_b[f_i]), p_c[f_i]);
+}
+
+void matte_max_scalar(const unsigned char *p_a, const unsigned char *p_b, const unsigned char *p_c, unsigned char *p_dst, int p_count)
+{
+	for (int f_i = 0; f_i < p_count; ++f_i)
+		p_dst[f_i] = std::max(std::max(p_a[f_i], p_b[f_i]), p_c[f_i]);
+}
+
+void matte_slide_scalar(unsigned short *p_sums, const unsigned char *p_add, const unsigned char *p_sub, int p_count)
+{
+	for (int f_i = 0; f_i < p_count; ++f_i)
+		p_sums[f_i] = static_cast<unsigned short> (p_sums[f_i] + p_add[f_i] - p_sub[f_i]);
+}
+
+void matte_feather_scalar(const unsigned short *p_sums, int p_radius, int p_recip, int p_weight, unsigned char *p_matte, int p_count)
+{
+	// the sum of the window is updated incrementally : add the sum entering on the right, drop the one leaving on the left
+	int f_box = 0;
+
+	for (int f_t = -p_radius; f_t < p_radius; ++f_t)
+		f_box += p_sums[f_t];
+
+	for (int f_i = 0; f_i < p_count; ++f_i)
+	{
+		f_box += p_sums[f_i + p_radius];
+
+		const int f_value = std::min((f_box * p_recip) >> 16, 255);
+		const int f_prev  = p_matte[f_i];
+
+		p_matte[f_i] = static_cast<unsigned char> (f_prev + ((((f_value - f_prev) * p_weight) + 64) >> 7));
+
+		f_box -= p_sums[f_i - p_radius];
+	}
+}
+
+void body_lookup_float_scalar(const float *p_points, const unsigned char *p_labels, int p_depth_width, int p_depth_height, unsigned char *p_mask, int p_count)
+{
+	const float f_width	 = static_cast<float> (p_depth_width);
+	const float f_height = static_cast<float> (p_depth_height);
+
+	for (int f_i = 0; f_i < p_count; ++f_i, p_points += 2)
+	{
+		// clamp to [-1, size] before the conversion (max and min put NaN and the infinities in range, without branches),
+		//	the truncated coordinates are then checked as unsigned : (-1, 0) truncates to the first row or column, just like the simd conversions
+		const int  f_x		= static_cast<int> (std::min(f_width, std::max(-1.0f, p_points[0])));
+		const int  f_y		= static_cast<int> (std::min(f_height, std::max(-1.0f, p_points[1])));
+		const bool f_inside = (static_cast<unsigned int> (f_x) < static_cast<unsigned int> (p_depth_width)) &
+							  (static_cast<unsigned int> (f_y) < static_cast<unsigned int> (p_depth_height));
+		const int  f_idx	= (f_inside) ? (f_y * p_depth_width) + f_x : 0;
+
+		p_mask[f_i] = static_cast<unsigned char> (-static_cast<int> (f_inside & (p_labels[f_idx] != 0xff)));
+	}
+}
+
+void body_lookup_int_scalar(const int *p_points, const unsigned int *p_labels, int p_depth_width, int p_depth_height, unsigned char *p_mask, int p_count)
+{
+	for (int f_i = 0; f_i < p_count; ++f_i, p_points += 4)
+	{
+		const bool f_inside = (static_cast<unsigned int> (p_points[0]) < static_cast<unsigned int> (p_depth_width)) &
+							  (static_cast<unsigned int> (p_points[1]) < static_cast<unsigned int> (p_depth_height));
+		const int  f_idx	= (f_inside) ? (p_points[1] * p_depth_width) + p_points[0] : 0;
+
+		p_mask[f_i] = static_cast<unsigned char> (-static_cast<int> (f_inside & ((p_labels[f_idx] & 0xffff) != 0)));
+	}
+}
+
+void depth_window_scalar(const unsigned short *p_depth, const unsigned char *p_body_index, int p_near, int p_far, unsigned char *p_labels, int p_count)
+{
+	for (int f_i = 0; f_i < p_count; ++f_i)
+	{
+		const bool f_inside = p_depth[f_i] >= p_near && p_depth[f_i] <= p_far;
+		p_labels[f_i] = (!f_inside) ? 0xff : (p_body_index) ? p_body_index[f_i] : 0;
+	}
+}
+
+void depth_window_packed_scalar(const unsigned int *p_pixels, bool p_player_index, int p_near, int p_far, unsigned int *p_labels, int p_count)
+{
+	for (int f_i = 0; f_i < p_count; ++f_i)
+	{
+		const int  f_depth	= static_cast<int> (p_pixels[f_i] >> 16);
+		const bool f_keep	= f_depth >= p_near && f_depth <= p_far && (!p_player_index || (p_pixels[f_i] & 0xffff) != 0);
+		p_labels[f_i] = (f_keep) ? 1 : 0;
+	}
+}
+
+void background_32bpp_scalar(const unsigned char *p_background, const unsigned char *p_mask, unsigned char *p_dst, int p_width)
+{
+	for (int f_w = 0; f_w < p_width; ++f_w, p_background += 4, p_dst += 4)
+	{
+		const int f_rest = 255 - p_mask[f_w];
+
+		p_dst[0] = static_cast<unsigned char> (p_dst[0] + premultiply(p_background[0], f_rest));
+		p_dst[1] = static_cast<unsigned char> (p_dst[1] + premultiply(p_background[1], f_rest));
+		p_dst[2] = static_cast<unsigned char> (p_dst[2] + premultiply(p_background[2], f_rest));
+		p_dst[3] = static_cast<unsigned char> (p_dst[3] + premultiply(p_background[3], f_rest));
+	}
+}
+
+void background_24bpp_scalar(const unsigned char *p_background, const unsigned char *p_mask, unsigned char *p_dst, int p_width)
+{
+	for (int f_w = 0; f_w < p_width; ++f_w, p_background += 3, p_dst += 3)
+	{
+		const int f_rest = 255 - p_mask[f_w];
+
+		p_dst[0] = static_cast<unsigned char> (p_dst[0] + premultiply(p_background[0], f_rest));
+		p_dst[1] = static_cast<unsigned char> (p_dst[1] + premultiply(p_background[1], f_rest));
+		p_dst[2] = static_cast<unsigned char> (p_dst[2] + premultiply(p_background[2], f_rest));
+	}
+}
+
+void select_32bpp_32bpp_scalar(const unsigned char *p_src, const unsigned char *p_mask, const unsigned char *p_background, unsigned char *p_dst, int p_width)
+{
+	for (int f_w = 0; f_w < p_width; ++f_w, p_src += 4, p_background += 4, p_dst += 4)
+	{
+		const unsigned char *f_from = (p_mask[f_w] != 0) ? p_src : p_background;
+
+		p_dst[0] = f_from[0];
+		p_dst[1] = f_from[1];
+		p_dst[2] = f_from[2];
+		p_dst[3] = f_from[3];
+	}
+}
+
+void select_32bpp_24bpp_scalar(const unsigned char *p_src, const unsigned char *p_mask, const unsigned char *p_background, unsigned char *p_dst, int p_width)
+{
+	for (int f_w = 0; f_w < p_width; ++f_w, p_src += 4, p_background += 3, p_dst += 3)
+	{
+		const unsigned char *f_from = (p_mask[f_w] != 0) ? p_src : p_background;
+
+		p_dst[0] = f_from[0];
+		p_dst[1] = f_from[1];
+		p_dst[2] = f_from[2];
+	}
+}
+
+void background_16bpp_scalar(const unsigned char *p_background, const unsigned char *p_mask, unsigned char *p_dst, int p_width)
+{
+	for (int f_w = 0; f_w < p_width; f_w += 2, p_background += 4, p_dst += 4)
+	{
+		const bool f_show_0 = p_mask[f_w] == 0;
+		const bool f_show_1 = p_mask[f_w + 1] == 0;
+		const bool f_show_c = f_show_0 && f_show_1;
+
+		if (f_show_0)	p_dst[0] = p_background[0];
+		if (f_show_c)	p_dst[1] = p_background[1];
+		if (f_show_1)	p_dst[2] = p_background[2];
+		if (f_show_c)	p_dst[3] = p_background[3];
+	}
+}
+
+namespace {
+
+template <bool t_nv12>
+void background_yuv420_scalar(KW_PLANAR_BACKGROUND_ARGS)
+{
+	for (int f_x = 0; f_x < p_width; f_x += 2)
+	{
+		const bool f_s00 = p_mask_0[f_x] == 0;
+		const bool f_s01 = p_mask_0[f_x + 1] == 0;
+		const bool f_s10 = p_mask_1[f_x] == 0;
+		const bool f_s11 = p_mask_1[f_x + 1] == 0;
+
+		if (f_s00)	p_dst_y_0[f_x]	   = p_bg_y_0[f_x];
+		if (f_s01)	p_dst_y_0[f_x + 1] = p_bg_y_0[f_x + 1];
+		if (f_s10)	p_dst_y_1[f_x]	   = p_bg_y_1[f_x];
+		if (f_s11)	p_dst_y_1[f_x + 1] = p_bg_y_1[f_x + 1];
+
+		if (f_s00 && f_s01 && f_s10 && f_s11)
+		{
+			const int f_c = (t_nv12) ? f_x : f_x / 2;
+			store_chroma(p_dst_u, p_dst_v, f_x, t_nv12, p_bg_u[f_c], (t_nv12) ? p_bg_u[f_c + 1] : p_bg_v[f_c]);
+		}
+	}
+}
+
+} // unnamed namespace
+
+void background_nv12_scalar(KW_PLANAR_BACKGROUND_ARGS)
+{
+	background_yuv420_scalar<true>(p_bg_y_0, p_bg_y_1, p_bg_u, p_bg_v, p_mask_0, p_mask_1, p_dst_y_0, p_dst_y_1, p_dst_u, p_dst_v, p_width);
+}
+
+void background_i420_scalar(KW_PLANAR_BACKGROUND_ARGS)
+{
+	background_yuv420_scalar<false>(p_bg_y_0, p_bg_y_1, p_bg_u, p_bg_v, p_mask_0, p_mask_1, p_dst_y_0, p_dst_y_1, p_dst_u, p_dst_v, p_width);
+}
+
+void blur_rows_scalar(const unsigned char *const *p_rows, int p_count, int p_recip, unsigned char *p_dst, int p_bytes)
+{
+	const int f_half = p_count / 2;
+
+	for (int f_i = 0; f_i < p_bytes; ++f_i)
+	{
+		int f_sum = f_half;
+
+		for (int f_r = 0; f_r < p_count; ++f_r)
+			f_sum += p_rows[f_r][f_i];
+
+		p_dst[f_i] = static_cast<unsigned char> ((f_sum * p_recip) >> 16);
+	}
+}
+
+void blur_cols_scalar(const unsigned char *p_src, int p_radius, int p_recip, unsigned char *p_dst, int p_count)
+{
+	const int f_last = p_count - 1;
+
+	for (int f_c = 0; f_c < 4; ++f_c)
+	{
+		// the window of the first element (the first element repeated to the left), plus half the window for the rounding
+		int f_sum = ((p_radius + 1) * p_src[f_c]) + p_radius;
+
+		for (int f_x = 1; f_x <= p_radius; ++f_x)
+			f_sum += p_src[(std::min(f_x, f_last) * 4) + f_c];
+
+		for (int f_x = 0; f_x < p_count; ++f_x)
+		{
+			p_dst[(f_x * 4) + f_c] = static_cast<unsigned char> ((f_sum * p_recip) >> 16);
+
+			f_sum += p_src[(std::min(f_x + p_radius + 1, f_last) * 4) + f_c];
+			f_sum -= p_src[(std::max(f_x - p_radius, 0) * 4) + f_c];
+		}
+	}
+}
+
+namespace {
+
+// (3 * a + b) / 4, the way the simd kernels compute it
+inline unsigned char blend_3_1(unsigned char p_a, unsigned char p_b)
+{
+	const int f_ab = (p_a + p_b + 1) >> 1;
+	return static_cast<unsigned char> ((f_ab + p_a + 1) >> 1);
+}
+
+} // unnamed namespace
+
+void upsample_2x_scalar(const unsigned char *p_near, const unsigned char *p_far, unsigned char *p_dst, int p_count)
+{
+	const int f_last = p_count - 1;
+
+	for (int f_x = 0; f_x < p_count; ++f_x)
+	{
+		const int f_left  = std::max(f_x - 1, 0) * 4;
+		const int f_right = std::min(f_x + 1, f_last) * 4;
+
+		for (int f_c = 0; f_c < 4; ++f_c)
+		{
+			const unsigned char f_v		  = blend_3_1(p_near[(f_x * 4) + f_c], p_far[(f_x * 4) + f_c]);
+			const unsigned char f_v_left  = blend_3_1(p_near[f_left + f_c], p_far[f_left + f_c]);
+			const unsigned char f_v_right = blend_3_1(p_near[f_right + f_c], p_far[f_right + f_c]);
+
+			p_dst[(f_x * 8) + f_c]	   = blend_3_1(f_v, f_v_left);
+			p_dst[(f_x * 8) + 4 + f_c] = blend_3_1(f_v, f_v_right);
+		}
+	}
+}
+
+void depth_to_color_scalar(const unsigned short *p_depth, const DepthColorCoefficients &p_coefficients, float *p_points, int p_count)
+{
+	const float f_inf = -std::numeric_limits<float>::infinity();
+
+	for (int f_i = 0; f_i < p_count; ++f_i)
+	{
+		const float f_z = static_cast<float> (p_depth[f_i]) * 0.001f;
+		const float f_w = (f_z * p_coefficients.m_w[f_i]) + p_coefficients.m_offset[2];
+
+		if (p_depth[f_i] == 0 || !(f_w > 0.0f))
+		{
+			p_points[(f_i * 2)]		= f_inf;
+			p_points[(f_i * 2) + 1] = f_inf;
+			continue;
+		}
+
+		p_points[(f_i * 2)]		= ((f_z * p_coefficients.m_u[f_i]) + p_coefficients.m_offset[0]) / f_w;
+		p_points[(f_i * 2) + 1] = ((f_z * p_coefficients.m_v[f_i]) + p_coefficients.m_offset[1]) / f_w;
+	}
+}
+
+void install_kernels_scalar(RowKernels &p_kernels)
+{
+	p_kernels.m_level			 = cpu::SIMD_NONE;
+	p_kernels.m_copy_32bpp_32bpp = copy_32bpp_32bpp_scalar;
+	p_kernels.m_copy_32bpp_24bpp = copy_32bpp_24bpp_scalar;
+	p_kernels.m_mask_32bpp_32bpp = mask_32bpp_32bpp_scalar;
+	p_kernels.m_mask_32bpp_24bpp = mask_32bpp_24bpp_scalar;
+	p_kernels.m_copy_16bpp_16bpp = copy_16bpp_16bpp_scalar;
+	p_kernels.m_mask_16bpp_16bpp = mask_16bpp_16bpp_scalar;
+	p_kernels.m_copy_32bpp_nv12	 = copy_32bpp_nv12_scalar;
+	p_kernels.m_mask_32bpp_nv12	 = mask_32bpp_nv12_scalar;
+	p_kernels.m_copy_32bpp_i420	 = copy_32bpp_i420_scalar;
+	p_kernels.m_mask_32bpp_i420	 = mask_32bpp_i420_scalar;
+	p_kernels.m_copy_16bpp_nv12	 = copy_16bpp_nv12_scalar;
+	p_kernels.m_mask_16bpp_nv12	 = mask_16bpp_nv12_scalar;
+	p_kernels.m_copy_16bpp_i420	 = copy_16bpp_i420_scalar;
+	p_kernels.m_mask_16bpp_i420	 = mask_16bpp_i420_scalar;
+	p_kernels.m_scale_rows		 = scale_rows_scalar;
+	p_kernels.m_scale_cols_32bpp = scale_cols_32bpp_scalar;
+	p_kernels.m_scale_cols_16bpp = scale_cols_16bpp_scalar;
+	p_kernels.m_matte_32bpp_32bpp = matte_32bpp_32bpp_scalar;
+	p_kernels.m_matte_32bpp_24bpp = matte_32bpp_24bpp_scalar;
+	p_kernels.m_matte_min		 = matte_min_scalar;
+	p_kernels.m_matte_max		 = matte_max_scalar;
+	p_kernels.m_matte_slide		 = matte_slide_scalar;
+	p_kernels.m_matte_feather	 = matte_feather_scalar;
+	p_kernels.m_body_lookup_float = body_lookup_float_scalar;
+	p_kernels.m_body_lookup_int	 = body_lookup_int_scalar;
+	p_kernels.m_depth_window	 = depth_window_scalar;
+	p_kernels.m_depth_window_packed = depth_window_packed_scalar;
+	p_kernels.m_background_32bpp = background_32bpp_scalar;
+	p_kernels.m_background_24bpp = background_24bpp_scalar;
+	p_kernels.m_background_16bpp = background_16bpp_scalar;
+	p_kernels.m_background_nv12	 = background_nv12_scalar;
+	p_kernels.m_background_i420	 = background_i420_scalar;
+	p_kernels.m_select_32bpp_32bpp = select_32bpp_32bpp_scalar;
+	p_kernels.m_select_32bpp_24bpp = select_32bpp_24bpp_scalar;
+	p_kernels.m_blur_rows		 = blur_rows_scalar;
+	p_kernels.m_blur_cols		 = blur_cols_scalar;
+	p_kernels.m_upsample_2x		 = upsample_2x_scalar;
+	p_kernels.m_depth_to_color	 = depth_to_color_scalar;
+}
+
+} // namespace kernels
+
+} // namespace img
@@ -0,0 +1,1115 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	image_kernels_sse2.cpp
+//
+// Purpose	: 	per-row image kernels - SSE2 implementation
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "image_kernels.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#ifdef KW_SIMD_X86
+#include <emmintrin.h>
+#endif // KW_SIMD_X86
+
+namespace img {
+
+namespace kernels {
+
+#ifdef KW_SIMD_X86
+
+namespace {
+
+inline void copy_bytes_sse2(const unsigned char *p_src, unsigned char *p_dst, int p_count)
+{
+	int f_i = 0;
+
+	for (; f_i + 64 <= p_count; f_i += 64)
+	{
+		__m128i f_a = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_src + f_i));
+		__m128i f_b = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_src + f_i + 16));
+		__m128i f_c = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_src + f_i + 32));
+		__m128i f_d = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_src + f_i + 48));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst + f_i), f_a);
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst + f_i + 16), f_b);
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst + f_i + 32), f_c);
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst + f_i + 48), f_d);
+	}
+
+	for (; f_i + 16 <= p_count; f_i += 16)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst + f_i), _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_src + f_i)));
+	}
+
+	for (; f_i < p_count; ++f_i)
+	{
+		p_dst[f_i] = p_src[f_i];
+	}
+}
+
+void copy_32bpp_32bpp_sse2(const unsigned char *p_src, unsigned char *p_dst, int p_width)
+{
+	copy_bytes_sse2(p_src, p_dst, p_width * 4);
+}
+
+void copy_16bpp_16bpp_sse2(const unsigned char *p_src, unsigned char *p_dst, int p_width)
+{
+	copy_bytes_sse2(p_src, p_dst, p_width * 2);
+}
+
+void mask_32bpp_32bpp_sse2(const unsigned char *p_src, const unsigned char *p_mask, unsigned char *p_dst, int p_width)
+{
+	const __m128i f_zero = _mm_setzero_si128();
+	int f_w = 0;
+
+	for (; f_w + 16 <= p_width; f_w += 16)
+	{
+		// replicate each mask byte over the four channels of its pixel
+		__m128i f_m	   = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_mask + f_w));
+		__m128i f_m_lo = _mm_unpacklo_epi8(f_m, f_m);
+		__m128i f_m_hi = _mm_unpackhi_epi8(f_m, f_m);
+
+		__m128i f_q[4] = {	_mm_unpacklo_epi16(f_m_lo, f_m_lo), _mm_unpackhi_epi16(f_m_lo, f_m_lo),
+							_mm_unpacklo_epi16(f_m_hi, f_m_hi), _mm_unpackhi_epi16(f_m_hi, f_m_hi) };
+
+		for (int f_i = 0; f_i < 4; ++f_i)
+		{
+			__m128i f_src  = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_src + (f_w + f_i * 4) * 4));
+			__m128i f_drop = _mm_cmpeq_epi32(f_q[f_i], f_zero);
+			_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst + (f_w + f_i * 4) * 4), _mm_andnot_si128(f_drop, f_src));
+		}
+	}
+
+	mask_32bpp_32bpp_scalar(p_src + f_w * 4, p_mask + f_w, p_dst + f_w * 4, p_width - f_w);
+}
+
+void mask_16bpp_16bpp_sse2(const unsigned char *p_src, const unsigned char *p_mask, unsigned char *p_dst, int p_width)
+{
+	const __m128i f_zero	= _mm_setzero_si128();
+	const __m128i f_luma	= _mm_set1_epi16(0x00ff);
+	const __m128i f_black	= _mm_set1_epi16(static_cast<short> (0x8010));	// Y = 16, U/V = 128
+	int f_w = 0;
+
+	for (; f_w + 8 <= p_width; f_w += 8)
+	{
+		// keep : 0xff for each of the 8 pixels that isn't masked out
+		__m128i f_keep	 = _mm_xor_si128(_mm_cmpeq_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *> (p_mask + f_w)), f_zero),
+										 _mm_set1_epi8(-1));
+
+		// luma : one mask byte per Y-byte
+		__m128i f_keep_y = _mm_unpacklo_epi8(f_keep, f_keep);
+
+		// chroma : or the mask bytes of both pixels in a macropixel and spread it over the 4 bytes
+		__m128i f_keep_c = _mm_and_si128(_mm_or_si128(f_keep, _mm_srli_epi16(f_keep, 8)), f_luma);
+		f_keep_c		 = _mm_or_si128(f_keep_c, _mm_slli_epi16(f_keep_c, 8));
+		f_keep_c		 = _mm_unpacklo_epi16(f_keep_c, f_keep_c);
+
+		__m128i f_keep_all = _mm_or_si128(_mm_and_si128(f_keep_y, f_luma), _mm_andnot_si128(f_luma, f_keep_c));
+
+		__m128i f_src = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_src + f_w * 2));
+		__m128i f_dst = _mm_or_si128(_mm_and_si128(f_keep_all, f_src), _mm_andnot_si128(f_keep_all, f_black));
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst + f_w * 2), f_dst);
+	}
+
+	mask_16bpp_16bpp_scalar(p_src + f_w * 2, p_mask + f_w, p_dst + f_w * 2, p_width - f_w);
+}
+
+// expand 16 mask bytes into 4 registers with all bits set for the masked out pixels (4 pixels each)
+inline void mask_drop_16_sse2(const unsigned char *p_mask, __m128i p_drop[4])
+{
+	const __m128i f_zero = _mm_setzero_si128();
+
+	__m128i f_m	   = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_mask));
+	__m128i f_m_lo = _mm_unpacklo_epi8(f_m, f_m);
+	__m128i f_m_hi = _mm_unpackhi_epi8(f_m, f_m);
+
+	p_drop[0] = _mm_cmpeq_epi32(_mm_unpacklo_epi16(f_m_lo, f_m_lo), f_zero);
+	p_drop[1] = _mm_cmpeq_epi32(_mm_unpackhi_epi16(f_m_lo, f_m_lo), f_zero);
+	p_drop[2] = _mm_cmpeq_epi32(_mm_unpacklo_epi16(f_m_hi, f_m_hi), f_zero);
+	p_drop[3] = _mm_cmpeq_epi32(_mm_unpackhi_epi16(f_m_hi, f_m_hi), f_zero);
+}
+
+// split 8 BGRA pixels into 16-bit blue, green and red vectors
+inline void unpack_bgr_sse2(__m128i p_lo, __m128i p_hi, __m128i &p_b, __m128i &p_g, __m128i &p_r)
+{
+	const __m128i f_ff = _mm_set1_epi32(0xff);
+
+	p_b = _mm_packs_epi32(_mm_and_si128(p_lo, f_ff), _mm_and_si128(p_hi, f_ff));
+	p_g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p_lo, 8), f_ff), _mm_and_si128(_mm_srli_epi32(p_hi, 8), f_ff));
+	p_r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p_lo, 16), f_ff), _mm_and_si128(_mm_srli_epi32(p_hi, 16), f_ff));
+}
+
+// luma of 8 pixels (16-bit) : the weighted sum fits in an unsigned 16-bit value
+inline __m128i bgr_to_y_sse2(__m128i p_b, __m128i p_g, __m128i p_r)
+{
+	__m128i f_sum = _mm_add_epi16(_mm_mullo_epi16(p_r, _mm_set1_epi16(66)), _mm_mullo_epi16(p_g, _mm_set1_epi16(129)));
+	f_sum		  = _mm_add_epi16(f_sum, _mm_mullo_epi16(p_b, _mm_set1_epi16(25)));
+	f_sum		  = _mm_add_epi16(f_sum, _mm_set1_epi16(128));
+
+	return _mm_add_epi16(_mm_srli_epi16(f_sum, 8), _mm_set1_epi16(16));
+}
+
+// chroma of 8 pixels (16-bit) : the weighted sums fit in a signed 16-bit value
+inline __m128i bgr_to_chroma_sse2(__m128i p_b, __m128i p_g, __m128i p_r, short p_cr, short p_cg, short p_cb)
+{
+	__m128i f_sum = _mm_add_epi16(_mm_mullo_epi16(p_r, _mm_set1_epi16(p_cr)), _mm_mullo_epi16(p_g, _mm_set1_epi16(p_cg)));
+	f_sum		  = _mm_add_epi16(f_sum, _mm_mullo_epi16(p_b, _mm_set1_epi16(p_cb)));
+	f_sum		  = _mm_add_epi16(f_sum, _mm_set1_epi16(128));
+
+	return _mm_add_epi16(_mm_srai_epi16(f_sum, 8), _mm_set1_epi16(128));
+}
+
+// add horizontally adjacent 16-bit values : 8 + 8 values in, 8 sums out
+inline __m128i pair_sum_sse2(__m128i p_a, __m128i p_b)
+{
+	const __m128i f_lo = _mm_set1_epi32(0xffff);
+
+	__m128i f_a = _mm_add_epi32(_mm_and_si128(p_a, f_lo), _mm_srli_epi32(p_a, 16));
+	__m128i f_b = _mm_add_epi32(_mm_and_si128(p_b, f_lo), _mm_srli_epi32(p_b, 16));
+
+	return _mm_packs_epi32(f_a, f_b);
+}
+
+// average of the 2x2 blocks of 16 pixels in two rows (8 results)
+inline __m128i block_average_sse2(__m128i p_r0_lo, __m128i p_r0_hi, __m128i p_r1_lo, __m128i p_r1_hi)
+{
+	__m128i f_sum = pair_sum_sse2(_mm_add_epi16(p_r0_lo, p_r1_lo), _mm_add_epi16(p_r0_hi, p_r1_hi));
+	return _mm_srli_epi16(_mm_add_epi16(f_sum, _mm_set1_epi16(2)), 2);
+}
+
+inline void store_chroma_sse2(unsigned char *p_dst_u, unsigned char *p_dst_v, bool p_nv12, __m128i p_u, __m128i p_v)
+{
+	// p_u and p_v hold 8 values in their low 8 bytes
+	if (p_nv12)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst_u), _mm_unpacklo_epi8(p_u, p_v));
+	}
+	else
+	{
+		_mm_storel_epi64(reinterpret_cast<__m128i *> (p_dst_u), p_u);
+		_mm_storel_epi64(reinterpret_cast<__m128i *> (p_dst_v), p_v);
+	}
+}
+
+template <bool t_nv12, bool t_mask>
+void bgra_to_yuv420_sse2(KW_PLANAR_ROW_ARGS)
+{
+	int f_x = 0;
+
+	for (; f_x + 16 <= p_width; f_x += 16)
+	{
+		__m128i f_px[2][4];
+		__m128i f_b[2][2], f_g[2][2], f_r[2][2];
+
+		for (int f_row = 0; f_row < 2; ++f_row)
+		{
+			const __m128i *f_src = reinterpret_cast<const __m128i *> ((f_row == 0 ? p_src_0 : p_src_1) + f_x * 4);
+
+			for (int f_i = 0; f_i < 4; ++f_i)
+				f_px[f_row][f_i] = _mm_loadu_si128(f_src + f_i);
+
+			if (t_mask)
+			{
+				__m128i f_drop[4];
+				mask_drop_16_sse2((f_row == 0 ? p_mask_0 : p_mask_1) + f_x, f_drop);
+
+				for (int f_i = 0; f_i < 4; ++f_i)
+					f_px[f_row][f_i] = _mm_andnot_si128(f_drop[f_i], f_px[f_row][f_i]);
+			}
+
+			unpack_bgr_sse2(f_px[f_row][0], f_px[f_row][1], f_b[f_row][0], f_g[f_row][0], f_r[f_row][0]);
+			unpack_bgr_sse2(f_px[f_row][2], f_px[f_row][3], f_b[f_row][1], f_g[f_row][1], f_r[f_row][1]);
+
+			__m128i f_y = _mm_packus_epi16(	bgr_to_y_sse2(f_b[f_row][0], f_g[f_row][0], f_r[f_row][0]),
+											bgr_to_y_sse2(f_b[f_row][1], f_g[f_row][1], f_r[f_row][1]));
+			_mm_storeu_si128(reinterpret_cast<__m128i *> ((f_row == 0 ? p_dst_y_0 : p_dst_y_1) + f_x), f_y);
+		}
+
+		__m128i f_b_avg = block_average_sse2(f_b[0][0], f_b[0][1], f_b[1][0], f_b[1][1]);
+		__m128i f_g_avg = block_average_sse2(f_g[0][0], f_g[0][1], f_g[1][0], f_g[1][1]);
+		__m128i f_r_avg = block_average_sse2(f_r[0][0], f_r[0][1], f_r[1][0], f_r[1][1]);
+
+		__m128i f_u = bgr_to_chroma_sse2(f_b_avg, f_g_avg, f_r_avg, -38, -74, 112);
+		__m128i f_v = bgr_to_chroma_sse2(f_b_avg, f_g_avg, f_r_avg, 112, -94, -18);
+
+		store_chroma_sse2(	t_nv12 ? p_dst_u + f_x : p_dst_u + f_x / 2, p_dst_v + f_x / 2, t_nv12,
+							_mm_packus_epi16(f_u, f_u), _mm_packus_epi16(f_v, f_v));
+	}
+
+	const PlanarRowFunc f_tail = t_nv12 ? (t_mask ? mask_32bpp_nv12_scalar : copy_32bpp_nv12_scalar)
+										: (t_mask ? mask_32bpp_i420_scalar : copy_32bpp_i420_scalar);
+	planar_row_tail(f_tail, 4, t_nv12, p_src_0, p_src_1, p_mask_0, p_mask_1, p_dst_y_0, p_dst_y_1, p_dst_u, p_dst_v, p_width, f_x);
+}
+
+template <bool t_nv12, bool t_mask>
+void yuy2_to_yuv420_sse2(KW_PLANAR_ROW_ARGS)
+{
+	const __m128i f_zero  = _mm_setzero_si128();
+	const __m128i f_ones  = _mm_set1_epi8(-1);
+	const __m128i f_lo	  = _mm_set1_epi16(0x00ff);
+	const __m128i f_black = _mm_set1_epi8(16);
+	const __m128i f_grey  = _mm_set1_epi8(static_cast<char> (128));
+	int f_x = 0;
+
+	for (; f_x + 16 <= p_width; f_x += 16)
+	{
+		const __m128i *f_src_0 = reinterpret_cast<const __m128i *> (p_src_0 + f_x * 2);
+		const __m128i *f_src_1 = reinterpret_cast<const __m128i *> (p_src_1 + f_x * 2);
+
+		__m128i f_s00 = _mm_loadu_si128(f_src_0), f_s01 = _mm_loadu_si128(f_src_0 + 1);
+		__m128i f_s10 = _mm_loadu_si128(f_src_1), f_s11 = _mm_loadu_si128(f_src_1 + 1);
+
+		// luma : the even bytes
+		__m128i f_y0 = _mm_packus_epi16(_mm_and_si128(f_s00, f_lo), _mm_and_si128(f_s01, f_lo));
+		__m128i f_y1 = _mm_packus_epi16(_mm_and_si128(f_s10, f_lo), _mm_and_si128(f_s11, f_lo));
+
+		// chroma : the odd bytes (U0 V0 U1 V1 ...) averaged over both rows
+		__m128i f_uv = _mm_avg_epu8(_mm_packus_epi16(_mm_srli_epi16(f_s00, 8), _mm_srli_epi16(f_s01, 8)),
+									_mm_packus_epi16(_mm_srli_epi16(f_s10, 8), _mm_srli_epi16(f_s11, 8)));
+
+		if (t_mask)
+		{
+			__m128i f_keep_0 = _mm_xor_si128(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *> (p_mask_0 + f_x)), f_zero), f_ones);
+			__m128i f_keep_1 = _mm_xor_si128(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *> (p_mask_1 + f_x)), f_zero), f_ones);
+
+			f_y0 = _mm_or_si128(_mm_and_si128(f_keep_0, f_y0), _mm_andnot_si128(f_keep_0, f_black));
+			f_y1 = _mm_or_si128(_mm_and_si128(f_keep_1, f_y1), _mm_andnot_si128(f_keep_1, f_black));
+
+			// chroma is kept when any pixel of the 2x2 block is kept
+			__m128i f_keep_c = _mm_or_si128(f_keep_0, f_keep_1);
+			f_keep_c		 = _mm_and_si128(_mm_or_si128(f_keep_c, _mm_srli_epi16(f_keep_c, 8)), f_lo);
+			f_keep_c		 = _mm_or_si128(f_keep_c, _mm_slli_epi16(f_keep_c, 8));
+
+			f_uv = _mm_or_si128(_mm_and_si128(f_keep_c, f_uv), _mm_andnot_si128(f_keep_c, f_grey));
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst_y_0 + f_x), f_y0);
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst_y_1 + f_x), f_y1);
+
+		if (t_nv12)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst_u + f_x), f_uv);
+		}
+		else
+		{
+			_mm_storel_epi64(reinterpret_cast<__m128i *> (p_dst_u + f_x / 2), _mm_packus_epi16(_mm_and_si128(f_uv, f_lo), f_zero));
+			_mm_storel_epi64(reinterpret_cast<__m128i *> (p_dst_v + f_x / 2), _mm_packus_epi16(_mm_srli_epi16(f_uv, 8), f_zero));
+		}
+	}
+
+	const PlanarRowFunc f_tail = t_nv12 ? (t_mask ? mask_16bpp_nv12_scalar : copy_16bpp_nv12_scalar)
+										: (t_mask ? mask_16bpp_i420_scalar : copy_16bpp_i420_scalar);
+	planar_row_tail(f_tail, 2, t_nv12, p_src_0, p_src_1, p_mask_0, p_mask_1, p_dst_y_0, p_dst_y_1, p_dst_u, p_dst_v, p_width, f_x);
+}
+
+// a pair of Q14 weights in each 32 bit lane, as expected by _mm_madd_epi16
+inline __m128i weight_pair_sse2(const short *p_weights)
+{
+	return _mm_set1_epi32((p_weights[0] & 0xffff) | (p_weights[1] << 16));
+}
+
+void scale_rows_sse2(const unsigned char *const *p_src, const short *p_weights, int p_taps, short *p_dst, int p_count)
+{
+	const __m128i f_zero  = _mm_setzero_si128();
+	const __m128i f_round = _mm_set1_epi32(1 << 6);
+	int f_i = 0;
+
+	for (; f_i + 16 <= p_count; f_i += 16)
+	{
+		__m128i f_acc0 = f_round, f_acc1 = f_round, f_acc2 = f_round, f_acc3 = f_round;
+
+		// two rows at a time : interleave the samples of both rows so madd weighs and adds them in one go
+		for (int f_t = 0; f_t < p_taps; f_t += 2)
+		{
+			const __m128i f_w = weight_pair_sse2(p_weights + f_t);
+			const __m128i f_a = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_src[f_t] + f_i));
+			const __m128i f_b = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_src[f_t + 1] + f_i));
+
+			const __m128i f_a_lo = _mm_unpacklo_epi8(f_a, f_zero);
+			const __m128i f_a_hi = _mm_unpackhi_epi8(f_a, f_zero);
+			const __m128i f_b_lo = _mm_unpacklo_epi8(f_b, f_zero);
+			const __m128i f_b_hi = _mm_unpackhi_epi8(f_b, f_zero);
+
+			f_acc0 = _mm_add_epi32(f_acc0, _mm_madd_epi16(_mm_unpacklo_epi16(f_a_lo, f_b_lo), f_w));
+			f_acc1 = _mm_add_epi32(f_acc1, _mm_madd_epi16(_mm_unpackhi_epi16(f_a_lo, f_b_lo), f_w));
+			f_acc2 = _mm_add_epi32(f_acc2, _mm_madd_epi16(_mm_unpacklo_epi16(f_a_hi, f_b_hi), f_w));
+			f_acc3 = _mm_add_epi32(f_acc3, _mm_madd_epi16(_mm_unpackhi_epi16(f_a_hi, f_b_hi), f_w));
+		}
+
+		const __m128i f_lo = _mm_packs_epi32(_mm_srai_epi32(f_acc0, 7), _mm_srai_epi32(f_acc1, 7));
+		const __m128i f_hi = _mm_packs_epi32(_mm_srai_epi32(f_acc2, 7), _mm_srai_epi32(f_acc3, 7));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst + f_i), f_lo);
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst + f_i + 8), f_hi);
+	}
+
+	scale_rows_tail(p_src, p_weights, p_taps, p_dst, f_i, p_count);
+}
+
+void scale_cols_32bpp_sse2(const short *p_src, const ScaleTaps &p_luma, const ScaleTaps &, unsigned char *p_dst, int p_width)
+{
+	const __m128i f_round = _mm_set1_epi32(1 << 20);
+
+	for (int f_x = 0; f_x < p_width; ++f_x)
+	{
+		const short *f_src	   = p_src + (p_luma.m_offset[f_x] * 4);
+		const short *f_weights = p_luma.m_weights + (f_x * p_luma.m_taps);
+		__m128i		 f_acc	   = f_round;
+
+		// two source pixels per step : (c0 c0' c1 c1' c2 c2' c3 c3') * (w w' ...) gives the four channels
+		for (int f_t = 0; f_t < p_luma.m_taps; f_t += 2)
+		{
+			const __m128i f_px = _mm_loadu_si128(reinterpret_cast<const __m128i *> (f_src + (f_t * 4)));
+			f_acc = _mm_add_epi32(f_acc, _mm_madd_epi16(_mm_unpacklo_epi16(f_px, _mm_srli_si128(f_px, 8)), weight_pair_sse2(f_weights + f_t)));
+		}
+
+		f_acc = _mm_srai_epi32(f_acc, 21);
+		f_acc = _mm_packs_epi32(f_acc, f_acc);
+		f_acc = _mm_packus_epi16(f_acc, f_acc);
+
+		const int f_pixel = _mm_cvtsi128_si32(f_acc);
+		std::memcpy(p_dst + (f_x * 4), &f_pixel, 4);
+	}
+}
+
+// the matte bytes of 4 pixels, each replicated over the four channels of its pixel
+inline __m128i matte_4px_sse2(const unsigned char *p_mask)
+{
+	int f_m4;
+	std::memcpy(&f_m4, p_mask, 4);
+	__m128i f_m = _mm_cvtsi32_si128(f_m4);
+	f_m			= _mm_unpacklo_epi8(f_m, f_m);
+	return _mm_unpacklo_epi16(f_m, f_m);
+}
+
+// c * a / 255 (rounded) for the 16 bytes of 4 pixels : t = c * a + 128, (t + (t >> 8)) >> 8
+inline __m128i premultiply_4px_sse2(const unsigned char *p_src, __m128i p_matte)
+{
+	const __m128i f_zero  = _mm_setzero_si128();
+	const __m128i f_round = _mm_set1_epi16(128);
+
+	__m128i f_src = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_src));
+	__m128i f_lo  = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(f_src, f_zero), _mm_unpacklo_epi8(p_matte, f_zero)), f_round);
+	__m128i f_hi  = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(f_src, f_zero), _mm_unpackhi_epi8(p_matte, f_zero)), f_round);
+	f_lo		  = _mm_srli_epi16(_mm_add_epi16(f_lo, _mm_srli_epi16(f_lo, 8)), 8);
+	f_hi		  = _mm_srli_epi16(_mm_add_epi16(f_hi, _mm_srli_epi16(f_hi, 8)), 8);
+
+	return _mm_packus_epi16(f_lo, f_hi);
+}
+
+// drop the alpha channel of 4 pixels without pshufb : 12 packed bytes in the low part of the register
+inline __m128i pack_bgr_sse2(__m128i p_bgra)
+{
+	// two pixels per 64 bit half : the second pixel moves down one byte, next to the first (six bytes, then zeros)
+	const __m128i f_first  = _mm_set_epi32(0, 0x00ffffff, 0, 0x00ffffff);
+	const __m128i f_second = _mm_set_epi32(0x0000ffff, static_cast<int> (0xff000000), 0x0000ffff, static_cast<int> (0xff000000));
+	const __m128i f_halves = _mm_or_si128(_mm_and_si128(p_bgra, f_first), _mm_and_si128(_mm_srli_epi64(p_bgra, 8), f_second));
+
+	// the six bytes of the high half move down two bytes, next to the low half
+	const __m128i f_low	   = _mm_set_epi32(0, 0, -1, -1);
+	return _mm_or_si128(_mm_and_si128(f_halves, f_low), _mm_srli_si128(_mm_andnot_si128(f_low, f_halves), 2));
+}
+
+// join four registers with 12 valid bytes each (and zeros above them) into three registers of 48 consecutive bytes
+inline void join_packed_bgr_sse2(__m128i p_s0, __m128i p_s1, __m128i p_s2, __m128i p_s3, __m128i p_out[3])
+{
+	p_out[0] = _mm_or_si128(p_s0, _mm_slli_si128(p_s1, 12));
+	p_out[1] = _mm_or_si128(_mm_srli_si128(p_s1, 4), _mm_slli_si128(p_s2, 8));
+	p_out[2] = _mm_or_si128(_mm_srli_si128(p_s2, 8), _mm_slli_si128(p_s3, 4));
+}
+
+inline void store_packed_bgr_sse2(unsigned char *p_dst, __m128i p_s0, __m128i p_s1, __m128i p_s2, __m128i p_s3)
+{
+	__m128i f_out[3];
+	join_packed_bgr_sse2(p_s0, p_s1, p_s2, p_s3, f_out);
+
+	for (int f_i = 0; f_i < 3; ++f_i)
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst) + f_i, f_out[f_i]);
+}
+
+void matte_32bpp_32bpp_sse2(const unsigned char *p_src, const unsigned char *p_mask, unsigned char *p_dst, int p_width)
+{
+	const __m128i f_alpha = _mm_set1_epi32(static_cast<int> (0xff000000));
+	int f_w = 0;
+
+	for (; f_w + 4 <= p_width; f_w += 4)
+	{
+		const __m128i f_m	= matte_4px_sse2(p_mask + f_w);
+		const __m128i f_dst = premultiply_4px_sse2(p_src + f_w * 4, f_m);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst + f_w * 4), _mm_or_si128(_mm_andnot_si128(f_alpha, f_dst), _mm_and_si128(f_alpha, f_m)));
+	}
+
+	matte_32bpp_32bpp_scalar(p_src + f_w * 4, p_mask + f_w, p_dst + f_w * 4, p_width - f_w);
+}
+
+void matte_32bpp_24bpp_sse2(const unsigned char *p_src, const unsigned char *p_mask, unsigned char *p_dst, int p_width)
+{
+	int f_w = 0;
+
+	for (; f_w + 16 <= p_width; f_w += 16)
+	{
+		const unsigned char *f_src	= p_src + f_w * 4;
+		const unsigned char *f_mask = p_mask + f_w;
+
+		store_packed_bgr_sse2(	p_dst + f_w * 3,
+								pack_bgr_sse2(premultiply_4px_sse2(f_src, matte_4px_sse2(f_mask))),
+								pack_bgr_sse2(premultiply_4px_sse2(f_src + 16, matte_4px_sse2(f_mask + 4))),
+								pack_bgr_sse2(premultiply_4px_sse2(f_src + 32, matte_4px_sse2(f_mask + 8))),
+								pack_bgr_sse2(premultiply_4px_sse2(f_src + 48, matte_4px_sse2(f_mask + 12))));
+	}
+
+	matte_32bpp_24bpp_scalar(p_src + f_w * 4, p_mask + f_w, p_dst + f_w * 3, p_width - f_w);
+}
+
+void matte_min_sse2(const unsigned char *p_a, const unsigned char *p_b, const unsigned char *p_c, unsigned char *p_dst, int p_count)
+{
+	int f_i = 0;
+
+	for (; f_i + 16 <= p_count; f_i += 16)
+	{
+		__m128i f_a = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_a + f_i));
+		__m128i f_b = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_b + f_i));
+		__m128i f_c = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_c + f_i));
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst + f_i), _mm_min_epu8(_mm_min_epu8(f_a, f_b), f_c));
+	}
+
+	matte_min_scalar(p_a + f_i, p_b + f_i, p_c + f_i, p_dst + f_i, p_count - f_i);
+}
+
+void matte_max_sse2(const unsigned char *p_a, const unsigned char *p_b, const unsigned char *p_c, unsigned char *p_dst, int p_count)
+{
+	int f_i = 0;
+
+	for (; f_i + 16 <= p_count; f_i += 16)
+	{
+		__m128i f_a = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_a + f_i));
+		__m128i f_b = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_b + f_i));
+		__m128i f_c = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_c + f_i));
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst + f_i), _mm_max_epu8(_mm_max_epu8(f_a, f_b), f_c));
+	}
+
+	matte_max_scalar(p_a + f_i, p_b + f_i, p_c + f_i, p_dst + f_i, p_count - f_i);
+}
+
+void matte_slide_sse2(unsigned short *p_sums, const unsigned char *p_add, const unsigned char *p_sub, int p_count)
+{
+	const __m128i f_zero = _mm_setzero_si128();
+	int f_i = 0;
+
+	for (; f_i + 8 <= p_count; f_i += 8)
+	{
+		__m128i f_add  = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *> (p_add + f_i)), f_zero);
+		__m128i f_sub  = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *> (p_sub + f_i)), f_zero);
+		__m128i f_sums = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_sums + f_i));
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (p_sums + f_i), _mm_sub_epi16(_mm_add_epi16(f_sums, f_add), f_sub));
+	}
+
+	matte_slide_scalar(p_sums + f_i, p_add + f_i, p_sub + f_i, p_count - f_i);
+}
+
+void matte_feather_sse2(const unsigned short *p_sums, int p_radius, int p_recip, int p_weight, unsigned char *p_matte, int p_count)
+{
+	// the reciprocal of a window of one sum (65536) doesn't fit in 16 bits
+	if (p_recip > 0xffff)
+	{
+		matte_feather_scalar(p_sums, p_radius, p_recip, p_weight, p_matte, p_count);
+		return;
+	}
+
+	const __m128i f_zero	= _mm_setzero_si128();
+	const __m128i f_recip	= _mm_set1_epi16(static_cast<short> (p_recip));
+	const __m128i f_weight	= _mm_set1_epi16(static_cast<short> (p_weight));
+	const __m128i f_max		= _mm_set1_epi16(255);
+	const __m128i f_round	= _mm_set1_epi16(64);
+	int f_i = 0;
+
+	for (; f_i + 8 <= p_count; f_i += 8)
+	{
+		// the box sums fit in 16 bits (see keying::SoftMatte)
+		__m128i f_box = f_zero;
+
+		for (int f_t = -p_radius; f_t <= p_radius; ++f_t)
+			f_box = _mm_add_epi16(f_box, _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_sums + f_i + f_t)));
+
+		__m128i f_value = _mm_min_epi16(_mm_mulhi_epu16(f_box, f_recip), f_max);
+		__m128i f_prev	= _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *> (p_matte + f_i)), f_zero);
+		__m128i f_delta = _mm_srai_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(f_value, f_prev), f_weight), f_round), 7);
+
+		_mm_storel_epi64(reinterpret_cast<__m128i *> (p_matte + f_i), _mm_packus_epi16(_mm_add_epi16(f_prev, f_delta), f_zero));
+	}
+
+	matte_feather_scalar(p_sums + f_i, p_radius, p_recip, p_weight, p_matte + f_i, p_count - f_i);
+}
+
+// x > -1 && x < p_limit for 4 coordinates (the float to int conversion returns INT_MIN for values that don't fit)
+inline __m128i inside_sse2(__m128i p_x, __m128i p_limit)
+{
+	return _mm_and_si128(_mm_cmpgt_epi32(p_x, _mm_set1_epi32(-1)), _mm_cmplt_epi32(p_x, p_limit));
+}
+
+// the index of 4 depth pixels : zero for the positions outside of the depth frame
+inline __m128i depth_index_sse2(__m128i p_x, __m128i p_y, __m128i p_inside, int p_depth_width)
+{
+	// the coordinates of the pixels inside the frame fit in 16 bits : madd does the multiplication
+	const __m128i f_y = _mm_madd_epi16(_mm_and_si128(p_y, p_inside), _mm_set1_epi32(p_depth_width));
+	return _mm_add_epi32(f_y, _mm_and_si128(p_x, p_inside));
+}
+
+// the x and y coordinates of 4 points, truncated to int
+inline void depth_points_sse2(const float *p_points, __m128i &p_x, __m128i &p_y)
+{
+	const __m128 f_a = _mm_loadu_ps(p_points);
+	const __m128 f_b = _mm_loadu_ps(p_points + 4);
+
+	p_x = _mm_cvttps_epi32(_mm_shuffle_ps(f_a, f_b, _MM_SHUFFLE(2, 0, 2, 0)));
+	p_y = _mm_cvttps_epi32(_mm_shuffle_ps(f_a, f_b, _MM_SHUFFLE(3, 1, 3, 1)));
+}
+
+void body_lookup_float_sse2(const float *p_points, const unsigned char *p_labels, int p_depth_width, int p_depth_height, unsigned char *p_mask, int p_count)
+{
+	const __m128i f_width  = _mm_set1_epi32(p_depth_width);
+	const __m128i f_height = _mm_set1_epi32(p_depth_height);
+	const __m128i f_byte   = _mm_set1_epi32(0xff);
+	int f_i = 0;
+
+	for (; f_i + 8 <= p_count; f_i += 8)
+	{
+		__m128i f_x[2], f_y[2], f_inside[2];
+		alignas(16) int f_idx[8];
+
+		for (int f_h = 0; f_h < 2; ++f_h)
+		{
+			depth_points_sse2(p_points + ((f_i + (f_h * 4)) * 2), f_x[f_h], f_y[f_h]);
+			f_inside[f_h] = _mm_and_si128(inside_sse2(f_x[f_h], f_width), inside_sse2(f_y[f_h], f_height));
+			_mm_store_si128(reinterpret_cast<__m128i *> (f_idx + (f_h * 4)), depth_index_sse2(f_x[f_h], f_y[f_h], f_inside[f_h], p_depth_width));
+		}
+
+		// no gather instruction : the lookups themselves are scalar, the labels are compared and packed as vectors
+		const __m128i f_lo = _mm_setr_epi32(p_labels[f_idx[0]], p_labels[f_idx[1]], p_labels[f_idx[2]], p_labels[f_idx[3]]);
+		const __m128i f_hi = _mm_setr_epi32(p_labels[f_idx[4]], p_labels[f_idx[5]], p_labels[f_idx[6]], p_labels[f_idx[7]]);
+		const __m128i f_words = _mm_packs_epi32(_mm_andnot_si128(_mm_cmpeq_epi32(f_lo, f_byte), f_inside[0]),
+												_mm_andnot_si128(_mm_cmpeq_epi32(f_hi, f_byte), f_inside[1]));
+
+		_mm_storel_epi64(reinterpret_cast<__m128i *> (p_mask + f_i), _mm_packs_epi16(f_words, f_words));
+	}
+
+	body_lookup_float_scalar(p_points + (f_i * 2), p_labels, p_depth_width, p_depth_height, p_mask + f_i, p_count - f_i);
+}
+
+void depth_window_sse2(const unsigned short *p_depth, const unsigned char *p_body_index, int p_near, int p_far, unsigned char *p_labels, int p_count)
+{
+	// depth - near wraps around below the range : inside when (depth - near) <= (far - near), as unsigned 16 bit values
+	const __m128i f_near = _mm_set1_epi16(static_cast<short> (p_near));
+	const __m128i f_span = _mm_set1_epi16(static_cast<short> (p_far - p_near));
+	const __m128i f_zero = _mm_setzero_si128();
+	const __m128i f_ones = _mm_set1_epi8(-1);
+	int f_i = 0;
+
+	for (; f_i + 16 <= p_count; f_i += 16)
+	{
+		const __m128i f_d0 = _mm_sub_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *> (p_depth + f_i)), f_near);
+		const __m128i f_d1 = _mm_sub_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *> (p_depth + f_i + 8)), f_near);
+		const __m128i f_in = _mm_packs_epi16(	_mm_cmpeq_epi16(_mm_subs_epu16(f_d0, f_span), f_zero),
+												_mm_cmpeq_epi16(_mm_subs_epu16(f_d1, f_span), f_zero));
+
+		// outside the range : 0xff, inside : the body index (or 0)
+		__m128i f_labels = _mm_xor_si128(f_in, f_ones);
+
+		if (p_body_index)
+			f_labels = _mm_or_si128(f_labels, _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_body_index + f_i)));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (p_labels + f_i), f_labels);
+	}
+
+	depth_window_scalar(p_depth + f_i, p_body_index ? p_body_index + f_i : nullptr, p_near, p_far, p_labels + f_i, p_count - f_i);
+}
+
+void depth_window_packed_sse2(const unsigned int *p_pixels, bool p_player_index, int p_near, int p_far, unsigned int *p_labels, int p_count)
+{
+	// the depth fits in 16 bits : (depth - near) as a 32 bit value can be compared signed
+	const __m128i f_near = _mm_set1_epi32(p_near);
+	const __m128i f_span = _mm_set1_epi32(p_far - p_near);
+	const __m128i f_low	 = _mm_set1_epi32(0xffff);
+	const __m128i f_zero = _mm_setzero_si128();
+	int f_i = 0;
+
+	for (; f_i + 4 <= p_count; f_i += 4)
+	{
+		const __m128i f_pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_pixels + f_i));
+		const __m128i f_delta  = _mm_sub_epi32(_mm_srli_epi32(f_pixels, 16), f_near);
+		__m128i		  f_keep   = _mm_andnot_si128(_mm_cmpgt_epi32(f_delta, f_span), _mm_cmpgt_epi32(f_delta, _mm_set1_epi32(-1)));
+
+		if (p_player_index)
+			f_keep = _mm_andnot_si128(_mm_cmpeq_epi32(_mm_and_si128(f_pixels, f_low), f_zero), f_keep);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (p_labels + f_i), _mm_srli_epi32(f_keep, 31));
+	}
+
+	depth_window_packed_scalar(p_pixels + f_i, p_player_index, p_near, p_far, p_labels + f_i, p_count - f_i);
+}
+
+// blend 4 pixels with the background (p_mask : the 4 mask values in the low bytes)
+inline __m128i background_4px_sse2(__m128i p_background, __m128i p_mask, __m128i p_dst)
+{
+	const __m128i f_zero  = _mm_setzero_si128();
+	const __m128i f_round = _mm_set1_epi16(128);
+
+	// replicate the inverse of each mask byte over the four channels of its pixel
+	__m128i f_m = _mm_xor_si128(p_mask, _mm_set1_epi8(-1));
+	f_m			= _mm_unpacklo_epi8(f_m, f_m);
+	f_m			= _mm_unpacklo_epi16(f_m, f_m);
+
+	// c * a / 255 (rounded) : t = c * a + 128, (t + (t >> 8)) >> 8
+	__m128i f_lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(p_background, f_zero), _mm_unpacklo_epi8(f_m, f_zero)), f_round);
+	__m128i f_hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(p_background, f_zero), _mm_unpackhi_epi8(f_m, f_zero)), f_round);
+	f_lo		 = _mm_srli_epi16(_mm_add_epi16(f_lo, _mm_srli_epi16(f_lo, 8)), 8);
+	f_hi		 = _mm_srli_epi16(_mm_add_epi16(f_hi, _mm_srli_epi16(f_hi, 8)), 8);
+
+	return _mm_add_epi8(p_dst, _mm_packus_epi16(f_lo, f_hi));
+}
+
+void background_32bpp_sse2(const unsigned char *p_background, const unsigned char *p_mask, unsigned char *p_dst, int p_width)
+{
+	const __m128i f_zero = _mm_setzero_si128();
+	int f_w = 0;
+
+	for (; f_w + 16 <= p_width; f_w += 16)
+	{
+		const __m128i f_m	 = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_mask + f_w));
+		const int	  f_kept = _mm_movemask_epi8(_mm_cmpeq_epi8(f_m, _mm_set1_epi8(-1)));
+		const int	  f_out	 = _mm_movemask_epi8(_mm_cmpeq_epi8(f_m, f_zero));
+
+		// hard masks : most groups are completely kept (nothing to do) or completely masked out (the row is black there)
+		if (f_kept == 0xffff)
+			continue;
+
+		const __m128i *f_bg	 = reinterpret_cast<const __m128i *> (p_background + f_w * 4);
+		__m128i *	   f_dst = reinterpret_cast<__m128i *> (p_dst + f_w * 4);
+
+		if (f_out == 0xffff)
+		{
+			for (int f_i = 0; f_i < 4; ++f_i)
+				_mm_storeu_si128(f_dst + f_i, _mm_loadu_si128(f_bg + f_i));
+			continue;
+		}
+
+		__m128i f_rest = f_m;
+
+		for (int f_i = 0; f_i < 4; ++f_i, f_rest = _mm_srli_si128(f_rest, 4))
+			_mm_storeu_si128(f_dst + f_i, background_4px_sse2(_mm_loadu_si128(f_bg + f_i), f_rest, _mm_loadu_si128(f_dst + f_i)));
+	}
+
+	for (; f_w + 4 <= p_width; f_w += 4)
+	{
+		int f_m4;
+		std::memcpy(&f_m4, p_mask + f_w, 4);
+
+		const __m128i f_bg	= _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_background + f_w * 4));
+		__m128i *	  f_dst = reinterpret_cast<__m128i *> (p_dst + f_w * 4);
+
+		_mm_storeu_si128(f_dst, background_4px_sse2(f_bg, _mm_cvtsi32_si128(f_m4), _mm_loadu_si128(f_dst)));
+	}
+
+	background_32bpp_scalar(p_background + f_w * 4, p_mask + f_w, p_dst + f_w * 4, p_width - f_w);
+}
+
+void background_24bpp_sse2(const unsigned char *p_background, const unsigned char *p_mask, unsigned char *p_dst, int p_width)
+{
+	const __m128i f_zero = _mm_setzero_si128();
+	int f_w = 0;
+
+	// there is no cheap way to spread the mask over 3 byte pixels : only the groups of 16 pixels that are
+	// completely kept or completely masked out are handled here, the edges of the mask go through the scalar kernel
+	for (; f_w + 16 <= p_width; f_w += 16)
+	{
+		const __m128i f_m	 = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_mask + f_w));
+		const int	  f_kept = _mm_movemask_epi8(_mm_cmpeq_epi8(f_m, _mm_set1_epi8(-1)));
+		const int	  f_out	 = _mm_movemask_epi8(_mm_cmpeq_epi8(f_m, f_zero));
+
+		if (f_kept == 0xffff)
+			continue;
+
+		if (f_out == 0xffff)
+		{
+			std::memcpy(p_dst + f_w * 3, p_background + f_w * 3, 16 * 3);
+			continue;
+		}
+
+		background_24bpp_scalar(p_background + f_w * 3, p_mask + f_w, p_dst + f_w * 3, 16);
+	}
+
+	background_24bpp_scalar(p_background + f_w * 3, p_mask + f_w, p_dst + f_w * 3, p_width - f_w);
+}
+
+// p_dst = (p_select) ? p_background : p_dst
+inline __m128i select_sse2(__m128i p_select, __m128i p_background, __m128i p_dst)
+{
+	return _mm_or_si128(_mm_and_si128(p_select, p_background), _mm_andnot_si128(p_select, p_dst));
+}
+
+// the pixels of a group of 16 the mask drops (a bit per pixel)
+inline int mask_dropped_16_sse2(const unsigned char *p_mask)
+{
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *> (p_mask)), _mm_setzero_si128()));
+}
+
+void select_32bpp_32bpp_sse2(const unsigned char *p_src, const unsigned char *p_mask, const unsigned char *p_background, unsigned char *p_dst, int p_width)
+{
+	int f_w = 0;
+
+	for (; f_w + 16 <= p_width; f_w += 16)
+	{
+		const __m128i *f_src = reinterpret_cast<const __m128i *> (p_src + f_w * 4);
+		const __m128i *f_bg	 = reinterpret_cast<const __m128i *> (p_background + f_w * 4);
+		__m128i *	   f_dst = reinterpret_cast<__m128i *> (p_dst + f_w * 4);
+		const int	   f_out = mask_dropped_16_sse2(p_mask + f_w);
+
+		// hard masks : most groups are completely kept or completely dropped, only one of the inputs is read
+		if (f_out == 0 || f_out == 0xffff)
+		{
+			const __m128i *f_from = (f_out == 0) ? f_src : f_bg;
+
+			for (int f_i = 0; f_i < 4; ++f_i)
+				_mm_storeu_si128(f_dst + f_i, _mm_loadu_si128(f_from + f_i));
+
+			continue;
+		}
+
+		__m128i f_drop[4];
+		mask_drop_16_sse2(p_mask + f_w, f_drop);
+
+		for (int f_i = 0; f_i < 4; ++f_i)
+			_mm_storeu_si128(f_dst + f_i, select_sse2(f_drop[f_i], _mm_loadu_si128(f_bg + f_i), _mm_loadu_si128(f_src + f_i)));
+	}
+
+	select_32bpp_32bpp_scalar(p_src + f_w * 4, p_mask + f_w, p_background + f_w * 4, p_dst + f_w * 4, p_width - f_w);
+}
+
+void select_32bpp_24bpp_sse2(const unsigned char *p_src, const unsigned char *p_mask, const unsigned char *p_background, unsigned char *p_dst, int p_width)
+{
+	int f_w = 0;
+
+	for (; f_w + 16 <= p_width; f_w += 16)
+	{
+		const unsigned char *f_src = p_src + f_w * 4;
+		const int			 f_out = mask_dropped_16_sse2(p_mask + f_w);
+
+		if (f_out == 0xffff)
+		{
+			std::memcpy(p_dst + f_w * 3, p_background + f_w * 3, 16 * 3);
+			continue;
+		}
+
+		__m128i f_px[3];
+		join_packed_bgr_sse2(	pack_bgr_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *> (f_src))),
+								pack_bgr_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *> (f_src + 16))),
+								pack_bgr_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *> (f_src + 32))),
+								pack_bgr_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *> (f_src + 48))), f_px);
+
+		// the edges of the mask : the dropped pixels are spread over 3 bytes the way the pixels are packed
+		if (f_out != 0)
+		{
+			__m128i f_drop[4], f_drop_px[3];
+			mask_drop_16_sse2(p_mask + f_w, f_drop);
+			join_packed_bgr_sse2(pack_bgr_sse2(f_drop[0]), pack_bgr_sse2(f_drop[1]), pack_bgr_sse2(f_drop[2]), pack_bgr_sse2(f_drop[3]), f_drop_px);
+
+			for (int f_i = 0; f_i < 3; ++f_i)
+				f_px[f_i] = select_sse2(f_drop_px[f_i], _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_background + f_w * 3) + f_i), f_px[f_i]);
+		}
+
+		for (int f_i = 0; f_i < 3; ++f_i)
+			_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst + f_w * 3) + f_i, f_px[f_i]);
+	}
+
+	select_32bpp_24bpp_scalar(p_src + f_w * 4, p_mask + f_w, p_background + f_w * 3, p_dst + f_w * 3, p_width - f_w);
+}
+
+void background_16bpp_sse2(const unsigned char *p_background, const unsigned char *p_mask, unsigned char *p_dst, int p_width)
+{
+	const __m128i f_zero  = _mm_setzero_si128();
+	const __m128i f_ones  = _mm_set1_epi8(-1);
+	const __m128i f_luma  = _mm_set1_epi16(0x00ff);
+	int f_w = 0;
+
+	for (; f_w + 8 <= p_width; f_w += 8)
+	{
+		// 8 pixels : Y0-U-Y1-V for 4 macropixels, luma follows its own mask, chroma needs both masks of the macropixel to be zero
+		const __m128i f_show	 = _mm_cmpeq_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *> (p_mask + f_w)), f_zero);
+		const __m128i f_show_y	 = _mm_unpacklo_epi8(f_show, f_show);
+		const __m128i f_show_c	 = _mm_cmpeq_epi16(f_show, f_ones);
+		const __m128i f_select	 = _mm_or_si128(_mm_and_si128(f_luma, f_show_y), _mm_andnot_si128(f_luma, _mm_unpacklo_epi16(f_show_c, f_show_c)));
+
+		__m128i *f_dst = reinterpret_cast<__m128i *> (p_dst + f_w * 2);
+		_mm_storeu_si128(f_dst, select_sse2(f_select, _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_background + f_w * 2)), _mm_loadu_si128(f_dst)));
+	}
+
+	background_16bpp_scalar(p_background + f_w * 2, p_mask + f_w, p_dst + f_w * 2, p_width - f_w);
+}
+
+template <bool t_nv12>
+void background_yuv420_sse2(KW_PLANAR_BACKGROUND_ARGS)
+{
+	const __m128i f_zero = _mm_setzero_si128();
+	const __m128i f_ones = _mm_set1_epi8(-1);
+	int f_x = 0;
+
+	for (; f_x + 16 <= p_width; f_x += 16)
+	{
+		const __m128i f_show_0 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *> (p_mask_0 + f_x)), f_zero);
+		const __m128i f_show_1 = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *> (p_mask_1 + f_x)), f_zero);
+
+		__m128i *f_y_0 = reinterpret_cast<__m128i *> (p_dst_y_0 + f_x);
+		__m128i *f_y_1 = reinterpret_cast<__m128i *> (p_dst_y_1 + f_x);
+		_mm_storeu_si128(f_y_0, select_sse2(f_show_0, _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_bg_y_0 + f_x)), _mm_loadu_si128(f_y_0)));
+		_mm_storeu_si128(f_y_1, select_sse2(f_show_1, _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_bg_y_1 + f_x)), _mm_loadu_si128(f_y_1)));
+
+		// a chroma sample is shared by 2x2 pixels : 0xffff for each of the 8 samples when all four are masked out
+		const __m128i f_show_c = _mm_cmpeq_epi16(_mm_and_si128(f_show_0, f_show_1), f_ones);
+
+		if (t_nv12)
+		{
+			__m128i *f_uv = reinterpret_cast<__m128i *> (p_dst_u + f_x);
+			_mm_storeu_si128(f_uv, select_sse2(f_show_c, _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_bg_u + f_x)), _mm_loadu_si128(f_uv)));
+		}
+		else
+		{
+			const __m128i f_show_8 = _mm_packs_epi16(f_show_c, f_show_c);
+			__m128i *	  f_u	   = reinterpret_cast<__m128i *> (p_dst_u + f_x / 2);
+			__m128i *	  f_v	   = reinterpret_cast<__m128i *> (p_dst_v + f_x / 2);
+			_mm_storel_epi64(f_u, select_sse2(f_show_8, _mm_loadl_epi64(reinterpret_cast<const __m128i *> (p_bg_u + f_x / 2)), _mm_loadl_epi64(f_u)));
+			_mm_storel_epi64(f_v, select_sse2(f_show_8, _mm_loadl_epi64(reinterpret_cast<const __m128i *> (p_bg_v + f_x / 2)), _mm_loadl_epi64(f_v)));
+		}
+	}
+
+	if (f_x < p_width)
+	{
+		const int f_c = (t_nv12) ? f_x : f_x / 2;
+		(t_nv12 ? background_nv12_scalar : background_i420_scalar)(	p_bg_y_0 + f_x, p_bg_y_1 + f_x, p_bg_u + f_c, (t_nv12) ? p_bg_v : p_bg_v + f_c,
+																	p_mask_0 + f_x, p_mask_1 + f_x, p_dst_y_0 + f_x, p_dst_y_1 + f_x,
+																	p_dst_u + f_c, (t_nv12) ? p_dst_v : p_dst_v + f_c, p_width - f_x);
+	}
+}
+
+void blur_rows_sse2(const unsigned char *const *p_rows, int p_count, int p_recip, unsigned char *p_dst, int p_bytes)
+{
+	// the reciprocal of a single row (65536) doesn't fit in 16 bits
+	if (p_recip > 0xffff)
+	{
+		blur_rows_scalar(p_rows, p_count, p_recip, p_dst, p_bytes);
+		return;
+	}
+
+	const __m128i f_zero  = _mm_setzero_si128();
+	const __m128i f_half  = _mm_set1_epi16(static_cast<short> (p_count / 2));
+	const __m128i f_recip = _mm_set1_epi16(static_cast<short> (p_recip));
+	int f_i = 0;
+
+	for (; f_i + 16 <= p_bytes; f_i += 16)
+	{
+		__m128i f_lo = f_half;
+		__m128i f_hi = f_half;
+
+		for (int f_r = 0; f_r < p_count; ++f_r)
+		{
+			const __m128i f_row = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_rows[f_r] + f_i));
+			f_lo = _mm_add_epi16(f_lo, _mm_unpacklo_epi8(f_row, f_zero));
+			f_hi = _mm_add_epi16(f_hi, _mm_unpackhi_epi8(f_row, f_zero));
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst + f_i), _mm_packus_epi16(_mm_mulhi_epu16(f_lo, f_recip), _mm_mulhi_epu16(f_hi, f_recip)));
+	}
+
+	if (f_i < p_bytes)
+	{
+		const unsigned char *f_rows[16];
+
+		for (int f_r = 0; f_r < p_count; ++f_r)
+			f_rows[f_r] = p_rows[f_r] + f_i;
+
+		blur_rows_scalar(f_rows, p_count, p_recip, p_dst + f_i, p_bytes - f_i);
+	}
+}
+
+// the four bytes of element p_x, widened to 16 bits
+inline __m128i load_element_sse2(const unsigned char *p_src, int p_x)
+{
+	int f_value;
+	std::memcpy(&f_value, p_src + (p_x * 4), 4);
+	return _mm_unpacklo_epi8(_mm_cvtsi32_si128(f_value), _mm_setzero_si128());
+}
+
+void blur_cols_sse2(const unsigned char *p_src, int p_radius, int p_recip, unsigned char *p_dst, int p_count)
+{
+	// the reciprocal of a window of one element (65536) doesn't fit in 16 bits
+	if (p_recip > 0xffff)
+	{
+		blur_cols_scalar(p_src, p_radius, p_recip, p_dst, p_count);
+		return;
+	}
+
+	// the four channels of an element are summed side by side (a running sum can't be split over more elements)
+	const __m128i f_recip = _mm_set1_epi16(static_cast<short> (p_recip));
+	const int	  f_last  = p_count - 1;
+
+	__m128i f_sum = _mm_add_epi16(_mm_mullo_epi16(load_element_sse2(p_src, 0), _mm_set1_epi16(static_cast<short> (p_radius + 1))),
+								  _mm_set1_epi16(static_cast<short> (p_radius)));
+
+	for (int f_x = 1; f_x <= p_radius; ++f_x)
+		f_sum = _mm_add_epi16(f_sum, load_element_sse2(p_src, std::min(f_x, f_last)));
+
+	for (int f_x = 0; f_x < p_count; ++f_x)
+	{
+		const int f_value = _mm_cvtsi128_si32(_mm_packus_epi16(_mm_mulhi_epu16(f_sum, f_recip), f_sum));
+		std::memcpy(p_dst + (f_x * 4), &f_value, 4);
+
+		f_sum = _mm_add_epi16(f_sum, load_element_sse2(p_src, std::min(f_x + p_radius + 1, f_last)));
+		f_sum = _mm_sub_epi16(f_sum, load_element_sse2(p_src, std::max(f_x - p_radius, 0)));
+	}
+}
+
+// (3 * a + b) / 4 for every byte, see blend_3_1
+inline __m128i blend_3_1_sse2(__m128i p_a, __m128i p_b)
+{
+	return _mm_avg_epu8(_mm_avg_epu8(p_a, p_b), p_a);
+}
+
+void upsample_2x_sse2(const unsigned char *p_near, const unsigned char *p_far, unsigned char *p_dst, int p_count)
+{
+	if (p_count < 6)
+	{
+		upsample_2x_scalar(p_near, p_far, p_dst, p_count);
+		return;
+	}
+
+	// groups of 4 elements from element 1 on, leaving at least one element after the last group (the groups read their neighbours)
+	const int f_end = 1 + (((p_count - 2) / 4) * 4);
+
+	// the edges go through the scalar kernel first : it repeats the edge elements of the part it gets,
+	// so the elements next to the groups (1 and f_end - 1) come out wrong there and are overwritten by the groups
+	upsample_2x_scalar(p_near, p_far, p_dst, 2);
+	upsample_2x_scalar(p_near + ((f_end - 1) * 4), p_far + ((f_end - 1) * 4), p_dst + ((f_end - 1) * 8), p_count - f_end + 1);
+
+	for (int f_x = 1; f_x < f_end; f_x += 4)
+	{
+		const unsigned char *f_n = p_near + (f_x * 4);
+		const unsigned char *f_f = p_far + (f_x * 4);
+
+		const __m128i f_v		= blend_3_1_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *> (f_n)),
+												 _mm_loadu_si128(reinterpret_cast<const __m128i *> (f_f)));
+		const __m128i f_v_left	= blend_3_1_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *> (f_n - 4)),
+												 _mm_loadu_si128(reinterpret_cast<const __m128i *> (f_f - 4)));
+		const __m128i f_v_right = blend_3_1_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *> (f_n + 4)),
+												 _mm_loadu_si128(reinterpret_cast<const __m128i *> (f_f + 4)));
+
+		const __m128i f_even = blend_3_1_sse2(f_v, f_v_left);
+		const __m128i f_odd	 = blend_3_1_sse2(f_v, f_v_right);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst + (f_x * 8)), _mm_unpacklo_epi32(f_even, f_odd));
+		_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst + (f_x * 8) + 16), _mm_unpackhi_epi32(f_even, f_odd));
+	}
+}
+
+void depth_to_color_sse2(const unsigned short *p_depth, const DepthColorCoefficients &p_coefficients, float *p_points, int p_count)
+{
+	const __m128i f_zero_i	= _mm_setzero_si128();
+	const __m128  f_zero	= _mm_setzero_ps();
+	const __m128  f_scale	= _mm_set1_ps(0.001f);
+	const __m128  f_inf		= _mm_set1_ps(-std::numeric_limits<float>::infinity());
+	const __m128  f_off_x	= _mm_set1_ps(p_coefficients.m_offset[0]);
+	const __m128  f_off_y	= _mm_set1_ps(p_coefficients.m_offset[1]);
+	const __m128  f_off_w	= _mm_set1_ps(p_coefficients.m_offset[2]);
+
+	int f_i = 0;
+
+	for (; f_i + 4 <= p_count; f_i += 4)
+	{
+		const __m128i f_d16 = _mm_loadl_epi64(reinterpret_cast<const __m128i *> (p_depth + f_i));
+		const __m128  f_z	= _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(f_d16, f_zero_i)), f_scale);
+		const __m128  f_w	= _mm_add_ps(_mm_mul_ps(f_z, _mm_loadu_ps(p_coefficients.m_w + f_i)), f_off_w);
+
+		// the same operations in the same order as the scalar kernel
+		const __m128  f_x	= _mm_div_ps(_mm_add_ps(_mm_mul_ps(f_z, _mm_loadu_ps(p_coefficients.m_u + f_i)), f_off_x), f_w);
+		const __m128  f_y	= _mm_div_ps(_mm_add_ps(_mm_mul_ps(f_z, _mm_loadu_ps(p_coefficients.m_v + f_i)), f_off_y), f_w);
+
+		// valid : a depth and in front of the color camera (also false for NaN)
+		const __m128  f_valid = _mm_and_ps(_mm_cmpneq_ps(f_z, f_zero), _mm_cmpgt_ps(f_w, f_zero));
+		const __m128  f_vx	  = _mm_or_ps(_mm_and_ps(f_valid, f_x), _mm_andnot_ps(f_valid, f_inf));
+		const __m128  f_vy	  = _mm_or_ps(_mm_and_ps(f_valid, f_y), _mm_andnot_ps(f_valid, f_inf));
+
+		_mm_storeu_ps(p_points + (f_i * 2), _mm_unpacklo_ps(f_vx, f_vy));
+		_mm_storeu_ps(p_points + (f_i * 2) + 4, _mm_unpackhi_ps(f_vx, f_vy));
+	}
+
+	if (f_i < p_count)
+	{
+		const DepthColorCoefficients f_tail = {	p_coefficients.m_u + f_i, p_coefficients.m_v + f_i, p_coefficients.m_w + f_i,
+												{p_coefficients.m_offset[0], p_coefficients.m_offset[1], p_coefficients.m_offset[2]}};
+		depth_to_color_scalar(p_depth + f_i, f_tail, p_points + (f_i * 2), p_count - f_i);
+	}
+}
+
+} // unnamed namespace
+
+void install_kernels_sse2(RowKernels &p_kernels)
+{
+	p_kernels.m_level			 = cpu::SIMD_SSE2;
+	p_kernels.m_copy_32bpp_32bpp = copy_32bpp_32bpp_sse2;
+	p_kernels.m_mask_32bpp_32bpp = mask_32bpp_32bpp_sse2;
+	p_kernels.m_copy_16bpp_16bpp = copy_16bpp_16bpp_sse2;
+	p_kernels.m_mask_16bpp_16bpp = mask_16bpp_16bpp_sse2;
+	p_kernels.m_copy_32bpp_nv12	 = bgra_to_yuv420_sse2<true, false>;
+	p_kernels.m_mask_32bpp_nv12	 = bgra_to_yuv420_sse2<true, true>;
+	p_kernels.m_copy_32bpp_i420	 = bgra_to_yuv420_sse2<false, false>;
+	p_kernels.m_mask_32bpp_i420	 = bgra_to_yuv420_sse2<false, true>;
+	p_kernels.m_copy_16bpp_nv12	 = yuy2_to_yuv420_sse2<true, false>;
+	p_kernels.m_mask_16bpp_nv12	 = yuy2_to_yuv420_sse2<true, true>;
+	p_kernels.m_copy_16bpp_i420	 = yuy2_to_yuv420_sse2<false, false>;
+	p_kernels.m_mask_16bpp_i420	 = yuy2_to_yuv420_sse2<false, true>;
+	p_kernels.m_scale_rows		 = scale_rows_sse2;
+	p_kernels.m_scale_cols_32bpp = scale_cols_32bpp_sse2;
+	p_kernels.m_matte_32bpp_32bpp = matte_32bpp_32bpp_sse2;
+	p_kernels.m_matte_32bpp_24bpp = matte_32bpp_24bpp_sse2;
+	p_kernels.m_matte_min		 = matte_min_sse2;
+	p_kernels.m_matte_max		 = matte_max_sse2;
+	p_kernels.m_matte_slide		 = matte_slide_sse2;
+	p_kernels.m_matte_feather	 = matte_feather_sse2;
+	p_kernels.m_body_lookup_float = body_lookup_float_sse2;
+	p_kernels.m_body_lookup_int	 = body_lookup_int_scalar;		// the reads of the 16 byte points and the labels dominate, sse2 doesn't gain
+	p_kernels.m_depth_window	 = depth_window_sse2;
+	p_kernels.m_depth_window_packed = depth_window_packed_sse2;
+	p_kernels.m_background_32bpp = background_32bpp_sse2;
+	p_kernels.m_background_24bpp = background_24bpp_sse2;
+	p_kernels.m_background_16bpp = background_16bpp_sse2;
+	p_kernels.m_background_nv12	 = background_yuv420_sse2<true>;
+	p_kernels.m_background_i420	 = background_yuv420_sse2<false>;
+	p_kernels.m_select_32bpp_32bpp = select_32bpp_32bpp_sse2;
+	p_kernels.m_select_32bpp_24bpp = select_32bpp_24bpp_sse2;
+	p_kernels.m_blur_rows		 = blur_rows_sse2;
+	p_kernels.m_blur_cols		 = blur_cols_sse2;
+	p_kernels.m_upsample_2x		 = upsample_2x_sse2;
+	p_kernels.m_depth_to_color	 = depth_to_color_sse2;
+}
+
+#else
+
+void install_kernels_sse2(RowKernels &)
+{
+}
+
+#endif // KW_SIMD_X86
+
+} // namespace kernels
+
+} // namespace img
@@ -0,0 +1,175 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	image_kernels_ssse3.cpp
+//
+// Purpose	: 	per-row image kernels - SSSE3 implementation
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "image_kernels.h"
+
+#ifdef KW_SIMD_X86
+#include <tmmintrin.h>
+#endif // KW_SIMD_X86
+
+namespace img {
+
+namespace kernels {
+
+#ifdef KW_SIMD_X86
+
+namespace {
+
+// drop the alpha channel of 4 pixels : 12 packed bytes in the low part of the register
+inline __m128i shuffle_bgra_to_bgr()
+{
+	return _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+}
+
+// join four registers with 12 valid bytes each into three registers of 48 consecutive bytes
+inline void join_packed_bgr(__m128i p_s0, __m128i p_s1, __m128i p_s2, __m128i p_s3, __m128i p_out[3])
+{
+	p_out[0] = _mm_or_si128(p_s0, _mm_slli_si128(p_s1, 12));
+	p_out[1] = _mm_or_si128(_mm_srli_si128(p_s1, 4), _mm_slli_si128(p_s2, 8));
+	p_out[2] = _mm_or_si128(_mm_srli_si128(p_s2, 8), _mm_slli_si128(p_s3, 4));
+}
+
+inline void store_packed_bgr(unsigned char *p_dst, __m128i p_s0, __m128i p_s1, __m128i p_s2, __m128i p_s3)
+{
+	__m128i f_out[3];
+	join_packed_bgr(p_s0, p_s1, p_s2, p_s3, f_out);
+
+	_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst), f_out[0]);
+	_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst + 16), f_out[1]);
+	_mm_storeu_si128(reinterpret_cast<__m128i *> (p_dst + 32), f_out[2]);
+}
+
+void copy_32bpp_24bpp_ssse3(const unsigned char *p_src, unsigned char *p_dst, int p_width)
+{
+	const __m128i f_shuffle = shuffle_bgra_to_bgr();
+	int f_w = 0;
+
+	for (; f_w + 16 <= p_width; f_w += 16)
+	{
+		const __m128i *f_src = reinterpret_cast<const __m128i *> (p_src + f_w * 4);
+
+		__m128i f_s0 = _mm_shuffle_epi8(_mm_loadu_si128(f_src + 0), f_shuffle);
+		__m128i f_s1 = _mm_shuffle_epi8(_mm_loadu_si128(f_src + 1), f_shuffle);
+		__m128i f_s2 = _mm_shuffle_epi8(_mm_loadu_si128(f_src + 2), f_shuffle);
+		__m128i f_s3 = _mm_shuffle_epi8(_mm_loadu_si128(f_src + 3), f_shuffle);
+
+		store_packed_bgr(p_dst + f_w * 3, f_s0, f_s1, f_s2, f_s3);
+	}
+
+	copy_32bpp_24bpp_scalar(p_src + f_w * 4, p_dst + f_w * 3, p_width - f_w);
+}
+
+void mask_32bpp_24bpp_ssse3(const unsigned char *p_src, const unsigned char *p_mask, unsigned char *p_dst, int p_width)
+{
+	const __m128i f_shuffle = shuffle_bgra_to_bgr();
+	const __m128i f_zero	= _mm_setzero_si128();
+	int f_w = 0;
+
+	for (; f_w + 16 <= p_width; f_w += 16)
+	{
+		const __m128i *f_src = reinterpret_cast<const __m128i *> (p_src + f_w * 4);
+
+		// replicate each mask byte over the four channels of its pixel
+		__m128i f_m	   = _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_mask + f_w));
+		__m128i f_m_lo = _mm_unpacklo_epi8(f_m, f_m);
+		__m128i f_m_hi = _mm_unpackhi_epi8(f_m, f_m);
+
+		__m128i f_d0 = _mm_cmpeq_epi32(_mm_unpacklo_epi16(f_m_lo, f_m_lo), f_zero);
+		__m128i f_d1 = _mm_cmpeq_epi32(_mm_unpackhi_epi16(f_m_lo, f_m_lo), f_zero);
+		__m128i f_d2 = _mm_cmpeq_epi32(_mm_unpacklo_epi16(f_m_hi, f_m_hi), f_zero);
+		__m128i f_d3 = _mm_cmpeq_epi32(_mm_unpackhi_epi16(f_m_hi, f_m_hi), f_zero);
+
+		__m128i f_s0 = _mm_shuffle_epi8(_mm_andnot_si128(f_d0, _mm_loadu_si128(f_src + 0)), f_shuffle);
+		__m128i f_s1 = _mm_shuffle_epi8(_mm_andnot_si128(f_d1, _mm_loadu_si128(f_src + 1)), f_shuffle);
+		__m128i f_s2 = _mm_shuffle_epi8(_mm_andnot_si128(f_d2, _mm_loadu_si128(f_src + 2)), f_shuffle);
+		__m128i f_s3 = _mm_shuffle_epi8(_mm_andnot_si128(f_d3, _mm_loadu_si128(f_src + 3)), f_shuffle);
+
+		store_packed_bgr(p_dst + f_w * 3, f_s0, f_s1, f_s2, f_s3);
+	}
+
+	mask_32bpp_24bpp_scalar(p_src + f_w * 4, p_mask + f_w, p_dst + f_w * 3, p_width - f_w);
+}
+
+void select_32bpp_24bpp_ssse3(const unsigned char *p_src, const unsigned char *p_mask, const unsigned char *p_background, unsigned char *p_dst, int p_width)
+{
+	const __m128i f_shuffle = shuffle_bgra_to_bgr();
+	const __m128i f_zero	= _mm_setzero_si128();
+	int f_w = 0;
+
+	for (; f_w + 16 <= p_width; f_w += 16)
+	{
+		const __m128i *f_src = reinterpret_cast<const __m128i *> (p_src + f_w * 4);
+		const __m128i *f_bg	 = reinterpret_cast<const __m128i *> (p_background + f_w * 3);
+		__m128i *	   f_dst = reinterpret_cast<__m128i *> (p_dst + f_w * 3);
+
+		const __m128i f_m	= _mm_loadu_si128(reinterpret_cast<const __m128i *> (p_mask + f_w));
+		const int	  f_out = _mm_movemask_epi8(_mm_cmpeq_epi8(f_m, f_zero));
+
+		// hard masks : most groups are completely kept or completely dropped, only one of the inputs is read
+		if (f_out == 0xffff)
+		{
+			for (int f_i = 0; f_i < 3; ++f_i)
+				_mm_storeu_si128(f_dst + f_i, _mm_loadu_si128(f_bg + f_i));
+
+			continue;
+		}
+
+		__m128i f_px[3];
+		join_packed_bgr(_mm_shuffle_epi8(_mm_loadu_si128(f_src + 0), f_shuffle), _mm_shuffle_epi8(_mm_loadu_si128(f_src + 1), f_shuffle),
+						_mm_shuffle_epi8(_mm_loadu_si128(f_src + 2), f_shuffle), _mm_shuffle_epi8(_mm_loadu_si128(f_src + 3), f_shuffle), f_px);
+
+		// the edges of the mask : the dropped pixels are spread over 3 bytes the way the pixels are packed
+		if (f_out != 0)
+		{
+			const __m128i f_m_lo = _mm_unpacklo_epi8(f_m, f_m);
+			const __m128i f_m_hi = _mm_unpackhi_epi8(f_m, f_m);
+			__m128i		  f_drop[3];
+
+			join_packed_bgr(_mm_shuffle_epi8(_mm_cmpeq_epi32(_mm_unpacklo_epi16(f_m_lo, f_m_lo), f_zero), f_shuffle),
+							_mm_shuffle_epi8(_mm_cmpeq_epi32(_mm_unpackhi_epi16(f_m_lo, f_m_lo), f_zero), f_shuffle),
+							_mm_shuffle_epi8(_mm_cmpeq_epi32(_mm_unpacklo_epi16(f_m_hi, f_m_hi), f_zero), f_shuffle),
+							_mm_shuffle_epi8(_mm_cmpeq_epi32(_mm_unpackhi_epi16(f_m_hi, f_m_hi), f_zero), f_shuffle), f_drop);
+
+			for (int f_i = 0; f_i < 3; ++f_i)
+				f_px[f_i] = _mm_or_si128(_mm_and_si128(f_drop[f_i], _mm_loadu_si128(f_bg + f_i)), _mm_andnot_si128(f_drop[f_i], f_px[f_i]));
+		}
+
+		for (int f_i = 0; f_i < 3; ++f_i)
+			_mm_storeu_si128(f_dst + f_i, f_px[f_i]);
+	}
+
+	select_32bpp_24bpp_scalar(p_src + f_w * 4, p_mask + f_w, p_background + f_w * 3, p_dst + f_w * 3, p_width - f_w);
+}
+
+} // unnamed namespace
+
+void install_kernels_ssse3(RowKernels &p_kernels)
+{
+	p_kernels.m_level			 = cpu::SIMD_SSSE3;
+	p_kernels.m_copy_32bpp_24bpp = copy_32bpp_24bpp_ssse3;
+	p_kernels.m_mask_32bpp_24bpp = mask_32bpp_24bpp_ssse3;
+	p_kernels.m_select_32bpp_24bpp = select_32bpp_24bpp_ssse3;
+}
+
+#else
+
+void install_kernels_ssse3(RowKernels &)
+{
+}
+
+#endif // KW_SIMD_X86
+
+} // namespace kernels
+
+} // namespace img
@@ -0,0 +1,582 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	keying.cpp
+//
+// Purpose	: 	separate the people in front of the sensor from the background
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "keying.h"
+#include "image_kernels.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace keying {
+
+//
+// LowResBodyMask
+//
+
+LowResBodyMask::LowResBodyMask() :	m_depth_width(0),
+									m_depth_height(0),
+									m_scale(1),
+									m_width(0),
+									m_height(0)
+{
+}
+
+void LowResBodyMask::configure(int p_depth_width, int p_depth_height, int p_color_width, int p_color_height, int p_scale)
+{
+	m_depth_width	= p_depth_width;
+	m_depth_height	= p_depth_height;
+	m_scale			= std::max(p_scale, 1);
+	m_width			= (p_color_width + m_scale - 1) / m_scale;
+	m_height		= (p_color_height + m_scale - 1) / m_scale;
+
+	m_points.resize(m_depth_width * m_depth_height);
+	m_mask.assign(m_width * m_height, 0);
+}
+
+bool LowResBodyMask::build(const uint16_t *p_depth, const unsigned char *p_body_index, const DepthToColorFunc &p_mapper)
+{
+	if (m_points.empty() || m_mask.empty() || !p_mapper(p_depth, m_points.data()))
+		return false;
+
+	std::fill(std::begin(m_mask), std::end(m_mask), 0);
+
+	// mark the mask value each body pixel lands on (positions outside of the color image, including infinity, fail the tests)
+	const float	f_limit_x  = static_cast<float> (m_width);
+	const float	f_limit_y  = static_cast<float> (m_height);
+	const float	f_to_mask  = 1.0f / m_scale;
+	const int	f_count	   = m_depth_width * m_depth_height;
+
+	for (int f_idx = 0; f_idx < f_count; ++f_idx)
+	{
+		if (p_body_index[f_idx] == 0xff)
+			continue;
+
+		const float f_x = m_points[f_idx].m_x * f_to_mask;
+		const float f_y = m_points[f_idx].m_y * f_to_mask;
+
+		if (f_x >= 0.0f && f_x < f_limit_x && f_y >= 0.0f && f_y < f_limit_y)
+			m_mask[(static_cast<int> (f_y) * m_width) + static_cast<int> (f_x)] = 0xff;
+	}
+
+	// a depth pixel covers a little less than one mask value : close the gaps of a single value between marked values
+	for (int f_y = 0; f_y < m_height; ++f_y)
+	{
+		unsigned char *f_row = &m_mask[f_y * m_width];
+
+		for (int f_x = 1; f_x < m_width - 1; ++f_x)
+		{
+			if (f_row[f_x - 1] & f_row[f_x + 1])
+				f_row[f_x] = 0xff;
+		}
+	}
+
+	for (int f_y = 1; f_y < m_height - 1; ++f_y)
+	{
+		const unsigned char *f_above = &m_mask[(f_y - 1) * m_width];
+		unsigned char *		 f_row	 = &m_mask[f_y * m_width];
+		const unsigned char *f_below = &m_mask[(f_y + 1) * m_width];
+
+		for (int f_x = 0; f_x < m_width; ++f_x)
+			f_row[f_x] |= f_above[f_x] & f_below[f_x];
+	}
+
+	return true;
+}
+
+img::MaskView LowResBodyMask::view() const
+{
+	return {m_mask.data(), m_width, m_height, m_width, m_scale, false, nullptr};
+}
+
+//
+// SoftMatte
+//
+
+namespace {
+
+// working memory for the matte rows, reused from frame to frame (each thread that refines rows has its own)
+struct MatteScratch
+{
+	std::vector<unsigned char>	m_padded[2];		// a row with a copy of its first and last value on either side
+	std::vector<unsigned char>	m_half_closed;		// the last 3 rows that were dilated and eroded horizontally
+	std::vector<unsigned char>	m_closed;			// the rows in the vertical window of the box filter
+	std::vector<unsigned char>	m_zero;
+	std::vector<unsigned short>	m_sums;				// the column sums of the vertical window, with p_radius copies of the edges on either side
+};
+
+thread_local MatteScratch g_matte_scratch;
+
+inline void pad_row(unsigned char *p_row, int p_width)
+{
+	p_row[0]		   = p_row[1];
+	p_row[p_width + 1] = p_row[p_width];
+}
+
+} // unnamed namespace
+
+SoftMatte::SoftMatte() :	m_radius(2),
+							m_weight(128),
+							m_width(0),
+							m_height(0),
+							m_scale(1),
+							m_history(false),
+							m_history_x(0),
+							m_history_y(0),
+							m_history_width(0),
+							m_history_height(0)
+{
+}
+
+void SoftMatte::configure(int p_radius, int p_weight)
+{
+	// at most 15 x 15 values : the box sums have to fit in 16 bits
+	m_radius = std::min(std::max(p_radius, 1), 7);
+
+	// with rounding, weights of at least one half always reach the new value
+	m_weight = std::min(std::max(p_weight, 64), 128);
+}
+
+void SoftMatte::reset()
+{
+	m_history = false;
+}
+
+bool SoftMatte::refine(const img::MaskView &p_hard, int p_x, int p_y, int p_width, int p_height)
+{
+	if (!p_hard.m_data || p_width <= 0 || p_height <= 0 || p_x < 0 || p_y < 0 ||
+		p_x + p_width > p_hard.m_width || p_y + p_height > p_hard.m_height)
+	{
+		return false;
+	}
+
+	if (p_hard.m_width != m_width || p_hard.m_height != m_height || p_hard.m_scale != m_scale)
+	{
+		m_width	  = p_hard.m_width;
+		m_height  = p_hard.m_height;
+		m_scale	  = p_hard.m_scale;
+		m_history = false;
+		m_matte.assign(m_width * m_height, 0);
+	}
+
+	const auto &f_kernels = img::kernels::row_kernels();
+	const int	f_radius  = m_radius;
+	const int	f_window  = (2 * f_radius) + 1;
+	const int	f_recip	  = (65536 + (f_window * f_window) - 1) / (f_window * f_window);
+	const int	f_ring	  = f_window + 1;
+
+	// only the part of the region that was also refined in the previous frame has a history
+	const int f_hist_x0 = (m_history) ? std::max(p_x, m_history_x) : 0;
+	const int f_hist_x1 = (m_history) ? std::min(p_x + p_width, m_history_x + m_history_width) : 0;
+	const int f_hist_y0 = (m_history) ? std::max(p_y, m_history_y) : 0;
+	const int f_hist_y1 = (m_history) ? std::min(p_y + p_height, m_history_y + m_history_height) : 0;
+
+	parallel::for_each_stripe(p_height, p_width * 8, [&](int p_begin, int p_end) {
+		auto &f_scratch = g_matte_scratch;
+
+		for (auto &f_padded : f_scratch.m_padded)
+			f_padded.resize(p_width + 2);
+
+		f_scratch.m_half_closed.resize(3 * p_width);
+		f_scratch.m_closed.resize(f_ring * p_width);
+		f_scratch.m_zero.assign(p_width, 0);
+		f_scratch.m_sums.assign(p_width + (2 * f_radius), 0);
+
+		unsigned char *	 f_padded_0 = f_scratch.m_padded[0].data();
+		unsigned char *	 f_padded_1 = f_scratch.m_padded[1].data();
+		unsigned short * f_sums		= f_scratch.m_sums.data() + f_radius;
+
+		// rows outside of the region repeat the first or the last row
+		auto clamp_row = [&](int p_r) {
+			return std::min(std::max(p_r, 0), p_height - 1);
+		};
+
+		auto hard_row = [&](int p_r) {
+			return p_hard.m_data + ((p_y + clamp_row(p_r)) * p_hard.m_stride) + p_x;
+		};
+
+		auto half_closed_row = [&](int p_r) {
+			return f_scratch.m_half_closed.data() + ((p_r % 3) * p_width);
+		};
+
+		auto closed_row = [&](int p_i) {
+			return f_scratch.m_closed.data() + (((p_i - p_begin + f_ring) % f_ring) * p_width);
+		};
+
+		// the close is a 3x3 dilation followed by a 3x3 erosion : all but the vertical erosion are done one row at a time
+		int f_last_half_closed = clamp_row(p_begin - f_radius) - 2;
+
+		auto update_half_closed = [&](int p_r) {
+			for (; f_last_half_closed < p_r; )
+			{
+				const int f_r = ++f_last_half_closed;
+
+				if (f_r < 0)
+					continue;
+
+				f_kernels.m_matte_max(hard_row(f_r - 1), hard_row(f_r), hard_row(f_r + 1), f_padded_0 + 1, p_width);
+				pad_row(f_padded_0, p_width);
+				f_kernels.m_matte_max(f_padded_0, f_padded_0 + 1, f_padded_0 + 2, f_padded_1 + 1, p_width);
+				pad_row(f_padded_1, p_width);
+				f_kernels.m_matte_min(f_padded_1, f_padded_1 + 1, f_padded_1 + 2, half_closed_row(f_r), p_width);
+			}
+		};
+
+		auto close_row = [&](int p_i) {
+			const int f_r = clamp_row(p_i);
+			update_half_closed(std::min(f_r + 1, p_height - 1));
+			f_kernels.m_matte_min(half_closed_row(std::max(f_r - 1, 0)), half_closed_row(f_r), half_closed_row(std::min(f_r + 1, p_height - 1)),
+								  closed_row(p_i), p_width);
+		};
+
+		// the vertical window of the first row
+		for (int f_i = p_begin - f_radius; f_i <= p_begin + f_radius; ++f_i)
+		{
+			close_row(f_i);
+			f_kernels.m_matte_slide(f_sums, closed_row(f_i), f_scratch.m_zero.data(), p_width);
+		}
+
+		for (int f_r = p_begin; f_r < p_end; ++f_r)
+		{
+			if (f_r > p_begin)
+			{
+				close_row(f_r + f_radius);
+				f_kernels.m_matte_slide(f_sums, closed_row(f_r + f_radius), closed_row(f_r - f_radius - 1), p_width);
+			}
+
+			for (int f_t = 1; f_t <= f_radius; ++f_t)
+			{
+				f_sums[-f_t]				= f_sums[0];
+				f_sums[p_width - 1 + f_t]	= f_sums[p_width - 1];
+			}
+
+			// the horizontal pass blends with the previous frame where there is one
+			const int		f_y		= p_y + f_r;
+			unsigned char *	f_matte	= m_matte.data() + (f_y * m_width) + p_x;
+			const bool		f_hist	= f_y >= f_hist_y0 && f_y < f_hist_y1 && f_hist_x0 < f_hist_x1;
+			const int		f_x0	= (f_hist) ? f_hist_x0 - p_x : p_width;
+			const int		f_x1	= (f_hist) ? f_hist_x1 - p_x : p_width;
+
+			if (f_x0 > 0)
+				f_kernels.m_matte_feather(f_sums, f_radius, f_recip, 128, f_matte, f_x0);
+
+			if (f_x1 > f_x0)
+				f_kernels.m_matte_feather(f_sums + f_x0, f_radius, f_recip, m_weight, f_matte + f_x0, f_x1 - f_x0);
+
+			if (f_x1 < p_width)
+				f_kernels.m_matte_feather(f_sums + f_x1, f_radius, f_recip, 128, f_matte + f_x1, p_width - f_x1);
+		}
+	});
+
+	m_history		 = true;
+	m_history_x		 = p_x;
+	m_history_y		 = p_y;
+	m_history_width	 = p_width;
+	m_history_height = p_height;
+
+	return true;
+}
+
+img::MaskView SoftMatte::view() const
+{
+	return {m_matte.data(), m_width, m_height, m_width, m_scale, true, nullptr};
+}
+
+//
+// background image
+//
+
+namespace {
+
+// the size of an image without padding
+inline size_t image_size(img::PixelFormat p_format, int p_width, int p_height)
+{
+	const size_t f_plane = static_cast<size_t> (img::packed_stride(p_format, p_width)) * p_height;
+	return (p_format == img::PF_NV12 || p_format == img::PF_I420) ? f_plane * 3 / 2 : f_plane;
+}
+
+} // unnamed namespace
+
+BackgroundImage::BackgroundImage() :	m_source_width(0),
+										m_source_height(0),
+										m_valid(false),
+										m_mirror(false),
+										m_view{nullptr, 0, 0, 0, img::PF_BGRA32}
+{
+}
+
+void BackgroundImage::assign(std::vector<unsigned char> p_pixels, int p_width, int p_height)
+{
+	if (p_width <= 0 || p_height <= 0 || p_pixels.size() < static_cast<size_t> (p_width) * p_height * 4)
+	{
+		clear();
+		return;
+	}
+
+	m_source		= std::move(p_pixels);
+	m_source_width	= p_width;
+	m_source_height = p_height;
+	m_valid			= false;
+
+	// the image is shown opaque, whatever its alpha channel says
+	for (size_t f_idx = 3; f_idx < m_source.size(); f_idx += 4)
+		m_source[f_idx] = 0xff;
+}
+
+void BackgroundImage::clear()
+{
+	m_source.clear();
+	m_source_width	= 0;
+	m_source_height = 0;
+	m_valid			= false;
+}
+
+bool BackgroundImage::empty() const
+{
+	return m_source.empty();
+}
+
+const img::ImageView *BackgroundImage::prepare(int p_width, int p_height, img::PixelFormat p_format, bool p_mirror)
+{
+	if (empty() || p_width <= 0 || p_height <= 0)
+		return nullptr;
+
+	if (m_valid && m_view.m_width == p_width && m_view.m_height == p_height && m_view.m_format == p_format && m_mirror == p_mirror)
+		return &m_view;
+
+	m_valid = false;
+
+	// the largest region of the image with the aspect ratio of the output
+	int f_src_w = m_source_width;
+	int f_src_h = m_source_height;
+
+	if (static_cast<int64_t> (f_src_w) * p_height > static_cast<int64_t> (f_src_h) * p_width)
+		f_src_w = std::max(1, static_cast<int> ((static_cast<int64_t> (f_src_h) * p_width) / p_height));
+	else
+		f_src_h = std::max(1, static_cast<int> ((static_cast<int64_t> (f_src_w) * p_height) / p_width));
+
+	const int f_src_x = (m_source_width - f_src_w) / 2;
+	const int f_src_y = (m_source_height - f_src_h) / 2;
+
+	const img::ImageView f_source = img::packed_view(m_source.data(), m_source_width, m_source_height, img::PF_BGRA32);
+
+	// YUY2 can't be converted to directly : go through NV12 and share the chroma of each pair of rows
+	const img::PixelFormat f_format = (p_format == img::PF_YUY2) ? img::PF_NV12 : p_format;
+
+	std::vector<unsigned char> &f_scaled = (p_format == img::PF_YUY2) ? m_temp : m_converted;
+	f_scaled.resize(image_size(f_format, p_width, p_height));
+
+	const img::ImageView f_scaled_view = img::packed_view(f_scaled.data(), p_width, p_height, f_format);
+
+	if (!img::scale_region(f_source, nullptr, f_src_x, f_src_y, f_src_w, f_src_h, f_scaled_view, img::SCALE_AREA, false, p_mirror))
+		return nullptr;
+
+	if (p_format == img::PF_YUY2)
+	{
+		m_converted.resize(image_size(img::PF_YUY2, p_width, p_height));
+
+		const unsigned char *f_uv = m_temp.data() + (p_width * p_height);
+
+		for (int f_y = 0; f_y < p_height; ++f_y)
+		{
+			const unsigned char *f_src_y  = m_temp.data() + (f_y * p_width);
+			const unsigned char *f_src_uv = f_uv + ((f_y / 2) * p_width);
+			unsigned char *		 f_dst	  = m_converted.data() + (f_y * p_width * 2);
+
+			for (int f_x = 0; f_x < p_width; f_x += 2)
+			{
+				f_dst[f_x * 2]		 = f_src_y[f_x];
+				f_dst[(f_x * 2) + 1] = f_src_uv[f_x];
+				f_dst[(f_x * 2) + 2] = f_src_y[f_x + 1];
+				f_dst[(f_x * 2) + 3] = f_src_uv[f_x + 1];
+			}
+		}
+
+		m_temp.clear();
+		m_temp.shrink_to_fit();
+	}
+
+	m_view	 = img::packed_view(m_converted.data(), p_width, p_height, p_format);
+	m_mirror = p_mirror;
+	m_valid	 = true;
+
+	return &m_view;
+}
+
+//
+// background blur
+//
+
+namespace {
+
+struct BlurLevel
+{
+	int	m_factor;		// the blur runs on an image this many times smaller than the output (a power of 2)
+	int	m_radius;		// of the box filter, in pixels of the small image
+	int	m_passes;		// box filters : three passes are close to a gaussian
+};
+
+const BlurLevel g_blur_levels[] =
+{
+	{8, 2, 1},			// low
+	{4, 3, 2},			// medium
+	{4, 5, 3}			// high
+};
+
+// a box filter over the 4 byte elements of p_image, first horizontally (into p_temp), then vertically (back into p_image)
+void box_blur(unsigned char *p_image, unsigned char *p_temp, int p_elements, int p_rows, int p_radius)
+{
+	const auto &f_kernels = img::kernels::row_kernels();
+	const int	f_count	  = (p_radius * 2) + 1;
+	const int	f_recip	  = img::kernels::box_recip(f_count);
+	const int	f_stride  = p_elements * 4;
+
+	parallel::for_each_stripe(p_rows, f_stride, [&](int p_begin, int p_end) {
+		for (int f_y = p_begin; f_y < p_end; ++f_y)
+			f_kernels.m_blur_cols(p_image + (f_y * f_stride), p_radius, f_recip, p_temp + (f_y * f_stride), p_elements);
+	});
+
+	parallel::for_each_stripe(p_rows, f_stride * f_count, [&](int p_begin, int p_end) {
+		const unsigned char *f_rows[15];
+
+		for (int f_y = p_begin; f_y < p_end; ++f_y)
+		{
+			for (int f_r = 0; f_r < f_count; ++f_r)
+				f_rows[f_r] = p_temp + (std::min(std::max(f_y - p_radius + f_r, 0), p_rows - 1) * f_stride);
+
+			f_kernels.m_blur_rows(f_rows, f_count, f_recip, p_image + (f_y * f_stride), f_stride);
+		}
+	});
+}
+
+// scale an image of 4 byte elements up 2x in both directions
+void upsample_2x(const unsigned char *p_src, int p_elements, int p_rows, unsigned char *p_dst)
+{
+	const auto &f_kernels	 = img::kernels::row_kernels();
+	const int	f_src_stride = p_elements * 4;
+	const int	f_dst_stride = p_elements * 8;
+
+	parallel::for_each_stripe(p_rows * 2, f_dst_stride, [&](int p_begin, int p_end) {
+		for (int f_y = p_begin; f_y < p_end; ++f_y)
+		{
+			// the even rows lean towards the row above, the odd rows towards the row below
+			const int f_near = f_y / 2;
+			const int f_far	 = (f_y & 1) ? std::min(f_near + 1, p_rows - 1) : std::max(f_near - 1, 0);
+
+			f_kernels.m_upsample_2x(p_src + (f_near * f_src_stride), p_src + (f_far * f_src_stride), p_dst + (f_y * f_dst_stride), p_elements);
+		}
+	});
+}
+
+} // unnamed namespace
+
+BackgroundBlur::BackgroundBlur() :	m_level(0),
+									m_view{nullptr, 0, 0, 0, img::PF_BGRA32}
+{
+}
+
+void BackgroundBlur::configure(int p_level)
+{
+	m_level = std::min(std::max(p_level, 0), static_cast<int> (sizeof(g_blur_levels) / sizeof(g_blur_levels[0])));
+
+	// release the memory when the blur isn't used
+	if (m_level == 0)
+	{
+		std::vector<unsigned char>().swap(m_small);
+		std::vector<unsigned char>().swap(m_temp);
+		std::vector<unsigned char>().swap(m_up);
+		std::vector<unsigned char>().swap(m_blurred);
+	}
+}
+
+int BackgroundBlur::level() const
+{
+	return m_level;
+}
+
+const img::ImageView *BackgroundBlur::apply(const img::ImageView &p_src, int p_src_x, int p_src_y, int p_src_w, int p_src_h,
+											int p_width, int p_height, img::PixelFormat p_format)
+{
+	if (m_level == 0 || p_width <= 0 || p_height <= 0)
+		return nullptr;
+
+	// the blur works on 4 byte elements : BGRA pixels or YUY2 macropixels
+	if (p_src.m_format != img::PF_BGRA32 && p_src.m_format != img::PF_YUY2)
+		return nullptr;
+
+	const BlurLevel &f_level  = g_blur_levels[m_level - 1];
+	const int		 f_bpp	  = (p_src.m_format == img::PF_BGRA32) ? 1 : 2;		// pixels per element
+
+	// when the output is a multiple of the small image, it is scaled up in cheap steps of 2x (the image is blurred anyway)
+	const bool		 f_steps  = (p_width % (f_level.m_factor * 2)) == 0 && (p_height % f_level.m_factor) == 0;
+	const int		 f_width  = (f_steps) ? p_width / f_level.m_factor : std::max(4, (p_width / f_level.m_factor) & ~1);
+	const int		 f_height = (f_steps) ? p_height / f_level.m_factor : std::max(2, p_height / f_level.m_factor);
+	const int		 f_elements = f_width / f_bpp;
+
+	m_small.resize(image_size(p_src.m_format, f_width, f_height));
+	m_temp.resize(m_small.size());
+
+	const img::ImageView f_small = img::packed_view(m_small.data(), f_width, f_height, p_src.m_format);
+
+	if (!img::scale_region(p_src, nullptr, p_src_x, p_src_y, p_src_w, p_src_h, f_small, img::SCALE_AREA))
+		return nullptr;
+
+	for (int f_pass = 0; f_pass < f_level.m_passes; ++f_pass)
+		box_blur(m_small.data(), m_temp.data(), f_elements, f_height, f_level.m_radius);
+
+	m_blurred.resize(image_size(p_format, p_width, p_height));
+	m_view = img::packed_view(m_blurred.data(), p_width, p_height, p_format);
+
+	if (!f_steps)
+		return (img::scale_region(f_small, nullptr, 0, 0, f_width, f_height, m_view, img::SCALE_BILINEAR)) ? &m_view : nullptr;
+
+	// the last step writes straight into the output when it has the format of the source, otherwise the result is converted
+	unsigned char *		 f_src		= m_small.data();
+	int					 f_step_els = f_elements;
+	int					 f_step_h	= f_height;
+
+	for (int f_factor = f_level.m_factor; f_factor > 1; f_factor /= 2)
+	{
+		const bool					f_last = (f_factor == 2);
+		std::vector<unsigned char> &f_buf  = (f_src == m_up.data()) ? m_temp : m_up;
+		unsigned char *				f_dst  = nullptr;
+
+		if (f_last && p_format == p_src.m_format)
+		{
+			f_dst = m_blurred.data();
+		}
+		else
+		{
+			f_buf.resize(static_cast<size_t> (f_step_els) * f_step_h * 16);
+			f_dst = f_buf.data();
+		}
+
+		upsample_2x(f_src, f_step_els, f_step_h, f_dst);
+
+		f_src		= f_dst;
+		f_step_els *= 2;
+		f_step_h   *= 2;
+	}
+
+	if (p_format != p_src.m_format)
+	{
+		const img::ImageView f_full = img::packed_view(f_src, p_width, p_height, p_src.m_format);
+
+		if (!img::copy_region(f_full, nullptr, 0, 0, m_view))
+			return nullptr;
+	}
+
+	return &m_view;
+}
+
+} // namespace keying
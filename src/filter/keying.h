@@ -0,0 +1,162 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	keying.h
+//
+// Purpose	: 	separate the people in front of the sensor from the background
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef KW_KEYING_H
+#define KW_KEYING_H
+
+#include "image.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace keying {
+
+// a position in the color image (same layout as the ColorSpacePoint of the Kinect v2 SDK)
+struct ColorPoint
+{
+	float	m_x;
+	float	m_y;
+};
+
+// maps every pixel of a depth frame (in millimeters) to the color image
+//	- pixels without a valid position get a coordinate outside of the color image (e.g. -infinity)
+//	- the sensor runtime (ICoordinateMapper::MapDepthFrameToColorSpace) or a CoordinateMapper (see coordinate_mapper.h) can do the work
+typedef std::function<bool (const uint16_t *p_depth, ColorPoint *p_points)> DepthToColorFunc;
+
+// the bodies visible in the depth frame, as a low resolution mask of the color image
+//	- every body pixel of the depth frame is mapped to the color image and marks the mask value it lands on :
+//	  for a 512x424 depth frame that is about 10x fewer mappings than looking up every pixel of a 1080p color image
+//	- the mask has one value for each p_scale x p_scale color pixels, it is interpolated bilinearly and thresholded when it is
+//	  applied (see img::MaskView)
+class LowResBodyMask
+{
+	public :
+		LowResBodyMask();
+
+		void configure(int p_depth_width, int p_depth_height, int p_color_width, int p_color_height, int p_scale);
+
+		// p_body_index has one byte for each depth pixel : 0xff = no body (the Kinect v2 body index frame)
+		bool build(const uint16_t *p_depth, const unsigned char *p_body_index, const DepthToColorFunc &p_mapper);
+
+		img::MaskView view() const;
+
+	private :
+		int							m_depth_width;
+		int							m_depth_height;
+		int							m_scale;
+		int							m_width;
+		int							m_height;
+		std::vector<ColorPoint>		m_points;
+		std::vector<unsigned char>	m_mask;
+};
+
+// refines a hard mask (0 / 0xff) into a soft alpha matte (see img::MaskView::m_soft)
+//	- a morphological close (3x3) fills the small holes and notches of the mask
+//	- a box filter of 2 * radius + 1 values wide and high feathers the edges
+//	- the matte is blended with the matte of the previous frame, so the edges don't flicker with the noise of the depth frame
+//	- the stages are fused : the region is read and written once, every thread keeps a few rows of context
+class SoftMatte
+{
+	public :
+		SoftMatte();
+
+		// p_radius : 1 - 7 mask values, p_weight : the weight of the new frame in 1/128 (64 = half, 128 = no smoothing)
+		void configure(int p_radius, int p_weight);
+
+		// forget the previous frame
+		void reset();
+
+		// refine the region (in mask values) of the hard mask, the matte has the size and the scale of the hard mask
+		//	- the hard mask is only read inside the region, the edges of the region are extended outwards
+		//	- afterwards only the region of the matte is valid
+		bool refine(const img::MaskView &p_hard, int p_x, int p_y, int p_width, int p_height);
+
+		img::MaskView view() const;
+
+	private :
+		int							m_radius;
+		int							m_weight;
+		int							m_width;
+		int							m_height;
+		int							m_scale;
+		bool						m_history;			// the previous frame is in the region below
+		int							m_history_x;
+		int							m_history_y;
+		int							m_history_width;
+		int							m_history_height;
+		std::vector<unsigned char>	m_matte;
+};
+
+// the image that replaces the background of the green screen (see img::MaskView::m_background)
+//	- the image is converted once to the format and the size of the output and kept until the output changes,
+//	  so every frame only has to read it (instead of scaling and converting it again)
+//	- the image covers the output : it is scaled to fill it and cropped in the center when the aspect ratio differs
+class BackgroundImage
+{
+	public :
+		BackgroundImage();
+
+		// p_pixels : PF_BGRA32 without padding, top-down
+		void assign(std::vector<unsigned char> p_pixels, int p_width, int p_height);
+		void clear();
+
+		bool empty() const;
+
+		// the background for an output of this size and format (nullptr without an image)
+		//	- p_mirror : the output is mirrored, the background is stored mirrored so it appears the right way around
+		const img::ImageView *prepare(int p_width, int p_height, img::PixelFormat p_format, bool p_mirror);
+
+	private :
+		std::vector<unsigned char>	m_source;
+		int							m_source_width;
+		int							m_source_height;
+		bool						m_valid;
+		bool						m_mirror;
+		img::ImageView				m_view;
+		std::vector<unsigned char>	m_converted;
+		std::vector<unsigned char>	m_temp;
+};
+
+// blurs the background of the green screen instead of replacing it (see img::MaskView::m_background)
+//	- a blur at output resolution is far too slow : the region is scaled down, blurred with a few box filters and scaled up again
+//	- the level trades the strength of the blur for processing time (1 = low, 2 = medium, 3 = high)
+//	- the working memory is kept from frame to frame
+class BackgroundBlur
+{
+	public :
+		BackgroundBlur();
+
+		// p_level : 0 = off
+		void configure(int p_level);
+		int level() const;
+
+		// the blurred region (p_src_x, p_src_y, p_src_w, p_src_h) of the source, with the size and the format of the output
+		//	- PF_BGRA32 or PF_YUY2 sources, to the formats scale_region can convert them to ; nullptr when it fails or the blur is off
+		//	- the result is top-down and not mirrored, the way the masked copy of the region expects its background
+		const img::ImageView *apply(const img::ImageView &p_src, int p_src_x, int p_src_y, int p_src_w, int p_src_h,
+									int p_width, int p_height, img::PixelFormat p_format);
+
+	private :
+		int							m_level;
+		std::vector<unsigned char>	m_small;
+		std::vector<unsigned char>	m_temp;
+		std::vector<unsigned char>	m_up;
+		std::vector<unsigned char>	m_blurred;
+		img::ImageView				m_view;
+};
+
+} // namespace keying
+
+#endif // KW_KEYING_H
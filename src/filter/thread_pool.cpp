@@ -0,0 +1,275 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	thread_pool.cpp
+//
+// Purpose	: 	persistent worker threads to process images in row stripes
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "thread_pool.h"
+#include "cpu_features.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef KW_SIMD_X86
+#include <emmintrin.h>
+#endif // KW_SIMD_X86
+
+namespace parallel {
+
+namespace {
+
+// about half of a typical L2 cache : the source rows of a stripe stay in cache while it is processed
+const int		STRIPE_BYTES	= 128 * 1024;
+
+// a worker spins this many times for new work before it parks (well below the interval between frames)
+const int		SPIN_COUNT		= 4000;
+
+inline void cpu_relax()
+{
+#ifdef KW_SIMD_X86
+	_mm_pause();
+#else
+	std::this_thread::yield();
+#endif // KW_SIMD_X86
+}
+
+// the claim word : generation (32 bits) | number of stripes (16 bits) | next stripe to process (16 bits)
+//	a worker can only claim a stripe of the job that is currently published, so it never runs a stripe of a stale job
+inline uint32_t claim_next(uint64_t p_claim)		{ return static_cast<uint32_t> (p_claim & 0xffff); }
+inline uint32_t claim_count(uint64_t p_claim)		{ return static_cast<uint32_t> ((p_claim >> 16) & 0xffff); }
+inline bool		claim_has_work(uint64_t p_claim)	{ return claim_next(p_claim) < claim_count(p_claim); }
+
+const int MAX_STRIPES = 0xffff;
+
+} // unnamed namespace
+
+struct ThreadPoolPrivate
+{
+	std::vector<std::thread>	m_workers;
+
+	// the current job (only changed while no stripes are claimed)
+	const StripeFunc *			m_func;
+	int							m_rows;
+	int							m_stripe_rows;
+	uint32_t					m_generation;
+
+	std::atomic<uint64_t>		m_claim;
+	std::atomic<int>			m_done;
+
+	// parking
+	std::mutex					m_park_lock;
+	std::condition_variable		m_park_wakeup;
+	std::atomic<int>			m_parked;
+	std::atomic<bool>			m_stop;
+
+	// only one thread can submit work at a time
+	std::mutex					m_submit_lock;
+
+	// claim and process stripes until there are none left
+	void process_stripes()
+	{
+		uint64_t f_claim = m_claim.load();
+
+		while (claim_has_work(f_claim))
+		{
+			if (!m_claim.compare_exchange_weak(f_claim, f_claim + 1))
+				continue;
+
+			const int f_begin = static_cast<int> (claim_next(f_claim)) * m_stripe_rows;
+			const int f_end	  = (f_begin + m_stripe_rows < m_rows) ? f_begin + m_stripe_rows : m_rows;
+
+			(*m_func)(f_begin, f_end);
+
+			m_done.fetch_add(1);
+			f_claim = m_claim.load();
+		}
+	}
+
+	void worker_main()
+	{
+		while (!m_stop.load())
+		{
+			// spin for a while : the image functions of one frame are submitted back to back
+			bool f_work = false;
+
+			for (int f_spin = 0; !f_work && f_spin < SPIN_COUNT; ++f_spin)
+			{
+				f_work = claim_has_work(m_claim.load()) || m_stop.load();
+
+				if (!f_work)
+					cpu_relax();
+			}
+
+			// then park until new work is published
+			if (!f_work)
+			{
+				std::unique_lock<std::mutex> f_lock(m_park_lock);
+				m_parked.fetch_add(1);
+				m_park_wakeup.wait(f_lock, [this]() {return claim_has_work(m_claim.load()) || m_stop.load();});
+				m_parked.fetch_sub(1);
+			}
+
+			process_stripes();
+		}
+	}
+
+	void wake_parked_workers()
+	{
+		if (m_parked.load() > 0)
+		{
+			// taking the lock makes sure a worker that is about to park sees the new work or gets the notification
+			{ std::lock_guard<std::mutex> f_lock(m_park_lock); }
+			m_park_wakeup.notify_all();
+		}
+	}
+};
+
+//
+// ThreadPool
+//
+
+ThreadPool::ThreadPool(int p_threads) : m_private(std::make_unique<ThreadPoolPrivate>())
+{
+	m_private->m_func		 = nullptr;
+	m_private->m_rows		 = 0;
+	m_private->m_stripe_rows = 1;
+	m_private->m_generation	 = 0;
+	m_private->m_claim		 = 0;
+	m_private->m_done		 = 0;
+	m_private->m_parked		 = 0;
+	m_private->m_stop		 = false;
+
+	for (int f_idx = 1; f_idx < p_threads; ++f_idx)
+	{
+		m_private->m_workers.emplace_back(&ThreadPoolPrivate::worker_main, m_private.get());
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	m_private->m_stop = true;
+
+	{ std::lock_guard<std::mutex> f_lock(m_private->m_park_lock); }
+	m_private->m_park_wakeup.notify_all();
+
+	for (auto &f_worker : m_private->m_workers)
+		f_worker.join();
+}
+
+int ThreadPool::thread_count() const
+{
+	return static_cast<int> (m_private->m_workers.size()) + 1;
+}
+
+void ThreadPool::run_stripes(int p_rows, int p_stripe_rows, const StripeFunc &p_func)
+{
+	if (p_rows <= 0)
+		return;
+
+	p_stripe_rows = (p_stripe_rows < 1) ? 1 : p_stripe_rows;
+
+	int f_stripes = (p_rows + p_stripe_rows - 1) / p_stripe_rows;
+
+	if (f_stripes > MAX_STRIPES)
+	{
+		p_stripe_rows = (p_rows + MAX_STRIPES - 1) / MAX_STRIPES;
+		f_stripes	  = (p_rows + p_stripe_rows - 1) / p_stripe_rows;
+	}
+
+	// nothing to share or somebody else is using the pool
+	std::unique_lock<std::mutex> f_submit(m_private->m_submit_lock, std::try_to_lock);
+
+	if (m_private->m_workers.empty() || f_stripes == 1 || !f_submit.owns_lock())
+	{
+		p_func(0, p_rows);
+		return;
+	}
+
+	// publish the job : all stripes of the previous job are done, so no worker is reading these fields
+	m_private->m_func		 = &p_func;
+	m_private->m_rows		 = p_rows;
+	m_private->m_stripe_rows = p_stripe_rows;
+	m_private->m_done		 = 0;
+	m_private->m_generation	+= 1;
+	m_private->m_claim		 = (static_cast<uint64_t> (m_private->m_generation) << 32) | (static_cast<uint64_t> (f_stripes) << 16);
+
+	m_private->wake_parked_workers();
+
+	// help out and wait for the stripes that are still being processed by the workers
+	m_private->process_stripes();
+
+	while (m_private->m_done.load() < f_stripes)
+		cpu_relax();
+}
+
+//
+// shared pool
+//
+
+namespace {
+
+std::mutex					g_shared_lock;
+int							g_shared_users = 0;
+std::unique_ptr<ThreadPool>	g_shared_owner;
+std::atomic<ThreadPool *>	g_shared_pool(nullptr);
+
+} // unnamed namespace
+
+void acquire_shared_pool(int p_threads)
+{
+	std::lock_guard<std::mutex> f_lock(g_shared_lock);
+
+	if (g_shared_users++ == 0)
+	{
+		g_shared_owner = std::make_unique<ThreadPool>(p_threads);
+		g_shared_pool  = g_shared_owner.get();
+	}
+}
+
+void release_shared_pool()
+{
+	std::lock_guard<std::mutex> f_lock(g_shared_lock);
+
+	if (g_shared_users > 0 && --g_shared_users == 0)
+	{
+		g_shared_pool = nullptr;
+		g_shared_owner.reset();
+	}
+}
+
+ThreadPool *shared_pool()
+{
+	return g_shared_pool.load();
+}
+
+void for_each_stripe(int p_rows, int p_row_bytes, const StripeFunc &p_func)
+{
+	const int	 f_stripe_rows = (p_row_bytes > 0 && p_row_bytes < STRIPE_BYTES) ? STRIPE_BYTES / p_row_bytes : 1;
+	ThreadPool * f_pool		   = shared_pool();
+
+	if (f_pool)
+		f_pool->run_stripes(p_rows, f_stripe_rows, p_func);
+	else if (p_rows > 0)
+		p_func(0, p_rows);
+}
+
+int default_thread_count()
+{
+	// leave a core for the sensor runtime and the application consuming the video
+	const int f_cores = static_cast<int> (std::thread::hardware_concurrency());
+	return (f_cores > 2) ? f_cores - 1 : 1;
+}
+
+} // namespace parallel
@@ -0,0 +1,77 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	thread_pool.h
+//
+// Purpose	: 	persistent worker threads to process images in row stripes
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef KW_THREAD_POOL_H
+#define KW_THREAD_POOL_H
+
+#include <memory>
+
+namespace parallel {
+
+// processes the rows [p_begin, p_end)
+//	- refers to the callable it is made from (nothing is copied or allocated) : only valid during the call it is passed to
+class StripeFunc
+{
+	public :
+		template <typename Func>
+		StripeFunc(const Func &p_func) :
+			m_func(&p_func),
+			m_call([](const void *p_target, int p_begin, int p_end) {(*static_cast<const Func *> (p_target))(p_begin, p_end);})
+		{
+		}
+
+		void operator()(int p_begin, int p_end) const
+		{
+			m_call(m_func, p_begin, p_end);
+		}
+
+	private :
+		const void *	m_func;
+		void			(*m_call) (const void *p_target, int p_begin, int p_end);
+};
+
+class ThreadPool
+{
+	public :
+		// p_threads includes the thread that submits the work : a pool of 1 thread has no workers and runs everything inline
+		explicit ThreadPool(int p_threads);
+		~ThreadPool();
+
+		int thread_count() const;
+
+		// split p_rows rows into stripes of p_stripe_rows rows and wait until all stripes have been processed
+		//	- the submitting thread processes stripes too
+		//	- when the pool is already busy (submitted from another thread) the work is done inline
+		void run_stripes(int p_rows, int p_stripe_rows, const StripeFunc &p_func);
+
+	private :
+		std::unique_ptr<struct ThreadPoolPrivate>	m_private;
+};
+
+// the pool used by the image functions and the devices
+//	- created by the first acquire, destroyed by the last release (one acquire/release per streaming thread)
+//	- without a pool all the work is done on the calling thread
+void		 acquire_shared_pool(int p_threads);
+void		 release_shared_pool();
+ThreadPool * shared_pool();
+
+// process p_rows rows of p_row_bytes bytes each in cache-sized stripes on the shared pool
+void for_each_stripe(int p_rows, int p_row_bytes, const StripeFunc &p_func);
+
+// a reasonable default number of threads for this machine (always at least 1)
+int default_thread_count();
+
+} // namespace parallel
+
+#endif // KW_THREAD_POOL_H
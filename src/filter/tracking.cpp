@@ -0,0 +1,408 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	tracking.cpp
+//
+// Purpose	: 	follow the tracked person with the visible part of the color image
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "tracking.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace tracking {
+
+namespace {
+
+const float PI = 3.14159265f;
+
+// a gap in the measurements (e.g. the person was lost for a while) counts as a single long frame
+const float MAX_TIME_STEP = 0.25f;
+
+// one euro : the cutoff (Hz) when the focus stands still, how fast it rises with the speed (pixels / s) and the cutoff of the speed
+const float ONE_EURO_MIN_CUTOFF		= 1.0f;
+const float ONE_EURO_BETA			= 0.005f;
+const float ONE_EURO_SPEED_CUTOFF	= 1.0f;
+
+// spring : the natural frequency (rad / s), settles within about 4 / SPRING_OMEGA seconds
+const float SPRING_OMEGA = 8.0f;
+
+// moving average : the window (seconds)
+const double AVERAGE_WINDOW = 1.0;
+
+// prediction : the cutoff (Hz) of the velocity and the speed
+const float PREDICTION_CUTOFF = 2.0f;
+
+// camera operator : a pan ends when the crop is this close to the focus (pixels)
+const float OPERATOR_SETTLE_DISTANCE = 1.0f;
+
+// the weight of a new value for an exponential low pass with the given cutoff (Hz)
+inline float low_pass_alpha(float p_cutoff, float p_dt)
+{
+	const float f_tau = 1.0f / (2.0f * PI * p_cutoff);
+	return 1.0f / (1.0f + (f_tau / p_dt));
+}
+
+inline void one_euro_update(float p_measured, float p_dt, float &p_value, float &p_speed)
+{
+	const float f_speed = (p_measured - p_value) / p_dt;
+
+	p_speed += low_pass_alpha(ONE_EURO_SPEED_CUTOFF, p_dt) * (f_speed - p_speed);
+
+	const float f_cutoff = ONE_EURO_MIN_CUTOFF + (ONE_EURO_BETA * std::abs(p_speed));
+	p_value += low_pass_alpha(f_cutoff, p_dt) * (p_measured - p_value);
+}
+
+// the exact solution for a target that stays put during the step : stable for any time step
+inline void spring_update(float p_target, float p_dt, float &p_value, float &p_velocity)
+{
+	const float f_offset = p_value - p_target;
+	const float f_temp	 = (p_velocity + (SPRING_OMEGA * f_offset)) * p_dt;
+	const float f_decay	 = std::exp(-SPRING_OMEGA * p_dt);
+
+	p_value	   = p_target + ((f_offset + f_temp) * f_decay);
+	p_velocity = (p_velocity - (SPRING_OMEGA * f_temp)) * f_decay;
+}
+
+} // unnamed namespace
+
+//
+// FocusFilter
+//
+
+FocusFilter::FocusFilter() :	m_type(FFT_ONE_EURO),
+								m_valid(false),
+								m_time(0.0),
+								m_first(0),
+								m_count(0),
+								m_sum_x(0.0),
+								m_sum_y(0.0)
+{
+	m_x = {0.0f, 0.0f};
+	m_y = {0.0f, 0.0f};
+}
+
+void FocusFilter::set_type(FocusFilterType p_type)
+{
+	if (p_type != m_type)
+	{
+		m_type = p_type;
+		reset();
+	}
+}
+
+FocusFilterType FocusFilter::type() const
+{
+	return m_type;
+}
+
+void FocusFilter::reset()
+{
+	m_valid = false;
+	m_first = 0;
+	m_count = 0;
+	m_sum_x = 0.0;
+	m_sum_y = 0.0;
+}
+
+FocusPoint FocusFilter::update(FocusPoint p_focus, double p_time)
+{
+	if (!m_valid)
+	{
+		m_valid = true;
+		m_time	= p_time;
+		m_x		= {p_focus.m_x, 0.0f};
+		m_y		= {p_focus.m_y, 0.0f};
+
+		if (m_type == FFT_MOVING_AVERAGE)
+			average_push(p_focus, p_time);
+
+		return p_focus;
+	}
+
+	// the same frame again (or a clock that went back) : nothing to filter
+	if (p_time <= m_time)
+		return value();
+
+	const float f_dt = std::min(static_cast<float> (p_time - m_time), MAX_TIME_STEP);
+	m_time = p_time;
+
+	switch (m_type)
+	{
+		case FFT_ONE_EURO :
+			one_euro_update(p_focus.m_x, f_dt, m_x.m_value, m_x.m_velocity);
+			one_euro_update(p_focus.m_y, f_dt, m_y.m_value, m_y.m_velocity);
+			break;
+
+		case FFT_SPRING :
+			spring_update(p_focus.m_x, f_dt, m_x.m_value, m_x.m_velocity);
+			spring_update(p_focus.m_y, f_dt, m_y.m_value, m_y.m_velocity);
+			break;
+
+		case FFT_MOVING_AVERAGE :
+			average_push(p_focus, p_time);
+			m_x.m_value = static_cast<float> (m_sum_x / m_count);
+			m_y.m_value = static_cast<float> (m_sum_y / m_count);
+			break;
+	}
+
+	return value();
+}
+
+bool FocusFilter::valid() const
+{
+	return m_valid;
+}
+
+FocusPoint FocusFilter::value() const
+{
+	return {m_x.m_value, m_y.m_value};
+}
+
+void FocusFilter::average_push(FocusPoint p_focus, double p_time)
+{
+	// drop the samples that left the window (or the oldest one to make room) : every sample is added and removed once
+	//	(the sums are exact : a double holds the sum of a window of floats in the range of the color image without rounding)
+	while (m_count > 0 && (m_count == AVERAGE_CAPACITY || m_samples[m_first].m_time <= p_time - AVERAGE_WINDOW))
+	{
+		m_sum_x -= m_samples[m_first].m_point.m_x;
+		m_sum_y -= m_samples[m_first].m_point.m_y;
+		m_first	 = (m_first + 1) % AVERAGE_CAPACITY;
+		--m_count;
+	}
+
+	m_samples[(m_first + m_count) % AVERAGE_CAPACITY] = {p_focus, p_time};
+	m_sum_x += p_focus.m_x;
+	m_sum_y += p_focus.m_y;
+	++m_count;
+}
+
+//
+// FocusPredictor
+//
+
+FocusPredictor::FocusPredictor() :	m_valid(false),
+									m_time(0.0),
+									m_velocity_x(0.0f),
+									m_velocity_y(0.0f),
+									m_speed(0.0f)
+{
+	m_settings	= {0.1f, 100.0f, 0.3f};
+	m_last		= {0.0f, 0.0f};
+}
+
+void FocusPredictor::configure(const PredictionSettings &p_settings)
+{
+	m_settings					= p_settings;
+	m_settings.m_min_confidence	= std::min(std::max(p_settings.m_min_confidence, 0.0f), 0.95f);
+}
+
+void FocusPredictor::reset()
+{
+	m_valid = false;
+}
+
+FocusPoint FocusPredictor::update(FocusPoint p_focus, double p_measured, double p_target)
+{
+	if (!m_valid || p_measured - m_time > MAX_TIME_STEP || p_measured < m_time)
+	{
+		// the first measurement (or the first one after a gap, or of a sensor that was opened again) : no motion yet
+		m_valid		 = true;
+		m_time		 = p_measured;
+		m_last		 = p_focus;
+		m_velocity_x = 0.0f;
+		m_velocity_y = 0.0f;
+		m_speed		 = 0.0f;
+	}
+	else if (p_measured > m_time)
+	{
+		const float f_dt	= static_cast<float> (p_measured - m_time);
+		const float f_vx	= (p_focus.m_x - m_last.m_x) / f_dt;
+		const float f_vy	= (p_focus.m_y - m_last.m_y) / f_dt;
+		const float f_alpha = low_pass_alpha(PREDICTION_CUTOFF, f_dt);
+
+		m_velocity_x += f_alpha * (f_vx - m_velocity_x);
+		m_velocity_y += f_alpha * (f_vy - m_velocity_y);
+		m_speed		 += f_alpha * (std::sqrt((f_vx * f_vx) + (f_vy * f_vy)) - m_speed);
+		m_time		  = p_measured;
+		m_last		  = p_focus;
+	}
+
+	// confidence clamping : below the minimum nothing is extrapolated, above it the extrapolation fades in
+	const float f_confidence = confidence();
+
+	if (f_confidence <= m_settings.m_min_confidence)
+		return m_last;
+
+	const float f_weight = (f_confidence - m_settings.m_min_confidence) / (1.0f - m_settings.m_min_confidence);
+	const float f_span	 = std::min(std::max(static_cast<float> (p_target - m_time), 0.0f), m_settings.m_horizon) * f_weight;
+
+	float f_dx	 = m_velocity_x * f_span;
+	float f_dy	 = m_velocity_y * f_span;
+	float f_dist = std::sqrt((f_dx * f_dx) + (f_dy * f_dy));
+
+	if (f_dist > m_settings.m_max_offset)
+	{
+		f_dx *= m_settings.m_max_offset / f_dist;
+		f_dy *= m_settings.m_max_offset / f_dist;
+	}
+
+	return {m_last.m_x + f_dx, m_last.m_y + f_dy};
+}
+
+float FocusPredictor::confidence() const
+{
+	if (!m_valid || m_speed <= 0.0f)
+		return 0.0f;
+
+	return std::min(std::sqrt((m_velocity_x * m_velocity_x) + (m_velocity_y * m_velocity_y)) / m_speed, 1.0f);
+}
+
+//
+// CameraOperator
+//
+
+CameraOperator::CameraOperator() :	m_valid(false),
+									m_time(0.0)
+{
+	m_settings	= {0.0f, 0.0f, 1000.0f, 0.5f};
+	m_x			= {0.0f, 0.0f, false};
+	m_y			= {0.0f, 0.0f, false};
+}
+
+void CameraOperator::configure(const OperatorSettings &p_settings)
+{
+	m_settings				= p_settings;
+	m_settings.m_max_speed	= std::max(p_settings.m_max_speed, 1.0f);
+	m_settings.m_ease_time	= std::max(p_settings.m_ease_time, 0.001f);
+}
+
+void CameraOperator::reset()
+{
+	m_valid = false;
+}
+
+FocusPoint CameraOperator::update(FocusPoint p_focus, double p_time)
+{
+	if (!m_valid)
+	{
+		// start on the focus
+		m_valid = true;
+		m_time	= p_time;
+		m_x		= {p_focus.m_x, 0.0f, false};
+		m_y		= {p_focus.m_y, 0.0f, false};
+	}
+	else if (p_time > m_time)
+	{
+		const float f_dt = std::min(static_cast<float> (p_time - m_time), MAX_TIME_STEP);
+		m_time = p_time;
+
+		update_axis(m_x, p_focus.m_x, m_settings.m_dead_zone_x, f_dt);
+		update_axis(m_y, p_focus.m_y, m_settings.m_dead_zone_y, f_dt);
+	}
+
+	return {m_x.m_position, m_y.m_position};
+}
+
+bool CameraOperator::moving() const
+{
+	return m_x.m_moving || m_y.m_moving;
+}
+
+void CameraOperator::update_axis(Axis &p_axis, float p_target, float p_dead_zone, float p_dt)
+{
+	const float f_offset = p_target - p_axis.m_position;
+
+	// hold still as long as the focus stays within the dead zone
+	if (!p_axis.m_moving)
+	{
+		if (std::abs(f_offset) <= p_dead_zone)
+			return;
+
+		p_axis.m_moving = true;
+	}
+
+	// the fastest speed that can still stop on the target (ease out), reached at a limited acceleration (ease in)
+	const float f_accel		= m_settings.m_max_speed / m_settings.m_ease_time;
+	const float f_stop		= std::sqrt(2.0f * f_accel * std::abs(f_offset));
+	const float f_wanted	= std::min(m_settings.m_max_speed, f_stop) * ((f_offset < 0.0f) ? -1.0f : 1.0f);
+	const float f_change	= f_accel * p_dt;
+
+	p_axis.m_velocity += std::min(std::max(f_wanted - p_axis.m_velocity, -f_change), f_change);
+	p_axis.m_position += p_axis.m_velocity * p_dt;
+
+	// the pan ends on the focus : close enough and slow enough to stop, or about to pass it
+	const float f_remaining = p_target - p_axis.m_position;
+	const bool	f_passed	= f_remaining * f_offset <= 0.0f;
+
+	if (f_passed || (std::abs(f_remaining) <= OPERATOR_SETTLE_DISTANCE && std::abs(p_axis.m_velocity) <= f_change))
+	{
+		if (f_passed)
+			p_axis.m_position = p_target;
+
+		p_axis.m_velocity = 0.0f;
+		p_axis.m_moving	  = false;
+	}
+}
+
+//
+// framing
+//
+
+Framing frame_bodies(const FramingBody *p_bodies, int p_count, const FramingRules &p_rules, int p_output_width, int p_output_height, float p_max_zoom)
+{
+	const Framing f_none = {{0.0f, 0.0f}, 1.0f};
+
+	if (p_count <= 0 || p_output_width <= 0 || p_output_height <= 0)
+		return f_none;
+
+	bool  f_any	   = false;
+	float f_left   = 0.0f;
+	float f_right  = 0.0f;
+	float f_top	   = 0.0f;
+	float f_bottom = 0.0f;
+
+	for (int f_idx = 0; f_idx < p_count; ++f_idx)
+	{
+		const FramingBody &f_body = p_bodies[f_idx];
+
+		// a joint the sensor couldn't map has no place in the box
+		if (!std::isfinite(f_body.m_focus.m_x) || !std::isfinite(f_body.m_focus.m_y) || !std::isfinite(f_body.m_scale))
+			continue;
+
+		if (!f_any)
+		{
+			f_any	 = true;
+			f_left	 = f_body.m_focus.m_x;
+			f_right	 = f_left;
+			f_top	 = f_body.m_focus.m_y;
+			f_bottom = f_top;
+		}
+
+		f_left	 = std::min(f_left,	  f_body.m_focus.m_x - (p_rules.m_side * f_body.m_scale));
+		f_right	 = std::max(f_right,  f_body.m_focus.m_x + (p_rules.m_side * f_body.m_scale));
+		f_top	 = std::min(f_top,	  f_body.m_focus.m_y - (p_rules.m_above * f_body.m_scale));
+		f_bottom = std::max(f_bottom, f_body.m_focus.m_y + (p_rules.m_below * f_body.m_scale));
+	}
+
+	if (!f_any)
+		return f_none;
+
+	// the zoom at which the crop holds the box in either direction
+	const float f_zoom_hor = (f_right - f_left) / p_output_width;
+	const float f_zoom_ver = (f_bottom - f_top) / p_output_height;
+
+	Framing f_result;
+	f_result.m_center = {(f_left + f_right) * 0.5f, (f_top + f_bottom) * 0.5f};
+	f_result.m_zoom	  = std::min(std::max(std::max(f_zoom_hor, f_zoom_ver), 1.0f), std::max(p_max_zoom, 1.0f));
+	return f_result;
+}
+
+} // namespace tracking
@@ -0,0 +1,198 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	tracking.h
+//
+// Purpose	: 	follow the tracked person with the visible part of the color image
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef KW_TRACKING_H
+#define KW_TRACKING_H
+
+namespace tracking {
+
+// a position in the color image (in pixels)
+struct FocusPoint
+{
+	float	m_x;
+	float	m_y;
+};
+
+// how the focus point is smoothed (values of the TrackingFilter setting)
+enum FocusFilterType
+{
+	FFT_ONE_EURO		= 0,		// low pass with a cutoff that rises with the speed : steady when still, little lag when moving
+	FFT_SPRING			= 1,		// critically damped spring : glides to the measurements without overshooting
+	FFT_MOVING_AVERAGE	= 2			// average over a fixed time window : lags by half the window
+};
+
+// smooths the jittery focus point of the body tracking
+//	- every update is O(1) and uses the time between the measurements : the result does not depend on the frame rate
+//	- the first measurement after a reset is passed on unchanged
+class FocusFilter
+{
+	public :
+		FocusFilter();
+
+		// switching to another type of filter starts over
+		void set_type(FocusFilterType p_type);
+		FocusFilterType type() const;
+
+		void reset();
+
+		// filter a new measurement taken at p_time (seconds, from any origin but increasing)
+		FocusPoint update(FocusPoint p_focus, double p_time);
+
+		bool valid() const;
+		FocusPoint value() const;
+
+	private :
+		// the state of a single axis
+		struct Axis
+		{
+			float	m_value;
+			float	m_velocity;			// one euro : the smoothed derivative, spring : its velocity
+		};
+
+		struct Sample
+		{
+			FocusPoint	m_point;
+			double		m_time;
+		};
+
+		static const int AVERAGE_CAPACITY = 128;	// more than the window holds at the highest frame rate
+
+		void average_push(FocusPoint p_focus, double p_time);
+
+	private :
+		FocusFilterType	m_type;
+		bool			m_valid;
+		double			m_time;
+		Axis			m_x;
+		Axis			m_y;
+
+		// moving average : the samples in the window and their running sum
+		Sample			m_samples[AVERAGE_CAPACITY];
+		int				m_first;
+		int				m_count;
+		double			m_sum_x;
+		double			m_sum_y;
+};
+
+// how far the focus may be extrapolated
+struct PredictionSettings
+{
+	float	m_horizon;				// seconds ahead of the measurement, at most
+	float	m_max_offset;			// pixels away from the measurement, at most
+	float	m_min_confidence;		// motion that is less consistent is not extrapolated (0 - 1)
+};
+
+// makes up for the latency of the body tracking : extrapolates the focus point to the time the video frame is shown
+//	- the velocity of the joint is low passed, the confidence is how consistent the motion is (the length of the average
+//	  velocity over the average speed) : steady motion is extrapolated fully, jitter and sudden turns hardly at all
+//	- a measurement is known by its time : a body frame that is passed again with the same time (the body frame rate
+//	  can be lower than the video frame rate) doesn't update the velocity, it is only extrapolated further
+class FocusPredictor
+{
+	public :
+		FocusPredictor();
+
+		void configure(const PredictionSettings &p_settings);
+		void reset();
+
+		// p_focus was measured at p_measured, the prediction is for p_target (seconds, the clock of the sensor : the timestamps
+		// of the body frame and of the color frame, see device::Device::focus_time) ; a target before the measurement isn't extrapolated
+		FocusPoint update(FocusPoint p_focus, double p_measured, double p_target);
+
+		float confidence() const;
+
+	private :
+		PredictionSettings	m_settings;
+		bool				m_valid;
+		double				m_time;				// of the last measurement
+		FocusPoint			m_last;
+		float				m_velocity_x;		// low passed velocity (pixels / s)
+		float				m_velocity_y;
+		float				m_speed;			// low passed length of the velocity
+};
+
+// how the camera operator moves the crop
+struct OperatorSettings
+{
+	float	m_dead_zone_x;				// pixels : the focus can move this far from the center of the crop before it pans
+	float	m_dead_zone_y;
+	float	m_max_speed;				// pixels / s
+	float	m_ease_time;				// seconds to speed up to the maximum speed (and to slow down from it)
+};
+
+// moves the crop like a camera operator would : the crop stays put while the focus moves within the dead zone around
+// its center, once the focus leaves it the crop eases in, pans at a limited speed and eases out on the focus
+//	- a crop that stays put lets everything that is keyed on the crop (mask region, scaler, background) be reused
+//	- the axes move independently, every update is O(1)
+class CameraOperator
+{
+	public :
+		CameraOperator();
+
+		void configure(const OperatorSettings &p_settings);
+		void reset();
+
+		// the center of the crop for the focus at p_time (seconds)
+		FocusPoint update(FocusPoint p_focus, double p_time);
+
+		bool moving() const;
+
+	private :
+		struct Axis
+		{
+			float	m_position;
+			float	m_velocity;
+			bool	m_moving;
+		};
+
+		void update_axis(Axis &p_axis, float p_target, float p_dead_zone, float p_dt);
+
+	private :
+		OperatorSettings	m_settings;
+		bool				m_valid;
+		double				m_time;
+		Axis				m_x;
+		Axis				m_y;
+};
+
+// a person to keep in view : its focus joint and its size in the image
+struct FramingBody
+{
+	FocusPoint	m_focus;
+	float		m_scale;				// pixels per meter at the distance of the person
+};
+
+// the part of a person that is kept in view, in meters around the focus joint (made for the head)
+struct FramingRules
+{
+	float	m_above;					// headroom above the joint
+	float	m_below;					// down to the chest
+	float	m_side;						// to either side
+};
+
+struct Framing
+{
+	FocusPoint	m_center;				// the center of the crop
+	float		m_zoom;					// the size of the crop relative to the output (see device::focus_region)
+};
+
+// the smallest crop with the aspect ratio of the output that keeps everyone in view
+//	- the box around all people (with the margins of the rules) is centered, the zoom is limited to [1, p_max_zoom] :
+//	  when everyone doesn't fit, the middle of the group stays in view
+//	- a single pass over the bodies, bodies with a focus or scale that isn't finite are left out
+Framing frame_bodies(const FramingBody *p_bodies, int p_count, const FramingRules &p_rules, int p_output_width, int p_output_height, float p_max_zoom);
+
+} // namespace tracking
+
+#endif // KW_TRACKING_H
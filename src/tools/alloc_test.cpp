@@ -0,0 +1,223 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	alloc_test.cpp
+//
+// Purpose	: 	check that the per-frame image processing doesn't allocate memory once it has warmed up
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// usage : alloc_test
+//
+// replaces the global operator new with one that counts the allocations, then runs the work of a frame over and over :
+//	- copies and scaled copies (a zoom that changes every frame) to all output formats, with and without flip and mirror
+//	- hard, low resolution and soft masks, black, a background image or a blurred background behind them
+// the working memory grows during the first frames (every thread sizes its own), after that a frame may not allocate at all :
+//	- without workers : the second round of frames may not allocate
+//	- with workers : a worker only sizes its memory when it gets to process a stripe, a round without allocations has to follow soon
+
+#include "image.h"
+#include "keying.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace {
+
+std::atomic<bool>	g_counting(false);
+std::atomic<int>	g_allocations(0);
+
+void *counted_alloc(std::size_t p_size)
+{
+	if (g_counting.load())
+		g_allocations.fetch_add(1);
+
+	void *f_result = std::malloc((p_size > 0) ? p_size : 1);
+
+	if (!f_result)
+		throw std::bad_alloc();
+
+	return f_result;
+}
+
+} // unnamed namespace
+
+void *operator new(std::size_t p_size)							{ return counted_alloc(p_size); }
+void *operator new[](std::size_t p_size)						{ return counted_alloc(p_size); }
+void operator delete(void *p_ptr) noexcept						{ std::free(p_ptr); }
+void operator delete[](void *p_ptr) noexcept					{ std::free(p_ptr); }
+void operator delete(void *p_ptr, std::size_t) noexcept			{ std::free(p_ptr); }
+void operator delete[](void *p_ptr, std::size_t) noexcept		{ std::free(p_ptr); }
+
+namespace {
+
+const int WIDTH			= 640;
+const int HEIGHT		= 480;
+const int MASK_SCALE	= 4;
+const int ROUND_FRAMES	= 8;
+
+struct Image
+{
+	std::vector<unsigned char>	m_pixels;
+	img::ImageView				m_view;
+
+	Image(int p_width, int p_height, img::PixelFormat p_format) :
+		m_pixels(img::packed_stride(p_format, p_width) * p_height * 2)
+	{
+		for (size_t f_i = 0; f_i < m_pixels.size(); ++f_i)
+			m_pixels[f_i] = static_cast<unsigned char> ((f_i * 7) ^ (f_i >> 9));
+
+		m_view = img::packed_view(m_pixels.data(), p_width, p_height, p_format);
+	}
+};
+
+// an output stream : its format doesn't change, so the background is converted once
+struct Output
+{
+	Image					m_image;
+	keying::BackgroundImage	m_background;
+	keying::BackgroundBlur	m_blur;
+
+	explicit Output(img::PixelFormat p_format) : m_image(WIDTH, HEIGHT, p_format)
+	{
+		std::vector<unsigned char> f_picture(WIDTH * HEIGHT * 4, 0x40);
+		m_background.assign(std::move(f_picture), WIDTH, HEIGHT);
+		m_blur.configure(2);
+	}
+};
+
+class Frames
+{
+	public :
+		Frames() :
+			m_bgra(WIDTH, HEIGHT, img::PF_BGRA32),
+			m_yuy2(WIDTH, HEIGHT, img::PF_YUY2),
+			m_hard((WIDTH / MASK_SCALE) * (HEIGHT / MASK_SCALE)),
+			m_frame(0)
+		{
+			// a body in the middle of the mask
+			for (int f_y = 0; f_y < HEIGHT / MASK_SCALE; ++f_y)
+			{
+				for (int f_x = 0; f_x < WIDTH / MASK_SCALE; ++f_x)
+				{
+					const int f_dx = f_x - (WIDTH / MASK_SCALE / 2);
+					const int f_dy = f_y - (HEIGHT / MASK_SCALE / 2);
+					m_hard[(f_y * (WIDTH / MASK_SCALE)) + f_x] = ((f_dx * f_dx) + (f_dy * f_dy) < 1200) ? 0xff : 0;
+				}
+			}
+
+			for (auto f_format : {img::PF_BGRA32, img::PF_BGR24, img::PF_YUY2, img::PF_NV12, img::PF_I420})
+				m_outputs.emplace_back(new Output(f_format));
+
+			m_matte.configure(3, 64);
+		}
+
+		// the work of one frame, returns false when one of the functions fails
+		bool run()
+		{
+			bool f_ok = true;
+
+			const img::MaskView f_hard = {m_hard.data(), WIDTH / MASK_SCALE, HEIGHT / MASK_SCALE, WIDTH / MASK_SCALE, MASK_SCALE, false, nullptr};
+			f_ok = m_matte.refine(f_hard, 0, 0, WIDTH / MASK_SCALE, HEIGHT / MASK_SCALE) && f_ok;
+
+			// a zoom that moves every frame : more region sizes than the scaler keeps coefficients for
+			const int f_step  = m_frame % 7;
+			const int f_crop_w = WIDTH - (32 * f_step);
+			const int f_crop_h = HEIGHT - (24 * f_step);
+			const int f_crop_x = (WIDTH - f_crop_w) / 2;
+			const int f_crop_y = (HEIGHT - f_crop_h) / 2;
+			const bool f_flip  = (m_frame & 1) != 0;
+
+			for (auto &f_output : m_outputs)
+			{
+				const img::ImageView &	f_dst	 = f_output->m_image.m_view;
+				const img::PixelFormat	f_format = f_dst.m_format;
+				const img::ImageView &	f_src	 = (f_format != img::PF_YUY2) ? m_bgra.m_view : m_yuy2.m_view;
+
+				img::MaskView f_soft = m_matte.view();
+				img::MaskView f_mask = f_hard;
+
+				f_ok = img::copy_region(f_src, nullptr, 0, 0, f_dst, f_flip, !f_flip) && f_ok;
+				f_ok = img::copy_region(f_src, &f_mask, 0, 0, f_dst, f_flip, false) && f_ok;
+
+				f_soft.m_background = f_output->m_background.prepare(WIDTH, HEIGHT, f_format, false);
+				f_ok = f_soft.m_background != nullptr && f_ok;
+				f_ok = img::copy_region(f_src, &f_soft, 0, 0, f_dst, false, f_flip) && f_ok;
+
+				f_soft.m_background = f_output->m_blur.apply(f_src, f_crop_x, f_crop_y, f_crop_w, f_crop_h, WIDTH, HEIGHT, f_format);
+				f_ok = f_soft.m_background != nullptr && f_ok;
+				f_ok = img::scale_region(f_src, &f_soft, f_crop_x, f_crop_y, f_crop_w, f_crop_h, f_dst, img::SCALE_AREA, f_flip, false) && f_ok;
+
+				f_mask.m_background = f_output->m_blur.apply(f_src, 0, 0, WIDTH, HEIGHT, WIDTH, HEIGHT, f_format);
+				f_ok = img::scale_region(f_src, &f_mask, f_crop_x, f_crop_y, f_crop_w, f_crop_h, f_dst, img::SCALE_BILINEAR, false, true) && f_ok;
+			}
+
+			++m_frame;
+			return f_ok;
+		}
+
+	private :
+		Image									m_bgra;
+		Image									m_yuy2;
+		std::vector<unsigned char>				m_hard;
+		std::vector<std::unique_ptr<Output>>	m_outputs;
+		keying::SoftMatte						m_matte;
+		int										m_frame;
+};
+
+// the allocations of a round of frames (-1 when a frame failed)
+int count_round(Frames &p_frames)
+{
+	bool f_ok = true;
+
+	g_allocations = 0;
+	g_counting	  = true;
+
+	for (int f_f = 0; f_f < ROUND_FRAMES; ++f_f)
+		f_ok = p_frames.run() && f_ok;
+
+	g_counting = false;
+	return (f_ok) ? g_allocations.load() : -1;
+}
+
+// p_rounds : the number of rounds the memory of the threads may take to settle
+bool test_pool(int p_threads, int p_rounds)
+{
+	parallel::acquire_shared_pool(p_threads);
+
+	Frames f_frames;
+	int	   f_first = count_round(f_frames);
+	int	   f_last  = f_first;
+	int	   f_round = 1;
+
+	for (; f_round <= p_rounds && f_last != 0; ++f_round)
+		f_last = count_round(f_frames);
+
+	parallel::release_shared_pool();
+
+	printf("%d thread(s) : %d allocations while warming up, %d in round %d\n", p_threads, f_first, f_last, f_round - 1);
+	return f_first >= 0 && f_last == 0;
+}
+
+} // unnamed namespace
+
+int main()
+{
+	bool f_ok = true;
+
+	f_ok = test_pool(1, 1) && f_ok;
+	f_ok = test_pool(4, 50) && f_ok;
+
+	printf("%s\n", (f_ok) ? "ok" : "FAILED");
+	return (f_ok) ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	background_bench.cpp
+//
+// Purpose	: 	time the green screen with a background image against the black fill
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// usage : background_bench [runs]
+//
+// a 1280x720 region of a synthetic 1920x1080 color frame of the kinect v2, single thread, at the best simd level of the cpu :
+//	- a copy of the region and a bilinear scale of the whole frame to 1280x720, into RGB32 and RGB24
+//	- a hard mask (one value per color pixel, a person in the middle : about a third of the pixels is kept) and the soft matte
+//	  made from it, each with the masked out pixels black and with a background image
+// a background image is not supposed to cost more than the black fill of the same mask
+
+#include "bench.h"
+#include "cpu_features.h"
+#include "image.h"
+#include "image_kernels.h"
+#include "keying.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+const int SRC_WIDTH		= 1920;
+const int SRC_HEIGHT	= 1080;
+const int DST_WIDTH		= 1280;
+const int DST_HEIGHT	= 720;
+
+struct Image
+{
+	std::vector<unsigned char>	m_pixels;
+	img::ImageView				m_view;
+
+	Image(int p_width, int p_height, img::PixelFormat p_format) :
+		m_pixels(img::packed_stride(p_format, p_width) * p_height)
+	{
+		for (size_t f_i = 0; f_i < m_pixels.size(); ++f_i)
+			m_pixels[f_i] = static_cast<unsigned char> ((f_i * 7) ^ (f_i >> 11));
+
+		m_view = img::packed_view(m_pixels.data(), p_width, p_height, p_format);
+	}
+};
+
+// a person in the middle of the frame : a head over a body
+std::vector<unsigned char> person_mask(int p_width, int p_height)
+{
+	std::vector<unsigned char> f_mask(p_width * p_height);
+
+	for (int f_y = 0; f_y < p_height; ++f_y)
+	{
+		for (int f_x = 0; f_x < p_width; ++f_x)
+		{
+			const int  f_dx	  = f_x - (p_width / 2);
+			const int  f_dy	  = f_y - (p_height / 3);
+			const bool f_head = (f_dx * f_dx) + (f_dy * f_dy) < (p_height * p_height) / 49;
+			const bool f_body = f_y > (p_height * 4) / 9 && (f_dx < 0 ? -f_dx : f_dx) < (p_width / 8) + ((f_y - (p_height * 4) / 9) / 2);
+
+			f_mask[(f_y * p_width) + f_x] = (f_head || f_body) ? 0xff : 0;
+		}
+	}
+
+	return f_mask;
+}
+
+int kept_percent(const std::vector<unsigned char> &p_mask)
+{
+	size_t f_kept = 0;
+
+	for (unsigned char f_m : p_mask)
+		f_kept += (f_m != 0) ? 1 : 0;
+
+	return static_cast<int> ((f_kept * 100) / p_mask.size());
+}
+
+} // unnamed namespace
+
+int main(int argc, char *argv[])
+{
+	const int f_runs = (argc > 1) ? std::max(atoi(argv[1]), 1) : 50;
+
+	const Image						 f_src(SRC_WIDTH, SRC_HEIGHT, img::PF_BGRA32);
+	const std::vector<unsigned char> f_hard = person_mask(SRC_WIDTH, SRC_HEIGHT);
+
+	keying::SoftMatte f_matte;
+	f_matte.configure(3, 128);
+
+	const img::MaskView f_hard_view = {f_hard.data(), SRC_WIDTH, SRC_HEIGHT, SRC_WIDTH, 1, false, nullptr};
+
+	if (!f_matte.refine(f_hard_view, 0, 0, SRC_WIDTH, SRC_HEIGHT))
+		return 1;
+
+	const int f_crop_x = (SRC_WIDTH - DST_WIDTH) / 2;
+	const int f_crop_y = (SRC_HEIGHT - DST_HEIGHT) / 2;
+
+	printf("%s, %d%% of the pixels kept, ms\n", cpu::simd_level_name(img::kernels::row_kernels().m_level), kept_percent(f_hard));
+	printf("%-8s %-6s %12s %12s %12s %12s\n", "", "", "hard black", "hard image", "soft black", "soft image");
+
+	for (img::PixelFormat f_format : {img::PF_BGRA32, img::PF_BGR24})
+	{
+		Image					f_dst(DST_WIDTH, DST_HEIGHT, f_format);
+		keying::BackgroundImage	f_background;
+
+		f_background.assign(Image(DST_WIDTH, DST_HEIGHT, img::PF_BGRA32).m_pixels, DST_WIDTH, DST_HEIGHT);
+
+		const img::ImageView *f_bg_view = f_background.prepare(DST_WIDTH, DST_HEIGHT, f_format, false);
+
+		for (int f_scaled = 0; f_scaled < 2; ++f_scaled)
+		{
+			double f_ms[4];
+
+			for (int f_case = 0; f_case < 4; ++f_case)
+			{
+				img::MaskView f_mask = (f_case < 2) ? f_hard_view : f_matte.view();
+				f_mask.m_background	 = (f_case & 1) ? f_bg_view : nullptr;
+
+				f_ms[f_case] = bench::median_ms(f_runs, [&]() {
+					if (f_scaled)
+						img::scale_region(f_src.m_view, &f_mask, 0, 0, SRC_WIDTH, SRC_HEIGHT, f_dst.m_view, img::SCALE_BILINEAR, false, false);
+					else
+						img::copy_region(f_src.m_view, &f_mask, f_crop_x, f_crop_y, f_dst.m_view, false, false);
+
+					bench::keep(f_dst.m_pixels.data());
+				});
+			}
+
+			printf("%-8s %-6s %12.2f %12.2f %12.2f %12.2f\n", (f_format == img::PF_BGRA32) ? "RGB32" : "RGB24", (f_scaled) ? "scale" : "copy",
+				   f_ms[0], f_ms[1], f_ms[2], f_ms[3]);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,101 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	bench.h
+//
+// Purpose	: 	timing helpers for the benchmark programs
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef KW_BENCH_H
+#define KW_BENCH_H
+
+#include "cpu_features.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#ifdef KW_SIMD_X86
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#else
+		#include <x86intrin.h>
+	#endif
+#endif // KW_SIMD_X86
+
+namespace bench {
+
+// the median of p_runs measurements of p_func, after a call that warms up the caches and the working memory
+//	p_measure (const Func &) : runs p_func once and returns what it took
+template <typename Func, typename Measure>
+double median(int p_runs, const Func &p_func, const Measure &p_measure)
+{
+	std::vector<double> f_values;
+	f_values.reserve(p_runs);
+
+	p_func();
+
+	for (int f_run = 0; f_run < p_runs; ++f_run)
+		f_values.push_back(p_measure(p_func));
+
+	std::nth_element(f_values.begin(), f_values.begin() + (p_runs / 2), f_values.end());
+	return f_values[p_runs / 2];
+}
+
+// the median time of p_runs calls of p_func (milliseconds)
+template <typename Func>
+double median_ms(int p_runs, const Func &p_func)
+{
+	return median(p_runs, p_func, [](const Func &p_f) {
+		const auto f_start = std::chrono::steady_clock::now();
+		p_f();
+		const auto f_end = std::chrono::steady_clock::now();
+
+		return std::chrono::duration<double, std::milli> (f_end - f_start).count();
+	});
+}
+
+// the time stamp counter : it counts at a constant rate (the nominal clock of the cpu, not the actual clock when it
+// runs faster or slower), 0 when the cpu doesn't have one
+inline uint64_t cycles()
+{
+#ifdef KW_SIMD_X86
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+// the median number of cycles of p_runs calls of p_func (see cycles, 0 without a time stamp counter)
+template <typename Func>
+double median_cycles(int p_runs, const Func &p_func)
+{
+	return median(p_runs, p_func, [](const Func &p_f) {
+		const uint64_t f_start = cycles();
+		p_f();
+		return static_cast<double> (cycles() - f_start);
+	});
+}
+
+// keeps the compiler from dropping work whose result isn't used : the pointer and the memory behind it count as read
+inline void keep(const void *p_data)
+{
+#ifdef __GNUC__
+	asm volatile("" : : "g"(p_data) : "memory");
+#else
+	static std::atomic<const void *> s_sink;
+	s_sink.store(p_data, std::memory_order_release);
+#endif // __GNUC__
+}
+
+} // namespace bench
+
+#endif // KW_BENCH_H
@@ -0,0 +1,165 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	blur_bench.cpp
+//
+// Purpose	: 	time the background blur at each quality level
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// usage : blur_bench [runs]
+//
+// the background blur of a synthetic 1920x1080 color frame of the kinect v2 (RGB32, YUY2 for the YUY2 output) with a person
+// in the middle of the mask, single thread, at the best simd level of the cpu, for each level of keying::BackgroundBlur :
+//	- blur : BackgroundBlur::apply, the working memory is kept from the previous frame
+//	- first frame : the same with a BackgroundBlur that was just configured (the working memory is allocated)
+//	- composite : the masked copy of the frame with the blurred background (what the device does with it)
+// level 0 is the replacement of the background by an image of the output size, the cost the blur adds to
+
+#include "bench.h"
+#include "image.h"
+#include "keying.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+const int SRC_WIDTH		= 1920;
+const int SRC_HEIGHT	= 1080;
+const int LEVEL_MAX		= 3;
+
+struct Output
+{
+	int					m_width;
+	int					m_height;
+	img::PixelFormat	m_format;
+	const char *		m_name;
+};
+
+const Output OUTPUTS[] = {
+	{1920, 1080, img::PF_BGRA32, "RGB32 1920x1080"},
+	{1920, 1080, img::PF_BGR24, "RGB24 1920x1080"},
+	{1920, 1080, img::PF_YUY2, "YUY2  1920x1080"},
+	{1280, 720, img::PF_BGRA32, "RGB32 1280x720"}
+};
+
+struct Image
+{
+	std::vector<unsigned char>	m_pixels;
+	img::ImageView				m_view;
+
+	// twice the size of the packed rows : room for the chroma planes
+	Image(int p_width, int p_height, img::PixelFormat p_format) :
+		m_pixels(img::packed_stride(p_format, p_width) * p_height * 2)
+	{
+		for (size_t f_i = 0; f_i < m_pixels.size(); ++f_i)
+			m_pixels[f_i] = static_cast<unsigned char> ((f_i * 7) ^ (f_i >> 11));
+
+		m_view = img::packed_view(m_pixels.data(), p_width, p_height, p_format);
+	}
+};
+
+// a person in the middle of the frame : an ellipse of half the width and most of the height
+std::vector<unsigned char> person_mask()
+{
+	std::vector<unsigned char> f_result(SRC_WIDTH * SRC_HEIGHT);
+
+	for (int f_y = 0; f_y < SRC_HEIGHT; ++f_y)
+	{
+		for (int f_x = 0; f_x < SRC_WIDTH; ++f_x)
+		{
+			const float f_dx = (f_x - (SRC_WIDTH / 2)) / (SRC_WIDTH / 4.0f);
+			const float f_dy = (f_y - SRC_HEIGHT) / (SRC_HEIGHT * 0.8f);
+
+			f_result[(f_y * SRC_WIDTH) + f_x] = ((f_dx * f_dx) + (f_dy * f_dy) < 1.0f) ? 0xff : 0;
+		}
+	}
+
+	return f_result;
+}
+
+} // unnamed namespace
+
+int main(int argc, char *argv[])
+{
+	const int f_runs = (argc > 1) ? std::max(atoi(argv[1]), 1) : 30;
+
+	const Image							f_bgra(SRC_WIDTH, SRC_HEIGHT, img::PF_BGRA32);
+	const Image							f_yuy2(SRC_WIDTH, SRC_HEIGHT, img::PF_YUY2);
+	const std::vector<unsigned char>	f_mask_data = person_mask();
+	bool								f_ok = true;
+
+	printf("%s, from %dx%d, ms\n", img::simd_level_name(), SRC_WIDTH, SRC_HEIGHT);
+	printf("%-16s %-6s %8s %12s %10s %8s\n", "", "level", "blur", "first frame", "composite", "total");
+
+	for (const Output &f_output : OUTPUTS)
+	{
+		const img::ImageView &f_src = (f_output.m_format == img::PF_YUY2) ? f_yuy2.m_view : f_bgra.m_view;
+		Image				  f_dst(f_output.m_width, f_output.m_height, f_output.m_format);
+		const Image			  f_replacement(f_output.m_width, f_output.m_height, f_output.m_format);
+
+		// the output is the whole frame scaled down when it is smaller : the mask covers the source
+		const bool f_scaled = f_output.m_width != SRC_WIDTH || f_output.m_height != SRC_HEIGHT;
+
+		for (int f_level = 0; f_level <= LEVEL_MAX; ++f_level)
+		{
+			keying::BackgroundBlur f_blur;
+			f_blur.configure(f_level);
+
+			const img::ImageView *f_background = &f_replacement.m_view;
+			double				  f_blur_ms	   = 0.0;
+			double				  f_first_ms   = 0.0;
+
+			if (f_level > 0)
+			{
+				f_blur_ms = bench::median_ms(f_runs, [&]() {
+					f_background = f_blur.apply(f_src, 0, 0, SRC_WIDTH, SRC_HEIGHT, f_output.m_width, f_output.m_height, f_output.m_format);
+					bench::keep(f_background);
+				});
+
+				f_first_ms = bench::median_ms(f_runs, [&]() {
+					keying::BackgroundBlur f_new;
+					f_new.configure(f_level);
+					bench::keep(f_new.apply(f_src, 0, 0, SRC_WIDTH, SRC_HEIGHT, f_output.m_width, f_output.m_height, f_output.m_format));
+				});
+
+				if (!f_background)
+				{
+					printf("  level %d : FAILED\n", f_level);
+					f_ok = false;
+					continue;
+				}
+			}
+
+			const img::MaskView f_mask = {f_mask_data.data(), SRC_WIDTH, SRC_HEIGHT, SRC_WIDTH, 1, false, f_background};
+
+			const double f_composite_ms = bench::median_ms(f_runs, [&]() {
+				if (f_scaled)
+					f_ok = img::scale_region(f_src, &f_mask, 0, 0, SRC_WIDTH, SRC_HEIGHT, f_dst.m_view, img::SCALE_AREA) && f_ok;
+				else
+					f_ok = img::copy_region(f_src, &f_mask, 0, 0, f_dst.m_view) && f_ok;
+
+				bench::keep(f_dst.m_pixels.data());
+			});
+
+			printf("%-16s %-6d", (f_level == 0) ? f_output.m_name : "", f_level);
+
+			if (f_level > 0)
+				printf(" %8.2f %12.2f", f_blur_ms, f_first_ms);
+			else
+				printf(" %8s %12s", "-", "-");
+
+			printf(" %10.2f %8.2f\n", f_composite_ms, f_blur_ms + f_composite_ms);
+		}
+	}
+
+	return (f_ok) ? 0 : 1;
+}
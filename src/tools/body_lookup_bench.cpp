@@ -0,0 +1,226 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	body_lookup_bench.cpp
+//
+// Purpose	: 	time the body index lookup of the green screen masks at every simd level
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// usage : body_lookup_bench [runs]
+//
+// a synthetic frame of each sensor, single thread :
+//	- kinect v2 : 1920x1080 color points mapped to a 512x424 body index frame (floats, -infinity where the depth camera
+//	  doesn't see the color pixel : the left and right bands), a person in the middle
+//	- kinect v1 : 1280x960 color points mapped to 640x480 depth pixels (x, y, depth, reserved), a player in the middle
+// the loops the devices had before the kernels are timed along, every kernel has to return what they return
+
+#include "bench.h"
+#include "cpu_features.h"
+#include "image_kernels.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+namespace {
+
+using img::kernels::RowKernels;
+
+struct FloatFrame
+{
+	int							m_color_width;
+	int							m_color_height;
+	int							m_depth_width;
+	int							m_depth_height;
+	std::vector<float>			m_points;			// x, y per color pixel
+	std::vector<unsigned char>	m_labels;			// 0xff = no body
+};
+
+struct IntFrame
+{
+	int							m_color_width;
+	int							m_color_height;
+	int							m_depth_width;
+	int							m_depth_height;
+	std::vector<int>			m_points;			// x, y, depth, reserved per color pixel
+	std::vector<unsigned int>	m_labels;			// player index in the low 16 bits
+};
+
+bool in_person(int p_x, int p_y, int p_width, int p_height)
+{
+	const int f_dx = p_x - (p_width / 2);
+	const int f_dy = p_y - (p_height / 2);
+	return (4 * f_dx * f_dx) + (f_dy * f_dy) < (p_height * p_height) / 9;
+}
+
+FloatFrame float_frame()
+{
+	FloatFrame f_frame = {1920, 1080, 512, 424, {}, {}};
+
+	f_frame.m_labels.resize(f_frame.m_depth_width * f_frame.m_depth_height);
+
+	for (int f_y = 0; f_y < f_frame.m_depth_height; ++f_y)
+		for (int f_x = 0; f_x < f_frame.m_depth_width; ++f_x)
+			f_frame.m_labels[(f_y * f_frame.m_depth_width) + f_x] = (in_person(f_x, f_y, f_frame.m_depth_width, f_frame.m_depth_height)) ? 0 : 0xff;
+
+	// the depth camera sees the middle 1400 columns of the color image, with some jitter from the depth of the scene
+	const float f_inf = -std::numeric_limits<float>::infinity();
+
+	f_frame.m_points.resize(f_frame.m_color_width * f_frame.m_color_height * 2);
+
+	for (int f_y = 0; f_y < f_frame.m_color_height; ++f_y)
+	{
+		for (int f_x = 0; f_x < f_frame.m_color_width; ++f_x)
+		{
+			float *f_point = &f_frame.m_points[((f_y * f_frame.m_color_width) + f_x) * 2];
+
+			if (f_x < 260 || f_x >= 1660)
+			{
+				f_point[0] = f_inf;
+				f_point[1] = f_inf;
+				continue;
+			}
+
+			f_point[0] = ((f_x - 260) * ((f_frame.m_depth_width - 1) / 1400.0f)) + (((f_x * 7 + f_y * 3) % 5) - 2) * 0.4f;
+			f_point[1] = (f_y * (f_frame.m_depth_height / 1080.0f)) - 8.0f;
+		}
+	}
+
+	return f_frame;
+}
+
+IntFrame int_frame()
+{
+	IntFrame f_frame = {1280, 960, 640, 480, {}, {}};
+
+	f_frame.m_labels.resize(f_frame.m_depth_width * f_frame.m_depth_height);
+
+	for (int f_y = 0; f_y < f_frame.m_depth_height; ++f_y)
+		for (int f_x = 0; f_x < f_frame.m_depth_width; ++f_x)
+			f_frame.m_labels[(f_y * f_frame.m_depth_width) + f_x] = (2000u << 16) | ((in_person(f_x, f_y, f_frame.m_depth_width, f_frame.m_depth_height)) ? 1u : 0u);
+
+	// the color camera sits next to the depth camera : the points are shifted, the top rows land above the depth frame
+	//	(the loop before the kernels only checked the index : x stays inside, where it can't wrap into the next row)
+	f_frame.m_points.resize(f_frame.m_color_width * f_frame.m_color_height * 4);
+
+	for (int f_y = 0; f_y < f_frame.m_color_height; ++f_y)
+	{
+		for (int f_x = 0; f_x < f_frame.m_color_width; ++f_x)
+		{
+			int *f_point = &f_frame.m_points[((f_y * f_frame.m_color_width) + f_x) * 4];
+
+			f_point[0] = ((f_x * 15) / 32) + 16 + ((f_x + f_y) % 3);
+			f_point[1] = (f_y / 2) - 12;
+			f_point[2] = 2000;
+			f_point[3] = 0;
+		}
+	}
+
+	return f_frame;
+}
+
+// the loop of the kinect v2 device before the kernels
+void old_lookup_float(const FloatFrame &p_frame, unsigned char *p_mask)
+{
+	const int f_depth_size = p_frame.m_depth_width * p_frame.m_depth_height;
+	const int f_count	   = p_frame.m_color_width * p_frame.m_color_height;
+
+	for (int f_idx = 0; f_idx < f_count; ++f_idx)
+	{
+		const float *f_point = &p_frame.m_points[f_idx * 2];
+
+		// unchecked, as it was : the conversion of -infinity is undefined (INT_MIN on x86, out of range like the kernels)
+		int f_depth_idx = (static_cast<int> (f_point[1]) * p_frame.m_depth_width) + static_cast<int> (f_point[0]);
+
+		p_mask[f_idx] = (f_depth_idx >= 0 && f_depth_idx < f_depth_size && p_frame.m_labels[f_depth_idx] != 0xff) ? 0xff : 0;
+	}
+}
+
+// the loop of the kinect v1 device before the kernels
+void old_lookup_int(const IntFrame &p_frame, unsigned char *p_mask)
+{
+	const int f_depth_size = p_frame.m_depth_width * p_frame.m_depth_height;
+	const int f_count	   = p_frame.m_color_width * p_frame.m_color_height;
+
+	for (int f_idx = 0; f_idx < f_count; ++f_idx)
+	{
+		const int *f_point = &p_frame.m_points[f_idx * 4];
+		int f_depth_idx = (f_point[1] * p_frame.m_depth_width) + f_point[0];
+
+		p_mask[f_idx] = (f_depth_idx >= 0 && f_depth_idx < f_depth_size && (p_frame.m_labels[f_depth_idx] & 0xffff) != 0) ? 0xff : 0;
+	}
+}
+
+void kernel_lookup_float(const RowKernels &p_kernels, const FloatFrame &p_frame, unsigned char *p_mask)
+{
+	for (int f_y = 0; f_y < p_frame.m_color_height; ++f_y)
+	{
+		const int f_row = f_y * p_frame.m_color_width;
+		p_kernels.m_body_lookup_float(&p_frame.m_points[f_row * 2], p_frame.m_labels.data(), p_frame.m_depth_width, p_frame.m_depth_height,
+									  p_mask + f_row, p_frame.m_color_width);
+	}
+}
+
+void kernel_lookup_int(const RowKernels &p_kernels, const IntFrame &p_frame, unsigned char *p_mask)
+{
+	for (int f_y = 0; f_y < p_frame.m_color_height; ++f_y)
+	{
+		const int f_row = f_y * p_frame.m_color_width;
+		p_kernels.m_body_lookup_int(&p_frame.m_points[f_row * 4], p_frame.m_labels.data(), p_frame.m_depth_width, p_frame.m_depth_height,
+									p_mask + f_row, p_frame.m_color_width);
+	}
+}
+
+int differences(const std::vector<unsigned char> &p_a, const std::vector<unsigned char> &p_b)
+{
+	int f_result = 0;
+
+	for (size_t f_i = 0; f_i < p_a.size(); ++f_i)
+		f_result += (p_a[f_i] != p_b[f_i]) ? 1 : 0;
+
+	return f_result;
+}
+
+} // unnamed namespace
+
+int main(int argc, char *argv[])
+{
+	const int f_runs = (argc > 1) ? std::max(atoi(argv[1]), 1) : 50;
+
+	const FloatFrame f_float = float_frame();
+	const IntFrame	 f_int	 = int_frame();
+
+	std::vector<unsigned char> f_float_ref(f_float.m_color_width * f_float.m_color_height);
+	std::vector<unsigned char> f_int_ref(f_int.m_color_width * f_int.m_color_height);
+	std::vector<unsigned char> f_float_mask(f_float_ref.size());
+	std::vector<unsigned char> f_int_mask(f_int_ref.size());
+
+	bool f_ok = true;
+
+	printf("%-8s %18s %18s\n", "", "float (v2, ms)", "int (v1, ms)");
+	printf("%-8s %18.2f %18.2f\n", "old loop",
+		   bench::median_ms(f_runs, [&]() { old_lookup_float(f_float, f_float_ref.data()); bench::keep(f_float_ref.data()); }),
+		   bench::median_ms(f_runs, [&]() { old_lookup_int(f_int, f_int_ref.data()); bench::keep(f_int_ref.data()); }));
+
+	for (int f_level = cpu::SIMD_NONE; f_level <= cpu::simd_level_supported(); ++f_level)
+	{
+		const RowKernels f_kernels = img::kernels::row_kernels_for_level(static_cast<cpu::SimdLevel> (f_level));
+
+		const double f_float_ms = bench::median_ms(f_runs, [&]() { kernel_lookup_float(f_kernels, f_float, f_float_mask.data()); bench::keep(f_float_mask.data()); });
+		const double f_int_ms	= bench::median_ms(f_runs, [&]() { kernel_lookup_int(f_kernels, f_int, f_int_mask.data()); bench::keep(f_int_mask.data()); });
+		const int	 f_diff		= differences(f_float_mask, f_float_ref) + differences(f_int_mask, f_int_ref);
+
+		printf("%-8s %18.2f %18.2f%s\n", cpu::simd_level_name(f_kernels.m_level), f_float_ms, f_int_ms, (f_diff == 0) ? "" : "   DIFFERENT");
+		f_ok = f_ok && f_diff == 0;
+	}
+
+	return (f_ok) ? 0 : 1;
+}
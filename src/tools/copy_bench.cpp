@@ -0,0 +1,168 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	copy_bench.cpp
+//
+// Purpose	: 	time the fused crop, flip and RGBA to RGB copy against the passes it replaced
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// usage : copy_bench [runs]
+//
+// regions of a synthetic 1920x1080 color frame of the kinect v2 to RGB24, upright and flipped, single thread :
+//	- fused : img::copy_region, at the best simd level of the cpu
+//	- 3 passes : the way the filter used to copy, without OpenCV : the region is copied out of the frame, converted into
+//	  a second temporary and copied (flipped) into the destination, the temporaries are allocated for every frame ; the
+//	  conversion uses the same row kernel as the fused copy, the difference is the passes over memory and the allocations
+//	- opencv : the code the filter had (a cropped cv::Mat, cv::cvtColor into a temporary, cv::flip or copyTo), only when
+//	  OpenCV was found : it crops without copying, the 3 passes are the worse case of it
+// bytes / cycle : the bytes of the destination per cycle of the time stamp counter (see bench::cycles)
+
+#include "bench.h"
+#include "image.h"
+#include "image_kernels.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifdef KW_BENCH_OPENCV
+	#include <opencv2/opencv.hpp>
+#endif // KW_BENCH_OPENCV
+
+namespace {
+
+const int SRC_WIDTH		= 1920;
+const int SRC_HEIGHT	= 1080;
+
+struct Size
+{
+	int m_width;
+	int m_height;
+};
+
+const Size REGIONS[] = {{1920, 1080}, {1280, 720}, {640, 480}};
+
+void three_passes(const unsigned char *p_src, int p_src_x, int p_src_y, unsigned char *p_dst, int p_width, int p_height, bool p_flip)
+{
+	const int f_src_stride = SRC_WIDTH * 4;
+
+	// crop
+	std::vector<unsigned char> f_cropped(p_width * p_height * 4);
+
+	for (int f_y = 0; f_y < p_height; ++f_y)
+		std::memcpy(&f_cropped[f_y * p_width * 4], p_src + ((p_src_y + f_y) * f_src_stride) + (p_src_x * 4), p_width * 4);
+
+	// color space conversion
+	std::vector<unsigned char> f_rgb(p_width * p_height * 3);
+
+	img::kernels::row_kernels().m_copy_32bpp_24bpp(f_cropped.data(), f_rgb.data(), p_width * p_height);
+
+	// copy to output (flipped or not)
+	for (int f_y = 0; f_y < p_height; ++f_y)
+		std::memcpy(p_dst + (((p_flip) ? p_height - 1 - f_y : f_y) * p_width * 3), &f_rgb[f_y * p_width * 3], p_width * 3);
+}
+
+#ifdef KW_BENCH_OPENCV
+
+void opencv(unsigned char *p_src, int p_src_x, int p_src_y, unsigned char *p_dst, int p_width, int p_height, bool p_flip)
+{
+	cv::Mat f_src(SRC_HEIGHT, SRC_WIDTH, CV_8UC4, p_src);
+	cv::Mat f_dst(p_height, p_width, CV_8UC3, p_dst);
+
+	cv::Mat f_src_cropped(f_src, cv::Rect(p_src_x, p_src_y, p_width, p_height));
+
+	cv::Mat f_src_rgb;
+	cv::cvtColor(f_src_cropped, f_src_rgb, cv::COLOR_RGBA2RGB);
+
+	if (p_flip)
+		cv::flip(f_src_rgb, f_dst, 0);
+	else
+		f_src_rgb.copyTo(f_dst);
+}
+
+#endif // KW_BENCH_OPENCV
+
+// milliseconds and bytes of the destination per cycle
+void print_result(const char *p_name, double p_ms, double p_cycles, int p_bytes)
+{
+	printf("  %-9s %8.2f ms %8.2f bytes / cycle\n", p_name, p_ms, (p_cycles > 0.0) ? p_bytes / p_cycles : 0.0);
+}
+
+} // unnamed namespace
+
+int main(int argc, char *argv[])
+{
+	const int f_runs = (argc > 1) ? std::max(atoi(argv[1]), 1) : 50;
+
+	std::vector<unsigned char> f_src(SRC_WIDTH * SRC_HEIGHT * 4);
+
+	for (size_t f_i = 0; f_i < f_src.size(); ++f_i)
+		f_src[f_i] = static_cast<unsigned char> ((f_i * 7) ^ (f_i >> 11));
+
+	const img::ImageView f_src_view = img::packed_view(f_src.data(), SRC_WIDTH, SRC_HEIGHT, img::PF_BGRA32);
+	bool				 f_ok		= true;
+
+	printf("%s, %dx%d RGB32 to RGB24\n", img::simd_level_name(), SRC_WIDTH, SRC_HEIGHT);
+
+	for (const Size &f_region : REGIONS)
+	{
+		for (int f_flip = 0; f_flip < 2; ++f_flip)
+		{
+			const int	f_x		= (SRC_WIDTH - f_region.m_width) / 2;
+			const int	f_y		= (SRC_HEIGHT - f_region.m_height) / 2;
+			const int	f_bytes	= f_region.m_width * f_region.m_height * 3;
+
+			std::vector<unsigned char> f_fused(f_bytes);
+			std::vector<unsigned char> f_passes(f_bytes);
+
+			const img::ImageView f_dst_view = img::packed_view(f_fused.data(), f_region.m_width, f_region.m_height, img::PF_BGR24);
+
+			auto f_run_fused = [&]() {
+				img::copy_region(f_src_view, nullptr, f_x, f_y, f_dst_view, f_flip != 0);
+				bench::keep(f_fused.data());
+			};
+
+			auto f_run_passes = [&]() {
+				three_passes(f_src.data(), f_x, f_y, f_passes.data(), f_region.m_width, f_region.m_height, f_flip != 0);
+				bench::keep(f_passes.data());
+			};
+
+			printf("%dx%d%s\n", f_region.m_width, f_region.m_height, (f_flip) ? ", flipped" : "");
+			print_result("fused", bench::median_ms(f_runs, f_run_fused), bench::median_cycles(f_runs, f_run_fused), f_bytes);
+			print_result("3 passes", bench::median_ms(f_runs, f_run_passes), bench::median_cycles(f_runs, f_run_passes), f_bytes);
+
+#ifdef KW_BENCH_OPENCV
+			std::vector<unsigned char> f_opencv(f_bytes);
+
+			auto f_run_opencv = [&]() {
+				opencv(f_src.data(), f_x, f_y, f_opencv.data(), f_region.m_width, f_region.m_height, f_flip != 0);
+				bench::keep(f_opencv.data());
+			};
+
+			print_result("opencv", bench::median_ms(f_runs, f_run_opencv), bench::median_cycles(f_runs, f_run_opencv), f_bytes);
+
+			if (f_opencv != f_fused)
+			{
+				printf("  opencv : DIFFERENT\n");
+				f_ok = false;
+			}
+#endif // KW_BENCH_OPENCV
+
+			// every path has to return the same pixels
+			if (f_passes != f_fused)
+			{
+				printf("  3 passes : DIFFERENT\n");
+				f_ok = false;
+			}
+		}
+	}
+
+	return (f_ok) ? 0 : 1;
+}
@@ -0,0 +1,228 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	focus_eval.cpp
+//
+// Purpose	: 	replay recorded focus trajectories through the focus filters and report how well they follow
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// usage : focus_eval <recording> [<recording> ...]
+//
+// a recording is written by the filter when the TrackingRecord setting names a file, a line for every video frame
+// with a focus point : the time of the color frame, the time of the body frame the focus was measured in (seconds, both
+// on the clock of the sensor : a body frame that is seen twice has the same time) and the focus point (pixels)
+//
+// every recording is replayed with each filter and prediction horizon, the output is compared against the measured
+// trajectory at the time of the sample (what the filter should show) :
+//	- error : mean and 95th percentile of the distance (pixels)
+//	- lag   : the delay of the measured trajectory that matches the output best (milliseconds)
+
+#include "tracking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+struct Record
+{
+	double	m_time;
+	double	m_measured;
+	float	m_x;
+	float	m_y;
+};
+
+struct Result
+{
+	float	m_mean;
+	float	m_p95;
+	float	m_lag;
+};
+
+// the settings of the filter
+const float PREDICTION_MAX_OFFSET	  = 100.0f;
+const float PREDICTION_MIN_CONFIDENCE = 0.3f;
+
+const int	HORIZONS[]	= {0, 50, 100, 150, 200};		// milliseconds, 0 = no prediction
+const char *FILTERS[]	= {"one euro", "spring", "moving average"};
+
+// the lag is searched in this range (seconds)
+const double LAG_MIN  = -0.25;
+const double LAG_MAX  = 1.0;
+const double LAG_STEP = 0.005;
+
+bool read_recording(const char *p_filename, std::vector<Record> &p_records)
+{
+	std::ifstream f_file(p_filename);
+
+	if (!f_file)
+		return false;
+
+	Record f_record;
+
+	while (f_file >> f_record.m_time >> f_record.m_measured >> f_record.m_x >> f_record.m_y)
+		p_records.push_back(f_record);
+
+	return !p_records.empty();
+}
+
+// the measured trajectory : every measurement once, ordered by the time it was measured
+std::vector<Record> measured_trajectory(const std::vector<Record> &p_records)
+{
+	std::vector<Record> f_result;
+
+	for (const auto &f_record : p_records)
+	{
+		if (f_result.empty() || f_record.m_measured > f_result.back().m_measured)
+			f_result.push_back(f_record);
+	}
+
+	return f_result;
+}
+
+// the measured trajectory at p_time (linear interpolation), false outside of the measurements or across a gap
+bool measured_at(const std::vector<Record> &p_trajectory, double p_time, float &p_x, float &p_y)
+{
+	auto f_next = std::lower_bound(	p_trajectory.begin(), p_trajectory.end(), p_time,
+									[](const Record &p_record, double p_t) {return p_record.m_measured < p_t;});
+
+	if (f_next == p_trajectory.begin() || f_next == p_trajectory.end())
+		return false;
+
+	auto f_prev = f_next - 1;
+
+	if (f_next->m_measured - f_prev->m_measured > 0.25)
+		return false;
+
+	const float f_t = static_cast<float> ((p_time - f_prev->m_measured) / (f_next->m_measured - f_prev->m_measured));
+	p_x = f_prev->m_x + ((f_next->m_x - f_prev->m_x) * f_t);
+	p_y = f_prev->m_y + ((f_next->m_y - f_prev->m_y) * f_t);
+	return true;
+}
+
+// the mean distance between the output and the measured trajectory, delayed by p_delay
+double mean_distance(const std::vector<Record> &p_output, const std::vector<Record> &p_trajectory, double p_delay, std::vector<float> *p_distances)
+{
+	double	f_sum	= 0.0;
+	int		f_count	= 0;
+
+	for (const auto &f_out : p_output)
+	{
+		float f_x, f_y;
+
+		if (!measured_at(p_trajectory, f_out.m_time - p_delay, f_x, f_y))
+			continue;
+
+		const float f_distance = std::sqrt(((f_out.m_x - f_x) * (f_out.m_x - f_x)) + ((f_out.m_y - f_y) * (f_out.m_y - f_y)));
+
+		if (p_distances)
+			p_distances->push_back(f_distance);
+
+		f_sum += f_distance;
+		++f_count;
+	}
+
+	return (f_count > 0) ? f_sum / f_count : 0.0;
+}
+
+Result evaluate(const std::vector<Record> &p_records, tracking::FocusFilterType p_filter, int p_horizon)
+{
+	const std::vector<Record> f_trajectory = measured_trajectory(p_records);
+
+	tracking::FocusFilter		f_filter;
+	tracking::FocusPredictor	f_predictor;
+
+	f_filter.set_type(p_filter);
+	f_predictor.configure({p_horizon / 1000.0f, PREDICTION_MAX_OFFSET, PREDICTION_MIN_CONFIDENCE});
+
+	// replay the recording the way the filter processes it
+	std::vector<Record> f_output;
+
+	for (const auto &f_record : p_records)
+	{
+		tracking::FocusPoint f_focus = {f_record.m_x, f_record.m_y};
+
+		if (p_horizon > 0)
+			f_focus = f_predictor.update(f_focus, f_record.m_measured, f_record.m_time);
+
+		f_focus = f_filter.update(f_focus, f_record.m_time);
+		f_output.push_back({f_record.m_time, f_record.m_time, f_focus.m_x, f_focus.m_y});
+	}
+
+	// the error against what should be shown : the position at the time of the sample
+	std::vector<float> f_distances;
+	Result f_result;
+
+	f_result.m_mean = static_cast<float> (mean_distance(f_output, f_trajectory, 0.0, &f_distances));
+	f_result.m_p95	= 0.0f;
+
+	if (!f_distances.empty())
+	{
+		auto f_p95 = f_distances.begin() + ((f_distances.size() * 95) / 100);
+		std::nth_element(f_distances.begin(), f_p95, f_distances.end());
+		f_result.m_p95 = *f_p95;
+	}
+
+	// the lag : the delay at which the output matches the measured trajectory best
+	double f_best = -1.0;
+	f_result.m_lag = 0.0f;
+
+	for (double f_delay = LAG_MIN; f_delay <= LAG_MAX; f_delay += LAG_STEP)
+	{
+		const double f_distance = mean_distance(f_output, f_trajectory, f_delay, nullptr);
+
+		if (f_best < 0.0 || f_distance < f_best)
+		{
+			f_best		   = f_distance;
+			f_result.m_lag = static_cast<float> (f_delay * 1000.0);
+		}
+	}
+
+	return f_result;
+}
+
+} // unnamed namespace
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage : %s <recording> [<recording> ...]\n", argv[0]);
+		return 1;
+	}
+
+	for (int f_arg = 1; f_arg < argc; ++f_arg)
+	{
+		std::vector<Record> f_records;
+
+		if (!read_recording(argv[f_arg], f_records))
+		{
+			fprintf(stderr, "%s : no focus points\n", argv[f_arg]);
+			return 1;
+		}
+
+		printf("%s : %d frames, %.1f s\n", argv[f_arg], static_cast<int> (f_records.size()), f_records.back().m_time - f_records.front().m_time);
+		printf("  %-16s %8s %10s %10s %8s\n", "filter", "horizon", "mean (px)", "p95 (px)", "lag (ms)");
+
+		for (int f_filter = 0; f_filter < 3; ++f_filter)
+		{
+			for (int f_horizon : HORIZONS)
+			{
+				const Result f_result = evaluate(f_records, static_cast<tracking::FocusFilterType> (f_filter), f_horizon);
+
+				printf("  %-16s %8d %10.1f %10.1f %8.0f\n", FILTERS[f_filter], f_horizon, f_result.m_mean, f_result.m_p95, f_result.m_lag);
+			}
+		}
+	}
+
+	return 0;
+}
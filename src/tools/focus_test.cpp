@@ -0,0 +1,308 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	focus_test.cpp
+//
+// Purpose	: 	check the jitter and the lag of the focus filters on a known trajectory
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// usage : focus_test <data/walk.txt>
+//
+// walk.txt is a synthetic recording (in the format of focus_eval) of 30 fps video with a tracking latency of 66 ms :
+//	- 0 - 2 s : standing still at (960, 500)
+//	- 2 - 4 s : walking right at 300 pixels / s
+//	- 4 - 6 s : standing still at (1560, 500)
+//	- 6 - 8 s : walking back left at 300 pixels / s, the body frames come at 15 fps (every measurement is seen twice)
+//	- 8 - 9 s : standing still at (960, 500)
+// the measurements have gaussian noise with a standard deviation of 3 pixels on either axis
+//
+// the recording is replayed through every type of filter the way the video filter does it, and checked for :
+//	- warm-up : the first measurement is passed on unchanged, the first second stays on the person (isn't pulled towards (0, 0))
+//	- jitter : the RMS of the movement from frame to frame while standing still
+//	- lag : how far the output trails the true position while walking (in seconds of walking), both ways
+//	- repeated timestamps : a measurement passed again at the same time doesn't change the output
+// and through the predictor (the times are those of the sensor : a body frame that is seen twice keeps its time), checked
+// for the lag that is left at the time of the video frame, the same whether the body frames come at 30 or 15 fps
+// the framing of a group leaves out the bodies the sensor couldn't map (a focus or scale that isn't finite)
+
+#include "tracking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <vector>
+
+namespace {
+
+struct Record
+{
+	double	m_time;
+	double	m_measured;
+	float	m_x;
+	float	m_y;
+};
+
+const float SPEED = 300.0f;
+
+// the true horizontal position of the trajectory
+float true_x(double p_time)
+{
+	if (p_time < 2.0)	return 960.0f;
+	if (p_time < 4.0)	return 960.0f + (SPEED * static_cast<float> (p_time - 2.0));
+	if (p_time < 6.0)	return 1560.0f;
+	if (p_time < 8.0)	return 1560.0f - (SPEED * static_cast<float> (p_time - 6.0));
+	return 960.0f;
+}
+
+const float TRUE_Y = 500.0f;
+
+// the bounds of each type of filter
+struct Bounds
+{
+	tracking::FocusFilterType	m_type;
+	const char *				m_name;
+	float						m_jitter;			// pixels per frame (the measurements : about 6)
+	float						m_lag;				// seconds
+};
+
+const Bounds BOUNDS[] = {
+	{tracking::FFT_ONE_EURO,		"one euro",			1.2f,	0.10f},
+	{tracking::FFT_SPRING,			"spring",			0.5f,	0.28f},		// 2 / SPRING_OMEGA
+	{tracking::FFT_MOVING_AVERAGE,	"moving average",	0.4f,	0.52f}		// half the window
+};
+
+// the warm-up may not stray further from the person than the noise of the measurements
+const float WARM_UP_DISTANCE = 12.0f;
+
+// the settings of the filter, with a horizon that covers the latency
+const tracking::PredictionSettings PREDICTION = {0.1f, 100.0f, 0.3f};
+
+// the lag the predictor may leave, either way (seconds : the latency is 66 ms ; a body frame seen twice that updates the
+// velocity again leaves 13 ms at 15 fps)
+const float PREDICTION_LAG = 0.012f;
+
+bool read_recording(const char *p_filename, std::vector<Record> &p_records)
+{
+	std::ifstream f_file(p_filename);
+
+	if (!f_file)
+		return false;
+
+	Record f_record;
+
+	while (f_file >> f_record.m_time >> f_record.m_measured >> f_record.m_x >> f_record.m_y)
+		p_records.push_back(f_record);
+
+	return !p_records.empty();
+}
+
+bool in_phase(double p_time, double p_begin, double p_end)
+{
+	return p_time >= p_begin && p_time < p_end;
+}
+
+bool test_filter(const std::vector<Record> &p_records, const Bounds &p_bounds)
+{
+	tracking::FocusFilter f_filter;
+	f_filter.set_type(p_bounds.m_type);
+
+	bool	f_ok		 = true;
+	bool	f_first		 = true;
+	float	f_warm_up	 = 0.0f;
+	double	f_jitter_sum = 0.0;
+	int		f_jitter_n	 = 0;
+	double	f_lag_sum[2] = {0.0, 0.0};
+	int		f_lag_n[2]	 = {0, 0};
+
+	tracking::FocusPoint f_prev = {0.0f, 0.0f};
+
+	for (const auto &f_record : p_records)
+	{
+		const tracking::FocusPoint f_out = f_filter.update({f_record.m_x, f_record.m_y}, f_record.m_time);
+
+		// the same frame again
+		const tracking::FocusPoint f_again = f_filter.update({f_record.m_x + 50.0f, f_record.m_y - 50.0f}, f_record.m_time);
+
+		if (f_again.m_x != f_out.m_x || f_again.m_y != f_out.m_y || !std::isfinite(f_out.m_x) || !std::isfinite(f_out.m_y))
+		{
+			printf("FAIL %s : %.3f s, the output changed on a repeated timestamp or isn't finite\n", p_bounds.m_name, f_record.m_time);
+			f_ok = false;
+		}
+
+		if (f_first && (f_out.m_x != f_record.m_x || f_out.m_y != f_record.m_y))
+		{
+			printf("FAIL %s : the first measurement isn't passed on unchanged\n", p_bounds.m_name);
+			f_ok = false;
+		}
+
+		// the measurements are 66 ms behind the video : compare against the true position at the time of the measurement
+		const float f_dx = true_x(f_record.m_measured) - f_out.m_x;
+		const float f_dy = TRUE_Y - f_out.m_y;
+
+		if (f_record.m_time < 1.0)
+			f_warm_up = std::max(f_warm_up, std::sqrt((f_dx * f_dx) + (f_dy * f_dy)));
+
+		// standing still (after the filter had time to settle)
+		if (in_phase(f_record.m_measured, 0.5, 2.0) || in_phase(f_record.m_measured, 5.0, 6.0))
+		{
+			f_jitter_sum += ((f_out.m_x - f_prev.m_x) * (f_out.m_x - f_prev.m_x)) + ((f_out.m_y - f_prev.m_y) * (f_out.m_y - f_prev.m_y));
+			++f_jitter_n;
+		}
+
+		// walking at a constant speed (after the filter had time to catch up)
+		if (in_phase(f_record.m_measured, 3.0, 4.0))
+		{
+			f_lag_sum[0] += f_dx / SPEED;
+			++f_lag_n[0];
+		}
+		else if (in_phase(f_record.m_measured, 7.0, 8.0))
+		{
+			f_lag_sum[1] += -f_dx / SPEED;
+			++f_lag_n[1];
+		}
+
+		f_prev	= f_out;
+		f_first	= false;
+	}
+
+	const float f_jitter = static_cast<float> (std::sqrt(f_jitter_sum / std::max(f_jitter_n, 1)));
+	const float f_lag[2] = {static_cast<float> (f_lag_sum[0] / std::max(f_lag_n[0], 1)), static_cast<float> (f_lag_sum[1] / std::max(f_lag_n[1], 1))};
+
+	printf("%-16s warm-up %5.1f px   jitter %4.2f px   lag %3.0f ms (30 fps) %3.0f ms (15 fps)\n",
+		   p_bounds.m_name, f_warm_up, f_jitter, f_lag[0] * 1000.0f, f_lag[1] * 1000.0f);
+
+	if (f_warm_up > WARM_UP_DISTANCE)
+	{
+		printf("FAIL %s : the warm-up strays %.1f pixels from the person (at most %.1f)\n", p_bounds.m_name, f_warm_up, WARM_UP_DISTANCE);
+		f_ok = false;
+	}
+
+	if (f_jitter > p_bounds.m_jitter)
+	{
+		printf("FAIL %s : jitter of %.2f pixels (at most %.2f)\n", p_bounds.m_name, f_jitter, p_bounds.m_jitter);
+		f_ok = false;
+	}
+
+	for (float f_l : f_lag)
+	{
+		if (f_l < 0.0f || f_l > p_bounds.m_lag)
+		{
+			printf("FAIL %s : lag of %.0f ms (0 - %.0f ms)\n", p_bounds.m_name, f_l * 1000.0f, p_bounds.m_lag * 1000.0f);
+			f_ok = false;
+		}
+	}
+
+	return f_ok;
+}
+
+bool test_predictor(const std::vector<Record> &p_records)
+{
+	tracking::FocusPredictor f_predictor;
+	f_predictor.configure(PREDICTION);
+
+	double	f_lag_sum[2] = {0.0, 0.0};
+	int		f_lag_n[2]	 = {0, 0};
+
+	for (const auto &f_record : p_records)
+	{
+		const tracking::FocusPoint f_out = f_predictor.update({f_record.m_x, f_record.m_y}, f_record.m_measured, f_record.m_time);
+
+		// compared against the true position at the time of the video frame
+		const float f_dx = true_x(f_record.m_time) - f_out.m_x;
+
+		if (in_phase(f_record.m_measured, 3.0, 4.0))
+		{
+			f_lag_sum[0] += f_dx / SPEED;
+			++f_lag_n[0];
+		}
+		else if (in_phase(f_record.m_measured, 7.0, 8.0))
+		{
+			f_lag_sum[1] += -f_dx / SPEED;
+			++f_lag_n[1];
+		}
+	}
+
+	const float f_lag[2] = {static_cast<float> (f_lag_sum[0] / std::max(f_lag_n[0], 1)), static_cast<float> (f_lag_sum[1] / std::max(f_lag_n[1], 1))};
+
+	printf("%-16s lag %3.0f ms (30 fps) %3.0f ms (15 fps)\n", "prediction", f_lag[0] * 1000.0f, f_lag[1] * 1000.0f);
+
+	bool f_ok = true;
+
+	for (float f_l : f_lag)
+	{
+		if (std::fabs(f_l) > PREDICTION_LAG)
+		{
+			printf("FAIL prediction : lag of %.0f ms (at most %.0f ms either way)\n", f_l * 1000.0f, PREDICTION_LAG * 1000.0f);
+			f_ok = false;
+		}
+	}
+
+	return f_ok;
+}
+
+bool test_framing()
+{
+	const float					 f_inf	 = std::numeric_limits<float>::infinity();
+	const float					 f_nan	 = std::numeric_limits<float>::quiet_NaN();
+	const tracking::FramingRules f_rules = {0.3f, 0.5f, 0.4f};
+
+	const tracking::FramingBody f_bodies[] = {
+		{{-f_inf, -f_inf}, 300.0f},
+		{{800.0f, 400.0f}, 250.0f},
+		{{900.0f, 450.0f}, f_nan},
+		{{1100.0f, 420.0f}, f_inf}
+	};
+
+	const tracking::Framing f_expected = tracking::frame_bodies(&f_bodies[1], 1, f_rules, 640, 360, 4.0f);
+	const tracking::Framing f_framing  = tracking::frame_bodies(f_bodies, 4, f_rules, 640, 360, 4.0f);
+	const tracking::Framing f_none	   = tracking::frame_bodies(&f_bodies[2], 2, f_rules, 640, 360, 4.0f);
+
+	bool f_ok = true;
+
+	if (f_framing.m_center.m_x != f_expected.m_center.m_x || f_framing.m_center.m_y != f_expected.m_center.m_y || f_framing.m_zoom != f_expected.m_zoom)
+	{
+		printf("FAIL framing : (%.1f, %.1f) zoom %.2f with the unmapped bodies, (%.1f, %.1f) zoom %.2f without\n",
+			   f_framing.m_center.m_x, f_framing.m_center.m_y, f_framing.m_zoom, f_expected.m_center.m_x, f_expected.m_center.m_y, f_expected.m_zoom);
+		f_ok = false;
+	}
+
+	if (f_none.m_center.m_x != 0.0f || f_none.m_center.m_y != 0.0f || f_none.m_zoom != 1.0f)
+	{
+		printf("FAIL framing : no body could be mapped, but the framing is (%.1f, %.1f) zoom %.2f\n", f_none.m_center.m_x, f_none.m_center.m_y, f_none.m_zoom);
+		f_ok = false;
+	}
+
+	return f_ok;
+}
+
+} // unnamed namespace
+
+int main(int argc, char *argv[])
+{
+	std::vector<Record> f_records;
+
+	if (argc != 2 || !read_recording(argv[1], f_records))
+	{
+		fprintf(stderr, "usage : %s <data/walk.txt>\n", argv[0]);
+		return 1;
+	}
+
+	bool f_ok = true;
+
+	for (const auto &f_bounds : BOUNDS)
+		f_ok = test_filter(f_records, f_bounds) && f_ok;
+
+	f_ok = test_predictor(f_records) && f_ok;
+	f_ok = test_framing() && f_ok;
+
+	printf("%s\n", (f_ok) ? "ok" : "FAILED");
+	return (f_ok) ? 0 : 1;
+}
@@ -0,0 +1,280 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	image_test.cpp
+//
+// Purpose	: 	check that the image functions write the same pixels into padded and packed images
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// usage : image_test
+//
+// every conversion copy_region and scale_region support is run twice, into a packed destination and into a padded one :
+//	- RGB24 widths of 4n + 1, 4n + 2 and 4n + 3 with the 4 byte aligned rows of a DIB, and wider pitches for all formats
+//	  (NV12 / I420 : the chroma planes follow the padded luma plane)
+//	- the sources are padded too, with data that may not show up in the output
+//	- with and without flip, mirror and (hard and soft, low resolution) masks
+// the rows of both destinations have to be the same, the padding of the padded destination has to stay untouched
+
+#include "image.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+const unsigned char UNTOUCHED = 0xcd;
+
+std::mt19937	g_random(20140102);
+int				g_checks   = 0;
+int				g_failures = 0;
+
+// the rows of one plane of an image
+struct Plane
+{
+	int m_offset;
+	int m_row_bytes;
+	int m_rows;
+	int m_stride;
+};
+
+std::vector<Plane> image_planes(const img::ImageView &p_image)
+{
+	const int f_luma = p_image.m_stride * p_image.m_height;
+
+	switch (p_image.m_format)
+	{
+		case img::PF_NV12 :
+			return {{0, p_image.m_width, p_image.m_height, p_image.m_stride},
+					{f_luma, p_image.m_width, p_image.m_height / 2, p_image.m_stride}};
+
+		case img::PF_I420 :
+			return {{0, p_image.m_width, p_image.m_height, p_image.m_stride},
+					{f_luma, p_image.m_width / 2, p_image.m_height / 2, p_image.m_stride / 2},
+					{f_luma + ((p_image.m_stride / 2) * (p_image.m_height / 2)), p_image.m_width / 2, p_image.m_height / 2, p_image.m_stride / 2}};
+
+		default :
+			return {{0, img::packed_stride(p_image.m_format, p_image.m_width), p_image.m_height, p_image.m_stride}};
+	}
+}
+
+int image_bytes(const img::ImageView &p_image)
+{
+	return (p_image.m_format == img::PF_NV12 || p_image.m_format == img::PF_I420) ? (p_image.m_stride * p_image.m_height * 3) / 2
+																				   : p_image.m_stride * p_image.m_height;
+}
+
+// an image with the requested row pitch (0 = packed) and some bytes behind it
+struct Image
+{
+	std::vector<unsigned char>	m_data;
+	img::ImageView				m_view;
+
+	Image(int p_width, int p_height, img::PixelFormat p_format, int p_stride, bool p_random)
+	{
+		m_view = img::packed_view(nullptr, p_width, p_height, p_format);
+
+		if (p_stride > 0)
+			m_view.m_stride = p_stride;
+
+		m_data.resize(image_bytes(m_view) + 64);
+		m_view.m_data = m_data.data();
+
+		for (auto &f_byte : m_data)
+			f_byte = (p_random) ? static_cast<unsigned char> (g_random()) : UNTOUCHED;
+	}
+
+	// the pixels, without the padding
+	std::vector<unsigned char> pixels() const
+	{
+		std::vector<unsigned char> f_result;
+
+		for (const auto &f_plane : image_planes(m_view))
+		{
+			for (int f_y = 0; f_y < f_plane.m_rows; ++f_y)
+			{
+				const unsigned char *f_row = m_data.data() + f_plane.m_offset + (f_y * f_plane.m_stride);
+				f_result.insert(f_result.end(), f_row, f_row + f_plane.m_row_bytes);
+			}
+		}
+
+		return f_result;
+	}
+
+	// the padding (and the bytes behind the image), with the pixels left out
+	std::vector<unsigned char> padding() const
+	{
+		std::vector<bool> f_pixel(m_data.size(), false);
+
+		for (const auto &f_plane : image_planes(m_view))
+		{
+			for (int f_y = 0; f_y < f_plane.m_rows; ++f_y)
+			{
+				for (int f_x = 0; f_x < f_plane.m_row_bytes; ++f_x)
+					f_pixel[f_plane.m_offset + (f_y * f_plane.m_stride) + f_x] = true;
+			}
+		}
+
+		std::vector<unsigned char> f_result;
+
+		for (size_t f_i = 0; f_i < m_data.size(); ++f_i)
+		{
+			if (!f_pixel[f_i])
+				f_result.push_back(m_data[f_i]);
+		}
+
+		return f_result;
+	}
+};
+
+const char *format_name(img::PixelFormat p_format)
+{
+	switch (p_format)
+	{
+		case img::PF_BGRA32 :	return "RGB32";
+		case img::PF_BGR24 :	return "RGB24";
+		case img::PF_YUY2 :		return "YUY2";
+		case img::PF_NV12 :		return "NV12";
+		case img::PF_I420 :		return "I420";
+		default :				return "?";
+	}
+}
+
+void check(bool p_passed, const char *p_what, img::PixelFormat p_src, img::PixelFormat p_dst, int p_width, int p_stride, int p_variant)
+{
+	++g_checks;
+
+	if (!p_passed && ++g_failures <= 20)
+		printf("FAIL %-12s %s -> %s width %3d stride %4d variant %d\n", p_what, format_name(p_src), format_name(p_dst), p_width, p_stride, p_variant);
+}
+
+// a mask over the whole source : a disc, with soft edges for a soft mask
+std::vector<unsigned char> disc_mask(int p_width, int p_height, bool p_soft)
+{
+	std::vector<unsigned char> f_result(p_width * p_height);
+
+	for (int f_y = 0; f_y < p_height; ++f_y)
+	{
+		for (int f_x = 0; f_x < p_width; ++f_x)
+		{
+			const int f_dx	 = (2 * f_x) - p_width;
+			const int f_dy	 = (2 * f_y) - p_height;
+			const int f_dist = (f_dx * f_dx) + (f_dy * f_dy) - (p_width * p_height / 2);
+			const int f_soft = 128 - (f_dist / 4);
+
+			f_result[(f_y * p_width) + f_x] = static_cast<unsigned char> ((p_soft) ? std::min(std::max(f_soft, 0), 255) : (f_dist < 0) ? 0xff : 0);
+		}
+	}
+
+	return f_result;
+}
+
+// the destination pitches to compare with the packed one
+std::vector<int> padded_strides(img::PixelFormat p_format, int p_width)
+{
+	const int f_packed = img::packed_stride(p_format, p_width);
+	const int f_dib	   = (f_packed + 3) & ~3;
+	const int f_wide   = (f_packed + 67) & ~3;
+
+	std::vector<int> f_result;
+
+	if (f_dib != f_packed)
+		f_result.push_back(f_dib);
+
+	f_result.push_back(f_wide);
+	return f_result;
+}
+
+void test_conversion(img::PixelFormat p_src_format, img::PixelFormat p_dst_format, int p_width, int p_height)
+{
+	// a padded source, larger than the destination
+	const int	f_src_width	 = (p_width * 2) + 4;
+	const int	f_src_height = (p_height * 2) + 2;
+	const Image f_src(f_src_width, f_src_height, p_src_format, img::packed_stride(p_src_format, f_src_width) + 36, true);
+
+	const int						 f_mask_scale = 2;
+	const std::vector<unsigned char> f_hard		  = disc_mask(f_src_width / f_mask_scale, f_src_height / f_mask_scale, false);
+	const std::vector<unsigned char> f_soft		  = disc_mask(f_src_width / f_mask_scale, f_src_height / f_mask_scale, true);
+	const img::MaskView				 f_masks[]	  = {
+		{f_hard.data(), f_src_width / f_mask_scale, f_src_height / f_mask_scale, f_src_width / f_mask_scale, f_mask_scale, false, nullptr},
+		{f_soft.data(), f_src_width / f_mask_scale, f_src_height / f_mask_scale, f_src_width / f_mask_scale, f_mask_scale, true, nullptr}
+	};
+
+	for (int f_stride : padded_strides(p_dst_format, p_width))
+	{
+		for (int f_variant = 0; f_variant < 36; ++f_variant)
+		{
+			// flip, mirror, no mask / hard mask / soft mask, copy / area scaling / bilinear scaling
+			const bool				f_flip	 = (f_variant & 1) != 0;
+			const bool				f_mirror = (f_variant & 2) != 0;
+			const int				f_mode	 = (f_variant / 4) % 3;
+			const int				f_scale	 = f_variant / 12;
+			const img::MaskView *	f_mask	 = (f_mode == 0) ? nullptr : &f_masks[f_mode - 1];
+
+			Image f_packed(p_width, p_height, p_dst_format, 0, false);
+			Image f_padded(p_width, p_height, p_dst_format, f_stride, false);
+
+			bool f_ok_packed = false;
+			bool f_ok_padded = false;
+
+			if (f_scale == 0)
+			{
+				f_ok_packed = img::copy_region(f_src.m_view, f_mask, 3, 1, f_packed.m_view, f_flip, f_mirror);
+				f_ok_padded = img::copy_region(f_src.m_view, f_mask, 3, 1, f_padded.m_view, f_flip, f_mirror);
+			}
+			else
+			{
+				// a region that doesn't scale by a whole factor
+				const img::ScaleFilter f_filter = (f_scale == 2) ? img::SCALE_BILINEAR : img::SCALE_AREA;
+				const int			   f_w		= f_src_width - 6;
+				const int			   f_h		= f_src_height - 3;
+
+				f_ok_packed = img::scale_region(f_src.m_view, f_mask, 2, 1, f_w, f_h, f_packed.m_view, f_filter, f_flip, f_mirror);
+				f_ok_padded = img::scale_region(f_src.m_view, f_mask, 2, 1, f_w, f_h, f_padded.m_view, f_filter, f_flip, f_mirror);
+			}
+
+			check(f_ok_packed && f_ok_padded, "converted", p_src_format, p_dst_format, p_width, f_stride, f_variant);
+			check(f_packed.pixels() == f_padded.pixels(), "same pixels", p_src_format, p_dst_format, p_width, f_stride, f_variant);
+
+			const std::vector<unsigned char> f_padding = f_padded.padding();
+			check(std::count(f_padding.begin(), f_padding.end(), UNTOUCHED) == static_cast<int> (f_padding.size()),
+				  "padding", p_src_format, p_dst_format, p_width, f_stride, f_variant);
+
+			const std::vector<unsigned char> f_behind = f_packed.padding();
+			check(std::count(f_behind.begin(), f_behind.end(), UNTOUCHED) == static_cast<int> (f_behind.size()),
+				  "behind", p_src_format, p_dst_format, p_width, f_stride, f_variant);
+		}
+	}
+}
+
+} // unnamed namespace
+
+int main()
+{
+	// RGB24 rows are padded to 4 bytes unless the width is a multiple of 4
+	for (int f_width : {5, 6, 7, 9, 13, 14, 15, 37, 38, 39, 101, 102, 103})
+	{
+		test_conversion(img::PF_BGRA32, img::PF_BGR24, f_width, 7);
+		test_conversion(img::PF_BGRA32, img::PF_BGRA32, f_width, 7);
+	}
+
+	// YUY2 and 4:2:0 need even sizes
+	for (int f_width : {2, 6, 10, 38, 66, 102})
+	{
+		test_conversion(img::PF_BGRA32, img::PF_NV12, f_width, 6);
+		test_conversion(img::PF_BGRA32, img::PF_I420, f_width, 6);
+		test_conversion(img::PF_YUY2, img::PF_YUY2, f_width, 6);
+		test_conversion(img::PF_YUY2, img::PF_NV12, f_width, 6);
+		test_conversion(img::PF_YUY2, img::PF_I420, f_width, 6);
+	}
+
+	printf("%d checks, %d failures\n", g_checks, g_failures);
+	return (g_failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,620 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	kernel_test.cpp
+//
+// Purpose	: 	check that every simd row kernel returns exactly what the scalar reference returns
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// usage : kernel_test
+//
+// the kernel table of every simd level the cpu supports (sse2, ssse3, avx2) is compared against the scalar table :
+//	- every kernel, for all widths from 0 to 199 (even widths for the YUY2 and 4:2:0 kernels)
+//	- the rows start at odd addresses and are an odd number of bytes apart, the kernels may not assume any alignment
+//	- the outputs are compared byte for byte, including the bytes behind them (a kernel may not write past its row)
+
+#include "image_kernels.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+
+using namespace img::kernels;
+
+typedef std::vector<unsigned char> Bytes;
+
+const int MAX_WIDTH = 200;
+const int TRIALS	= 3;			// different random data for every width
+const int GUARD		= 64;			// bytes behind every output that have to stay untouched
+
+std::mt19937	g_random(20140101);
+int				g_checks   = 0;
+int				g_failures = 0;
+
+int random_int(int p_min, int p_max)
+{
+	return std::uniform_int_distribution<int>(p_min, p_max)(g_random);
+}
+
+float random_float(float p_min, float p_max)
+{
+	return std::uniform_real_distribution<float>(p_min, p_max)(g_random);
+}
+
+Bytes random_bytes(size_t p_count)
+{
+	Bytes f_result(p_count);
+
+	for (auto &f_byte : f_result)
+		f_byte = static_cast<unsigned char> (random_int(0, 255));
+
+	return f_result;
+}
+
+// runs of masked out, kept and (for soft masks) partially kept pixels : the kernels have shortcuts for whole groups
+Bytes random_mask(size_t p_count, bool p_soft)
+{
+	Bytes f_result(p_count);
+
+	for (size_t f_i = 0; f_i < p_count; )
+	{
+		const int	 f_kind = random_int(0, (p_soft) ? 3 : 2);
+		const size_t f_end	= std::min(p_count, f_i + random_int(1, 40));
+
+		for (; f_i < f_end; ++f_i)
+		{
+			switch (f_kind)
+			{
+				case 0 :	f_result[f_i] = 0;		break;
+				case 1 :	f_result[f_i] = 0xff;	break;
+				default :	f_result[f_i] = static_cast<unsigned char> (random_int(0, 255));
+			}
+		}
+	}
+
+	return f_result;
+}
+
+// the elements of a vector, as raw bytes
+template <typename T>
+Bytes as_bytes(const std::vector<T> &p_values)
+{
+	Bytes f_result(p_values.size() * sizeof(T));
+	std::memcpy(f_result.data(), p_values.data(), f_result.size());
+	return f_result;
+}
+
+template <typename T>
+T *at(Bytes &p_bytes, size_t p_offset)
+{
+	return reinterpret_cast<T *> (p_bytes.data() + p_offset);
+}
+
+// run a kernel of the scalar and of the tested table on two copies of the same output buffer and compare the copies
+//	p_run (const RowKernels &, Bytes &p_output) : the buffer starts out with p_output, its size includes the guard bytes
+template <typename Run>
+void compare(const char *p_name, const RowKernels &p_reference, const RowKernels &p_tested, int p_width, const Bytes &p_output, Run p_run)
+{
+	Bytes f_expected = p_output;
+	Bytes f_actual	 = p_output;
+
+	p_run(p_reference, f_expected);
+	p_run(p_tested, f_actual);
+
+	++g_checks;
+
+	if (f_expected == f_actual)
+		return;
+
+	const auto f_diff = std::mismatch(f_expected.begin(), f_expected.end(), f_actual.begin());
+
+	if (++g_failures <= 20)
+	{
+		printf(	"FAIL %-22s %-6s width %3d : byte %d is %d, expected %d\n", p_name, cpu::simd_level_name(p_tested.m_level), p_width,
+				static_cast<int> (f_diff.first - f_expected.begin()), *f_diff.second, *f_diff.first);
+	}
+}
+
+//
+// the kernels, grouped by their signature
+//
+
+void test_copy(const char *p_name, CopyRowFunc RowKernels::*p_kernel, int p_src_bpp, int p_dst_bpp, int p_align,
+			   const RowKernels &p_ref, const RowKernels &p_test)
+{
+	for (int f_width = 0; f_width < MAX_WIDTH; f_width += p_align)
+	{
+		const Bytes f_src = random_bytes((f_width * p_src_bpp) + 1);
+
+		compare(p_name, p_ref, p_test, f_width, random_bytes((f_width * p_dst_bpp) + 1 + GUARD), [&](const RowKernels &p_kernels, Bytes &p_out) {
+			(p_kernels.*p_kernel)(f_src.data() + 1, p_out.data() + 1, f_width);
+		});
+	}
+}
+
+void test_mask(const char *p_name, MaskRowFunc RowKernels::*p_kernel, int p_src_bpp, int p_dst_bpp, int p_align, bool p_soft,
+			   const RowKernels &p_ref, const RowKernels &p_test)
+{
+	for (int f_width = 0; f_width < MAX_WIDTH; f_width += p_align)
+	{
+		const Bytes f_src  = random_bytes((f_width * p_src_bpp) + 1);
+		const Bytes f_mask = random_mask(f_width + 1, p_soft);
+
+		compare(p_name, p_ref, p_test, f_width, random_bytes((f_width * p_dst_bpp) + 1 + GUARD), [&](const RowKernels &p_kernels, Bytes &p_out) {
+			(p_kernels.*p_kernel)(f_src.data() + 1, f_mask.data() + 1, p_out.data() + 1, f_width);
+		});
+	}
+}
+
+void test_planar(const char *p_name, PlanarRowFunc RowKernels::*p_kernel, int p_src_bpp, bool p_nv12, bool p_mask,
+				 const RowKernels &p_ref, const RowKernels &p_test)
+{
+	for (int f_width = 0; f_width < MAX_WIDTH; f_width += 2)
+	{
+		// two source rows (and two mask rows) an odd number of bytes apart
+		const int	f_src_stride  = (f_width * p_src_bpp) + 5;
+		const int	f_mask_stride = f_width + 3;
+		const Bytes f_src		  = random_bytes(1 + (2 * f_src_stride));
+		const Bytes f_mask		  = random_mask(1 + (2 * f_mask_stride), false);
+
+		// the destination : Y0, Y1, U (NV12 : U/V) and V, each followed by its guard bytes
+		const int f_chroma	= (p_nv12) ? f_width : f_width / 2;
+		const int f_y_0		= 1;
+		const int f_y_1		= f_y_0 + f_width + GUARD + 1;
+		const int f_u		= f_y_1 + f_width + GUARD;
+		const int f_v		= f_u + f_chroma + GUARD;
+
+		compare(p_name, p_ref, p_test, f_width, random_bytes(f_v + f_chroma + GUARD), [&](const RowKernels &p_kernels, Bytes &p_out) {
+			(p_kernels.*p_kernel)(	f_src.data() + 1, f_src.data() + 1 + f_src_stride,
+									(p_mask) ? f_mask.data() + 1 : nullptr, (p_mask) ? f_mask.data() + 1 + f_mask_stride : nullptr,
+									p_out.data() + f_y_0, p_out.data() + f_y_1, p_out.data() + f_u, p_out.data() + f_v, f_width);
+		});
+	}
+}
+
+// Q14 weights that sum to one
+std::vector<short> random_weights(int p_taps)
+{
+	std::vector<short> f_weights(p_taps);
+	int				   f_left = 1 << 14;
+
+	for (int f_t = 0; f_t < p_taps - 1; ++f_t)
+	{
+		f_weights[f_t]	= static_cast<short> (random_int(0, f_left));
+		f_left		   -= f_weights[f_t];
+	}
+
+	f_weights[p_taps - 1] = static_cast<short> (f_left);
+	std::shuffle(f_weights.begin(), f_weights.end(), g_random);
+	return f_weights;
+}
+
+void test_scale_rows(const RowKernels &p_ref, const RowKernels &p_test)
+{
+	for (int f_count = 0; f_count < MAX_WIDTH; ++f_count)
+	{
+		const int	f_taps	 = 2 * random_int(1, 4);
+		const int	f_stride = f_count + 7;
+		const Bytes f_src	 = random_bytes(1 + (f_taps * f_stride));
+
+		std::vector<const unsigned char *> f_rows;
+
+		for (int f_t = 0; f_t < f_taps; ++f_t)
+			f_rows.push_back(f_src.data() + 1 + (f_t * f_stride));
+
+		const std::vector<short> f_weights = random_weights(f_taps);
+
+		compare("scale_rows", p_ref, p_test, f_count, random_bytes(((f_count + 1) * 2) + GUARD), [&](const RowKernels &p_kernels, Bytes &p_out) {
+			p_kernels.m_scale_rows(f_rows.data(), f_weights.data(), f_taps, at<short>(p_out, 2), f_count);
+		});
+	}
+}
+
+// filter taps for p_count output samples over p_src source samples
+struct Taps
+{
+	int					m_taps;
+	std::vector<int>	m_offset;
+	std::vector<short>	m_weights;
+
+	Taps(int p_count, int p_src) : m_taps(2 * random_int(1, 4))
+	{
+		for (int f_i = 0; f_i < p_count; ++f_i)
+		{
+			m_offset.push_back(random_int(0, p_src - 1));
+
+			const std::vector<short> f_weights = random_weights(m_taps);
+			m_weights.insert(m_weights.end(), f_weights.begin(), f_weights.end());
+		}
+
+		std::sort(m_offset.begin(), m_offset.end());
+	}
+
+	ScaleTaps taps() const
+	{
+		return {m_taps, m_offset.data(), m_weights.data()};
+	}
+};
+
+// an intermediate row of the scaler : Q7 values, followed by the zeros the horizontal pass may read
+std::vector<short> scaled_row(int p_values, int p_padding)
+{
+	std::vector<short> f_row(p_values + p_padding, 0);
+
+	for (int f_i = 0; f_i < p_values; ++f_i)
+		f_row[f_i] = static_cast<short> (random_int(0, 255 << 7));
+
+	return f_row;
+}
+
+void test_scale_cols(const RowKernels &p_ref, const RowKernels &p_test)
+{
+	for (int f_width = 0; f_width < MAX_WIDTH; ++f_width)
+	{
+		const int				 f_src_w = random_int(1, 300);
+		const Taps				 f_luma(f_width, f_src_w);
+		const std::vector<short> f_src = scaled_row(f_src_w * 4, ((2 * f_luma.m_taps) + 2) * 4);
+
+		compare("scale_cols_32bpp", p_ref, p_test, f_width, random_bytes((f_width * 4) + 1 + GUARD), [&](const RowKernels &p_kernels, Bytes &p_out) {
+			p_kernels.m_scale_cols_32bpp(f_src.data(), f_luma.taps(), f_luma.taps(), p_out.data() + 1, f_width);
+		});
+	}
+
+	for (int f_width = 0; f_width < MAX_WIDTH; f_width += 2)
+	{
+		// YUY2 : luma samples are 2 values apart, the chroma samples of a macropixel 4
+		const int				 f_src_w = 2 * random_int(1, 150);
+		const Taps				 f_luma(f_width, f_src_w);
+		const Taps				 f_chroma(f_width / 2, f_src_w / 2);
+		const std::vector<short> f_src = scaled_row(f_src_w * 2, ((2 * std::max(f_luma.m_taps, f_chroma.m_taps)) + 2) * 2);
+
+		compare("scale_cols_16bpp", p_ref, p_test, f_width, random_bytes((f_width * 2) + 1 + GUARD), [&](const RowKernels &p_kernels, Bytes &p_out) {
+			p_kernels.m_scale_cols_16bpp(f_src.data(), f_luma.taps(), f_chroma.taps(), p_out.data() + 1, f_width);
+		});
+	}
+}
+
+void test_morph(const char *p_name, MorphRowFunc RowKernels::*p_kernel, const RowKernels &p_ref, const RowKernels &p_test)
+{
+	for (int f_count = 0; f_count < MAX_WIDTH; ++f_count)
+	{
+		const Bytes f_rows = random_bytes(1 + (3 * (f_count + 3)));
+		const int	f_stride = f_count + 3;
+
+		compare(p_name, p_ref, p_test, f_count, random_bytes(f_count + 1 + GUARD), [&](const RowKernels &p_kernels, Bytes &p_out) {
+			(p_kernels.*p_kernel)(f_rows.data() + 1, f_rows.data() + 1 + f_stride, f_rows.data() + 1 + (2 * f_stride), p_out.data() + 1, f_count);
+		});
+	}
+}
+
+void test_matte_slide(const RowKernels &p_ref, const RowKernels &p_test)
+{
+	for (int f_count = 0; f_count < MAX_WIDTH; ++f_count)
+	{
+		const Bytes f_add = random_bytes(f_count + 1);
+		const Bytes f_sub = random_bytes(f_count + 3);
+
+		std::vector<unsigned short> f_sums(f_count + 1 + GUARD);
+
+		for (auto &f_sum : f_sums)
+			f_sum = static_cast<unsigned short> (random_int(255, 60000));
+
+		compare("matte_slide", p_ref, p_test, f_count, as_bytes(f_sums), [&](const RowKernels &p_kernels, Bytes &p_out) {
+			p_kernels.m_matte_slide(at<unsigned short>(p_out, 2), f_add.data() + 1, f_sub.data() + 3, f_count);
+		});
+	}
+}
+
+void test_matte_feather(const RowKernels &p_ref, const RowKernels &p_test, int p_min_radius)
+{
+	for (int f_count = 0; f_count < MAX_WIDTH; ++f_count)
+	{
+		// the column sums of a vertical window of the box filter, p_radius values on either side of the row
+		const int f_radius = random_int(p_min_radius, 7);
+		const int f_window = (2 * f_radius) + 1;
+		const int f_weight = random_int(1, 128);
+
+		std::vector<unsigned short> f_sums(f_count + (2 * f_radius) + 1);
+
+		for (auto &f_sum : f_sums)
+			f_sum = static_cast<unsigned short> ((random_int(0, 3) == 0) ? 255 * f_window : random_int(0, 255 * f_window));
+
+		compare("matte_feather", p_ref, p_test, f_count, random_bytes(f_count + 1 + GUARD), [&](const RowKernels &p_kernels, Bytes &p_out) {
+			p_kernels.m_matte_feather(f_sums.data() + 1 + f_radius, f_radius, box_recip(f_window * f_window), f_weight, p_out.data() + 1, f_count);
+		});
+	}
+}
+
+// depth frames of the body lookups : their size is a multiple of 4
+const int LOOKUP_WIDTH	= 20;
+const int LOOKUP_HEIGHT	= 14;
+
+float lookup_coordinate(int p_size)
+{
+	const float f_inf = std::numeric_limits<float>::infinity();
+	const float f_special[] = {	-f_inf, f_inf, std::numeric_limits<float>::quiet_NaN(), -1.0f, -0.999f, -0.0f, 0.0f,
+								static_cast<float> (p_size) - 0.001f, static_cast<float> (p_size), 1e10f, -1e10f};
+
+	if (random_int(0, 4) == 0)
+		return f_special[random_int(0, static_cast<int> (sizeof(f_special) / sizeof(f_special[0])) - 1)];
+
+	return random_float(-3.0f, p_size + 3.0f);
+}
+
+void test_body_lookup(const RowKernels &p_ref, const RowKernels &p_test)
+{
+	Bytes f_labels = random_bytes(LOOKUP_WIDTH * LOOKUP_HEIGHT);
+
+	for (auto &f_label : f_labels)
+		f_label = (f_label < 128) ? 0xff : f_label & 7;
+
+	std::vector<unsigned int> f_pixels(LOOKUP_WIDTH * LOOKUP_HEIGHT);
+
+	for (auto &f_pixel : f_pixels)
+		f_pixel = (static_cast<unsigned int> (random_int(0, 65535)) << 16) | ((random_int(0, 1) == 0) ? 0 : random_int(0, 65535));
+
+	for (int f_count = 0; f_count < MAX_WIDTH; ++f_count)
+	{
+		std::vector<float> f_points(2 * (f_count + 1));
+
+		for (int f_i = 2; f_i < static_cast<int> (f_points.size()); f_i += 2)
+		{
+			f_points[f_i]	  = lookup_coordinate(LOOKUP_WIDTH);
+			f_points[f_i + 1] = lookup_coordinate(LOOKUP_HEIGHT);
+		}
+
+		compare("body_lookup_float", p_ref, p_test, f_count, random_bytes(f_count + 1 + GUARD), [&](const RowKernels &p_kernels, Bytes &p_out) {
+			p_kernels.m_body_lookup_float(f_points.data() + 2, f_labels.data(), LOOKUP_WIDTH, LOOKUP_HEIGHT, p_out.data() + 1, f_count);
+		});
+
+		const int f_special[] = {std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), -1, -65536, 65536};
+		std::vector<int> f_int_points(4 * (f_count + 1));
+
+		for (int f_i = 4; f_i < static_cast<int> (f_int_points.size()); f_i += 4)
+		{
+			f_int_points[f_i]	  = (random_int(0, 5) == 0) ? f_special[random_int(0, 4)] : random_int(-3, LOOKUP_WIDTH + 3);
+			f_int_points[f_i + 1] = (random_int(0, 5) == 0) ? f_special[random_int(0, 4)] : random_int(-3, LOOKUP_HEIGHT + 3);
+			f_int_points[f_i + 2] = random_int(0, 8000);
+			f_int_points[f_i + 3] = random_int(-100, 100);
+		}
+
+		compare("body_lookup_int", p_ref, p_test, f_count, random_bytes(f_count + 1 + GUARD), [&](const RowKernels &p_kernels, Bytes &p_out) {
+			p_kernels.m_body_lookup_int(f_int_points.data() + 4, f_pixels.data(), LOOKUP_WIDTH, LOOKUP_HEIGHT, p_out.data() + 1, f_count);
+		});
+	}
+}
+
+unsigned short random_depth(int p_near, int p_far)
+{
+	const int f_special[] = {0, 1, p_near - 1, p_near, p_far, p_far + 1, 65535};
+	const int f_depth	  = (random_int(0, 2) == 0) ? f_special[random_int(0, 6)] : random_int(0, 9000);
+
+	return static_cast<unsigned short> (std::min(std::max(f_depth, 0), 65535));
+}
+
+void test_depth_window(const RowKernels &p_ref, const RowKernels &p_test)
+{
+	for (int f_count = 0; f_count < MAX_WIDTH; ++f_count)
+	{
+		const int	f_near		 = (random_int(0, 3) == 0) ? 1 : random_int(1, 4000);
+		const int	f_far		 = (random_int(0, 3) == 0) ? 65535 : random_int(f_near, 8000);
+		const bool	f_body_index = random_int(0, 1) == 0;
+		const Bytes f_index		 = random_mask(f_count + 1, true);
+
+		std::vector<unsigned short> f_depth(f_count + 1);
+		std::vector<unsigned int>	f_pixels(f_count + 1);
+
+		for (int f_i = 0; f_i <= f_count; ++f_i)
+		{
+			f_depth[f_i]  = random_depth(f_near, f_far);
+			f_pixels[f_i] = (static_cast<unsigned int> (random_depth(f_near, f_far)) << 16) | ((random_int(0, 1) == 0) ? 0 : random_int(1, 6));
+		}
+
+		compare("depth_window", p_ref, p_test, f_count, random_bytes(f_count + 1 + GUARD), [&](const RowKernels &p_kernels, Bytes &p_out) {
+			p_kernels.m_depth_window(f_depth.data() + 1, (f_body_index) ? f_index.data() + 1 : nullptr, f_near, f_far, p_out.data() + 1, f_count);
+		});
+
+		compare("depth_window_packed", p_ref, p_test, f_count, random_bytes(((f_count + 1) * 4) + GUARD), [&](const RowKernels &p_kernels, Bytes &p_out) {
+			p_kernels.m_depth_window_packed(f_pixels.data() + 1, f_body_index, f_near, f_far, at<unsigned int>(p_out, 4), f_count);
+		});
+	}
+}
+
+void test_background(const char *p_name, BackgroundRowFunc RowKernels::*p_kernel, int p_bpp, int p_align, bool p_soft,
+					 const RowKernels &p_ref, const RowKernels &p_test)
+{
+	for (int f_width = 0; f_width < MAX_WIDTH; f_width += p_align)
+	{
+		const Bytes f_background = random_bytes((f_width * p_bpp) + 1);
+		const Bytes f_mask		 = random_mask(f_width + 1, p_soft);
+
+		// the destination is a masked row : black where the mask is zero, premultiplied by the mask elsewhere
+		Bytes f_dst = random_bytes((f_width * p_bpp) + 1 + GUARD);
+
+		for (int f_i = 0; f_i < f_width * p_bpp && p_bpp != 2; ++f_i)
+			f_dst[1 + f_i] = premultiply(f_dst[1 + f_i], f_mask[1 + (f_i / p_bpp)]);
+
+		compare(p_name, p_ref, p_test, f_width, f_dst, [&](const RowKernels &p_kernels, Bytes &p_out) {
+			(p_kernels.*p_kernel)(f_background.data() + 1, f_mask.data() + 1, p_out.data() + 1, f_width);
+		});
+	}
+}
+
+// p_in_place : the source is the destination (the scaler selects in its output row)
+void test_select(const char *p_name, SelectRowFunc RowKernels::*p_kernel, int p_dst_bpp, bool p_in_place, const RowKernels &p_ref, const RowKernels &p_test)
+{
+	for (int f_width = 0; f_width < MAX_WIDTH; ++f_width)
+	{
+		const Bytes f_src		 = random_bytes((f_width * 4) + 1 + GUARD);
+		const Bytes f_background = random_bytes((f_width * p_dst_bpp) + 1);
+		const Bytes f_mask		 = random_mask(f_width + 1, false);
+
+		compare(p_name, p_ref, p_test, f_width, (p_in_place) ? f_src : random_bytes((f_width * p_dst_bpp) + 1 + GUARD), [&](const RowKernels &p_kernels, Bytes &p_out) {
+			(p_kernels.*p_kernel)((p_in_place) ? p_out.data() + 1 : f_src.data() + 1, f_mask.data() + 1, f_background.data() + 1, p_out.data() + 1, f_width);
+		});
+	}
+}
+
+void test_planar_background(const char *p_name, PlanarBackgroundFunc RowKernels::*p_kernel, bool p_nv12, const RowKernels &p_ref, const RowKernels &p_test)
+{
+	for (int f_width = 0; f_width < MAX_WIDTH; f_width += 2)
+	{
+		const int f_chroma	= (p_nv12) ? f_width : f_width / 2;
+		const int f_y_0		= 1;
+		const int f_y_1		= f_y_0 + f_width + GUARD + 1;
+		const int f_u		= f_y_1 + f_width + GUARD;
+		const int f_v		= f_u + f_chroma + GUARD;
+		const int f_size	= f_v + f_chroma + GUARD;
+
+		const Bytes f_background  = random_bytes(f_size);
+		const int	f_mask_stride = f_width + 3;
+		const Bytes f_mask		  = random_mask(1 + (2 * f_mask_stride), false);
+
+		compare(p_name, p_ref, p_test, f_width, random_bytes(f_size), [&](const RowKernels &p_kernels, Bytes &p_out) {
+			(p_kernels.*p_kernel)(	f_background.data() + f_y_0, f_background.data() + f_y_1, f_background.data() + f_u, f_background.data() + f_v,
+									f_mask.data() + 1, f_mask.data() + 1 + f_mask_stride,
+									p_out.data() + f_y_0, p_out.data() + f_y_1, p_out.data() + f_u, p_out.data() + f_v, f_width);
+		});
+	}
+}
+
+void test_blur(const RowKernels &p_ref, const RowKernels &p_test, int p_min_count, int p_min_radius)
+{
+	for (int f_bytes = 0; f_bytes < MAX_WIDTH; ++f_bytes)
+	{
+		const int	f_count	 = random_int(p_min_count, 15);
+		const int	f_stride = f_bytes + 9;
+		const Bytes f_src	 = random_bytes(1 + (f_count * f_stride));
+
+		const unsigned char *f_rows[15];
+
+		for (int f_r = 0; f_r < f_count; ++f_r)
+			f_rows[f_r] = f_src.data() + 1 + (f_r * f_stride);
+
+		compare("blur_rows", p_ref, p_test, f_bytes, random_bytes(f_bytes + 1 + GUARD), [&](const RowKernels &p_kernels, Bytes &p_out) {
+			p_kernels.m_blur_rows(f_rows, f_count, box_recip(f_count), p_out.data() + 1, f_bytes);
+		});
+	}
+
+	// the elements are 4 bytes, a row has at least one
+	for (int f_count = 1; f_count < MAX_WIDTH; ++f_count)
+	{
+		const int	f_radius = random_int(p_min_radius, 7);
+		const Bytes f_src	 = random_bytes(1 + (f_count * 4));
+
+		compare("blur_cols", p_ref, p_test, f_count, random_bytes((f_count * 4) + 1 + GUARD), [&](const RowKernels &p_kernels, Bytes &p_out) {
+			p_kernels.m_blur_cols(f_src.data() + 1, f_radius, box_recip((2 * f_radius) + 1), p_out.data() + 1, f_count);
+		});
+
+		const Bytes f_near = random_bytes(1 + (f_count * 4));
+		const Bytes f_far  = random_bytes(3 + (f_count * 4));
+
+		compare("upsample_2x", p_ref, p_test, f_count, random_bytes((f_count * 8) + 1 + GUARD), [&](const RowKernels &p_kernels, Bytes &p_out) {
+			p_kernels.m_upsample_2x(f_near.data() + 1, f_far.data() + 3, p_out.data() + 1, f_count);
+		});
+	}
+}
+
+void test_depth_to_color(const RowKernels &p_ref, const RowKernels &p_test)
+{
+	for (int f_count = 0; f_count < MAX_WIDTH; ++f_count)
+	{
+		std::vector<unsigned short> f_depth(f_count + 1);
+		std::vector<float>			f_u(f_count + 1), f_v(f_count + 1), f_w(f_count + 1);
+
+		for (int f_i = 0; f_i <= f_count; ++f_i)
+		{
+			f_depth[f_i] = static_cast<unsigned short> ((random_int(0, 5) == 0) ? 0 : random_int(1, 8000));
+			f_u[f_i]	 = random_float(-800.0f, 800.0f);
+			f_v[f_i]	 = random_float(-600.0f, 600.0f);
+			f_w[f_i]	 = random_float(-0.1f, 1.1f);
+		}
+
+		const DepthColorCoefficients f_coefficients = {	f_u.data() + 1, f_v.data() + 1, f_w.data() + 1,
+														{random_float(-50.0f, 50.0f), random_float(-50.0f, 50.0f), random_float(-0.05f, 0.05f)}};
+
+		compare("depth_to_color", p_ref, p_test, f_count, random_bytes(((f_count + 1) * 8) + GUARD), [&](const RowKernels &p_kernels, Bytes &p_out) {
+			p_kernels.m_depth_to_color(f_depth.data() + 1, f_coefficients, at<float>(p_out, 8), f_count);
+		});
+	}
+}
+
+void test_level(const RowKernels &p_ref, const RowKernels &p_test)
+{
+	test_copy("copy_32bpp_32bpp", &RowKernels::m_copy_32bpp_32bpp, 4, 4, 1, p_ref, p_test);
+	test_copy("copy_32bpp_24bpp", &RowKernels::m_copy_32bpp_24bpp, 4, 3, 1, p_ref, p_test);
+	test_copy("copy_16bpp_16bpp", &RowKernels::m_copy_16bpp_16bpp, 2, 2, 2, p_ref, p_test);
+
+	test_mask("mask_32bpp_32bpp", &RowKernels::m_mask_32bpp_32bpp, 4, 4, 1, true, p_ref, p_test);
+	test_mask("mask_32bpp_24bpp", &RowKernels::m_mask_32bpp_24bpp, 4, 3, 1, true, p_ref, p_test);
+	test_mask("mask_16bpp_16bpp", &RowKernels::m_mask_16bpp_16bpp, 2, 2, 2, true, p_ref, p_test);
+	test_mask("matte_32bpp_32bpp", &RowKernels::m_matte_32bpp_32bpp, 4, 4, 1, true, p_ref, p_test);
+	test_mask("matte_32bpp_24bpp", &RowKernels::m_matte_32bpp_24bpp, 4, 3, 1, true, p_ref, p_test);
+
+	test_planar("copy_32bpp_nv12", &RowKernels::m_copy_32bpp_nv12, 4, true, false, p_ref, p_test);
+	test_planar("mask_32bpp_nv12", &RowKernels::m_mask_32bpp_nv12, 4, true, true, p_ref, p_test);
+	test_planar("copy_32bpp_i420", &RowKernels::m_copy_32bpp_i420, 4, false, false, p_ref, p_test);
+	test_planar("mask_32bpp_i420", &RowKernels::m_mask_32bpp_i420, 4, false, true, p_ref, p_test);
+	test_planar("copy_16bpp_nv12", &RowKernels::m_copy_16bpp_nv12, 2, true, false, p_ref, p_test);
+	test_planar("mask_16bpp_nv12", &RowKernels::m_mask_16bpp_nv12, 2, true, true, p_ref, p_test);
+	test_planar("copy_16bpp_i420", &RowKernels::m_copy_16bpp_i420, 2, false, false, p_ref, p_test);
+	test_planar("mask_16bpp_i420", &RowKernels::m_mask_16bpp_i420, 2, false, true, p_ref, p_test);
+
+	test_scale_rows(p_ref, p_test);
+	test_scale_cols(p_ref, p_test);
+
+	test_morph("matte_min", &RowKernels::m_matte_min, p_ref, p_test);
+	test_morph("matte_max", &RowKernels::m_matte_max, p_ref, p_test);
+	test_matte_slide(p_ref, p_test);
+	test_matte_feather(p_ref, p_test, 0);
+
+	test_body_lookup(p_ref, p_test);
+	test_depth_window(p_ref, p_test);
+
+	test_background("background_32bpp", &RowKernels::m_background_32bpp, 4, 1, true, p_ref, p_test);
+	test_background("background_24bpp", &RowKernels::m_background_24bpp, 3, 1, true, p_ref, p_test);
+	test_background("background_16bpp", &RowKernels::m_background_16bpp, 2, 2, false, p_ref, p_test);
+	test_select("select_32bpp_32bpp", &RowKernels::m_select_32bpp_32bpp, 4, false, p_ref, p_test);
+	test_select("select_32bpp_32bpp", &RowKernels::m_select_32bpp_32bpp, 4, true, p_ref, p_test);
+	test_select("select_32bpp_24bpp", &RowKernels::m_select_32bpp_24bpp, 3, false, p_ref, p_test);
+	test_planar_background("background_nv12", &RowKernels::m_background_nv12, true, p_ref, p_test);
+	test_planar_background("background_i420", &RowKernels::m_background_i420, false, p_ref, p_test);
+
+	test_blur(p_ref, p_test, 1, 0);
+	test_depth_to_color(p_ref, p_test);
+}
+
+} // unnamed namespace
+
+int main()
+{
+	const cpu::SimdLevel f_supported = cpu::simd_level_supported();
+	const RowKernels	 f_reference = row_kernels_for_level(cpu::SIMD_NONE);
+
+	printf("cpu supports : %s\n", cpu::simd_level_name(f_supported));
+
+	for (int f_level = cpu::SIMD_SSE2; f_level <= f_supported; ++f_level)
+	{
+		const RowKernels f_tested = row_kernels_for_level(static_cast<cpu::SimdLevel> (f_level));
+		const int		 f_before = g_failures;
+
+		for (int f_trial = 0; f_trial < TRIALS; ++f_trial)
+			test_level(f_reference, f_tested);
+
+		printf("%-6s : %s\n", cpu::simd_level_name(f_tested.m_level), (g_failures == f_before) ? "ok" : "FAILED");
+	}
+
+	printf("%d checks, %d failures\n", g_checks, g_failures);
+	return (g_failures == 0) ? 0 : 1;
+}
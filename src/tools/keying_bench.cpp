@@ -0,0 +1,194 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	keying_bench.cpp
+//
+// Purpose	: 	time the depth range keying against the body index keying
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// usage : keying_bench [runs]
+//
+// the green screen of the kinect v2 for a synthetic frame (512x424 depth, 1920x1080 color, a pinhole calibration), single
+// thread : a person at 1.6 m, a desk at 1 m in front of the lower part of the frame, a wall at 3.5 m, 1 of 32 pixels without
+// a depth ; the body index frame has the person only, the depth range is 0.5 - 2 m
+// for each keying mode (see GreenScreenKeying) :
+//	- labels : what the body lookups read, the copy of the body index frame or the depth frame relabeled by the depth window
+//	  (DeviceKinectV2 : kinectv2_keying_labels), in microseconds, with the scalar and the best kernel of the cpu
+//	- frame : the labels, every color pixel mapped to depth space, the body lookup and the masked copy to RGB32, in ms ;
+//	  the mapping only depends on the depth frame, the device maps once for all modes
+//	- kept : the color pixels the mask keeps, and how many of them the body index keying drops (the desk)
+// the sensor runtime work the depth range mode saves (tracking the bodies, the body index stream) is not part of it
+
+#include "bench.h"
+#include "coordinate_mapper.h"
+#include "cpu_features.h"
+#include "image.h"
+#include "image_kernels.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const int DEPTH_WIDTH	= 512;
+const int DEPTH_HEIGHT	= 424;
+const int COLOR_WIDTH	= 1920;
+const int COLOR_HEIGHT	= 1080;
+
+// focal lengths and centers (pixels), the color camera sits 5.2 cm beside the depth camera
+const float DEPTH_FOCAL	= 365.0f;
+const float COLOR_FOCAL	= 1060.0f;
+const float BASELINE	= 0.052f;
+
+const int KEYING_NEAR	= 500;
+const int KEYING_FAR	= 2000;
+
+// the modes of the green screen (GreenScreenKeying)
+enum Mode
+{
+	MODE_BODY_INDEX,
+	MODE_DEPTH_RANGE,
+	MODE_BODY_INDEX_IN_RANGE
+};
+
+const char *MODE_NAMES[] = {"body index", "depth range", "bodies in range"};
+
+keying::CameraCalibration calibration()
+{
+	keying::CameraCalibration f_result;
+
+	f_result.m_depth_width	= DEPTH_WIDTH;
+	f_result.m_depth_height	= DEPTH_HEIGHT;
+	f_result.m_depth_rays.resize(DEPTH_WIDTH * DEPTH_HEIGHT);
+
+	for (int f_y = 0; f_y < DEPTH_HEIGHT; ++f_y)
+	{
+		for (int f_x = 0; f_x < DEPTH_WIDTH; ++f_x)
+		{
+			f_result.m_depth_rays[(f_y * DEPTH_WIDTH) + f_x] = {(f_x + 0.5f - (DEPTH_WIDTH / 2)) / DEPTH_FOCAL,
+																(f_y + 0.5f - (DEPTH_HEIGHT / 2)) / DEPTH_FOCAL};
+		}
+	}
+
+	const float f_projection[12] = {COLOR_FOCAL, 0.0f, COLOR_WIDTH / 2.0f, -COLOR_FOCAL * BASELINE,
+									0.0f, COLOR_FOCAL, COLOR_HEIGHT / 2.0f, 0.0f,
+									0.0f, 0.0f, 1.0f, 0.0f};
+
+	std::copy(std::begin(f_projection), std::end(f_projection), f_result.m_color_projection);
+	return f_result;
+}
+
+// a person in the middle of the depth frame : a head over a body
+bool in_person(int p_x, int p_y)
+{
+	const int  f_dx	  = p_x - (DEPTH_WIDTH / 2);
+	const int  f_dy	  = p_y - (DEPTH_HEIGHT / 3);
+	const bool f_head = (f_dx * f_dx) + (f_dy * f_dy) < (DEPTH_HEIGHT * DEPTH_HEIGHT) / 64;
+	const bool f_body = p_y > (DEPTH_HEIGHT * 4) / 9 && (f_dx < 0 ? -f_dx : f_dx) < (DEPTH_WIDTH / 10) + ((p_y - (DEPTH_HEIGHT * 4) / 9) / 3);
+
+	return f_head || f_body;
+}
+
+int kept_pixels(const std::vector<unsigned char> &p_pixels, const std::vector<unsigned char> *p_dropped_by)
+{
+	int f_result = 0;
+
+	for (size_t f_i = 0; f_i < p_pixels.size(); f_i += 4)
+		f_result += (p_pixels[f_i] != 0 && (!p_dropped_by || (*p_dropped_by)[f_i] == 0)) ? 1 : 0;
+
+	return f_result;
+}
+
+} // unnamed namespace
+
+int main(int argc, char *argv[])
+{
+	const int f_runs = (argc > 1) ? std::max(atoi(argv[1]), 1) : 50;
+
+	std::vector<uint16_t>		f_depth(DEPTH_WIDTH * DEPTH_HEIGHT);
+	std::vector<unsigned char>	f_body_index(DEPTH_WIDTH * DEPTH_HEIGHT);
+
+	for (int f_y = 0; f_y < DEPTH_HEIGHT; ++f_y)
+	{
+		for (int f_x = 0; f_x < DEPTH_WIDTH; ++f_x)
+		{
+			const int  f_idx	= (f_y * DEPTH_WIDTH) + f_x;
+			const bool f_person	= in_person(f_x, f_y);
+			const bool f_desk	= f_y > (DEPTH_HEIGHT * 4) / 5;
+
+			f_depth[f_idx]		= (f_desk) ? 1000 : (f_person) ? 1600 : 3500;
+			f_depth[f_idx]		= ((f_idx * 2654435761u) >> 27 == 0) ? 0 : f_depth[f_idx];
+			f_body_index[f_idx] = (f_person && !f_desk && f_depth[f_idx] != 0) ? 0 : 0xff;
+		}
+	}
+
+	keying::CoordinateMapper f_mapper;
+
+	if (!f_mapper.configure(calibration(), COLOR_WIDTH, COLOR_HEIGHT))
+		return 1;
+
+	const img::kernels::RowKernels &f_kernels = img::kernels::row_kernels();
+	const img::kernels::RowKernels	f_scalar  = img::kernels::row_kernels_for_level(cpu::SIMD_NONE);
+
+	std::vector<unsigned char>		f_labels(DEPTH_WIDTH * DEPTH_HEIGHT);
+	std::vector<keying::DepthPoint>	f_points(COLOR_WIDTH * COLOR_HEIGHT);
+	std::vector<unsigned char>		f_mask(COLOR_WIDTH * COLOR_HEIGHT);
+
+	std::vector<unsigned char>	f_white(img::packed_stride(img::PF_BGRA32, COLOR_WIDTH) * COLOR_HEIGHT, 0xff);
+	std::vector<unsigned char>	f_out[3];
+
+	const img::ImageView f_src	= img::packed_view(f_white.data(), COLOR_WIDTH, COLOR_HEIGHT, img::PF_BGRA32);
+	const img::MaskView	 f_view = {f_mask.data(), COLOR_WIDTH, COLOR_HEIGHT, COLOR_WIDTH, 1, false, nullptr};
+
+	printf("%s, %dx%d depth, %dx%d color, %d - %d mm\n", cpu::simd_level_name(f_kernels.m_level), DEPTH_WIDTH, DEPTH_HEIGHT,
+		   COLOR_WIDTH, COLOR_HEIGHT, KEYING_NEAR, KEYING_FAR);
+	printf("%-16s %18s %18s %11s %10s %14s\n", "", "labels scalar (us)", "labels best (us)", "frame (ms)", "kept", "not a body");
+
+	for (int f_mode = MODE_BODY_INDEX; f_mode <= MODE_BODY_INDEX_IN_RANGE; ++f_mode)
+	{
+		auto f_make_labels = [&](const img::kernels::RowKernels &p_kernels) {
+			if (f_mode == MODE_BODY_INDEX)
+				std::memcpy(f_labels.data(), f_body_index.data(), f_labels.size());
+			else
+				p_kernels.m_depth_window(	f_depth.data(), (f_mode == MODE_BODY_INDEX_IN_RANGE) ? f_body_index.data() : nullptr,
+											KEYING_NEAR, KEYING_FAR, f_labels.data(), static_cast<int> (f_labels.size()));
+
+			bench::keep(f_labels.data());
+		};
+
+		const double f_scalar_us = 1000.0 * bench::median_ms(f_runs, [&]() { f_make_labels(f_scalar); });
+		const double f_best_us	 = 1000.0 * bench::median_ms(f_runs, [&]() { f_make_labels(f_kernels); });
+
+		f_out[f_mode].resize(f_white.size());
+
+		const img::ImageView f_dst = img::packed_view(f_out[f_mode].data(), COLOR_WIDTH, COLOR_HEIGHT, img::PF_BGRA32);
+
+		const double f_frame_ms = bench::median_ms(f_runs, [&]() {
+			f_make_labels(f_kernels);
+			f_mapper.color_to_depth(f_depth.data(), 0, 0, COLOR_WIDTH, COLOR_HEIGHT, f_points.data());
+
+			for (int f_y = 0; f_y < COLOR_HEIGHT; ++f_y)
+			{
+				f_kernels.m_body_lookup_float(	&f_points[f_y * COLOR_WIDTH].m_x, f_labels.data(), DEPTH_WIDTH, DEPTH_HEIGHT,
+												&f_mask[f_y * COLOR_WIDTH], COLOR_WIDTH);
+			}
+
+			img::copy_region(f_src, &f_view, 0, 0, f_dst, false, false);
+			bench::keep(f_out[f_mode].data());
+		});
+
+		printf("%-16s %18.1f %18.1f %11.2f %10d %14d\n", MODE_NAMES[f_mode], f_scalar_us, f_best_us, f_frame_ms,
+			   kept_pixels(f_out[f_mode], nullptr), kept_pixels(f_out[f_mode], &f_out[MODE_BODY_INDEX]));
+	}
+
+	return 0;
+}
@@ -0,0 +1,193 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	lowres_mask_bench.cpp
+//
+// Purpose	: 	time the green screen mask built at depth resolution against the mask built per color pixel
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// usage : lowres_mask_bench [runs]
+//
+// a synthetic kinect v2 frame (512x424 depth, a person at 1.6 m in front of a wall at 3.5 m, 1920x1080 color) and a pinhole
+// calibration without distortion, single thread, at the best simd level of the cpu :
+//	- full : every color pixel is mapped to depth space (CoordinateMapper::color_to_depth) and looks up the body index
+//	- low res : every depth pixel is mapped to color space and marks a mask with a value for each 4x4 color pixels (keying::LowResBodyMask)
+//	- the masked copy of the whole frame to RGB32 with either mask : the low resolution mask is interpolated bilinearly
+//	  and thresholded on the way (img::MaskView), the color image doesn't take part in it
+// the pixels where both masks disagree are counted, they are along the outline of the person
+
+#include "bench.h"
+#include "coordinate_mapper.h"
+#include "cpu_features.h"
+#include "image.h"
+#include "image_kernels.h"
+#include "keying.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+const int DEPTH_WIDTH	= 512;
+const int DEPTH_HEIGHT	= 424;
+const int COLOR_WIDTH	= 1920;
+const int COLOR_HEIGHT	= 1080;
+const int MASK_SCALE	= 4;
+
+// focal lengths and centers (pixels), the color camera sits 5.2 cm beside the depth camera
+const float DEPTH_FOCAL	= 365.0f;
+const float COLOR_FOCAL	= 1060.0f;
+const float BASELINE	= 0.052f;
+
+keying::CameraCalibration calibration()
+{
+	keying::CameraCalibration f_result;
+
+	f_result.m_depth_width	= DEPTH_WIDTH;
+	f_result.m_depth_height	= DEPTH_HEIGHT;
+	f_result.m_depth_rays.resize(DEPTH_WIDTH * DEPTH_HEIGHT);
+
+	for (int f_y = 0; f_y < DEPTH_HEIGHT; ++f_y)
+	{
+		for (int f_x = 0; f_x < DEPTH_WIDTH; ++f_x)
+		{
+			f_result.m_depth_rays[(f_y * DEPTH_WIDTH) + f_x] = {(f_x + 0.5f - (DEPTH_WIDTH / 2)) / DEPTH_FOCAL,
+																(f_y + 0.5f - (DEPTH_HEIGHT / 2)) / DEPTH_FOCAL};
+		}
+	}
+
+	const float f_projection[12] = {COLOR_FOCAL, 0.0f, COLOR_WIDTH / 2.0f, -COLOR_FOCAL * BASELINE,
+									0.0f, COLOR_FOCAL, COLOR_HEIGHT / 2.0f, 0.0f,
+									0.0f, 0.0f, 1.0f, 0.0f};
+
+	std::copy(std::begin(f_projection), std::end(f_projection), f_result.m_color_projection);
+	return f_result;
+}
+
+// a person in the middle of the depth frame : a head over a body
+bool in_person(int p_x, int p_y)
+{
+	const int  f_dx	  = p_x - (DEPTH_WIDTH / 2);
+	const int  f_dy	  = p_y - (DEPTH_HEIGHT / 3);
+	const bool f_head = (f_dx * f_dx) + (f_dy * f_dy) < (DEPTH_HEIGHT * DEPTH_HEIGHT) / 64;
+	const bool f_body = p_y > (DEPTH_HEIGHT * 4) / 9 && (f_dx < 0 ? -f_dx : f_dx) < (DEPTH_WIDTH / 10) + ((p_y - (DEPTH_HEIGHT * 4) / 9) / 3);
+
+	return f_head || f_body;
+}
+
+int kept_pixels(const std::vector<unsigned char> &p_pixels)
+{
+	int f_result = 0;
+
+	for (size_t f_i = 0; f_i < p_pixels.size(); f_i += 4)
+		f_result += (p_pixels[f_i] != 0) ? 1 : 0;
+
+	return f_result;
+}
+
+int differences(const std::vector<unsigned char> &p_a, const std::vector<unsigned char> &p_b)
+{
+	int f_result = 0;
+
+	for (size_t f_i = 0; f_i < p_a.size(); f_i += 4)
+		f_result += ((p_a[f_i] != 0) != (p_b[f_i] != 0)) ? 1 : 0;
+
+	return f_result;
+}
+
+} // unnamed namespace
+
+int main(int argc, char *argv[])
+{
+	const int f_runs = (argc > 1) ? std::max(atoi(argv[1]), 1) : 50;
+
+	std::vector<uint16_t>		f_depth(DEPTH_WIDTH * DEPTH_HEIGHT);
+	std::vector<unsigned char>	f_body_index(DEPTH_WIDTH * DEPTH_HEIGHT);
+
+	for (int f_y = 0; f_y < DEPTH_HEIGHT; ++f_y)
+	{
+		for (int f_x = 0; f_x < DEPTH_WIDTH; ++f_x)
+		{
+			const bool f_person = in_person(f_x, f_y);
+
+			f_depth[(f_y * DEPTH_WIDTH) + f_x]		= (f_person) ? 1600 : 3500;
+			f_body_index[(f_y * DEPTH_WIDTH) + f_x] = (f_person) ? 0 : 0xff;
+		}
+	}
+
+	keying::CoordinateMapper f_mapper;
+
+	if (!f_mapper.configure(calibration(), COLOR_WIDTH, COLOR_HEIGHT))
+		return 1;
+
+	const img::kernels::RowKernels &f_kernels = img::kernels::row_kernels();
+
+	// full : a point and a mask value for every color pixel
+	std::vector<keying::DepthPoint>	f_points(COLOR_WIDTH * COLOR_HEIGHT);
+	std::vector<unsigned char>		f_full(COLOR_WIDTH * COLOR_HEIGHT);
+
+	auto f_build_full = [&]() {
+		f_mapper.color_to_depth(f_depth.data(), 0, 0, COLOR_WIDTH, COLOR_HEIGHT, f_points.data());
+
+		for (int f_y = 0; f_y < COLOR_HEIGHT; ++f_y)
+		{
+			f_kernels.m_body_lookup_float(	&f_points[f_y * COLOR_WIDTH].m_x, f_body_index.data(), DEPTH_WIDTH, DEPTH_HEIGHT,
+											&f_full[f_y * COLOR_WIDTH], COLOR_WIDTH);
+		}
+
+		bench::keep(f_full.data());
+	};
+
+	// low res : a point for every depth pixel, a mask value for every 4x4 color pixels
+	keying::LowResBodyMask			f_low_res;
+	const keying::DepthToColorFunc	f_depth_to_color = f_mapper.depth_to_color_func();
+
+	f_low_res.configure(DEPTH_WIDTH, DEPTH_HEIGHT, COLOR_WIDTH, COLOR_HEIGHT, MASK_SCALE);
+
+	auto f_build_low_res = [&]() {
+		f_low_res.build(f_depth.data(), f_body_index.data(), f_depth_to_color);
+		bench::keep(&f_low_res);
+	};
+
+	const double f_full_ms	  = bench::median_ms(f_runs, f_build_full);
+	const double f_low_res_ms = bench::median_ms(f_runs, f_build_low_res);
+
+	// the masked copies of a white frame : the kept pixels stay white
+	std::vector<unsigned char>	f_white(img::packed_stride(img::PF_BGRA32, COLOR_WIDTH) * COLOR_HEIGHT, 0xff);
+	std::vector<unsigned char>	f_full_out(f_white.size());
+	std::vector<unsigned char>	f_low_res_out(f_white.size());
+
+	const img::ImageView f_src			= img::packed_view(f_white.data(), COLOR_WIDTH, COLOR_HEIGHT, img::PF_BGRA32);
+	const img::ImageView f_full_dst		= img::packed_view(f_full_out.data(), COLOR_WIDTH, COLOR_HEIGHT, img::PF_BGRA32);
+	const img::ImageView f_low_res_dst	= img::packed_view(f_low_res_out.data(), COLOR_WIDTH, COLOR_HEIGHT, img::PF_BGRA32);
+	const img::MaskView	 f_full_mask	= {f_full.data(), COLOR_WIDTH, COLOR_HEIGHT, COLOR_WIDTH, 1, false, nullptr};
+	const img::MaskView	 f_low_res_mask	= f_low_res.view();
+
+	const double f_full_copy_ms = bench::median_ms(f_runs, [&]() {
+		img::copy_region(f_src, &f_full_mask, 0, 0, f_full_dst, false, false);
+		bench::keep(f_full_out.data());
+	});
+
+	const double f_low_res_copy_ms = bench::median_ms(f_runs, [&]() {
+		img::copy_region(f_src, &f_low_res_mask, 0, 0, f_low_res_dst, false, false);
+		bench::keep(f_low_res_out.data());
+	});
+
+	const int f_kept = kept_pixels(f_full_out);
+	const int f_diff = differences(f_full_out, f_low_res_out);
+
+	printf("%s, %dx%d depth, %dx%d color\n", cpu::simd_level_name(f_kernels.m_level), DEPTH_WIDTH, DEPTH_HEIGHT, COLOR_WIDTH, COLOR_HEIGHT);
+	printf("%-8s %10s %12s %14s\n", "", "mappings", "build (ms)", "copy (ms)");
+	printf("%-8s %10d %12.2f %14.2f\n", "full", COLOR_WIDTH * COLOR_HEIGHT, f_full_ms, f_full_copy_ms);
+	printf("%-8s %10d %12.2f %14.2f\n", "low res", DEPTH_WIDTH * DEPTH_HEIGHT, f_low_res_ms, f_low_res_copy_ms);
+	printf("%d pixels kept, the masks disagree on %d (%.1f%%)\n", f_kept, f_diff, (f_kept > 0) ? (100.0 * f_diff) / f_kept : 0.0);
+
+	return 0;
+}
@@ -0,0 +1,283 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	mapper_test.cpp
+//
+// Purpose	: 	check the software coordinate mapper against reference points, offline
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// usage : mapper_test <data/calibration_v2.txt> <data/mapping_v2.txt>
+//
+// calibration_v2.txt is a calibration file (see keying::write_calibration) made from a model of a Kinect v2, not captured
+// from the sensor runtime : the calibration was taken from the model the way the device takes it from the runtime
+// (the rays of the depth pixels, a projection fitted to projection_samples, the offsets of a flat frame at 2 m)
+//	- depth camera : the nominal intrinsics of a Kinect v2 with its radial distortion, a 64x53 grid over the 512x424 frame
+//	  (every 8th pixel, to keep the file small)
+//	- color camera : 1920x1080, 5.2 cm beside the depth camera, turned by 0.2 and 0.3 degrees, with some radial distortion
+// mapping_v2.txt has the reference points of the model, in double precision : a depth pixel (x, y), its depth (millimeters,
+// 0.5 - 4.5 m) and where the model puts it in the color image (x, y : some are outside of it)
+//
+// the test checks :
+//	- a calibration that is written and read again is the same
+//	- depth to color : the mapper has to match the reference points well within the bounds the device accepts (keying::mappings_match),
+//	  depth pixels without a depth get no position
+//	- color to depth : every depth pixel of a flat frame is found again at the color pixel it maps to (or a neighbour, at the
+//	  edges of its footprint), the same on one thread and on a pool of threads
+
+#include "coordinate_mapper.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+const int COLOR_WIDTH	= 1920;
+const int COLOR_HEIGHT	= 1080;
+
+// depth to color, in color pixels : the offsets are exact at 2 m, closer to the sensor the points move across the distortion
+// of the color camera (the model is off by up to 1.4 pixels at 0.5 m, at the edges ; the device accepts 4)
+const float MAX_MEAN_ERROR	= 0.2f;
+const float MAX_ERROR		= 2.0f;
+
+const uint16_t FLAT_DEPTH	= 2000;
+const int	   POOL_THREADS	= 4;
+
+struct Reference
+{
+	int					m_x;
+	int					m_y;
+	uint16_t			m_depth;
+	keying::ColorPoint	m_color;
+};
+
+bool read_references(const char *p_filename, std::vector<Reference> &p_references)
+{
+	std::ifstream f_file(p_filename);
+
+	if (!f_file)
+		return false;
+
+	Reference f_ref;
+
+	while (f_file >> f_ref.m_x >> f_ref.m_y >> f_ref.m_depth >> f_ref.m_color.m_x >> f_ref.m_color.m_y)
+		p_references.push_back(f_ref);
+
+	return !p_references.empty();
+}
+
+bool same_points(const std::vector<keying::ColorPoint> &p_a, const std::vector<keying::ColorPoint> &p_b)
+{
+	if (p_a.size() != p_b.size())
+		return false;
+
+	for (size_t f_i = 0; f_i < p_a.size(); ++f_i)
+	{
+		if (p_a[f_i].m_x != p_b[f_i].m_x || p_a[f_i].m_y != p_b[f_i].m_y)
+			return false;
+	}
+
+	return true;
+}
+
+bool test_round_trip(const keying::CameraCalibration &p_calibration)
+{
+	std::stringstream			f_stream;
+	keying::CameraCalibration	f_read;
+
+	const bool f_ok =	keying::write_calibration(f_stream, p_calibration) && keying::read_calibration(f_stream, f_read) &&
+						f_read.m_depth_width == p_calibration.m_depth_width && f_read.m_depth_height == p_calibration.m_depth_height &&
+						std::equal(std::begin(f_read.m_color_projection), std::end(f_read.m_color_projection), p_calibration.m_color_projection) &&
+						same_points(f_read.m_depth_rays, p_calibration.m_depth_rays) && same_points(f_read.m_color_offsets, p_calibration.m_color_offsets);
+
+	if (!f_ok)
+		printf("FAIL calibration : it changed when it was written and read again\n");
+
+	return f_ok;
+}
+
+bool test_depth_to_color(const keying::CameraCalibration &p_calibration, const std::vector<Reference> &p_references)
+{
+	keying::CoordinateMapper f_mapper;
+
+	if (!f_mapper.configure(p_calibration, COLOR_WIDTH, COLOR_HEIGHT))
+	{
+		printf("FAIL depth to color : the calibration was refused\n");
+		return false;
+	}
+
+	// the depth pixels with a reference point have its depth, the others none
+	const int						f_size = p_calibration.m_depth_width * p_calibration.m_depth_height;
+	std::vector<uint16_t>			f_depth(f_size, 0);
+	std::vector<keying::ColorPoint>	f_points(f_size);
+
+	for (const auto &f_ref : p_references)
+		f_depth[(f_ref.m_y * p_calibration.m_depth_width) + f_ref.m_x] = f_ref.m_depth;
+
+	f_mapper.depth_to_color(f_depth.data(), f_points.data());
+
+	std::vector<keying::ColorPoint> f_expected;
+	std::vector<keying::ColorPoint> f_actual;
+
+	for (const auto &f_ref : p_references)
+	{
+		f_expected.push_back(f_ref.m_color);
+		f_actual.push_back(f_points[(f_ref.m_y * p_calibration.m_depth_width) + f_ref.m_x]);
+	}
+
+	const keying::MappingError f_error = keying::compare_mappings(	f_expected.data(), f_actual.data(), static_cast<int> (f_expected.size()),
+																	COLOR_WIDTH, COLOR_HEIGHT);
+
+	int f_positioned = 0;
+
+	for (int f_i = 0; f_i < f_size; ++f_i)
+		f_positioned += (f_depth[f_i] == 0 && std::isfinite(f_points[f_i].m_x)) ? 1 : 0;
+
+	printf(	"%-16s %d points : mean %.3f px, max %.3f px, %d inside only one of the mappings\n", "depth to color",
+			f_error.m_compared, f_error.m_mean, f_error.m_max, f_error.m_mismatched);
+
+	bool f_ok = true;
+
+	if (!keying::mappings_match(f_error) || f_error.m_mean > MAX_MEAN_ERROR || f_error.m_max > MAX_ERROR || f_error.m_mismatched > 0)
+	{
+		printf("FAIL depth to color : at most %.3f px on average, %.3f px at most, the same points inside the color image\n", MAX_MEAN_ERROR, MAX_ERROR);
+		f_ok = false;
+	}
+
+	if (f_positioned > 0)
+	{
+		printf("FAIL depth to color : %d depth pixels without a depth got a position\n", f_positioned);
+		f_ok = false;
+	}
+
+	return f_ok;
+}
+
+// the depth pixel behind each color pixel of a flat frame, on p_threads threads
+bool color_to_depth(const keying::CameraCalibration &p_calibration, int p_threads, std::vector<keying::ColorPoint> &p_mapped,
+					std::vector<keying::DepthPoint> &p_points, std::vector<keying::DepthPixelPoint> &p_pixels)
+{
+	parallel::acquire_shared_pool(p_threads);
+
+	keying::CoordinateMapper	f_mapper;
+	const std::vector<uint16_t>	f_depth(p_calibration.m_depth_width * p_calibration.m_depth_height, FLAT_DEPTH);
+
+	p_mapped.resize(f_depth.size());
+	p_points.resize(COLOR_WIDTH * COLOR_HEIGHT);
+	p_pixels.resize(COLOR_WIDTH * COLOR_HEIGHT);
+
+	const bool f_ok =	f_mapper.configure(p_calibration, COLOR_WIDTH, COLOR_HEIGHT) &&
+						f_mapper.depth_to_color(f_depth.data(), p_mapped.data()) &&
+						f_mapper.color_to_depth(f_depth.data(), 0, 0, COLOR_WIDTH, COLOR_HEIGHT, p_points.data()) &&
+						f_mapper.color_to_depth(f_depth.data(), 0, 0, COLOR_WIDTH, COLOR_HEIGHT, p_pixels.data());
+
+	parallel::release_shared_pool();
+	return f_ok;
+}
+
+bool test_color_to_depth(const keying::CameraCalibration &p_calibration)
+{
+	std::vector<keying::ColorPoint>			f_mapped;
+	std::vector<keying::DepthPoint>			f_points[2];
+	std::vector<keying::DepthPixelPoint>	f_pixels[2];
+
+	if (!color_to_depth(p_calibration, 1, f_mapped, f_points[0], f_pixels[0]) ||
+		!color_to_depth(p_calibration, POOL_THREADS, f_mapped, f_points[1], f_pixels[1]))
+	{
+		printf("FAIL color to depth : the mapper failed\n");
+		return false;
+	}
+
+	int f_checked = 0;
+	int f_moved	  = 0;
+	int f_lost	  = 0;
+
+	for (int f_y = 0; f_y < p_calibration.m_depth_height; ++f_y)
+	{
+		for (int f_x = 0; f_x < p_calibration.m_depth_width; ++f_x)
+		{
+			const keying::ColorPoint &f_pos = f_mapped[(f_y * p_calibration.m_depth_width) + f_x];
+
+			if (!(f_pos.m_x >= 0.0f && f_pos.m_x < COLOR_WIDTH && f_pos.m_y >= 0.0f && f_pos.m_y < COLOR_HEIGHT))
+				continue;
+
+			const size_t					f_idx	= (static_cast<size_t> (f_pos.m_y) * COLOR_WIDTH) + static_cast<size_t> (f_pos.m_x);
+			const keying::DepthPoint &		f_point = f_points[0][f_idx];
+			const keying::DepthPixelPoint & f_pixel = f_pixels[0][f_idx];
+
+			++f_checked;
+
+			if (std::fabs(f_point.m_x - f_x) > 1.0f || std::fabs(f_point.m_y - f_y) > 1.0f ||
+				f_pixel.m_x != static_cast<int> (f_point.m_x) || f_pixel.m_y != static_cast<int> (f_point.m_y) || f_pixel.m_depth != FLAT_DEPTH)
+			{
+				++f_lost;
+			}
+			else if (f_point.m_x != f_x || f_point.m_y != f_y)
+			{
+				++f_moved;
+			}
+		}
+	}
+
+	bool f_same_threads = true;
+
+	for (size_t f_i = 0; f_i < f_points[0].size() && f_same_threads; ++f_i)
+	{
+		// the color pixels without a depth pixel are -infinity in both
+		f_same_threads =	f_points[0][f_i].m_x == f_points[1][f_i].m_x && f_points[0][f_i].m_y == f_points[1][f_i].m_y &&
+							f_pixels[0][f_i].m_x == f_pixels[1][f_i].m_x && f_pixels[0][f_i].m_y == f_pixels[1][f_i].m_y &&
+							f_pixels[0][f_i].m_depth == f_pixels[1][f_i].m_depth;
+	}
+
+	printf("%-16s %d depth pixels found again, %d of them as a neighbour\n", "color to depth", f_checked - f_lost, f_moved);
+
+	bool f_ok = true;
+
+	if (f_checked == 0 || f_lost > 0)
+	{
+		printf("FAIL color to depth : %d of %d depth pixels were not found at the color pixel they map to\n", f_lost, f_checked);
+		f_ok = false;
+	}
+
+	if (!f_same_threads)
+	{
+		printf("FAIL color to depth : %d threads map differently than one\n", POOL_THREADS);
+		f_ok = false;
+	}
+
+	return f_ok;
+}
+
+} // unnamed namespace
+
+int main(int argc, char *argv[])
+{
+	keying::CameraCalibration	f_calibration;
+	std::vector<Reference>		f_references;
+	std::ifstream				f_file((argc == 3) ? argv[1] : "");
+
+	if (argc != 3 || !keying::read_calibration(f_file, f_calibration) || !read_references(argv[2], f_references))
+	{
+		fprintf(stderr, "usage : %s <data/calibration_v2.txt> <data/mapping_v2.txt>\n", argv[0]);
+		return 1;
+	}
+
+	bool f_ok = true;
+
+	f_ok = test_round_trip(f_calibration) && f_ok;
+	f_ok = test_depth_to_color(f_calibration, f_references) && f_ok;
+	f_ok = test_color_to_depth(f_calibration) && f_ok;
+
+	printf("%s\n", (f_ok) ? "ok" : "FAILED");
+	return (f_ok) ? 0 : 1;
+}
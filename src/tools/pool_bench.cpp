@@ -0,0 +1,203 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	pool_bench.cpp
+//
+// Purpose	: 	time the image work of a frame on the shared pool, from 1 to N threads
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// usage : pool_bench [runs] [threads]
+//
+// the work the streaming thread does for a synthetic 1920x1080 frame of the kinect v2, at the best simd level of the cpu,
+// on a shared pool of 1 to [threads] threads (default : the number of cores) :
+//	- copy : the flipped copy of the frame from RGB32 to RGB24
+//	- nv12 : the frame from YUY2 to NV12 (rows in pairs, the chroma is averaged)
+//	- scale : the frame scaled to 1280x720 RGB32 with the area filter
+//	- mapper : every color pixel mapped to depth space (CoordinateMapper::color_to_depth, a pinhole calibration)
+//	- dispatch : run_stripes of 64 empty stripes, in microseconds : what the pool costs when there is no work to share
+// every output has to be the same as the one of a single thread ; the speedup of the work is against a single thread
+// a pool of more threads than the machine has cores measures the parking of the workers, not the scaling
+
+#include "bench.h"
+#include "coordinate_mapper.h"
+#include "image.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const int SRC_WIDTH		= 1920;
+const int SRC_HEIGHT	= 1080;
+const int SCALE_WIDTH	= 1280;
+const int SCALE_HEIGHT	= 720;
+
+const int DEPTH_WIDTH	= 512;
+const int DEPTH_HEIGHT	= 424;
+const float DEPTH_FOCAL	= 365.0f;
+const float COLOR_FOCAL	= 1060.0f;
+const float BASELINE	= 0.052f;
+
+const int DISPATCH_STRIPES = 64;
+
+struct Image
+{
+	std::vector<unsigned char>	m_pixels;
+	img::ImageView				m_view;
+
+	// twice the size of the packed rows : room for the chroma planes
+	Image(int p_width, int p_height, img::PixelFormat p_format) :
+		m_pixels(img::packed_stride(p_format, p_width) * p_height * 2)
+	{
+		for (size_t f_i = 0; f_i < m_pixels.size(); ++f_i)
+			m_pixels[f_i] = static_cast<unsigned char> ((f_i * 7) ^ (f_i >> 11));
+
+		m_view = img::packed_view(m_pixels.data(), p_width, p_height, p_format);
+	}
+};
+
+keying::CameraCalibration calibration()
+{
+	keying::CameraCalibration f_result;
+
+	f_result.m_depth_width	= DEPTH_WIDTH;
+	f_result.m_depth_height	= DEPTH_HEIGHT;
+	f_result.m_depth_rays.resize(DEPTH_WIDTH * DEPTH_HEIGHT);
+
+	for (int f_y = 0; f_y < DEPTH_HEIGHT; ++f_y)
+	{
+		for (int f_x = 0; f_x < DEPTH_WIDTH; ++f_x)
+		{
+			f_result.m_depth_rays[(f_y * DEPTH_WIDTH) + f_x] = {(f_x + 0.5f - (DEPTH_WIDTH / 2)) / DEPTH_FOCAL,
+																(f_y + 0.5f - (DEPTH_HEIGHT / 2)) / DEPTH_FOCAL};
+		}
+	}
+
+	const float f_projection[12] = {COLOR_FOCAL, 0.0f, SRC_WIDTH / 2.0f, -COLOR_FOCAL * BASELINE,
+									0.0f, COLOR_FOCAL, SRC_HEIGHT / 2.0f, 0.0f,
+									0.0f, 0.0f, 1.0f, 0.0f};
+
+	std::copy(std::begin(f_projection), std::end(f_projection), f_result.m_color_projection);
+	return f_result;
+}
+
+// the outputs of one run of all the work, to compare them between pools
+struct Outputs
+{
+	Image							m_copy;
+	Image							m_nv12;
+	Image							m_scale;
+	std::vector<keying::DepthPoint>	m_points;
+
+	Outputs() :
+		m_copy(SRC_WIDTH, SRC_HEIGHT, img::PF_BGR24),
+		m_nv12(SRC_WIDTH, SRC_HEIGHT, img::PF_NV12),
+		m_scale(SCALE_WIDTH, SCALE_HEIGHT, img::PF_BGRA32),
+		m_points(SRC_WIDTH * SRC_HEIGHT)
+	{
+	}
+
+	bool operator==(const Outputs &p_other) const
+	{
+		for (size_t f_i = 0; f_i < m_points.size(); ++f_i)
+		{
+			if (m_points[f_i].m_x != p_other.m_points[f_i].m_x || m_points[f_i].m_y != p_other.m_points[f_i].m_y)
+				return false;
+		}
+
+		return	m_copy.m_pixels == p_other.m_copy.m_pixels && m_nv12.m_pixels == p_other.m_nv12.m_pixels &&
+				m_scale.m_pixels == p_other.m_scale.m_pixels;
+	}
+};
+
+const int WORK_COUNT = 5;
+const char *WORK_NAMES[WORK_COUNT] = {"copy", "nv12", "scale", "mapper", "dispatch"};
+
+} // unnamed namespace
+
+int main(int argc, char *argv[])
+{
+	const int f_runs	= (argc > 1) ? std::max(atoi(argv[1]), 1) : 50;
+	const int f_threads	= (argc > 2) ? std::max(atoi(argv[2]), 1) : std::max(static_cast<int> (std::thread::hardware_concurrency()), 1);
+
+	const Image					f_bgra(SRC_WIDTH, SRC_HEIGHT, img::PF_BGRA32);
+	const Image					f_yuy2(SRC_WIDTH, SRC_HEIGHT, img::PF_YUY2);
+	const std::vector<uint16_t>	f_depth(DEPTH_WIDTH * DEPTH_HEIGHT, 2000);
+
+	keying::CoordinateMapper f_mapper;
+
+	if (!f_mapper.configure(calibration(), SRC_WIDTH, SRC_HEIGHT))
+		return 1;
+
+	Outputs f_single;
+	Outputs f_pooled;
+	double	f_single_ms[WORK_COUNT - 1] = {};
+	bool	f_ok = true;
+
+	printf("%s, %dx%d, %d cores, ms (speedup)\n", img::simd_level_name(), SRC_WIDTH, SRC_HEIGHT, std::thread::hardware_concurrency());
+	printf("%-8s", "threads");
+
+	for (const char *f_name : WORK_NAMES)
+		printf(" %15s", f_name);
+
+	printf("\n");
+
+	for (int f_count = 1; f_count <= f_threads; ++f_count)
+	{
+		Outputs &f_out = (f_count == 1) ? f_single : f_pooled;
+
+		parallel::acquire_shared_pool(f_count);
+
+		const double f_ms[WORK_COUNT] = {
+			bench::median_ms(f_runs, [&]() {
+				f_ok = img::copy_region(f_bgra.m_view, nullptr, 0, 0, f_out.m_copy.m_view, true) && f_ok;
+				bench::keep(f_out.m_copy.m_pixels.data());
+			}),
+			bench::median_ms(f_runs, [&]() {
+				f_ok = img::copy_region(f_yuy2.m_view, nullptr, 0, 0, f_out.m_nv12.m_view) && f_ok;
+				bench::keep(f_out.m_nv12.m_pixels.data());
+			}),
+			bench::median_ms(f_runs, [&]() {
+				f_ok = img::scale_region(f_bgra.m_view, nullptr, 0, 0, SRC_WIDTH, SRC_HEIGHT, f_out.m_scale.m_view, img::SCALE_AREA) && f_ok;
+				bench::keep(f_out.m_scale.m_pixels.data());
+			}),
+			bench::median_ms(f_runs, [&]() {
+				f_ok = f_mapper.color_to_depth(f_depth.data(), 0, 0, SRC_WIDTH, SRC_HEIGHT, f_out.m_points.data()) && f_ok;
+				bench::keep(f_out.m_points.data());
+			}),
+			1000.0 * bench::median_ms(f_runs, [&]() {
+				parallel::shared_pool()->run_stripes(DISPATCH_STRIPES, 1, [](int, int) {});
+			})
+		};
+
+		parallel::release_shared_pool();
+
+		printf("%-8d", f_count);
+
+		for (int f_i = 0; f_i < WORK_COUNT - 1; ++f_i)
+		{
+			f_single_ms[f_i] = (f_count == 1) ? f_ms[f_i] : f_single_ms[f_i];
+			printf(" %8.2f (%4.1f)", f_ms[f_i], (f_ms[f_i] > 0.0) ? f_single_ms[f_i] / f_ms[f_i] : 0.0);
+		}
+
+		printf(" %15.2f\n", f_ms[WORK_COUNT - 1]);
+
+		if (f_count > 1 && !(f_pooled == f_single))
+		{
+			printf("  %d threads : DIFFERENT\n", f_count);
+			f_ok = false;
+		}
+	}
+
+	return (f_ok) ? 0 : 1;
+}
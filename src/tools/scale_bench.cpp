@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	scale_bench.cpp
+//
+// Purpose	: 	time the scaled resolutions against a crop of the same size
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// usage : scale_bench [runs]
+//
+// the full field of view of a synthetic 1920x1080 color frame of the kinect v2 (RGB32, YUY2 for the YUY2 output) scaled
+// to the resolutions the device offers, single thread, at the best simd level of the cpu :
+//	- crop : a copy of a region of the output size (all that smaller resolutions were before they were scaled)
+//	- area, bilinear : img::scale_region with either filter, the coefficients come from the cache after the first frame
+//	- first frame : the area filter for a region size the cache doesn't have yet (the coefficients are computed)
+
+#include "bench.h"
+#include "image.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+const int SRC_WIDTH		= 1920;
+const int SRC_HEIGHT	= 1080;
+
+struct Size
+{
+	int m_width;
+	int m_height;
+};
+
+const Size				SIZES[]	  = {{1280, 720}, {960, 540}, {640, 360}};
+const img::PixelFormat	FORMATS[] = {img::PF_BGRA32, img::PF_BGR24, img::PF_YUY2, img::PF_NV12};
+
+struct Image
+{
+	std::vector<unsigned char>	m_pixels;
+	img::ImageView				m_view;
+
+	// twice the size of the packed rows : room for the chroma planes
+	Image(int p_width, int p_height, img::PixelFormat p_format) :
+		m_pixels(img::packed_stride(p_format, p_width) * p_height * 2)
+	{
+		for (size_t f_i = 0; f_i < m_pixels.size(); ++f_i)
+			m_pixels[f_i] = static_cast<unsigned char> ((f_i * 7) ^ (f_i >> 11));
+
+		m_view = img::packed_view(m_pixels.data(), p_width, p_height, p_format);
+	}
+};
+
+const char *format_name(img::PixelFormat p_format)
+{
+	switch (p_format)
+	{
+		case img::PF_BGRA32 :	return "RGB32";
+		case img::PF_BGR24 :	return "RGB24";
+		case img::PF_YUY2 :		return "YUY2";
+		case img::PF_NV12 :		return "NV12";
+		default :				return "?";
+	}
+}
+
+} // unnamed namespace
+
+int main(int argc, char *argv[])
+{
+	const int f_runs = (argc > 1) ? std::max(atoi(argv[1]), 1) : 50;
+
+	const Image f_bgra(SRC_WIDTH, SRC_HEIGHT, img::PF_BGRA32);
+	const Image f_yuy2(SRC_WIDTH, SRC_HEIGHT, img::PF_YUY2);
+	bool		f_ok = true;
+
+	printf("%s, from %dx%d, ms\n", img::simd_level_name(), SRC_WIDTH, SRC_HEIGHT);
+	printf("%-6s %-10s %8s %8s %9s %12s\n", "", "", "crop", "area", "bilinear", "first frame");
+
+	for (img::PixelFormat f_format : FORMATS)
+	{
+		const img::ImageView &f_src = (f_format == img::PF_YUY2) ? f_yuy2.m_view : f_bgra.m_view;
+
+		for (const Size &f_size : SIZES)
+		{
+			Image f_dst(f_size.m_width, f_size.m_height, f_format);
+
+			const double f_crop = bench::median_ms(f_runs, [&]() {
+				f_ok = img::copy_region(f_src, nullptr, (SRC_WIDTH - f_size.m_width) / 2, (SRC_HEIGHT - f_size.m_height) / 2, f_dst.m_view) && f_ok;
+				bench::keep(f_dst.m_pixels.data());
+			});
+
+			double f_scaled[2];
+
+			for (img::ScaleFilter f_filter : {img::SCALE_AREA, img::SCALE_BILINEAR})
+			{
+				f_scaled[f_filter] = bench::median_ms(f_runs, [&]() {
+					f_ok = img::scale_region(f_src, nullptr, 0, 0, SRC_WIDTH, SRC_HEIGHT, f_dst.m_view, f_filter) && f_ok;
+					bench::keep(f_dst.m_pixels.data());
+				});
+			}
+
+			// a region that is 2 pixels narrower every time : the coefficients of every call are new
+			int f_shrink = 0;
+
+			const double f_first = bench::median_ms(f_runs, [&]() {
+				f_shrink = (f_shrink + 2) % 400;
+				f_ok = img::scale_region(f_src, nullptr, 0, 0, SRC_WIDTH - f_shrink, SRC_HEIGHT, f_dst.m_view, img::SCALE_AREA) && f_ok;
+				bench::keep(f_dst.m_pixels.data());
+			});
+
+			printf("%-6s %4dx%-5d %8.2f %8.2f %9.2f %12.2f\n", format_name(f_format), f_size.m_width, f_size.m_height,
+				   f_crop, f_scaled[img::SCALE_AREA], f_scaled[img::SCALE_BILINEAR], f_first);
+		}
+	}
+
+	return (f_ok) ? 0 : 1;
+}
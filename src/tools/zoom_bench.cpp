@@ -0,0 +1,195 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// File 	: 	zoom_bench.cpp
+//
+// Purpose	: 	time the tracking zoom against the crop it replaces
+//
+// Copyright (c) 2014	Contributors as noted in the AUTHORS file
+//
+// This file is licensed under the terms of the MIT license,
+// for more details please see LICENSE.txt in the root directory
+// of the provided source or http://opensource.org/licenses/MIT
+//
+///////////////////////////////////////////////////////////////////////////////
+
+// usage : zoom_bench [runs]
+//
+// a synthetic 1920x1080 color frame of the kinect v2 (RGB32, YUY2 for the 4:2:0 output), single thread, at the best simd
+// level of the cpu, the outputs the zoom applies to (cropped resolutions) :
+//	- fixed zooms : the region of device::focus_region scaled to the output the way the device does it (bilinear up to a
+//	  factor 2, the area filter above), zoom 1 is the crop (a copy, without the scaler)
+//	- a walk : 10 seconds at 30 fps of a person who comes from 3 m to 0.7 m and goes back while moving sideways, with the
+//	  smoothing and the steps of the zoom of the video filter (see filter_video.cpp) ; the time of every frame against
+//	  the crop that follows the same person without zooming, and how many frames needed new scaler coefficients
+
+#include "bench.h"
+#include "device.h"
+#include "image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+const int SRC_WIDTH		= 1920;
+const int SRC_HEIGHT	= 1080;
+
+// the zoom of the video filter (filter_video.cpp)
+const float ZOOM_REFERENCE_DEPTH = 2.0f;
+const float ZOOM_MAX			 = 3.0f;
+const float ZOOM_SMOOTHING		 = 0.1f;
+const float ZOOM_STEP			 = 1.0f / 32.0f;
+
+const float ZOOMS[]		 = {1.0f, 1.25f, 1.5f, 1.75f, 2.25f, 3.0f};
+const int	WALK_FRAMES	 = 300;
+
+struct Output
+{
+	int					m_width;
+	int					m_height;
+	img::PixelFormat	m_format;
+	const char *		m_name;
+};
+
+const Output OUTPUTS[] = {
+	{640, 480, img::PF_BGR24, "RGB24  640x480"},
+	{640, 480, img::PF_NV12, "NV12   640x480"},
+	{1280, 720, img::PF_BGRA32, "RGB32 1280x720"}
+};
+
+struct Image
+{
+	std::vector<unsigned char>	m_pixels;
+	img::ImageView				m_view;
+
+	// twice the size of the packed rows : room for the chroma planes
+	Image(int p_width, int p_height, img::PixelFormat p_format) :
+		m_pixels(img::packed_stride(p_format, p_width) * p_height * 2)
+	{
+		for (size_t f_i = 0; f_i < m_pixels.size(); ++f_i)
+			m_pixels[f_i] = static_cast<unsigned char> ((f_i * 7) ^ (f_i >> 11));
+
+		m_view = img::packed_view(m_pixels.data(), p_width, p_height, p_format);
+	}
+};
+
+// the output of a frame : a crop at zoom 1, the scaled region otherwise (see DeviceKinectV2::scaled_color_data)
+bool zoomed_frame(const img::ImageView &p_src, device::Point2D p_focus, float p_zoom, const img::ImageView &p_dst)
+{
+	const device::Region2D f_region = device::focus_region(SRC_WIDTH, SRC_HEIGHT, p_focus, p_dst.m_width, p_dst.m_height, p_zoom);
+
+	if (f_region.m_width == p_dst.m_width && f_region.m_height == p_dst.m_height)
+		return img::copy_region(p_src, nullptr, f_region.m_x, f_region.m_y, p_dst);
+
+	const img::ScaleFilter f_filter = (f_region.m_width < p_dst.m_width * 2) ? img::SCALE_BILINEAR : img::SCALE_AREA;
+
+	return img::scale_region(p_src, nullptr, f_region.m_x, f_region.m_y, f_region.m_width, f_region.m_height, p_dst, f_filter);
+}
+
+// the walk : the distance of the person (meters) and where they are in the image
+float walk_depth(int p_frame)
+{
+	const float f_t = static_cast<float> (p_frame) / WALK_FRAMES;
+	return 3.0f - (2.3f * std::sin(f_t * 3.14159265f));
+}
+
+device::Point2D walk_focus(int p_frame)
+{
+	const float f_t = static_cast<float> (p_frame) / WALK_FRAMES;
+	return {static_cast<int> (960.0f + (500.0f * std::sin(f_t * 6.2831853f))), 400};
+}
+
+struct WalkResult
+{
+	double	m_mean;
+	double	m_max;
+	int		m_new_zooms;
+};
+
+// p_zooming : false follows the person with the crop only
+WalkResult walk(const img::ImageView &p_src, const img::ImageView &p_dst, bool p_zooming, bool &p_ok)
+{
+	WalkResult	f_result  = {0.0, 0.0, 0};
+	float		f_zoom	  = 1.0f;
+	float		f_applied = 1.0f;
+
+	for (int f_frame = 0; f_frame < WALK_FRAMES; ++f_frame)
+	{
+		// the smoothing and the steps of the video filter
+		const float f_target = std::min(std::max(ZOOM_REFERENCE_DEPTH / walk_depth(f_frame), 1.0f), ZOOM_MAX);
+		f_zoom = f_zoom + ((f_target - f_zoom) * ZOOM_SMOOTHING);
+
+		const float f_previous = f_applied;
+
+		if (f_zoom <= 1.0f)
+			f_applied = 1.0f;
+		else if (std::fabs(f_zoom - f_applied) >= ZOOM_STEP)
+			f_applied = std::floor((f_zoom / ZOOM_STEP) + 0.5f) * ZOOM_STEP;
+
+		f_result.m_new_zooms += (p_zooming && f_applied != f_previous) ? 1 : 0;
+
+		const auto f_start = std::chrono::steady_clock::now();
+		p_ok = zoomed_frame(p_src, walk_focus(f_frame), (p_zooming) ? f_applied : 1.0f, p_dst) && p_ok;
+		const auto f_end = std::chrono::steady_clock::now();
+
+		const double f_ms = std::chrono::duration<double, std::milli> (f_end - f_start).count();
+
+		f_result.m_mean += f_ms / WALK_FRAMES;
+		f_result.m_max	 = std::max(f_result.m_max, f_ms);
+	}
+
+	return f_result;
+}
+
+} // unnamed namespace
+
+int main(int argc, char *argv[])
+{
+	const int f_runs = (argc > 1) ? std::max(atoi(argv[1]), 1) : 30;
+
+	const Image f_bgra(SRC_WIDTH, SRC_HEIGHT, img::PF_BGRA32);
+	const Image f_yuy2(SRC_WIDTH, SRC_HEIGHT, img::PF_YUY2);
+	bool		f_ok = true;
+
+	printf("%s, from %dx%d, ms\n", img::simd_level_name(), SRC_WIDTH, SRC_HEIGHT);
+	printf("%-15s", "zoom");
+
+	for (float f_zoom : ZOOMS)
+		printf(" %7.2f", f_zoom);
+
+	printf("   walk : crop mean / max, zoom mean / max, new zooms\n");
+
+	for (const Output &f_output : OUTPUTS)
+	{
+		const img::ImageView &f_src = (f_output.m_format == img::PF_NV12) ? f_yuy2.m_view : f_bgra.m_view;
+		Image				  f_dst(f_output.m_width, f_output.m_height, f_output.m_format);
+
+		printf("%-15s", f_output.m_name);
+
+		for (float f_zoom : ZOOMS)
+		{
+			// a zoom that doesn't fit the sensor image is limited by focus_region
+			if (f_output.m_width * f_zoom > SRC_WIDTH || f_output.m_height * f_zoom > SRC_HEIGHT)
+			{
+				printf(" %7s", "-");
+				continue;
+			}
+
+			printf(" %7.2f", bench::median_ms(f_runs, [&]() {
+				f_ok = zoomed_frame(f_src, {SRC_WIDTH / 2, SRC_HEIGHT / 2}, f_zoom, f_dst.m_view) && f_ok;
+				bench::keep(f_dst.m_pixels.data());
+			}));
+		}
+
+		const WalkResult f_crop = walk(f_src, f_dst.m_view, false, f_ok);
+		const WalkResult f_zoom = walk(f_src, f_dst.m_view, true, f_ok);
+
+		printf("   %5.2f / %5.2f, %5.2f / %5.2f, %d of %d frames\n", f_crop.m_mean, f_crop.m_max, f_zoom.m_mean, f_zoom.m_max, f_zoom.m_new_zooms, WALK_FRAMES);
+	}
+
+	return (f_ok) ? 0 : 1;
+}
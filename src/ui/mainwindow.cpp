@@ -15,6 +15,7 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include <qmessagebox.h>
+#include <qfiledialog.h>
 
 #include "ds_capture.h"
 #include "qt_utils.h"
@@ -106,6 +107,42 @@ void MainWindow::on_cbTracking_stateChanged (int p_state)
 		ui_to_settings();
 }
 
+void MainWindow::on_cbTrackingZoom_stateChanged (int p_state)
+{
+	if (ui->cbTrackingZoom->isChecked() != settings::TrackingZoom)
+		ui_to_settings();
+}
+
+void MainWindow::on_cbTrackingFrameAll_stateChanged (int p_state)
+{
+	if (ui->cbTrackingFrameAll->isChecked() != settings::TrackingFrameAll)
+		ui_to_settings();
+}
+
+void MainWindow::on_selTrackingFilter_currentIndexChanged (int p_index)
+{
+	if (p_index != settings::TrackingFilter)
+		ui_to_settings();
+}
+
+void MainWindow::on_spnTrackingPrediction_valueChanged (int p_value)
+{
+	if (p_value != settings::TrackingPrediction)
+		ui_to_settings();
+}
+
+void MainWindow::on_spnTrackingDeadZone_valueChanged (int p_value)
+{
+	if (p_value != settings::TrackingDeadZone)
+		ui_to_settings();
+}
+
+void MainWindow::on_spnTrackingPanSpeed_valueChanged (int p_value)
+{
+	if (p_value != settings::TrackingPanSpeed)
+		ui_to_settings();
+}
+
 void MainWindow::on_cbKinectV2_stateChanged (int p_state)
 {
 	if (ui->cbKinectV2->isChecked() != settings::KinectV2Enabled)
@@ -124,6 +161,69 @@ void MainWindow::on_cbGreenScreen_stateChanged (int p_state)
 		ui_to_settings();
 }
 
+void MainWindow::on_cbGreenScreenLowRes_stateChanged (int p_state)
+{
+	if (ui->cbGreenScreenLowRes->isChecked() != settings::GreenScreenLowRes)
+		ui_to_settings();
+}
+
+void MainWindow::on_cbGreenScreenSoftEdges_stateChanged (int p_state)
+{
+	if (ui->cbGreenScreenSoftEdges->isChecked() != settings::GreenScreenSoftEdges)
+		ui_to_settings();
+}
+
+void MainWindow::on_selGreenScreenKeying_currentIndexChanged (int p_index)
+{
+	if (p_index != settings::GreenScreenKeying)
+		ui_to_settings();
+}
+
+void MainWindow::on_spnGreenScreenNear_valueChanged (int p_value)
+{
+	if (p_value != settings::GreenScreenNear)
+		ui_to_settings();
+}
+
+void MainWindow::on_spnGreenScreenFar_valueChanged (int p_value)
+{
+	if (p_value != settings::GreenScreenFar)
+		ui_to_settings();
+}
+
+void MainWindow::on_btnGreenScreenBackground_clicked()
+{
+	const QString f_file = QFileDialog::getOpenFileName(this, tr("Background image"), ui->edtGreenScreenBackground->text(),
+														tr("Images (*.bmp *.png *.jpg *.jpeg *.tif *.tiff);;All files (*.*)"));
+
+	if (!f_file.isEmpty())
+	{
+		ui->edtGreenScreenBackground->setText(QDir::toNativeSeparators(f_file));
+		ui_to_settings();
+	}
+}
+
+void MainWindow::on_btnGreenScreenBackgroundClear_clicked()
+{
+	if (!settings::GreenScreenBackground.empty())
+	{
+		ui->edtGreenScreenBackground->clear();
+		ui_to_settings();
+	}
+}
+
+void MainWindow::on_selGreenScreenBlur_currentIndexChanged (int p_index)
+{
+	if (p_index != settings::GreenScreenBlur)
+		ui_to_settings();
+}
+
+void MainWindow::on_cbMirrorOutput_stateChanged (int p_state)
+{
+	if (ui->cbMirrorOutput->isChecked() != settings::MirrorOutput)
+		ui_to_settings();
+}
+
 void MainWindow::on_selTrackingJoint_currentIndexChanged (int p_index)
 {
 	if (p_index != settings::TrackingJoint)
@@ -178,9 +278,25 @@ void MainWindow::ui_from_settings()
 	// effects - tracking
 	ui->cbTracking->setChecked(settings::TrackingEnabled);
 	ui->selTrackingJoint->setCurrentIndex(settings::TrackingJoint);
+	ui->cbTrackingZoom->setChecked(settings::TrackingZoom);
+	ui->cbTrackingFrameAll->setChecked(settings::TrackingFrameAll);
+	ui->selTrackingFilter->setCurrentIndex(settings::TrackingFilter);
+	ui->spnTrackingPrediction->setValue(settings::TrackingPrediction);
+	ui->spnTrackingDeadZone->setValue(settings::TrackingDeadZone);
+	ui->spnTrackingPanSpeed->setValue(settings::TrackingPanSpeed);
 
 	// effects - green screen
 	ui->cbGreenScreen->setChecked(settings::GreenScreenEnabled);
+	ui->cbGreenScreenLowRes->setChecked(settings::GreenScreenLowRes);
+	ui->cbGreenScreenSoftEdges->setChecked(settings::GreenScreenSoftEdges);
+	ui->selGreenScreenKeying->setCurrentIndex(settings::GreenScreenKeying);
+	ui->spnGreenScreenNear->setValue(settings::GreenScreenNear);
+	ui->spnGreenScreenFar->setValue(settings::GreenScreenFar);
+	ui->edtGreenScreenBackground->setText(QString::fromStdWString(settings::GreenScreenBackground));
+	ui->selGreenScreenBlur->setCurrentIndex(settings::GreenScreenBlur);
+
+	// effects - image
+	ui->cbMirrorOutput->setChecked(settings::MirrorOutput);
 
 	// advanced - devices
 	ui->cbKinectV2->setChecked(settings::KinectV2Enabled);
@@ -197,9 +313,25 @@ void MainWindow::ui_to_settings()
 	// effects - tracking
 	settings::TrackingEnabled = ui->cbTracking->isChecked();
 	settings::TrackingJoint	  = ui->selTrackingJoint->currentIndex();
+	settings::TrackingZoom	  = ui->cbTrackingZoom->isChecked();
+	settings::TrackingFrameAll = ui->cbTrackingFrameAll->isChecked();
+	settings::TrackingFilter  = ui->selTrackingFilter->currentIndex();
+	settings::TrackingPrediction = ui->spnTrackingPrediction->value();
+	settings::TrackingDeadZone = ui->spnTrackingDeadZone->value();
+	settings::TrackingPanSpeed = ui->spnTrackingPanSpeed->value();
 
 	// effects - green screen
 	settings::GreenScreenEnabled = ui->cbGreenScreen->isChecked();
+	settings::GreenScreenLowRes	 = ui->cbGreenScreenLowRes->isChecked();
+	settings::GreenScreenSoftEdges = ui->cbGreenScreenSoftEdges->isChecked();
+	settings::GreenScreenKeying	 = ui->selGreenScreenKeying->currentIndex();
+	settings::GreenScreenNear	 = ui->spnGreenScreenNear->value();
+	settings::GreenScreenFar	 = ui->spnGreenScreenFar->value();
+	settings::GreenScreenBackground = ui->edtGreenScreenBackground->text().toStdWString();
+	settings::GreenScreenBlur	 = ui->selGreenScreenBlur->currentIndex();
+
+	// effects - image
+	settings::MirrorOutput = ui->cbMirrorOutput->isChecked();
 
 	// advanced - devices
 	settings::KinectV2Enabled = ui->cbKinectV2->isChecked();
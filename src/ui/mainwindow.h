@@ -33,11 +33,26 @@ class MainWindow : public QMainWindow
 	private slots:
 		void on_selResolution_currentIndexChanged (int p_index);
 		void on_cbTracking_stateChanged (int p_state);
+		void on_cbTrackingZoom_stateChanged (int p_state);
+		void on_cbTrackingFrameAll_stateChanged (int p_state);
+		void on_selTrackingFilter_currentIndexChanged (int p_index);
+		void on_spnTrackingPrediction_valueChanged (int p_value);
+		void on_spnTrackingDeadZone_valueChanged (int p_value);
+		void on_spnTrackingPanSpeed_valueChanged (int p_value);
 		void on_cbKinectV2_stateChanged (int p_state);
 		void on_cbKinectV1_stateChanged (int p_state);
 		void on_selTrackingJoint_currentIndexChanged (int p_index);
 		void on_cbEnablePreview_stateChanged (int p_state);
 		void on_cbGreenScreen_stateChanged (int p_state);
+		void on_cbGreenScreenLowRes_stateChanged (int p_state);
+		void on_cbGreenScreenSoftEdges_stateChanged (int p_state);
+		void on_selGreenScreenKeying_currentIndexChanged (int p_index);
+		void on_spnGreenScreenNear_valueChanged (int p_value);
+		void on_spnGreenScreenFar_valueChanged (int p_value);
+		void on_btnGreenScreenBackground_clicked();
+		void on_btnGreenScreenBackgroundClear_clicked();
+		void on_selGreenScreenBlur_currentIndexChanged (int p_index);
+		void on_cbMirrorOutput_stateChanged (int p_state);
 
 		void on_btnRegister_clicked();
 		void on_btnUnregister_clicked();